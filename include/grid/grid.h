@@ -2,12 +2,15 @@
 #define __GRID_H_
 
 #include "grid/gridPoint.h"
+#include <cstddef>
 
 /**
  * The class represents the base class for all 2D views.
- * It contains a two dimensional array of gridPoints, 
+ * It contains the counters of all cells in two contiguous arrays,
  * the offset (in absolute coordinates) of the grid and
- * the size of the grid.
+ * the size of the grid. The cells are stored row by row in x, i.e.,
+ * the cell (i, j) is found at index i * sizeZ + j. A gridPoint is
+ * only created as a view of a cell on request.
  * The size of the grid must be set during the instanciation of
  * the grid and cant be changed afterwards.
  *
@@ -22,9 +25,12 @@
  */
 class grid
 {
- public:
-    /** Array containing the gridPoints */
-    gridPoint*** points;
+ protected:
+    /** Visit counters of all cells */
+    unsigned int* counts;
+
+    /** Occupied counters of all cells */
+    unsigned int* occupieds;
 
  private:
     /** X offset (absolute coordinate) */
@@ -42,8 +48,14 @@ class grid
     /** @brief The method frees the internal array */
     void clear();
 
-    /** @brief The method allocates and initialises the internal array */
-    void allocate(long maxX, long maxZ);
+    /**
+     * Index of a cell in the internal arrays
+     * @param i the relative x coordinate
+     * @param j the relative z coordinate
+     */
+    inline size_t index(long i, long j) const {
+	return (size_t)i * this->sizeZ + j;
+    }
 
  public:
     /** @brief CTor */
@@ -61,8 +73,71 @@ class grid
     /** @brief Sets the fixed values for a points */
     virtual void setPoint(long x, long z, unsigned int count, unsigned int occupied);
     
+    /** @brief Adds the overlapping part of the given grid to this grid */
+    void addGrid(const grid* g);
+
     /** @brief Returns the point of the absolute coordinates */
-    gridPoint* getAbsolutePoint(long x, long z) const;
+    gridPoint getAbsolutePoint(long x, long z) const;
+
+    /**
+     * Returns a view of a cell
+     * @param i the relative x coordinate
+     * @param j the relative z coordinate
+     */
+    inline gridPoint getPoint(long i, long j) const {
+	size_t k = index(i, j);
+	return gridPoint(this->offsetX + i, this->offsetZ + j,
+			 this->counts[k], this->occupieds[k]);
+    }
+
+    /**
+     * Getter for the visited counter of a cell
+     * @param i the relative x coordinate
+     * @param j the relative z coordinate
+     */
+    inline unsigned int getCount(long i, long j) const {
+	return this->counts[index(i, j)];
+    }
+
+    /**
+     * Getter for the occupied counter of a cell
+     * @param i the relative x coordinate
+     * @param j the relative z coordinate
+     */
+    inline unsigned int getOccupied(long i, long j) const {
+	return this->occupieds[index(i, j)];
+    }
+
+    /**
+     * Occupancy of a cell, see gridPoint::getPercent()
+     * @param i the relative x coordinate
+     * @param j the relative z coordinate
+     */
+    inline float getPercent(long i, long j) const {
+	size_t k = index(i, j);
+	if(this->counts[k] == 0)
+	    return -1.0;
+	return (float)this->occupieds[k] / (float)this->counts[k];
+    }
+
+    /**
+     * Overwrites the counters of a cell
+     * @param i the relative x coordinate
+     * @param j the relative z coordinate
+     */
+    inline void setFixed(long i, long j, unsigned int count, unsigned int occupied) {
+	size_t k = index(i, j);
+	this->counts[k] = count;
+	this->occupieds[k] = occupied;
+    }
+
+    /**
+     * The number of bytes used by the cells
+     * @return size of the cell arrays in bytes
+     */
+    inline size_t getMemoryUsage() const {
+	return 2 * (size_t)this->sizeX * this->sizeZ * sizeof(unsigned int);
+    }
 
     /**
      * Method checks if the given Point is in this grid
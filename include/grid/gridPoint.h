@@ -6,6 +6,8 @@
  * absolute coordinates (x, z), a counter how often the point
  * has been found within a scan and a counter how often it has 
  * been found occupied. 
+ * The grid does not store gridPoints, it returns them as a
+ * copy of a cell on request.
  * 
  * @author Sebastian Stock, Uwe Hebbelmann, Andre Schemschat
  * @date 11.02.2008
@@ -28,6 +30,9 @@ class gridPoint
  public:
     /** @brief CTor */
     gridPoint(long x, long z);
+
+    /** @brief CTor */
+    gridPoint(long x, long z, unsigned int count, unsigned int occupied);
     
     /** @brief Adds amount to the internal counter */
     void addCount(unsigned int count, unsigned int occupied);
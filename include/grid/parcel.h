@@ -20,11 +20,14 @@ class parcel : public grid
     /** @brief Ctor */
     parcel(long offSetX, long offSetZ, long sizeX, long sizeZ);
 
-    /** @brief Adds a grid to the parcel */
-    void addGrid(const grid* grid);
-
     /** @brief Creates a parcel from the file */
     static parcel* readParcel(std::string filename);
+
+    /** @brief Writes the parcel to a binary tile file */
+    bool writeTile(const std::string &filename) const;
+
+    /** @brief Creates a parcel from a binary tile file */
+    static parcel* readTile(const std::string &filename);
 };
 
 #endif
@@ -2,11 +2,13 @@
 #define __PARCELMANAGER_H_
 
 #include <string>
-#include <map>
-using std::map;
+#include <list>
+#include <vector>
+#include <unordered_map>
 
 #include "grid/parcel.h"
 #include "grid/parcelinfo.h"
+#include "grid/scanGrid.h"
 #include <string>
 using std::string;
 
@@ -14,25 +16,50 @@ using std::string;
 #define PARCELINFOFILE "parcelinfo.conf"
 
 /**
- * The parcelmanager manages all views of the map 
+ * The parcelmanager manages all views of the map
  * (Views are represented as parcels)
  * It provides methods for adding scangrids and creating the entire map.
- * It contains an internal memorymanagment for managing the parcels 
- * during runtime.
- * 
- * 
+ *
+ * The parcels are tiles of a fixed size, addressed by their integer tile
+ * coordinates. Only a limited number of them is kept in memory, given by
+ * a memory budget. If the budget is exhausted, the least recently used
+ * parcel is written to its binary tile file and freed. Parcels that have
+ * been written are loaded again on demand.
+ *
  * @author Uwe Hebbelmann, Sebastian Stock, Andre Schemschat
  * @date 15.02.08
  */
 class parcelmanager
 {
  private:
-    /** Typedef for the map */
-    typedef map<parcelinfo*, parcel*> parcelmap;
-    
-    /** The map for all parcelinfos and parcels */
+    /** A parcel and its state in the cache */
+    struct tile
+    {
+	/** Offset and filename of the parcel */
+	parcelinfo *info;
+
+	/** The parcel, NULL if it is not in memory */
+	parcel *data;
+
+	/** The parcel has been changed since it was loaded */
+	bool dirty;
+
+	/** Position in the LRU list, valid if data is set */
+	std::list<long long>::iterator lru;
+    };
+
+    /** Typedef for the map, keyed by the packed tile coordinates */
+    typedef std::unordered_map<long long, tile> parcelmap;
+
+    /** The map for all parcels */
     parcelmap parcels;
 
+    /** Keys of the parcels in memory, the most recently used first */
+    std::list<long long> lru;
+
+    /** The maximal number of parcels in memory */
+    size_t maxLoaded;
+
     /** The width of each parcel */
     int parcelwidth;
     /** The height of each parcel */
@@ -50,34 +77,46 @@ class parcelmanager
     long minX;
     /** The maximal found x value */
     long maxX;
-    
+
     /** The minimal found z value */
     long minZ;
     /** The maximal found z value */
     long maxZ;
 
-    
+    /** Number of parcels loaded from disk */
+    unsigned long loads;
+    /** Number of parcels written to disk */
+    unsigned long stores;
+
+
     /** The path where all infos should be stored */
     string path;
 
-    /** @brief The method frees each (not used) parcel */ 
-    void freeMemory(bool all);
+    /** @brief The method saves and frees each parcel in memory */
+    void freeMemory();
 
     /** @brief The method clears all internal data */
     void clear();
 
-    /** @brief The method loads a parcel specified by info */
-    void loadParcel(parcelinfo *info);
+    /** @brief The method writes the parcel to disk and frees it */
+    void evict(tile &t);
+
+    /** @brief Returns the parcel of the tile, loading or creating it */
+    parcel* acquire(long tileX, long tileZ, bool create = true);
+
+    /** @brief Returns the tile coordinate of an absolute coordinate */
+    static long tileCoord(long v, long size);
 
-    /** @brief The method creates a new parcel */
-    void createParcel(long x, long z);
+    /** @brief Packs tile coordinates into a key of the map */
+    static long long tileKey(long tileX, long tileZ);
 
     /** @brief Method keeps min/Max-X/Z up to date */
     void updateOuterPoints(const grid* g);
 
  public:
     /** @brief CTor */
-    parcelmanager(long width, long height, string path, int resolution, bool resume);
+    parcelmanager(long width, long height, string path, int resolution, bool resume,
+		  size_t memoryBudget = 512 * 1024 * 1024);
 
     /** @brief Dtor */
     ~parcelmanager();
@@ -85,6 +124,9 @@ class parcelmanager
     /** @brief The method adds a grid to all affected parcels */
     void addGrid(const grid* g, long vpX, long vpZ);
 
+    /** @brief The method adds several grids, one parcel at a time */
+    void addGrids(const std::vector<scanGrid*> &grids);
+
     /** @brief The method saves the infos created so far */
     void saveParcelinfo(string filename);
 
@@ -94,8 +136,22 @@ class parcelmanager
     /** @brief The method combines all parcels to a worldmap and writes it */
     void writeWorld(string filename);
 
+    /** @brief Writes the worldmap as ppm, one row of parcels at a time */
+    void writeWorldPPM(string filename);
+
     /** @brief Merges all parcels into one grid and returns it */
     grid* createWorldGrid();
+
+    /**
+     * The number of parcels written to and read from disk
+     */
+    inline unsigned long getStores() const { return this->stores; }
+    inline unsigned long getLoads() const { return this->loads; }
+
+    /**
+     * The maximal number of parcels in memory
+     */
+    inline size_t getMaxLoaded() const { return this->maxLoaded; }
 };
 
 #endif
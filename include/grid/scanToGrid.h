@@ -4,6 +4,7 @@
 #include "grid/scanGrid.h"
 #include "slam6d/scan.h"
 #include "slam6d/globals.icc"
+#include <vector>
 
 #define WAYPOINTWEIGHT 10
 #define SOLIDWEIGHT 5000
@@ -57,11 +58,14 @@ class scanToGrid
 	return this->minimalWeighting * distance + 1; 
     }
 
-    /** @brief Calculates the normvector for the vector (x|z) */
-    void calculateNormvector(long x, long z, double& xnorm, double &znorm);
+    /** @brief Projects the relevant points of the scan to grid cells */
+    void projectPoints(Scan& scan, std::vector<long>& cells) const;
 
     /** @brief Creates a new grid and sets the offsets */
-    scanGrid* createGrid(Scan& scan, const double* transformation);
+    scanGrid* createGrid(const std::vector<long>& cells, const double* transformation);
+
+    /** @brief Adds an occupied cell with its waypoints and neighbours */
+    void rasterize(scanGrid* grid, long x, long z);
 
     /** @brief Creates the free points between the robot and the occupied point */
     void createWaypoints(scanGrid* grid, long x, long z, float weighting);
@@ -76,10 +80,10 @@ class scanToGrid
     void killAlonePoints(scanGrid* grid, int distance, int neighbours);
  
     /** @brief Checks if the points lies within the relevant area */
-    bool isPointRelevant(const Point& p) const;
+    bool isPointRelevant(const double* p) const;
 
     /** @brief Converts the coordinate of a scanpoint to the grid raster */
-    long scaleToGrid(double point);
+    long scaleToGrid(double point) const;
         
  public:
     /** @brief Ctor*/
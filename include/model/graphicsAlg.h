@@ -14,6 +14,9 @@
 //==============================================================================
 #include "model/plane3d.h"
 #include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
 
 #include <CGAL/Simple_cartesian.h>
 #include <CGAL/Filtered_kernel.h>
@@ -95,8 +98,96 @@ public:
      */
     static void getDiscreteLine(model::Point3d src, model::Point3d dest, double precision, const double& extraDist,
             std::vector<model::Point3d>& line);
+
+    /**
+     * Walks the discrete line getDiscreteLine() computes, without storing it.
+     * The visitor is called with the coordinates of each point multiplied by
+     * 10^precision, which are integers, and stops the walk by returning true.
+     * @return true if the visitor stopped the walk
+     */
+    template <class Visitor>
+    static bool walkDiscreteLine(model::Point3d src, model::Point3d dest, double precision, const double& extraDist,
+            Visitor& visit);
 };
 
+template <class Visitor>
+bool GraphicsAlg::walkDiscreteLine(Point3d src, Point3d dest, double precision, const double& extraDist,
+        Visitor& visit)
+{
+    // add the extra distance
+    double len = src.distance(dest);
+    double temp = (len + extraDist) / len;
+    dest.x = src.x + (dest.x - src.x) * temp;
+    dest.y = src.y + (dest.y - src.y) * temp;
+    dest.z = src.z + (dest.z - src.z) * temp;
+
+    // round up the values
+    precision = round(precision);
+
+    src.x = round(src.x);
+    src.y = round(src.y);
+    src.z = round(src.z);
+
+    dest.x = round(dest.x);
+    dest.y = round(dest.y);
+    dest.z = round(dest.z);
+
+    // adjust according to precision
+    const double coef = pow(10.0, precision);
+    src  *= coef;
+    dest *= coef;
+
+    double p[] = {src.x, src.y, src.z};
+    double e[] = {dest.x, dest.y, dest.z};
+    double a[3], s[3];
+    for (int k = 0; k < 3; ++k) {
+        double d = e[k] - p[k];
+        a[k] = 2 * fabs(d);
+        s[k] = d > 0 ? +1.0 : -1.0;
+    }
+
+    // the dominant axis m is moved in every step, u and v when their error is due
+    int m, u, v;
+    if (a[0] >= std::max(a[1], a[2])) {
+        m = 0; u = 1; v = 2;
+    } else if (a[1] >= std::max(a[0], a[2])) {
+        m = 1; u = 0; v = 2;
+    } else if (a[2] >= std::max(a[0], a[1])) {
+        m = 2; u = 0; v = 1;
+    } else {
+        throw std::logic_error("invalid branch taken while computing discrete line");
+    }
+
+    double ud = a[u] - a[m] / 2.0;
+    double vd = a[v] - a[m] / 2.0;
+
+    while (1) {
+        if (visit(p[0], p[1], p[2])) {
+            return true;
+        }
+
+        if (p[m] == e[m]) {
+            break;
+        }
+
+        if (ud >= 0) {
+            p[u] += s[u];
+            ud   -= a[m];
+        }
+
+        if (vd >= 0) {
+            p[v] += s[v];
+            vd   -= a[m];
+        }
+
+        p[m] += s[m];
+        ud   += a[u];
+        vd   += a[v];
+    }
+
+    return false;
+}
+
 } /* namespace model */
 
 #endif /* GRAPHICSALG_H_ */
@@ -99,6 +99,12 @@ public:
      */
     std::pair<double, double> depthMapDistances;
 
+    /**
+     * The index of the surface in the scene, walls first, then ceiling and
+     * floor. Keeps the debug images of the surfaces apart.
+     */
+    int index;
+
     // constructores and destructors
     LabeledPlane3d();
     LabeledPlane3d(const Point3d& pt, const Vector3d& normal);
@@ -110,6 +116,11 @@ public:
     // operators
     LabeledPlane3d& operator=(const LabeledPlane3d& other);
 
+    /**
+     * Returns the file of the debug image with the given name for this surface.
+     */
+    std::string imageName(const std::string& name) const;
+
     /**
      * Computes the Canny for this wall using the depth image.
      */
@@ -0,0 +1,127 @@
+/**
+ * @file occupancyGrid.h
+ *
+ * A bit-packed occupancy grid used for ray casting in the scene.
+ */
+
+#ifndef OCCUPANCYGRID_H_
+#define OCCUPANCYGRID_H_
+
+//==============================================================================
+//  Includes
+//==============================================================================
+#include "model/point3d.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace model {
+
+/**
+ * An occupancy grid over the points of a lattice with spacing 1 / coef. A
+ * lattice point is occupied if the cube of the given width centered at it
+ * contains a point of the scene. The lattice is split into blocks of 16^3
+ * points, each stored as one bit. Only blocks containing occupied points are
+ * allocated, a hash map from the block coordinates refers to them, so the
+ * memory does not depend on the extent of the scene.
+ */
+class OccupancyGrid {
+private:
+    // private fields
+    static const int BLOCK_BITS  = 4;                      //!< log2 of the lattice points per block side.
+    static const int BLOCK_SIDE  = 1 << BLOCK_BITS;        //!< The lattice points per block side.
+    static const int BLOCK_MASK  = BLOCK_SIDE - 1;
+    static const int BLOCK_WORDS = BLOCK_SIDE * BLOCK_SIDE * BLOCK_SIDE / 64; //!< The words of a block.
+
+    /**
+     * The coordinates of a block, the lattice indices divided by BLOCK_SIDE.
+     */
+    struct BlockKey {
+        long x, y, z;
+
+        BlockKey(long x, long y, long z) : x(x), y(y), z(z) {}
+
+        inline bool operator==(const BlockKey& other) const {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    struct BlockHash {
+        inline size_t operator()(const BlockKey& key) const {
+            unsigned long long h = static_cast<unsigned long long>(key.x) * 73856093ULL
+                                 ^ static_cast<unsigned long long>(key.y) * 19349663ULL
+                                 ^ static_cast<unsigned long long>(key.z) * 83492791ULL;
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+    };
+
+    typedef std::unordered_map<BlockKey, int, BlockHash> BlockMap;
+
+    bool built;                        //!< The grid has been built.
+    long minBlock[3];                  //!< The first block of the bounding box.
+    long maxBlock[3];                  //!< The last block of the bounding box.
+    BlockMap blockIndex;               //!< The allocated block of each block containing occupied points.
+    std::vector<unsigned long long> bits; //!< The occupancy bits of the allocated blocks.
+
+public:
+    // public methods
+    OccupancyGrid();
+
+    /**
+     * Marks the lattice points whose cube contains one of the points.
+     * @param points the points of the scene
+     * @param width the width of the cube around each lattice point
+     * @param coef the number of lattice points per unit
+     */
+    void build(const std::vector<Point3d>& points, const double& width, const double& coef);
+
+    /**
+     * Returns true if the lattice point with the given indices is occupied.
+     */
+    inline bool isOccupied(const long& x, const long& y, const long& z) const {
+        long bx = x >> BLOCK_BITS;
+        long by = y >> BLOCK_BITS;
+        long bz = z >> BLOCK_BITS;
+        if (bx < minBlock[0] || bx > maxBlock[0] || by < minBlock[1] || by > maxBlock[1]
+                || bz < minBlock[2] || bz > maxBlock[2]) {
+            return false;
+        }
+
+        BlockMap::const_iterator found = blockIndex.find(BlockKey(bx, by, bz));
+        if (found == blockIndex.end()) {
+            return false;
+        }
+
+        int block = found->second;
+
+        int bit = (((z & BLOCK_MASK) << BLOCK_BITS | (y & BLOCK_MASK)) << BLOCK_BITS) | (x & BLOCK_MASK);
+        return (bits[static_cast<size_t>(block) * BLOCK_WORDS + (bit >> 6)] >> (bit & 63)) & 1;
+    }
+
+    /**
+     * Returns true if the grid has been built.
+     */
+    inline bool isBuilt() const {
+        return built;
+    }
+
+    /**
+     * Returns the number of allocated blocks.
+     */
+    inline unsigned long getNrAllocatedBlocks() const {
+        return bits.size() / BLOCK_WORDS;
+    }
+
+private:
+    // private methods
+
+    /**
+     * Computes the range of lattice indices whose interval of the given half
+     * width contains the coordinate, lo > hi if there is none.
+     */
+    static void cellRange(const double& p, const double& halfWidth, const double& coef, long& lo, long& hi);
+};
+
+} /* namespace model */
+
+#endif /* OCCUPANCYGRID_H_ */
@@ -15,6 +15,7 @@
 #include "model/point3d.h"
 #include "model/vector3d.h"
 #include "model/labeledPlane3d.h"
+#include "model/occupancyGrid.h"
 
 #include "shapes/hough.h"
 #include "shapes/shape.h"
@@ -55,6 +56,7 @@ public:
     SearchTree *octTree;               //!< An efficient octree containing the points.
     double **octTreePoints;            //!< Used to construct the octree.
     unsigned int nrPoints;             //!< The total number of points in the octree.
+    OccupancyGrid occupancy;           //!< Occupancy of the points of the rays, built on first use.
 
     std::vector<Point3d> points;       //!< The 3d point cloud.
     std::vector<Plane3d> planes;       //!< The list of planes in our scene.
@@ -121,14 +123,14 @@ public:
 
     /**
      * Performs ray casting from source point to destination and returns true
-     * if the ray successfully reached the destination point, returning the
-     * point it hit along the way.
+     * if the ray hit something on its way, returning the point it hit. The
+     * points of the discrete line are looked up in the occupancy grid.
      */
     bool castRay(const model::Point3d& src, const model::Point3d& dest, const double& extraDist,
             Point3d& ptHit);
 
     /**
-     * Applies labels to the given plane.
+     * Applies labels to the given plane, the patches are labeled in parallel.
      */
     void applyLabels(LabeledPlane3d& surf);
 
@@ -145,10 +147,11 @@ public:
 
     /**
      * Applies KMeans clustering to the multiple windows yielding only one possible window for each cluster.
+     * The initial centers are drawn from rng.
      * Does not work with OpenCV 2.4.0!!!
      */
     void clusterOpenings(const LabeledPlane3d& surf, const std::vector<CandidateOpening>& openings,
-            std::vector<CandidateOpening>& result) const;
+            std::vector<CandidateOpening>& result, cv::RNG& rng) const;
 
     /**
      * Returns all openings, after deciding which are the correct ones.
@@ -157,9 +160,19 @@ public:
             std::vector<CandidateOpening>& result);
 
     /**
-     * Corrects an image to fill in missing data.
+     * Corrects an image to fill in missing data, the noise is drawn from rng.
      */
-    void correct(LabeledPlane3d& surf, const std::vector<CandidateOpening>& openings);
+    void correct(LabeledPlane3d& surf, const std::vector<CandidateOpening>& openings, cv::RNG& rng);
+
+    /**
+     * Adds the final openings of all surfaces and corrects them, the surfaces
+     * are processed in parallel. Each surface draws from its own random
+     * number generator seeded with its index, so the result does not depend
+     * on the threads. The openings are added in the order walls, ceiling,
+     * floor, and the time in ms spent on each surface is returned in the same
+     * order.
+     */
+    void correctAllSurfaces(std::vector<unsigned long>& times);
 
     /**
      * Writes the walls to appropriate files in the given folder.
@@ -180,16 +193,25 @@ private:
     // private methods
 
     /**
-     * Floods a point on the labeling matrix with the other given value.
+     * Floods a point on the labeling matrix with the other given value. The
+     * fill goes span by span along the rows and keeps its seeds on the heap.
      */
     void flood(LabeledPlane3d& surf,
             const int& i, const int& j,
             const Label& target, const Label& replacement);
 
     /**
-     * Returns true if the cube centered at the given coordinates is occupied.
+     * Returns the final openings of the surface, both as candidates and as
+     * planes, without adding them to the scene.
+     */
+    void computeFinalOpenings(const LabeledPlane3d& surf,
+            std::vector<CandidateOpening>& result, std::vector<Plane3d>& surfOpenings, cv::RNG& rng);
+
+    /**
+     * Builds the occupancy grid from the points, a lattice point of the rays
+     * is occupied if the cube of width RAY_DIST centered at it contains a point.
      */
-    bool isOccupied(const Point3d& center, const double& width);
+    void buildOccupancy();
 
 };
 
@@ -15,7 +15,13 @@
 #include "model/vector3d.h"
 
 #include <stdlib.h>
+#include <string>
 #include <vector>
+#include <sstream>
+
+namespace cv {
+class Mat;
+}
 
 namespace model {
 
@@ -50,6 +56,36 @@ bool fileIsDir(const std::string& fileName);
  */
 bool makeDir(const std::string& path);
 
+/**
+ * Writes a debug image to the given file. The surfaces of a scene are processed
+ * in parallel, so the writes are serialized.
+ */
+void writeImage(const std::string& file, const cv::Mat& img);
+
+/**
+ * Collects a line of progress output and prints it to cout at once when
+ * destroyed, so the lines of surfaces processed in parallel do not mix.
+ * Used as a temporary: ProgressLine() << "** Done" << std::endl;
+ */
+class ProgressLine {
+private:
+    std::ostringstream line;
+
+public:
+    ~ProgressLine();
+
+    template <class T>
+    ProgressLine& operator<<(const T& value) {
+        line << value;
+        return *this;
+    }
+
+    ProgressLine& operator<<(std::ostream& (*manip)(std::ostream&)) {
+        line << manip;
+        return *this;
+    }
+};
+
 /**
  * definition of x^2
  */
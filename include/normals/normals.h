@@ -10,6 +10,10 @@
 #include <opencv2/opencv.hpp>
 #endif
 
+/*
+ * The k nearest neighbor methods run in parallel on a shared k-d tree. The
+ * neighbors are found exactly, eps is kept for compatibility only.
+ */
 void calculateNormalsApxKNN(std::vector<Point> &normals,
 					   vector<Point> &points,
 					   int k,
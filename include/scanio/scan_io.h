@@ -27,6 +27,8 @@
  */
 class ScanIO {
 public:
+  virtual ~ScanIO() {}
+
   /**
    * Read a directory and return all possible scans in the [start,end] interval.
    *
@@ -62,6 +64,17 @@ public:
    * @return whether it's supported or not
    */
   virtual bool supports(IODataType type) = 0;
+
+  /**
+   * Returns the files a scan is read from, if they are not the files
+   * scan<identifier>.* in its directory, e.g. for formats keeping all scans
+   * in one file. Used to detect changed scans.
+   *
+   * @param dir_path The directory the scan is contained in
+   * @param identifier IO-specific identifier for the particular scan
+   * @return paths of the files, empty for the files scan<identifier>.*
+   */
+  virtual std::list<std::string> readFiles(const char* dir_path, const char* identifier) { return std::list<std::string>(); }
   
   /**
    * @brief Global mapping of io_types to single instances of ScanIOs.
@@ -11,20 +11,29 @@
 using std::string;
 #include <vector>
 using std::vector;
+#include <cstdio>
 
 #include "scan_io.h"
 
 /**
  * @brief 3D scan loader for VELODYNE scans
  *
+ * All revolutions are stored in a single file scan.bin. Each revolution is
+ * decoded from its offset, only its pages are mapped into memory. The
+ * reader keeps no state between calls, so scans can be read concurrently.
+ *
  * The compiled class is available as shared object file
  */
 class ScanIO_velodyne : public ScanIO {
 public:
+  ScanIO_velodyne();
+  virtual ~ScanIO_velodyne();
+
   virtual std::list<std::string> readDirectory(const char* dir_path, unsigned int start, unsigned int end);
   virtual void readPose(const char* dir_path, const char* identifier, double* pose);
   virtual void readScan(const char* dir_path, const char* identifier, PointFilter& filter, std::vector<double>* xyz, std::vector<unsigned char>* rgb, std::vector<float>* reflectance, std::vector<float>* temperature, std::vector<float>* amplitude, std::vector<int>* type, std::vector<float>* deviation);
   virtual bool supports(IODataType type);
+  virtual std::list<std::string> readFiles(const char* dir_path, const char* identifier);
 
   int fileCounter;
 };
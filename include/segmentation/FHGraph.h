@@ -13,16 +13,20 @@
 #define __FHGRAPH_H_
 
 #include <vector>
-#include <list>
 
 #include <slam6d/point.h>
 #include <slam6d/scan.h>
 #include <segmentation/segment-graph.h>
-#include <ANN/ANN.h>
 
 class FHGraph {
 public:
     FHGraph(std::vector< Point >& ps, double weight(Point, Point), double sigma, double eps, int neighbors, float radius);
+    ~FHGraph();
+
+    /**
+     * Returns the edges of the graph. The caller owns the array and has to
+     * delete[] it, the graph does not keep it.
+     */
     edge* getGraph();
     Point operator[](int index);
     int getNumPoints();
@@ -34,7 +38,7 @@ private:
     void do_gauss(double sigma);
     void without_gauss();
 
-    std::vector<edge> edges;
+    edge* edges;
     std::vector<Point>& points;
     int V;
     int E;
@@ -44,7 +48,9 @@ private:
 
 
     struct he{ int x; float w; };
-    std::vector< std::list<he> > adjency_list;
+    // the neighbors of point i are adjacency[first[i]] .. adjacency[first[i+1]-1]
+    std::vector<int> first;
+    std::vector<he> adjacency;
 };
 
 #endif
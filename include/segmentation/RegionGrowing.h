@@ -0,0 +1,122 @@
+/**
+  * Point Cloud Segmentation by Region Growing over Voxels
+  *
+  * Copyright (C) Jacobs University Bremen
+  *
+  * Released under the GPL version 3.
+  *
+  */
+
+
+#ifndef __REGIONGROWING_H_
+#define __REGIONGROWING_H_
+
+#include <vector>
+
+#include <slam6d/data_types.h>
+
+/**
+ * Parameters of the region growing.
+ */
+struct RegionGrowingParams {
+    double voxelSize;       //!< side length of the voxels
+    double blockSize;       //!< side length of the blocks that are processed at once
+    double maxAngle;        //!< maximal angle between the normals of neighboring voxels in degrees
+    double maxReflectance;  //!< maximal difference of the mean reflectance of neighboring voxels, < 0 to ignore it
+    unsigned int minSize;   //!< segments with fewer points are not written
+
+    RegionGrowingParams() :
+        voxelSize(5.0), blockSize(500.0), maxAngle(10.0), maxReflectance(-1.0), minSize(0) {}
+};
+
+/**
+ * Receives the segments as soon as they are complete.
+ */
+class SegmentWriter {
+public:
+    virtual ~SegmentWriter() {}
+
+    /**
+     * @param points indices of the points of the segment, ascending
+     */
+    virtual void write(const std::vector<unsigned int>& points) = 0;
+};
+
+/**
+ * Segments a scan by growing regions over the voxels of a grid. Neighboring
+ * voxels belong to the same region if their normals, fitted to the points
+ * of the voxel and its neighbors, and their mean reflectance are similar.
+ *
+ * The scan is swept along the x axis in layers of blocks. The blocks of a
+ * layer are grown in parallel, then the regions are merged across the
+ * block borders within the layer and with the previous layer. A region
+ * that does not reach into the current layer cannot grow anymore and is
+ * written right away. Besides the input and one index per point, the
+ * memory used depends on the size of two layers and of the open regions,
+ * not on the size of the scan.
+ */
+class RegionGrowing {
+public:
+    RegionGrowing(const RegionGrowingParams& params);
+
+    /**
+     * Segments the points and hands the segments to the writer.
+     *
+     * @param xyz the points
+     * @param reflectance the reflectance of the points, may be empty
+     * @param writer receives the segments of at least minSize points
+     * @return the number of segments written
+     */
+    int segment(const DataXYZ& xyz, const DataReflectance& reflectance, SegmentWriter& writer);
+
+private:
+    struct Voxel {
+        long long key;      //!< global voxel index
+        int first, count;   //!< range of the points in Block::points
+        double normal[3];
+        bool hasNormal;
+        float reflectance;  //!< mean reflectance
+        int segment;        //!< region within the block
+    };
+
+    struct Block {
+        int by, bz;
+        int nrSegments;
+        int base;                           //!< global id of the first region
+        std::vector<unsigned int> points;   //!< point indices, grouped by region
+        std::vector<int> segmentStart;      //!< start of each region in points
+        std::vector<Voxel> border;          //!< voxels on the faces, sorted by key
+    };
+
+    void computeBounds(const DataXYZ& xyz);
+    bool voxelOf(const double* p, long long v[3]) const;
+    long long voxelKey(long long x, long long y, long long z) const;
+    void growBlock(const DataXYZ& xyz, const DataReflectance& reflectance,
+                   const unsigned int* indices, int n, Block& block) const;
+    bool compatible(const Voxel& a, const Voxel& b) const;
+    const Voxel* findBorder(const Block& block, long long key) const;
+    void mergeBorders(const std::vector<Block>& blocks, const std::vector<int>& blockAt,
+                      const std::vector<Block>& previous, const std::vector<int>& previousAt);
+
+    int find(int x);
+    void join(int a, int b);
+    void compact(std::vector<Block>& current, int firstCurrent, std::vector<int>& open);
+
+    RegionGrowingParams params;
+    double cosAngle;
+    bool useReflectance;
+
+    double min[3];
+    long long voxels[3];        //!< voxels of the grid along each axis
+    int blockVoxels;            //!< voxels of a block along each axis
+    int blocks[3];              //!< blocks along each axis
+    int layer;                  //!< the layer being merged
+
+    // regions of the open roots and the last layer, as a disjoint-set forest
+    std::vector<int> parent;
+    std::vector<int> rank;
+    std::vector<int> lastLayer;                         //!< last layer a region reaches into
+    std::vector< std::vector<unsigned int> > members;   //!< points of each root
+};
+
+#endif
@@ -19,7 +19,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
 #ifndef DISJOINT_SET
 #define DISJOINT_SET
 
-// disjoint-set forests using union-by-rank and path compression (sort of).
+// disjoint-set forests using union-by-rank and path compression.
 
 typedef struct {
     int rank;
@@ -1,9 +1,11 @@
 #ifndef __ACCUMULATOR__
 #define __ACCUMULATOR__
 #include <set>
+#include <vector>
 #include "shapes/ConfigFileHough.h"
 #include "slam6d/point.h"
 using std::multiset;
+using std::vector;
 #include "shapes/hsm3d.h"
 
 
@@ -25,13 +27,13 @@ class Accumulator {
     /** TODO */
     int count;
     /** Constructor */
-    Accumulator() { }
+    Accumulator();
     /** Destructor */
-    virtual ~Accumulator() { }
+    virtual ~Accumulator();
     /** Prints the accumulator so that the data can be shown using gnuplot */
     virtual void printAccumulator() = 0;
     /** Sets the counters for each accumulator cells back to 0 */
-    virtual void resetAccumulator() = 0;
+    virtual void resetAccumulator();
     /** Accumulates the cell containing theta, phi and rho.
      * A plane is represented by:
      * rho = cos(theta)*sin(phi)*x + sin(phi)*sin(theta)*y + cos(phi)*z
@@ -45,7 +47,15 @@ class Accumulator {
      * rho = cos(theta)*sin(phi)*x + sin(phi)*sin(theta)*y + cos(phi)*z
      * @param p the point that is transformed into Hough Space
      */
-    virtual void accumulate(Point p) = 0;
+    virtual void accumulate(Point p);
+    /** Accumulates all the cells that correspond to planes that go through
+     * any of the points. The counters are the same as after calling
+     * accumulate(Point) for each point. The points are voted in blocks, each
+     * thread counts the votes of its own normal directions, so no cell is
+     * written by two threads and no copies of the accumulator are needed.
+     * @param points the points that are transformed into Hough Space
+     */
+    virtual void accumulate(const vector<Point> &points);
     /** Accumulates all the cells that correspond to planes that go through p.
      * @param p the point that is transformed into Hough Space
      * @return the plane whose counter has exceeded the 
@@ -90,6 +100,50 @@ class Accumulator {
      * @param the size of the window
      */
     virtual void peakWindow(int size) = 0;
+
+  protected:
+    /** Number of normal directions, i.e., cells for each rho */
+    int nrDirections;
+    /** Unit normal vector of each direction, 3 values per direction */
+    double *normals;
+    /** Theta and phi of each direction, 2 values per direction */
+    double *polars;
+    /** Accumulator indices of each direction, 3 values per direction */
+    int *indices;
+    /** Center of each rho cell */
+    double *rhos;
+    /** Counters of all cells, allocated in one block */
+    int *counters;
+    /** Offset of the first rho cell of each direction in counters */
+    long *cellOffset;
+    /** Distance between two neighbouring rho cells of one direction */
+    long rhoStride;
+    /** Number of counters */
+    long nrCounters;
+
+    /**
+     * Allocates the tables for the given number of directions and the
+     * counters. The rho cells of a direction are either consecutive
+     * (rhoInner) or one direction apart. The subclass fills in normals,
+     * polars and indices in the order it visits the directions.
+     */
+    void initAccumulator(int directions, bool rhoInner);
+    /** Returns the counter of the given direction and rho cell */
+    inline int& counter(int direction, int k) {
+      return counters[cellOffset[direction] + k * rhoStride];
+    }
+    /**
+     * Votes for p in all directions until a counter exceeds AccumulatorMax
+     * and PlaneRatio of all votes or peak.
+     * @return true if such a counter has been found in direction and rho
+     * cell k
+     */
+    bool accumulateUntil(const Point &p, unsigned int peak, int &direction, int &k);
+    /**
+     * Votes for p in all directions.
+     * @return the highest counter touched, found in direction and rho cell k
+     */
+    int accumulateMax(const Point &p, int &direction, int &k);
 };
 
 /**
@@ -102,9 +156,8 @@ class AccumulatorSimple : public Accumulator {
     AccumulatorSimple(ConfigFileHough myCfg);
     virtual ~AccumulatorSimple();
     virtual void printAccumulator();
-    void resetAccumulator();
     bool accumulate(double theta, double phi, double rho);
-    void accumulate(Point p);
+    using Accumulator::accumulate;
     double* accumulateRet(Point p);
     int* accumulateAPHT(Point p);
     double* getMax(double &rho, double &theta, double &phi);
@@ -125,10 +178,9 @@ class AccumulatorCube : public Accumulator {
     virtual ~AccumulatorCube();
     virtual void printAccumulator();
     void printAccumulator2();
-    void resetAccumulator();
     void peakWindow(int size);
     bool accumulate(double theta, double phi, double rho);
-    void accumulate(Point p);
+    using Accumulator::accumulate;
     double* accumulateRet(Point p);
     int* accumulateAPHT(Point p);
     double* getMax(double &rho, double &theta, double &phi);
@@ -153,9 +205,8 @@ class AccumulatorBall : public Accumulator {
     AccumulatorBall(ConfigFileHough myCfg);
     virtual ~AccumulatorBall();
     virtual void printAccumulator();
-    void resetAccumulator();
     bool accumulate(double theta, double phi, double rho);
-    void accumulate(Point p);
+    using Accumulator::accumulate;
     double* accumulateRet(Point p);
     int* accumulateAPHT(Point p);
     double* getMax(double &rho, double &theta, double &phi);
@@ -179,9 +230,8 @@ class AccumulatorBallI : public Accumulator {
     AccumulatorBallI(ConfigFileHough myCfg);
     virtual ~AccumulatorBallI();
     virtual void printAccumulator();
-    void resetAccumulator();
     bool accumulate(double theta, double phi, double rho);
-    void accumulate(Point p);
+    using Accumulator::accumulate;
     double* accumulateRet(Point p);
     int* accumulateAPHT(Point p);
     double* getMax(double &rho, double &theta, double &phi);
@@ -7,6 +7,7 @@
 #include "slam6d/point.h"
 #include "slam6d/scan.h"
 #include "shapes/accumulator.h"
+#include "shapes/slabtree.h"
 #include "newmat/newmatio.h"
 #include <iostream>
 using std::ofstream;
@@ -30,7 +31,14 @@ public:
   Accumulator *acc;
 
   int nrEntries;
+  /** all points of the scan, points are not removed from this vector */
   vector <Point>* allPoints;
+  /** indices of the points that are not deleted yet, in sampling order */
+  vector <unsigned int> remaining;
+  /** position of each point in remaining */
+  vector <unsigned int> position;
+  /** spatial index for finding the points close to a plane */
+  SlabTree *pointTree;
   bool maximum;  
   bool quiet;
   Scan *PlaneScan;
@@ -59,6 +67,8 @@ public:
   double * const* getPoints(int &size);
   int deletePoints(double * n, double rho);
   int deletePointsQuad(double * n, double rho);
+  void planeBand(double * n, double rho, vector<unsigned int> &band);
+  void removeBand(const vector<unsigned int> &band, const vector<unsigned int> &kept);
 
   int writePlanes(int startCount);
   void writePlanes(std::string);
@@ -5,50 +5,185 @@
 #include "slam6d/scan.h"
 #include "shapes/ransac_Boctree.h"
 
-// TODO implement some parameters to modify ransac (maybe in CollisionShape?)
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <math.h>
+
+/**
+ * The best shape found by one thread, on equal scores the one of the
+ * earlier hypothesis wins as in a sequential search.
+ */
 template <class T>
-void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0) {
-  int best_score = 0;
-  CollisionShape<T> *best = shape.copy();
+struct RansacCandidate {
+  long score;
+  long index;
+  CollisionShape<T> *shape;
 
-  // stores 3 sample points    
-  vector<T *> ps;
-  // create octree from the points
-  DataXYZ xyz(scan->get("xyz reduced"));
-  RansacOctTree<T> *oct = new RansacOctTree<T>(PointerArray<double>(xyz).get(), xyz.size(), 50.0 );
-  cout << "start 5000 iterations" << endl;
-  for(int i = 0; i < 5000; i++) {
-    ps.clear();
-    // randomly select points from the octree
-    oct->DrawPoints(ps, shape.getNrPoints());
-    // compute shape parameters from points
-    if ( shape.hypothesize(ps) ) {
-      // count number of points on the shape
-      int r = oct->PointsOnShape(shape);
-      if (r > best_score) {
-        if (best) delete best;
-        // remember this best fitted shape
-        best_score = r;
-        best = shape.copy();
+  RansacCandidate() : score(0), index(-1), shape(0) {}
+
+  void consider(long _score, long _index, CollisionShape<T> &_shape) {
+    if (_score > score || (_score == score && index >= 0 && _index < index)) {
+      score = _score;
+      index = _index;
+      if (shape) delete shape;
+      shape = _shape.copy();
+    }
+  }
+};
+
+/**
+ * Fits the shape to the points of the octree.
+ *
+ * The hypotheses are drawn in blocks, each with its own generator seeded
+ * by the number of its first hypothesis, and the blocks are distributed
+ * over the threads. The result does not depend on the number of threads.
+ *
+ * If preemptive is set, each hypothesis is first scored on a fixed random
+ * subset of the points. Only if the inliers of the subset may still beat
+ * the best score of the block the octree is traversed.
+ *
+ * After each tenth of maxIterations the number of hypotheses needed to
+ * draw one of only inliers with the given confidence is estimated from the
+ * inlier ratio of the best shape. The octree draws the points of a
+ * hypothesis close to each other, so the estimate is on the safe side.
+ * A confidence of 1 always runs maxIterations hypotheses.
+ */
+template <class T>
+void Ransac(CollisionShape<T> &shape, RansacOctTree<T> &oct, vector<T*> *best_points = 0,
+    long maxIterations = 5000, double confidence = 0.99, bool preemptive = true) {
+
+  vector<T *> all;
+  oct.PointRefs(all);
+  long nrPoints = all.size();
+  if (nrPoints == 0) return;
+
+  // seeds depend on the caller's srand() only
+  unsigned long long seed = std::rand();
+
+  // the subset for scoring a hypothesis before traversing the octree
+  vector<T *> subset;
+  const unsigned int subsetSize = 300;
+  if (preemptive && nrPoints > 2 * (long)subsetSize) {
+    RansacRandom random(seed + 0x5EED);
+    for (unsigned int i = 0; i < subsetSize; i++) {
+      subset.push_back(all[random(nrPoints)]);
+    }
+  }
+
+  RansacCandidate<T> best;
+  const int block = 50;
+  const long round = maxIterations < 10 ? 1 : maxIterations / 10;
+  long needed = maxIterations;
+  long iterations = 0;
+  cout << "start at most " << maxIterations << " iterations" << endl;
+
+  for (long first = 0; first < needed; first += round) {
+    long last = first + round < maxIterations ? first + round : maxIterations;
+    int blocks = (last - first + block - 1) / block;
+    long known = best.score;
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+    {
+      CollisionShape<T> *hypothesis = shape.copy();
+      RansacCandidate<T> local;
+      vector<T *> ps;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (int b = 0; b < blocks; b++) {
+        long r0 = first + (long)b * block;
+        long r1 = r0 + block < last ? r0 + block : last;
+        RansacRandom random(seed + r0);
+        long blockBest = known;
+        for (long r = r0; r < r1; r++) {
+          ps.clear();
+          // randomly select points from the octree
+          oct.DrawPoints(ps, hypothesis->getNrPoints(), random);
+          // compute shape parameters from points
+          if (!hypothesis->hypothesize(ps)) continue;
+
+          if (!subset.empty() && blockBest > 0) {
+            unsigned int inliers = 0;
+            for (unsigned int i = 0; i < subset.size(); i++) {
+              if (hypothesis->containsPoint(subset[i])) inliers++;
+            }
+            // upper bound of the inlier ratio, three standard deviations
+            double w = (double)inliers / subset.size();
+            double bound = w + 3.0 * sqrt(w * (1.0 - w) / subset.size()) + 1.0 / subset.size();
+            if (bound * nrPoints < blockBest) continue;
+          }
+
+          // count number of points on the shape
+          long score = oct.PointsOnShape(*hypothesis);
+          if (score > blockBest) blockBest = score;
+          local.consider(score, r, *hypothesis);
+        }
+      }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      {
+        if (local.shape) best.consider(local.score, local.index, *local.shape);
+      }
+      if (local.shape) delete local.shape;
+      delete hypothesis;
+    }
+    iterations = last;
+
+    // stop as soon as a hypothesis of only inliers has been drawn with the
+    // given confidence, for the inlier ratio of the best shape
+    if (confidence > 0 && confidence < 1 && best.score > 0) {
+      double w = (double)best.score / nrPoints;
+      double wn = pow(w < 1.0 ? w : 1.0, (int)shape.getNrPoints());
+      if (wn >= 1.0) {
+        needed = 0;
+      } else {
+        double n = ceil(log(1.0 - confidence) / log(1.0 - wn));
+        needed = n < maxIterations ? (long)n : maxIterations;
       }
     }
   }
-  cout << "5000 iterations done" << endl;
+  cout << iterations << " iterations done" << endl;
+
+  if (!best.shape) return;
+
   if (best_points) {
     best_points->clear();
-    oct->PointsOnShape(*best, *best_points);
+    oct.PointsOnShape(*best.shape, *best_points);
     cout << "Nr points before refinement " << best_points->size() << endl;
-    best->refine(best_points);
+    best.shape->refine(best_points);
+    for (unsigned int i = 0; i < best_points->size(); i++) {
+      delete[] (*best_points)[i];
+    }
     best_points->clear();
-    oct->PointsOnShape(*best, *best_points);
+    oct.PointsOnShape(*best.shape, *best_points);
     cout << "Nr points after refinement " << best_points->size() << endl;
   }
-  shape = *best;
-  delete best;
+  shape = *best.shape;
+  delete best.shape;
+}
 
-  delete oct;
+// TODO implement some parameters to modify ransac (maybe in CollisionShape?)
+template <class T>
+void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0,
+    long maxIterations = 5000, double confidence = 0.99) {
+  // create octree from the points
+  DataXYZ xyz(scan->get("xyz reduced"));
+  RansacOctTree<T> *oct = new RansacOctTree<T>(PointerArray<double>(xyz).get(), xyz.size(), 50.0 );
 
+  Ransac(shape, *oct, best_points, maxIterations, confidence);
 
+  delete oct;
 }
 
 #endif
@@ -27,6 +27,31 @@ using std::list;
 #include "slam6d/Boctree.h"
 #include "shape.h"
 
+/**
+ * @brief xorshift generator, one per thread drawing hypotheses
+ */
+class RansacRandom {
+public:
+  RansacRandom(unsigned long long seed) {
+    state = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+  }
+
+  unsigned int next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (unsigned int)((state * 0x2545F4914F6CDD1DULL) >> 32);
+  }
+
+  /** returns a number in [0, n) */
+  unsigned int operator()(unsigned int n) {
+    return (unsigned int)(((unsigned long long)next() * n) >> 32);
+  }
+
+private:
+  unsigned long long state;
+};
+
 /**
  * @brief Octree
  * 
@@ -48,7 +73,23 @@ public:
   RansacOctTree(std::string filename) : BOctTree<T> (filename) {}
 
   void DrawPoints(vector<T *> &p, unsigned char nrp) {
-    DrawPoints(p, *BOctTree<T>::root, nrp);
+    StdRandom random;
+    DrawPoints(p, *BOctTree<T>::root, nrp, random);
+  }
+
+  /**
+   * Draws the points with the given generator instead of rand(), so
+   * several threads can draw from the tree at the same time.
+   */
+  void DrawPoints(vector<T *> &p, unsigned char nrp, RansacRandom &random) {
+    DrawPoints(p, *BOctTree<T>::root, nrp, random);
+  }
+
+  /**
+   * Collects pointers to all points stored in the tree, without copying them.
+   */
+  void PointRefs(vector<T *> &points) {
+    PointRefs(*BOctTree<T>::root, points);
   }
  
 
@@ -62,6 +103,34 @@ public:
   }
 
 protected:
+  struct StdRandom {
+    unsigned int operator()(unsigned int n) {
+      return rand((int)n);
+    }
+  };
+
+  void PointRefs(bitoct &node, vector<T *> &vpoints) {
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (unsigned char i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get points
+          pointrep *points = children->getPointreps();
+          unsigned int length = points[0].length;
+          T *point = &(points[1].v);  // first point
+          for(unsigned int iterator = 0; iterator < length; iterator++ ) {
+            vpoints.push_back(point);
+            point+= BOctTree<T>::POINTDIM;
+          }
+        } else { // recurse
+          PointRefs( children->node, vpoints);
+        }
+        ++children; // next child
+      }
+    }
+  }
+
 void showbits(char a)
 {
   int i  , k , mask;
@@ -104,7 +173,7 @@ void showbits(char a)
 //    printf("i: %u r: %d  parent %p   child[r]: %p \n", i, r, &node, children);
 //    r++;
 
-        childcenter(center, ccenter, size, i);  // childrens center
+        BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
         if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
           // check if leaf contains shape
           if ( shape.isInCube(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
@@ -139,7 +208,7 @@ void showbits(char a)
 
     for (unsigned char i = 0; i < 8; i++) {
       if (  ( 1 << i ) & node.valid ) {   // if ith node exists
-        childcenter(center, ccenter, size, i);  // childrens center
+        BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
         if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
           // check if leaf contains shape
           if ( shape.isInCube(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
@@ -167,11 +236,12 @@ void showbits(char a)
   }
 
 
-  void DrawPoints(vector<T *> &p, bitoct &node, unsigned char nrp) {
+  template <class R>
+  void DrawPoints(vector<T *> &p, bitoct &node, unsigned char nrp, R &random) {
     bitunion<T> *children;
     bitoct::getChildren(node, children);
     unsigned char n_children = POPCOUNT(node.valid);
-    unsigned char r = randUC(n_children);
+    unsigned char r = random(n_children);
     if (r == n_children) r--;
 
 /*    cout << (unsigned int)r << " nc " << (unsigned int)n_children << endl;
@@ -230,7 +300,7 @@ void showbits(char a)
       }
       // randomly get nrp points, we will not check if this succeeds in getting nrp distinct points
       for (char c = 0; c < nrp; c++) {
-        int tmp = rand(points[0].length);
+        int tmp = random(points[0].length);
         p.push_back(&(points[BOctTree<T>::POINTDIM*tmp+1].v));
       }
     } else {
@@ -240,7 +310,7 @@ void showbits(char a)
     showbits(node.leaf);
     cout << endl;
       cout << "RECURSED" << endl;*/
-      DrawPoints(p, children[r].node, nrp);
+      DrawPoints(p, children[r].node, nrp, random);
     }
   }
 
@@ -4,6 +4,7 @@
 #include <vector>
 using std::vector;
 #include "slam6d/globals.icc"
+#include "shapes/geom_math.h"
 #include "newmat/newmatio.h"
 #include "newmat/newmatap.h"
 using namespace NEWMAT;
@@ -17,6 +18,7 @@ template <class T=double>
 class CollisionShape {
   public:
 
+  virtual ~CollisionShape() {}
 
   /**
    * This is the main function for speeding up the search for points on the shape.
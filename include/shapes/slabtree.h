@@ -0,0 +1,61 @@
+#ifndef SLABTREE_H
+#define SLABTREE_H
+
+#include <vector>
+using std::vector;
+
+#include "slam6d/point.h"
+
+/**
+ * A k-d tree over the points of a scan for finding the points close to a
+ * plane. A query visits only the nodes whose bounding box intersects the
+ * slab of the given thickness around the plane. Points can be removed from
+ * the tree, subtrees without points left are skipped.
+ */
+class SlabTree {
+public:
+  /**
+   * Builds the tree over the points, which are referred to by their index.
+   * @param points the points, they have to stay unchanged
+   * @param bucketSize maximal number of points in a leaf
+   */
+  SlabTree(const vector<Point> &points, int bucketSize = 16);
+
+  /**
+   * Collects the points p that are not removed and fulfill
+   * fabs(p.x * n[0] + p.y * n[1] + p.z * n[2] - rho) < maxDist.
+   * @param n normal vector of the plane
+   * @param rho distance between plane and origin
+   * @param maxDist half the thickness of the slab
+   * @param result the indices of the points, in no particular order
+   */
+  void query(const double *n, double rho, double maxDist, vector<unsigned int> &result) const;
+
+  /** Removes the point with the given index from all further queries. */
+  void remove(unsigned int index);
+
+  /** Returns true if the point with the given index has been removed. */
+  inline bool isRemoved(unsigned int index) const {
+    return removed[index];
+  }
+
+private:
+  struct Node {
+    double min[3];    //!< lower corner of the bounding box
+    double max[3];    //!< upper corner of the bounding box
+    int begin, end;   //!< range of the node in order
+    int left, right;  //!< children, -1 for a leaf
+    int parent;       //!< parent, -1 for the root
+    int alive;        //!< number of points not removed
+  };
+
+  const vector<Point> &points;
+  vector<Node> nodes;
+  vector<unsigned int> order;  //!< point indices, the points of each node are consecutive
+  vector<int> leafOf;          //!< leaf of each point
+  vector<bool> removed;
+
+  int build(int begin, int end, int parent, int bucketSize);
+};
+
+#endif
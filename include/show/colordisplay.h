@@ -1,10 +1,13 @@
 #ifndef __COLORDISPLAY_H__
 #define __COLORDISPLAY_H__
 #include "show/colormanager.h"
+#include "show/viewcull.h"
 #include "limits.h"
 #include <set>
 using std::set;
 
+class PointBatch;
+
 class colordisplay {
   public:
   virtual ~colordisplay() {}
@@ -31,6 +34,18 @@ class colordisplay {
 
   virtual void cycleLOD() {};
 
+  /**
+   * Fill \a batch with the points displayLOD would draw for the view \a vf.
+   * Returns false if this display can only be drawn directly.
+   */
+  virtual bool collectLOD(float lod, const show::ViewFrustum &vf, PointBatch &batch) { return false; }
+
+  //! Cube enclosing all points, false if unknown
+  virtual bool getBoundingCube(float center[3], float &size) { return false; }
+
+  //! Number of points sent to GL by the last displayLOD or display call
+  virtual unsigned long drawnPoints() = 0;
+
   protected:
   
   virtual void drawLOD(float lod) = 0; 
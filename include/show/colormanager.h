@@ -197,6 +197,17 @@ class ColorManager {
       glTexCoord1f( (float)((val[currentdim]-min)/extent) );
     }
 
+    /**
+     * Computes the color setColor would result in, for drawing from
+     * vertex arrays without the 1D color texture
+     */
+    virtual void getColor(float *val, float *rgb) {
+      lookupColor( (float)((val[currentdim]-min)/extent), rgb );
+    }
+    virtual void getColor(double *val, float *rgb) {
+      lookupColor( (float)((val[currentdim]-min)/extent), rgb );
+    }
+
     virtual void setColorMap(ColorMap &cm) {
       for (unsigned int i = 0; i < buckets; i++) {
         cm.calcColor(colormap[i], i, buckets);
@@ -222,6 +233,15 @@ class ColorManager {
 
   protected:
     
+    void lookupColor(float t, float *rgb) {
+      if (t < 0.0) t = 0.0;
+      else if (t > 1.0) t = 1.0;
+      float *c = colormap[(unsigned int)(t * buckets)];
+      // the texture is modulated with the base color
+      rgb[0] = c[0] * color[0];
+      rgb[1] = c[1] * color[1];
+      rgb[2] = c[2] * color[2];
+    }
     
     void convertToTexture1D() {
       unsigned char *imageData = new unsigned char[(buckets+1) * 3];
@@ -313,7 +333,23 @@ class CColorManager : public ColorManager {
       glColor3ubv(color); 
     }
 
+    void getColor(double *val, float *rgb) {
+      unpackColor(&val[colordim], rgb);
+    }
+    void getColor(float *val, float *rgb) {
+      unpackColor(&val[colordim], rgb);
+    }
+
   private:
+    void unpackColor(const void *packed, float *rgb) {
+      GLubyte color[3];
+      memcpy(color, packed, 3);
+      rgb[0] = color[0] / 255.0;
+      rgb[1] = color[1] / 255.0;
+      rgb[2] = color[2] / 255.0;
+    }
+
+
     unsigned int colordim;
     GLboolean color_state;
 };
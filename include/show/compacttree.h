@@ -184,6 +184,7 @@ public:
     setColorManager(0);
     maxtargetpoints =  maxTargetPoints(*root);
     current_lod_mode = 0;
+    drawn_points = 0;
   }
 
   virtual ~compactTree();
@@ -196,6 +197,7 @@ public:
   void setColorManager(ColorManager *_cm);
   void drawLOD(float lod);
   void draw();
+  unsigned long drawnPoints() { return drawn_points; }
   void displayOctTree(double minsize = FLT_MAX);
   template <class T>
   void selectRay(vector<T *> &points);
@@ -296,6 +298,9 @@ inline unsigned char childIndex(const double *center, const P *point);
   
   unsigned long maxtargetpoints;
   unsigned int current_lod_mode;
+
+  //! points emitted by the last drawLOD or draw
+  unsigned long drawn_points;
   
   void cycleLOD() {
     current_lod_mode = (current_lod_mode+1)%3;
@@ -344,6 +349,7 @@ template <class P>
     countPointsAndQueue(pts, newcenter, sizeNew, *root, center);
     maxtargetpoints =  maxTargetPoints(*root);
     current_lod_mode = 0;
+    drawn_points = 0;
   }
 
 template <class P>
@@ -523,6 +529,7 @@ template <class P>
     countPointsAndQueue(pts, n, newcenter, sizeNew, *root, center);
     maxtargetpoints =  maxTargetPoints(*root);
     current_lod_mode = 0;
+    drawn_points = 0;
   } 
 
 template <class P>
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Point budget scheduling of the frames drawn by show
+ * @author Jan Elseberg. Jacobs University Bremen gGmbH, Germany
+ */
+
+#ifndef __FRAMESCHEDULER_H__
+#define __FRAMESCHEDULER_H__
+
+#include <vector>
+#include <fstream>
+#include <string>
+
+/**
+ * @brief Distributes a global point budget over the scans of a frame
+ *
+ * The scheduler learns the time it takes to draw a point from the last
+ * frames and derives the number of points that fit into the target frame
+ * time. This budget is shared among the scans by their screen coverage. As
+ * the traversal of an octree does not emit exactly the number of points
+ * requested, the number of points each scan delivers per unit of level of
+ * detail is learned as well and used to convert its share of the budget
+ * into a level of detail.
+ *
+ * While the camera does not move the budget is doubled with every frame
+ * until the scans do not deliver any more points, so that the view is
+ * refined progressively instead of being redrawn in full at once.
+ */
+class FrameScheduler {
+public:
+  FrameScheduler();
+  ~FrameScheduler();
+
+  //! The frame time in milliseconds the budget is chosen for
+  void setTargetTime(double ms);
+  inline double getTargetTime() const { return target_ms; }
+
+  //! Writes one line per frame to \a filename, for tuning the parameters
+  bool openLog(const std::string &filename);
+
+  /**
+   * Start a new frame for \a nr_scans scans. Unless the frame was requested
+   * by refine() the camera is considered moving and refinement restarts.
+   */
+  void beginFrame(unsigned int nr_scans);
+
+  /**
+   * Computes the level of detail of every scan from its \a coverage, i.e.,
+   * the fraction of the screen it covers (0 if culled)
+   */
+  void allocate(const std::vector<float> &coverage, std::vector<float> &lods);
+
+  /**
+   * Reports the measured time of the frame and the number of points every
+   * scan actually emitted for the level of detail assigned by allocate()
+   */
+  void endFrame(double ms, const std::vector<unsigned long> &points);
+
+  /**
+   * Requests the next refinement step for an idle camera. Returns false if
+   * the view is already drawn in full detail.
+   */
+  bool refine();
+
+  //! The number of points planned for the current frame
+  inline unsigned long getBudget() const { return budget; }
+  //! The number of points drawn in the last frame
+  inline unsigned long getDrawnPoints() const { return drawn; }
+  //! The measured duration of the last frame in milliseconds
+  inline double getFrameTime() const { return frame_ms; }
+  //! The number of refinement steps of the current view
+  inline unsigned int getRefinement() const { return level; }
+  //! true if the view cannot be refined any further
+  inline bool isComplete() const { return complete; }
+
+  //! points are never allotted below this budget
+  static const unsigned long min_budget = 10000;
+  //! weight of the last frame in the running averages
+  static const float smoothing;
+  //! level of detail assigned to scans that are culled
+  static const float min_lod;
+
+private:
+  double target_ms;
+  //! running average of the time it takes to draw one point
+  double ms_per_point;
+  //! per scan running average of emitted points per unit of level of detail
+  std::vector<double> points_per_lod;
+  //! level of detail assigned in the current frame
+  std::vector<float> assigned;
+
+  unsigned long budget;
+  unsigned long moving_budget;
+  unsigned long drawn;
+  unsigned long last_drawn;
+  double frame_ms;
+  unsigned int level;
+  bool refining;
+  bool complete;
+  unsigned long frame_nr;
+
+  std::ofstream *log;
+};
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Contiguous vertex and color batches for drawing show octrees
+ * @author Jan Elseberg. Jacobs University Bremen gGmbH, Germany
+ */
+
+#ifndef __POINTBATCH_H__
+#define __POINTBATCH_H__
+
+#include <vector>
+#include <math.h>
+
+#include "show/viewcull.h"
+#include "show/colormanager.h"
+
+/**
+ * @brief Points selected by one traversal of a show octree
+ *
+ * The traversal only appends to the batch and never calls into GL, so the
+ * batches of all scans can be computed without a display and in parallel.
+ * A batch remembers the view and level of detail it was collected for, so
+ * it can be drawn again in the following frames as long as the camera has
+ * not moved noticeably.
+ */
+class PointBatch {
+public:
+  PointBatch() : lod(0.0), valid(false), vbo(0), uploaded(false) {}
+
+  //! Remove all points but keep the memory for the next traversal
+  void clear() {
+    vertices.clear();
+    colors.clear();
+    valid = false;
+    uploaded = false;
+  }
+
+  //! Number of points in the batch
+  inline size_t size() const { return vertices.size() / 3; }
+
+  template <class T>
+  inline void addPoint(T *point, ColorManager *cm) {
+    vertices.push_back(point[0]);
+    vertices.push_back(point[1]);
+    vertices.push_back(point[2]);
+    if (cm) {
+      float rgb[3];
+      cm->getColor(point, rgb);
+      colors.push_back(rgb[0]);
+      colors.push_back(rgb[1]);
+      colors.push_back(rgb[2]);
+    }
+  }
+
+  //! Remember the view the current content was collected for
+  void validate(const show::ViewFrustum &vf, float _lod) {
+    view = vf;
+    lod = _lod;
+    valid = true;
+  }
+
+  //! Mark the content as outdated, e.g. after the colors changed
+  void invalidate() { valid = false; }
+
+  /**
+   * true if the batch may be drawn instead of traversing the tree again for
+   * the view \a vf, i.e., no matrix entry changed by more than \a eps and
+   * the level of detail changed by less than the relative \a lod_tolerance
+   */
+  bool reusable(const show::ViewFrustum &vf, float _lod,
+                float eps = 1e-4, float lod_tolerance = 0.1) const {
+    if (!valid) return false;
+    if (fabs(_lod - lod) > lod_tolerance * lod) return false;
+    return view.similar(vf, eps);
+  }
+
+  //! x, y, z of each point
+  std::vector<float> vertices;
+  //! r, g, b of each point, empty if collected without a color manager
+  std::vector<float> colors;
+
+  show::ViewFrustum view;
+  float lod;
+  bool valid;
+
+  //! name of the vertex buffer object holding the content, if any
+  unsigned int vbo;
+  //! true if the content has been copied to the vertex buffer object
+  bool uploaded;
+};
+
+/**
+ * Draw a batch as GL_POINTS from a vertex array. With GL extensions
+ * available the content is kept in a vertex buffer object, so that reused
+ * batches are not transferred again.
+ */
+void drawPointBatch(PointBatch &batch);
+
+//! Free the GL resources held by the batch
+void releasePointBatch(PointBatch &batch);
+
+#endif
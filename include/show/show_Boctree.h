@@ -13,6 +13,7 @@
 #include "show/scancolormanager.h"
 #include "show/viewcull.h"
 #include "show/colordisplay.h"
+#include "show/pointbatch.h"
 #include "slam6d/scan.h"
 
 using namespace show;
@@ -37,6 +38,9 @@ protected:
 
   unsigned int current_lod_mode;
 
+  //! points emitted by the last drawLOD or draw
+  unsigned long drawn_points;
+
   //! A copy of pointdim of the tree initialized from
   unsigned int POINTDIM;
 
@@ -53,6 +57,7 @@ protected:
     POINTDIM = m_tree->getPointdim();
     maxtargetpoints = maxTargetPoints(m_tree->getRoot());
     current_lod_mode = 0;
+    drawn_points = 0;
     m_cache_access = 0;
     m_scan = 0;
   }
@@ -141,16 +146,22 @@ public:
   }
 
   void drawLOD(float ratio) {
+    ViewFrustum vf;
+    vf.fromGlobals();
+    GLSink sink(cm);
+    drawn_points = 0;
     switch (current_lod_mode) {
       case 0:
         glBegin(GL_POINTS);
-        displayOctTreeCulledLOD(maxtargetpoints * ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
+        displayOctTreeCulledLOD(maxtargetpoints * ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize(), vf, sink);
         glEnd();
+        drawn_points = sink.count;
         break;
       case 1:
         glBegin(GL_POINTS);
-        displayOctTreeCulledLOD2(ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
+        displayOctTreeCulledLOD2(ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize(), vf, sink);
         glEnd();
+        drawn_points = sink.count;
         break;
       case 2:
 #ifdef WITH_GLEE
@@ -173,17 +184,86 @@ public:
   }
   
   void draw() {
+    ViewFrustum vf;
+    vf.fromGlobals();
+    GLSink sink(cm);
     glBegin(GL_POINTS);
-    displayOctTreeAllCulled(m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize());
+    displayOctTreeAllCulled(m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize(), vf, sink);
     glEnd();
+    drawn_points = sink.count;
+  }
+
+  /**
+   * Collect the points drawLOD would draw for the view \a vf into \a batch
+   * instead of drawing them. No GL calls are made, so this is safe to call
+   * headless and concurrently for different trees.
+   * Returns false if the current LOD mode needs direct drawing.
+   */
+  bool collectLOD(float ratio, const ViewFrustum &vf, PointBatch &batch) {
+    batch.clear();
+    BatchSink sink(cm, batch);
+    switch (current_lod_mode) {
+      case 0:
+        displayOctTreeCulledLOD(maxtargetpoints * ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize(), vf, sink);
+        break;
+      case 1:
+        displayOctTreeCulledLOD2(ratio, m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize(), vf, sink);
+        break;
+      default:
+        return false;
+    }
+    batch.validate(vf, ratio);
+    return true;
+  }
+
+  //! Collect all points inside the view \a vf into \a batch
+  bool collect(const ViewFrustum &vf, PointBatch &batch) {
+    batch.clear();
+    BatchSink sink(cm, batch);
+    displayOctTreeAllCulled(m_tree->getRoot(), m_tree->getCenter(), m_tree->getSize(), vf, sink);
+    batch.validate(vf, 1.0);
+    return true;
   }
   
+  bool getBoundingCube(float center[3], float &size) {
+    const T* c = m_tree->getCenter();
+    center[0] = c[0];
+    center[1] = c[1];
+    center[2] = c[2];
+    size = m_tree->getSize();
+    return true;
+  }
+
+  unsigned long drawnPoints() { return drawn_points; }
+
   // reroute center call (for recast from colordisplay to show_bocttree)
   void getCenter(double _center[3]) const {
     m_tree->getCenter(_center);
   }
   
 protected:
+
+  //! Draws every selected point immediately
+  struct GLSink {
+    ColorManager *cm;
+    unsigned long count;
+    GLSink(ColorManager *_cm) : cm(_cm), count(0) {}
+    inline void operator()(T *point) {
+      if(cm) cm->setColor(point);
+      glVertex3f( point[0], point[1], point[2]);
+      ++count;
+    }
+  };
+
+  //! Appends every selected point to a batch
+  struct BatchSink {
+    ColorManager *cm;
+    PointBatch &batch;
+    BatchSink(ColorManager *_cm, PointBatch &_batch) : cm(_cm), batch(_batch) {}
+    inline void operator()(T *point) {
+      batch.addPoint(point, cm);
+    }
+  };
   
   //! ?
   unsigned long maxTargetPoints(const bitoct &node) {
@@ -209,7 +289,8 @@ protected:
     return max*POPCOUNT(node.valid);
   }
 
-  void displayOctTreeAll(const bitoct &node) {
+  template <class Sink>
+  void displayOctTreeAll(const bitoct &node, Sink &sink) {
 //    T ccenter[3];
     bitunion<T> *children;
     bitoct::getChildren(node, children);
@@ -221,24 +302,24 @@ protected:
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-            if(cm) cm->setColor(point);
-            glVertex3f( point[0], point[1], point[2]);
+            sink(point);
             point+=POINTDIM;
           }
         } else { // recurse
-          displayOctTreeAll( children->node);
+          displayOctTreeAll( children->node, sink);
         }
         ++children; // next child
       }
     }
   }
 
-  void displayOctTreeAllCulled(const bitoct &node, const T* center, T size ) {
-    int res = CubeInFrustum2(center[0], center[1], center[2], size);
+  template <class Sink>
+  void displayOctTreeAllCulled(const bitoct &node, const T* center, T size, const ViewFrustum &vf, Sink &sink ) {
+    int res = vf.CubeInFrustum2(center[0], center[1], center[2], size);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
-      displayOctTreeAll(node);
+      displayOctTreeAll(node, sink);
       return;
     }
 
@@ -256,20 +337,20 @@ protected:
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              sink(point);
               point+=POINTDIM;
             }
           //}
         } else { // recurse
-          displayOctTreeAllCulled( children->node, ccenter, size/2.0);
+          displayOctTreeAllCulled( children->node, ccenter, size/2.0, vf, sink);
         }
         ++children; // next child
       }
     }
   }
   
-  void displayOctTreeLOD2(float ratio, const bitoct &node, const T* center, T size ) {
+  template <class Sink>
+  void displayOctTreeLOD2(float ratio, const bitoct &node, const T* center, T size, const ViewFrustum &vf, Sink &sink ) {
 
     T ccenter[3];
     bitunion<T> *children;
@@ -283,7 +364,7 @@ protected:
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
 
-          int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
+          int l = vf.LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
           l = max((int)(l*l*ratio), 0);
           if (l > 1) {
             if ((int)length > l ) {
@@ -293,13 +374,11 @@ protected:
               for(int iterator = 0; iterator < l; iterator++ ) {
                 index = (T)iterator * each;
                 p = point + index - index%POINTDIM;
-                if(cm) cm->setColor(p);
-                glVertex3f( p[0], p[1], p[2]);
+                sink(p);
               }
             } else if ((int)length <= l) { 
               for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0], point[1], point[2]);
+                sink(point);
                 point+=POINTDIM;
               }
             } /* else if (l == 1) {
@@ -307,14 +386,13 @@ protected:
               glVertex3f( point[0], point[1], point[2]);
             }*/
           } else {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              sink(point);
           }
         } else { // recurse
-            int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
+            int l = vf.LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
             l = max((int)(l*l*ratio), 0);
             if (l > 0) {
-              displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0);
+              displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0, vf, sink);
             }
         }
         ++children; // next child
@@ -322,13 +400,14 @@ protected:
     }
   }
   
-  void displayOctTreeCulledLOD2(float ratio, const bitoct &node, const T* center, T size ) {
+  template <class Sink>
+  void displayOctTreeCulledLOD2(float ratio, const bitoct &node, const T* center, T size, const ViewFrustum &vf, Sink &sink ) {
 
-    int res = CubeInFrustum2(center[0], center[1], center[2], size);
+    int res = vf.CubeInFrustum2(center[0], center[1], center[2], size);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
-      displayOctTreeLOD2(ratio, node, center, size);
+      displayOctTreeLOD2(ratio, node, center, size, vf, sink);
       return;
     }
 
@@ -341,12 +420,12 @@ protected:
         BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
         if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
           // check if leaf is visible
-          if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
+          if ( vf.CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
             pointrep *points = children->getPointreps();
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
 
-            int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
+            int l = vf.LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
             l = max((int)(l*l*ratio), 0);
             if (l != 0) {
               if ((int)length > l ) {
@@ -356,18 +435,15 @@ protected:
                 for(int iterator = 0; iterator < l; iterator++ ) {
                   index = (T)iterator * each;
                   p = point + index - index%POINTDIM;
-                  if(cm) cm->setColor(p);
-                  glVertex3f( p[0], p[1], p[2]);
+                  sink(p);
                 }
               } else if ((int)length <= l) { 
                 for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                  if(cm) cm->setColor(point);
-                  glVertex3f( point[0], point[1], point[2]);
+                  sink(point);
                   point+=POINTDIM;
                 }
               } else if (l == 1) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0], point[1], point[2]);
+                sink(point);
               }
             } 
           }
@@ -375,7 +451,7 @@ protected:
           //int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
           //l = max((int)(l*l*ratio), 0);
           //if (l > 0) {
-            displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0);
+            displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0, vf, sink);
           //}
         }
         ++children; // next child
@@ -467,14 +543,15 @@ protected:
     }
   }
 
-  void displayOctTreeCulledLOD(long targetpts, const bitoct &node, const T* center, T size ) {
+  template <class Sink>
+  void displayOctTreeCulledLOD(long targetpts, const bitoct &node, const T* center, T size, const ViewFrustum &vf, Sink &sink ) {
     if (targetpts <= 0) return; // no need to display anything
 
-    int res = CubeInFrustum2(center[0], center[1], center[2], size);
+    int res = vf.CubeInFrustum2(center[0], center[1], center[2], size);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
-      displayOctTreeLOD(targetpts, node, center, size);
+      displayOctTreeLOD(targetpts, node, center, size, vf, sink);
       return;
     }
 
@@ -494,18 +571,16 @@ protected:
         BOctTree<T>::childcenter(center, ccenter, size, i);  // childrens center
         if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
           // check if leaf is visible
-          if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
+          if ( vf.CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
             pointrep *points = children->getPointreps();
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
 
-            if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+            if (length > 10 && !vf.LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
+              sink(point);
             } else if (length <= newtargetpts) {        // more points requested than possible, plot all
               for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0], point[1], point[2]);
+                sink(point);
                 point+=POINTDIM;
               }
             } else {                         // select points to show
@@ -516,22 +591,22 @@ protected:
               for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
                 index = (T)iterator * each;
                 p = point + index - index%POINTDIM;
-                if(cm) cm->setColor(p);
-                glVertex3f( p[0], p[1], p[2]);
+                sink(p);
                 //point += each;
               }
             }
           }
 
         } else { // recurse
-          displayOctTreeCulledLOD(newtargetpts, children->node, ccenter, size/2.0);
+          displayOctTreeCulledLOD(newtargetpts, children->node, ccenter, size/2.0, vf, sink);
         }
         ++children; // next child
       }
     }
   }
 
-  void displayOctTreeLOD(long targetpts, const bitoct &node, const T* center, T size ) {
+  template <class Sink>
+  void displayOctTreeLOD(long targetpts, const bitoct &node, const T* center, T size, const ViewFrustum &vf, Sink &sink ) {
     if (targetpts <= 0) return; // no need to display anything
 
     T ccenter[3];
@@ -553,13 +628,11 @@ protected:
           pointrep *points = children->getPointreps();
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
-          if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
-            if(cm) cm->setColor(point);
-            glVertex3f( point[0], point[1], point[2]);
+          if (length > 10 && !vf.LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
+            sink(point);
           } else if (length <= newtargetpts) {        // more points requested than possible, plot all
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              sink(point);
               point+=POINTDIM;
             }
           } else {                         // select points to show
@@ -570,13 +643,12 @@ protected:
             for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
               index = (T)iterator * each;
               p = point + index - index%POINTDIM;
-              if(cm) cm->setColor(p);
-              glVertex3f( p[0], p[1], p[2]);
+              sink(p);
               //point += each;
             }
           }
         } else { // recurse
-          displayOctTreeLOD(newtargetpts, children->node, ccenter, size/2.0);
+          displayOctTreeLOD(newtargetpts, children->node, ccenter, size/2.0, vf, sink);
         }
         ++children; // next child
       }
@@ -749,12 +821,14 @@ protected:
             glBegin(GL_POINTS);
             glVertex3f( ccenter[0], ccenter[1], ccenter[2] ); 
             glEnd();
+            ++drawn_points;
           }
         }else if ( ( 1 << i ) & node.leaf ) {
           if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
             pointrep *points = children->getPointreps();
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
+            drawn_points += length;
             glPointSize(1.0);
             glBegin(GL_POINTS);
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
@@ -794,11 +868,13 @@ protected:
             glBegin(GL_POINTS);
             glVertex3f( ccenter[0], ccenter[1], ccenter[2] ); 
             glEnd();
+            ++drawn_points;
           }
         }else if ( ( 1 << i ) & node.leaf ) {
           pointrep *points = children->getPointreps();
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
+          drawn_points += length;
           glPointSize(1.0);
           glBegin(GL_POINTS);
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
@@ -869,7 +945,8 @@ protected:
       } // other case is simply not to continue culling with the respective plane
     }
     if (counter == 0) { // if entirely within frustrum discontinue culling
-      displayOctTreeAll(node);
+      GLSink sink(cm);
+      displayOctTreeAll(node, sink);
       return;
     }
     
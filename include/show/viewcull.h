@@ -166,5 +166,35 @@ void remViewport();
 bool LOD(float x, float y, float z, float size);
 int LOD2(float x, float y, float z, float size);
 
+/**
+ * @brief Culling state of a single view
+ *
+ * Holds a copy of everything the culling and LOD functions above depend on.
+ * This way an octree can be traversed without a GL context and concurrently
+ * for several scans with different poses.
+ */
+class ViewFrustum {
+public:
+  //! Take over the state of the last ExtractFrustum call
+  void fromGlobals();
+  //! Compute the state from (column-major) modelview and projection matrix
+  void set(const float *modl, const float *proj, const int *viewport, short detail);
+  //! true if the views differ by less than eps in every entry of the matrix
+  bool similar(const ViewFrustum &other, float eps) const;
+
+  bool CubeInFrustum( float x, float y, float z, float size ) const;
+  int  CubeInFrustum2( float x, float y, float z, float size ) const;
+  bool LOD(float x, float y, float z, float size) const;
+  int  LOD2(float x, float y, float z, float size) const;
+  //! Estimated fraction of the screen covered by the cube, 0 if culled
+  float ScreenCoverage(float x, float y, float z, float size) const;
+
+  float frustum[6][4];
+  float matrix[16];
+  short VP[4];
+  float right[3];
+  short DETAIL;
+};
+
 }
 #endif
@@ -31,6 +31,8 @@ using std::list;
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <stdexcept>
+#include <string.h>
 
 #if __GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4)
   #define POPCOUNT(mask) __builtin_popcount(mask)
@@ -197,6 +199,49 @@ template <class T> union bitunion {
 
 
 // initialized in Boctree.cc, sequence intialized on startup
+/**
+ * Header of an octree image. The image holds the nodes and points of a tree
+ * in a single block of memory, which is usable in place after mapping the
+ * file, as all links between nodes are relative offsets. An image is only
+ * valid for the architecture it was written on, which is checked via the
+ * version and the sizes of the node types.
+ */
+struct OcttreeImageHeader {
+  //! 'X', 'I'
+  char magic[2];
+  unsigned char version;
+  //! sizeof of the coordinate type
+  unsigned char coordsize;
+  //! sizeof of a node
+  unsigned int nodesize;
+  //! PointType flags and resulting point dimension
+  unsigned int pointtype;
+  unsigned int pointdim;
+  //! voxel size of the octree
+  double voxelSize;
+  //! voxel size of the reduction applied to the scan, -1 if unreduced
+  double reduction;
+  //! fingerprint of the scan files the octree was built from
+  unsigned long long fingerprint;
+  double center[3];
+  double size;
+  //! offsets of mins, maxs and the root node from the start of the file
+  unsigned long long mins, maxs, root;
+  //! total length of the file
+  unsigned long long length;
+};
+
+#define OCTTREE_IMAGE_VERSION 1
+
+//! Reads the header of an octree image, false if \a filename is none
+bool readOcttreeImageHeader(const std::string& filename, OcttreeImageHeader& header);
+
+//! Maps the whole file into memory, 0 on failure
+unsigned char* mapOcttreeImage(const std::string& filename, size_t& length);
+
+//! Releases a mapping created by mapOcttreeImage
+void unmapOcttreeImage(unsigned char* image, size_t length);
+
 extern char amap[8][8];
 extern char imap[8][8];
 extern char sequence2ci[8][256][8];  // maps preference to index in children array for every valid_mask and every case
@@ -214,11 +259,11 @@ extern char sequence2ci[8][256][8];  // maps preference to index in children arr
 template <typename T>
 class BOctTree : public SearchTree {
 public:
-  BOctTree() {
+  BOctTree() : image(0), image_length(0) {
   }
 
   template <class P>
-  BOctTree(P * const* pts, int n, T voxelSize, PointType _pointtype = PointType(), bool _earlystop = false ) : pointtype(_pointtype), earlystop(_earlystop)
+  BOctTree(P * const* pts, int n, T voxelSize, PointType _pointtype = PointType(), bool _earlystop = false ) : pointtype(_pointtype), earlystop(_earlystop), image(0), image_length(0)
   {
     alloc = new PackedChunkAllocator;
     
@@ -263,14 +308,22 @@ public:
     init();
   }
 
-  BOctTree(std::string filename) {
+  /**
+   * Loads a serialized octree, octree images are mapped into memory
+   * directly instead of being parsed
+   */
+  BOctTree(std::string filename) : image(0), image_length(0) {
     alloc = new PackedChunkAllocator;
-    deserialize(filename); 
+    if(isImage(filename)) {
+      mapImage(filename);
+    } else {
+      deserialize(filename); 
+    }
     init();
   }
 
   template <class P>
-  BOctTree(vector<P *> &pts, T voxelSize, PointType _pointtype = PointType(), bool _earlystop = false) : earlystop(_earlystop)
+  BOctTree(vector<P *> &pts, T voxelSize, PointType _pointtype = PointType(), bool _earlystop = false) : earlystop(_earlystop), image(0), image_length(0)
   {
     alloc = new PackedChunkAllocator;
     
@@ -320,6 +373,9 @@ public:
     if(alloc) {
       delete alloc;
     }
+    if(image) {
+      unmapOcttreeImage(image, image_length);
+    }
   } 
 
   void init() {
@@ -404,6 +460,10 @@ protected:
 
   //! Allocator used for creating nodes in the constructor
   Allocator* alloc;
+
+  //! Mapped octree image holding the nodes, if loaded from one
+  unsigned char* image;
+  size_t image_length;
   
 public:
   
@@ -474,6 +534,17 @@ public:
   }
   
   static void deserialize(std::string filename, vector<Point> &points ) {
+    if(isImage(filename)) {
+      BOctTree<T> tree(filename);
+      vector<T*> vp;
+      tree.AllPoints(vp);
+      for(unsigned int i = 0; i < vp.size(); i++) {
+        points.push_back(tree.pointtype.createPoint(vp[i]));
+        delete[] vp[i];
+      }
+      return;
+    }
+
     char buffer[sizeof(T) * 20];
 
     std::ifstream file;
@@ -547,6 +618,11 @@ public:
   }
 
   static PointType readType(std::string filename ) {
+    OcttreeImageHeader header;
+    if(readOcttreeImageHeader(filename, header)) {
+      return PointType(header.pointtype);
+    }
+
     char buffer[sizeof(T) * 20];
 
     std::ifstream file;
@@ -569,6 +645,81 @@ public:
   }
   
 
+  //! true if \a filename holds an octree image instead of a serialized octree
+  static bool isImage(std::string filename) {
+    OcttreeImageHeader header;
+    return readOcttreeImageHeader(filename, header);
+  }
+
+  /**
+   * true if \a filename holds an octree image this class can map, which was
+   * built with the given parameters from scan files with the given fingerprint
+   */
+  static bool isCurrentImage(std::string filename, double voxelSize, double reduction,
+                             PointType pointtype, unsigned long long fingerprint) {
+    OcttreeImageHeader header;
+    if(!readOcttreeImageHeader(filename, header)) return false;
+    if(!compatibleImage(header)) return false;
+    return header.pointtype == pointtype.toFlags()
+      && fabs(header.voxelSize - voxelSize) <= 0.0001 * fabs(voxelSize)
+      && fabs(header.reduction - reduction) <= 0.0001 * fabs(reduction)
+      && header.fingerprint == fingerprint;
+  }
+
+  /**
+   * Writes the tree as an octree image, which can be mapped into memory
+   * without parsing. \a reduction and \a fingerprint are stored to decide
+   * later on if the image is still up to date, cf. isCurrentImage.
+   */
+  void serializeImage(std::string filename, double reduction = -1.0, unsigned long long fingerprint = 0) {
+    OcttreeImageHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic[0] = 'X';
+    header.magic[1] = 'I';
+    header.version = OCTTREE_IMAGE_VERSION;
+    header.coordsize = sizeof(T);
+    header.nodesize = sizeof(bitunion<T>);
+    header.pointtype = pointtype.toFlags();
+    header.pointdim = POINTDIM;
+    header.voxelSize = voxelSize;
+    header.reduction = reduction;
+    header.fingerprint = fingerprint;
+    for(int i = 0; i < 3; i++) header.center[i] = center[i];
+    header.size = size;
+
+    // copy all nodes into one block, the links between them stay relative
+    unsigned int length = 2*POINTDIM*sizeof(T) + sizeof(bitunion<T>) + sizeChildren(*root);
+    unsigned char* block = new unsigned char[length];
+    Allocator* own = alloc;
+    alloc = new SequentialAllocator(block, length);
+    T* image_mins = alloc->allocate<T>(POINTDIM);
+    T* image_maxs = alloc->allocate<T>(POINTDIM);
+    for(unsigned int i = 0; i < POINTDIM; i++) {
+      image_mins[i] = mins[i];
+      image_maxs[i] = maxs[i];
+    }
+    bitunion<T>* image_root = alloc->allocate<bitunion<T> >();
+    copy_children(*root, image_root->node);
+    delete alloc;
+    alloc = own;
+
+    // keep the block aligned in the file
+    unsigned long long offset = (sizeof(header) + 15) & ~15ULL;
+    header.mins = offset + ((unsigned char*)image_mins - block);
+    header.maxs = offset + ((unsigned char*)image_maxs - block);
+    header.root = offset + ((unsigned char*)image_root - block);
+    header.length = offset + length;
+
+    std::ofstream file;
+    file.open(filename.c_str(), std::ios::out | std::ios::binary);
+    file.write(reinterpret_cast<char*>(&header), sizeof(header));
+    char padding[16] = {0};
+    file.write(padding, offset - sizeof(header));
+    file.write(reinterpret_cast<char*>(block), length);
+    file.close();
+    delete[] block;
+  }
+
   /**
    * Picks the first point in depth first order starting from the given node
    *
@@ -688,6 +839,107 @@ public:
   }
   
 protected:
+
+  static bool compatibleImage(const OcttreeImageHeader& header) {
+    return header.version == OCTTREE_IMAGE_VERSION
+      && header.coordsize == sizeof(T)
+      && header.nodesize == sizeof(bitunion<T>);
+  }
+
+  /**
+   * true if the \a length bytes at \a offset in the mapped image lie behind
+   * \a cursor and within the image. Advances \a cursor to their end.
+   */
+  bool claimImage(long long offset, unsigned long long length, unsigned long long &cursor) const {
+    if(offset < 0 || (unsigned long long)offset < cursor) return false;
+    if((unsigned long long)offset > image_length || length > image_length - offset) return false;
+    cursor = offset + length;
+    return true;
+  }
+
+  /**
+   * Checks the header of the mapped image and all nodes and points below
+   * the root against the length of the image. The blocks of an image are
+   * written in depth first order, so every node, children array and point
+   * array has to start behind the previous one, which also rules out cycles.
+   */
+  bool validImage(const OcttreeImageHeader& header) const {
+    if(POINTDIM == 0 || POINTDIM != PointType(header.pointtype).getPointDim()) return false;
+    // bounds the depth computed by init
+    if(!(header.voxelSize > 0.0) || !(header.size >= 0.0)
+       || !(header.size / header.voxelSize < 1e15)) return false;
+
+    unsigned long long cursor = sizeof(OcttreeImageHeader);
+    if(header.mins > (unsigned long long)image_length
+       || header.maxs > (unsigned long long)image_length
+       || header.root > (unsigned long long)image_length) return false;
+    if(!claimImage(header.mins, POINTDIM*sizeof(T), cursor)) return false;
+    if(!claimImage(header.maxs, POINTDIM*sizeof(T), cursor)) return false;
+    if(!claimImage(header.root, sizeof(bitunion<T>), cursor)) return false;
+    return validImageNode(reinterpret_cast<bitunion<T>*>(image + header.root)->node, 0, cursor);
+  }
+
+  bool validImageNode(const bitoct& node, unsigned int depth, unsigned long long &cursor) const {
+    // deeper than any tree with the size ratio checked above
+    if(depth > 64) return false;
+    if(node.leaf & ~node.valid) return false;
+    unsigned int n_children = POPCOUNT(node.valid);
+    if(n_children == 0) return true;
+
+    long long offset = ((const unsigned char*)&node - image) + node.child_pointer;
+    if(!claimImage(offset, n_children*sizeof(bitunion<T>), cursor)) return false;
+    const bitunion<T>* children = reinterpret_cast<const bitunion<T>*>(image + offset);
+
+    for(unsigned int i = 0; i < 8; ++i) {
+      if((1<<i) & node.valid) {
+        if((1<<i) & node.leaf) {
+          long long points = ((const unsigned char*)children - image) + children->node.child_pointer;
+          // the length first, then the points it announces
+          unsigned long long start = cursor;
+          if(!claimImage(points, sizeof(pointrep), cursor)) return false;
+          cursor = start;
+          unsigned long long length = children->getLength();
+          if(!claimImage(points, sizeof(pointrep)*(length*POINTDIM + 1), cursor)) return false;
+        } else {
+          if(!validImageNode(children->node, depth + 1, cursor)) return false;
+        }
+        ++children;
+      }
+    }
+    return true;
+  }
+
+  //! Takes the nodes from a mapped octree image instead of allocating them
+  void mapImage(std::string filename) {
+    OcttreeImageHeader header;
+    if(!readOcttreeImageHeader(filename, header) || !compatibleImage(header)) {
+      throw std::runtime_error("Octree image " + filename + " is incompatible");
+    }
+    image = mapOcttreeImage(filename, image_length);
+    if(image == 0 || image_length < header.length) {
+      if(image) unmapOcttreeImage(image, image_length);
+      image = 0;
+      throw std::runtime_error("Octree image " + filename + " could not be mapped");
+    }
+
+    pointtype = PointType(header.pointtype);
+    POINTDIM = header.pointdim;
+    if(!validImage(header)) {
+      unmapOcttreeImage(image, image_length);
+      image = 0;
+      throw std::runtime_error("Octree image " + filename + " is corrupt");
+    }
+    voxelSize = header.voxelSize;
+    center[0] = header.center[0];
+    center[1] = header.center[1];
+    center[2] = header.center[2];
+    size = header.size;
+
+    mins = reinterpret_cast<T*>(image + header.mins);
+    maxs = reinterpret_cast<T*>(image + header.maxs);
+    uroot = reinterpret_cast<bitunion<T>*>(image + header.root);
+    root = &uroot->node;
+  }
   
   void AllPoints( bitoct &node, vector<T*> &vp) {
     bitunion<T> *children;
@@ -1311,6 +1563,142 @@ protected:
   }
 
 
+public:
+  /**
+   * Finds the k closest points within maxdist2, sorted by distance. Like
+   * FindClosest the results point into the octree, so the query is only
+   * available for BOctTree<double>.
+   */
+  int FindKClosest(double *point, int k, double maxdist2, double **neighbors, double *dist2, int threadNum = 0) const
+  {
+    if (sizeof(T) != sizeof(double)) {
+      throw std::runtime_error("FindKClosest needs an octree of doubles");
+    }
+    if (k <= 0) return 0;
+    params[threadNum].p = point;
+    params[threadNum].closest_d2 = maxdist2;
+    params[threadNum].neighbors = neighbors;
+    params[threadNum].neighbors_d2 = dist2;
+    params[threadNum].k = k;
+    params[threadNum].found = 0;
+    if (boxDist2(point, center, size) < maxdist2) {
+      _FindKClosest(threadNum, *root, center, size);
+    }
+    return params[threadNum].found;
+  }
+
+  /**
+   * Finds all points within maxdist2 in no particular order. The vectors are
+   * cleared first. The results point into the octree, so the query is only
+   * available for BOctTree<double>.
+   */
+  int FindInRadius(double *point, double maxdist2, vector<double*> &neighbors, vector<double> &dist2, int threadNum = 0) const
+  {
+    if (sizeof(T) != sizeof(double)) {
+      throw std::runtime_error("FindInRadius needs an octree of doubles");
+    }
+    neighbors.clear();
+    dist2.clear();
+    params[threadNum].p = point;
+    params[threadNum].closest_d2 = maxdist2;
+    params[threadNum].range = &neighbors;
+    params[threadNum].range_d2 = &dist2;
+    if (boxDist2(point, center, size) < maxdist2) {
+      _FindInRadius(threadNum, *root, center, size);
+    }
+    return neighbors.size();
+  }
+
+protected:
+  /**
+   * Squared distance of the query point to the axis aligned box of the given
+   * center and half edge length, 0 if the point is inside
+   */
+  static inline double boxDist2(const double *p, const T *center, T size) {
+    double d2 = 0.0;
+    for (unsigned char i = 0; i < 3; i++) {
+      double d = fabs(p[i] - center[i]) - size;
+      if (d > 0.0) d2 += d * d;
+    }
+    return d2;
+  }
+
+  /**
+   * Best bin first traversal for the k nearest neighbors. Children are
+   * visited in the same order of preference as in _FindClosest and skipped
+   * as soon as their box is farther away than the k-th neighbor found so
+   * far.
+   */
+  void _FindKClosest(int threadNum, const bitoct &node, const T *center, T size) const
+  {
+    NNParams &np = params[threadNum];
+    unsigned char child_index = (np.p[0] > center[0]) |
+                               ((np.p[1] > center[1]) << 1) |
+                               ((np.p[2] > center[2]) << 2);
+    char *seq2ci = sequence2ci[child_index][node.valid];
+    char *mmap = amap[child_index];
+
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+    T ccenter[3];
+    T csize = size / 2.0;
+    for (unsigned char i = 0; i < 8; i++) {
+      child_index = mmap[i];
+      if ( !(( 1 << child_index ) & node.valid) ) continue;
+      childcenter(center, ccenter, size, child_index);
+      if (boxDist2(np.p, ccenter, csize) >= np.closest_d2) continue;
+
+      if (  ( 1 << child_index ) & node.leaf ) {
+        T* points = children[seq2ci[i]].getPoints();
+        unsigned int length = children[seq2ci[i]].getLength();
+        for (unsigned int j = 0; j < length; j++) {
+          double myd2 = Dist2(np.p, points);
+          if (myd2 < np.closest_d2) {
+            np.found = insertNeighbor((double*)points, myd2, np.neighbors, np.neighbors_d2, np.found, np.k);
+            if (np.found == np.k) np.closest_d2 = np.neighbors_d2[np.k-1];
+          }
+          points += BOctTree<T>::POINTDIM;
+        }
+      } else {
+        _FindKClosest(threadNum, children[seq2ci[i]].node, ccenter, csize);
+      }
+    }
+  }
+
+  //! Collects all points in the search radius, skipping boxes outside of it
+  void _FindInRadius(int threadNum, const bitoct &node, const T *center, T size) const
+  {
+    NNParams &np = params[threadNum];
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+    T ccenter[3];
+    T csize = size / 2.0;
+    for (unsigned char i = 0; i < 8; i++) {
+      if ( !(( 1 << i ) & node.valid) ) continue;
+      childcenter(center, ccenter, size, i);
+      if (boxDist2(np.p, ccenter, csize) >= np.closest_d2) {
+        ++children;
+        continue;
+      }
+
+      if (  ( 1 << i ) & node.leaf ) {
+        T* points = children->getPoints();
+        unsigned int length = children->getLength();
+        for (unsigned int j = 0; j < length; j++) {
+          double myd2 = Dist2(np.p, points);
+          if (myd2 < np.closest_d2) {
+            np.range->push_back((double*)points);
+            np.range_d2->push_back(myd2);
+          }
+          points += BOctTree<T>::POINTDIM;
+        }
+      } else {
+        _FindInRadius(threadNum, children->node, ccenter, csize);
+      }
+      ++children;
+    }
+  }
+
   /** 
    * This function shows the possible speedup that can be gained by using the
    * octree for nearest neighbour search, if a more sophisticated
@@ -1451,6 +1839,7 @@ public:
    * Copies another (via new constructed) octtree into cache allocated memory and makes it position independant
    */
   BOctTree(const BOctTree& other, unsigned char* mem_ptr, unsigned int mem_max)
+    : image(0), image_length(0)
   {
     alloc = new SequentialAllocator(mem_ptr, mem_max);
     
@@ -124,7 +124,7 @@ public:
   }
   
   //! The number of T instances in this array
-  unsigned int size() {
+  unsigned int size() const {
     return m_size / sizeof(T);
   }
 };
@@ -0,0 +1,94 @@
+/**
+ * @file feature_cache.h
+ * @brief stores the features of scans on disk
+ * This class computes the panorama, keypoints and descriptors of a scan once
+ * and keeps them in a cache file, together with the 3D coordinate of each
+ * keypoint, which is all the registration needs. The file name contains the
+ * projection and feature parameters and a hash of the scan directory, so
+ * caches of different settings and datasets can be kept in the same
+ * directory. A fingerprint of the scan files in the header detects scans
+ * that have been replaced since.
+ */
+
+#ifndef FEATURE_CACHE_H_
+#define FEATURE_CACHE_H_
+
+#include "fbr_global.h"
+#include "feature.h"
+
+using namespace std;
+
+namespace fbr{
+  /**
+   * @class feature_cache
+   * @brief loads the features of a scan from its cache file or creates them
+   * @param cDir directory of the cache files
+   * @param sFormat input scan file format
+   * @param pMethod projection method of the panorama
+   * @param iWidth, iHeight size of the panorama
+   * @param nImages number of images of the projection
+   * @param pParam special projection parameter
+   * @param mapMethod mapping method of the panorama map
+   * @param fMethod feature detector method
+   * @param dMethod feature descriptor method
+   * @param fFiltrationMethod feature filtration method
+   */
+  class feature_cache{
+    string cDir;
+    IOType sFormat;
+    projection_method pMethod;
+    unsigned int iWidth;
+    unsigned int iHeight;
+    unsigned int nImages;
+    double pParam;
+    panorama_map_method mapMethod;
+    feature_detector_method fMethod;
+    feature_descriptor_method dMethod;
+    feature_filtration_method fFiltrationMethod;
+
+    /**
+     * getKey : string of all parameters the features depend on
+     */
+    string getKey();
+
+  public:
+    feature_cache(string dir, IOType format, projection_method projection, unsigned int width, unsigned int height, unsigned int numberOfImages, double param, panorama_map_method map, feature_detector_method detector, feature_descriptor_method descriptor, feature_filtration_method filtration);
+    /**
+     * getFileName : name of the cache file of a scan
+     * @param sDir directory of the scans
+     * @param scanNumber number of the scan
+     */
+    string getFileName(string sDir, unsigned int scanNumber);
+    /**
+     * load : reads the features of a scan from its cache file
+     * @param sDir directory of the scans
+     * @param scanNumber number of the scan
+     * @param sFeature returning the keypoints and descriptors
+     * @param coords returning the 3D coordinate of each keypoint, (0,0,0) if unknown
+     * @return true if the cache file exists and has been created with the same parameters from the same scan files
+     */
+    bool load(string sDir, unsigned int scanNumber, feature& sFeature, vector<cv::Point3f>& coords);
+    /**
+     * save : writes the features of a scan to its cache file
+     * @return true on success
+     */
+    bool save(string sDir, unsigned int scanNumber, feature& sFeature, const vector<cv::Point3f>& coords);
+    /**
+     * compute : loads the scan and creates its panorama and features
+     * @param sDir directory of the scans
+     * @param scanNumber number of the scan
+     * @param scanServer whether the scan server is used
+     * @param sFeature returning the keypoints and descriptors
+     * @param coords returning the 3D coordinate of each keypoint, (0,0,0) if unknown
+     */
+    void compute(string sDir, unsigned int scanNumber, bool scanServer, feature& sFeature, vector<cv::Point3f>& coords);
+    /**
+     * get : loads the features from the cache or computes and stores them
+     * @return true if the features have been found in the cache
+     */
+    bool get(string sDir, unsigned int scanNumber, bool scanServer, feature& sFeature, vector<cv::Point3f>& coords);
+    string getCacheDir();
+    void getDescription();
+  };
+}
+#endif /* FEATURE_CACHE_H_ */
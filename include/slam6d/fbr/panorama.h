@@ -40,7 +40,13 @@ namespace fbr{
     panorama_map_method mapMethod;
 
     void init(unsigned int width, unsigned int height, projection_method method, unsigned int numberOfImages, double param, panorama_map_method mapMethod);
-    void map(int x, int y, cv::MatIterator_<cv::Vec4f> it, double range);
+    void map(int x, int y, const cv::Vec4f &point, double range);
+    /**
+     * @brief fills the images and maps from the pixels of the projected points
+     * @param points the points of the scan
+     * @param pixel the pixel index y * iWidth + x of each point, -1 if it is not projected
+     */
+    void fillImages(const cv::Vec4f *points, const vector<int> &pixel);
   public:
     /**
      * constructor of class panorama
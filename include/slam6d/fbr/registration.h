@@ -22,6 +22,8 @@ namespace fbr{
    * @param minError threshold for min error after transformation of a point from second coordinate to first to determin the inliers
    * @param minInlier threshold fir min inlier to consider the align as positive
    * @param rMethod registration Method
+   * @param confidence probability of having drawn an all inlier hypothesis after which RANSAC stops, 0 to disable
+   * @param iterations number of hypotheses tested by the last registration
    * @param bAlign best alignment
    * @param bError error of registration with bAlign
    * @param bErrorIndex error index of registration with bAlign
@@ -31,6 +33,8 @@ namespace fbr{
     double minError;
     unsigned int minInlier;
     registration_method rMethod;
+    double confidence;
+    unsigned long iterations;
     double bestAlign[16];
     double bestError;
     unsigned int bestErrorIndex;
@@ -47,7 +51,7 @@ namespace fbr{
      * @param ct Point3f for returning the 3D coordinate of train scan
      * @return 1 on success 0 on failure
      */
-    int getCoord( vector<cv::KeyPoint> fKeypoints, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches, cv::Mat fPMap, cv::Mat sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct);
+    int getCoord(const vector<cv::KeyPoint>& fKeypoints, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches, const cv::Mat& fPMap, const cv::Mat& sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct);
     /**
      * pointToArray : convert 3D point3f to double array
      * @param c 3D point whith Point3f type
@@ -62,14 +66,24 @@ namespace fbr{
      */
     cv::Point3f coordTransform(cv::Point3f p, double* align);
     /**
-     * findAlign : find the best align
-     * @param fPMap input Mat wich contains the 3D coordinates of each pixel of first panorama image
-     * @param fKeypoints vector<KeyPoints> containing the features of first panorama image
-     * @param sPMap input Mat wich contains the 3D coordinates of each pixel of second panorama image
-     * @param sKeypoints vector<KeyPoints> containing the features of second panorama image
-     * @param matches vector<DMatches> containing the matched features of both images
+     * findAlign : computes the align of three matches and its inliers
+     * @param i, j, k indices of the matches
+     * @param cq 3D coordinates of the matches in the query (first) scan
+     * @param ct 3D coordinates of the matches in the train (second) scan
+     * @param valid whether the coordinates of a match are known
+     * @param align returning the transformation matrix
+     * @param iError returning the sum of the errors of the inliers
+     * @param eIdx returning the number of inliers
+     * @return 1 if the align has been computed, 0 if the matches are not suitable
      */
-    int findAlign(unsigned int i, unsigned int j, unsigned int k, cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches);
+    int findAlign(unsigned int i, unsigned int j, unsigned int k, const vector<cv::Point3f>& cq, const vector<cv::Point3f>& ct, const vector<char>& valid, double* align, double& iError, unsigned int& eIdx);
+    /**
+     * findBestAlign : tests the hypotheses and keeps the best align
+     * @param cq 3D coordinates of the matches in the query (first) scan
+     * @param ct 3D coordinates of the matches in the train (second) scan
+     * @param valid whether the coordinates of a match are known
+     */
+    void findBestAlign(const vector<cv::Point3f>& cq, const vector<cv::Point3f>& ct, const vector<char>& valid);
 
   public:
     registration();
@@ -81,12 +95,31 @@ namespace fbr{
      * @param sPMap second panorama map which is 3D points coresponding to second panorama image
      * @param sKeypoints keypoints from the second scan
      * @param matches matched keypoints from first to second scan
+     * The hypotheses are tested in parallel, the result does not depend on the number of threads.
+     */
+    void findRegistration(const cv::Mat& fPMap, const vector<cv::KeyPoint>& fKeypoints, const cv::Mat& sPMap, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches);
+    /**
+     * findRegistration : find the transformation matrix from the 3D coordinates of the keypoints
+     * @param fCoords 3D coordinate of each keypoint of the first scan, (0,0,0) if unknown
+     * @param sCoords 3D coordinate of each keypoint of the second scan, (0,0,0) if unknown
+     * @param matches matched keypoints from first to second scan
+     */
+    void findRegistration(const vector<cv::Point3f>& fCoords, const vector<cv::Point3f>& sCoords, const vector<cv::DMatch>& matches);
+    /**
+     * getKeypointCoord : get the 3D coordinate of a keypoint from the panorama map
+     * @param keypoint the keypoint
+     * @param pMap panorama map of the scan
+     * @param c Point3f for returning the 3D coordinate
+     * @return 1 on success 0 if the map has no point there
      */
-    void findRegistration(cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches);
+    static int getKeypointCoord(const cv::KeyPoint& keypoint, const cv::Mat& pMap, cv::Point3f& c);
     unsigned int getMinDistance();
     double getMinError();
     unsigned int getMinInlier();
     registration_method getRegistrationMethod();
+    void setConfidence(double c);
+    double getConfidence();
+    unsigned long getIterations();
     double * getBestAlign();
     double getBestError();
     unsigned int getBestErrorIndex();
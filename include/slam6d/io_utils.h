@@ -33,4 +33,18 @@ private:
 
 void parseFormatFile(string& dir, WriteOnce<IOType>& type, WriteOnce<int>& start, WriteOnce<int>& end);
 
+/**
+ * Continues the fingerprint \a hash (FNV-1a) with \a length bytes of \a data
+ */
+unsigned long long fingerprint(unsigned long long hash, const void* data, unsigned int length);
+
+/**
+ * Fingerprint of the files a scan is read from, based on name, size and
+ * modification time of the files ScanIO::readFiles() names for \a type, by
+ * default all files scanNNN.* in \a dir except octrees and frames. The files
+ * are hashed in the order of their names. Changes whenever the scan is
+ * replaced.
+ */
+unsigned long long scanFingerprint(const string& dir, const string& identifier, IOType type);
+
 #endif
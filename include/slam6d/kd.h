@@ -54,6 +54,19 @@ public:
 							   double maxdist2,
 							   int threadNum = 0) const;
 
+  virtual int FindKClosest(double *_p,
+                           int k,
+                           double maxdist2,
+                           double **neighbors,
+                           double *dist2,
+                           int threadNum = 0) const;
+
+  virtual int FindInRadius(double *_p,
+                           double maxdist2,
+                           vector<double*> &neighbors,
+                           vector<double> &dist2,
+                           int threadNum = 0) const;
+
   virtual vector<Point> kNearestNeighbors(double *_p,
 								  int k,
 								  double sqRad2,
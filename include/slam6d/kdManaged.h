@@ -57,6 +57,10 @@ public:
   virtual double* FindClosest(double *_p, double maxdist2, int threadNum = 0) const;
 
   virtual double *FindClosestAlongDir(double *_p, double *_dir, double maxdist2, int threadNum = 0) const;
+
+  virtual int FindKClosest(double *_p, int k, double maxdist2, double **neighbors, double *dist2, int threadNum = 0) const;
+
+  virtual int FindInRadius(double *_p, double maxdist2, vector<double*> &neighbors, vector<double> &dist2, int threadNum = 0) const;
 private:
   Scan* m_scan;
   DataXYZ* m_data;
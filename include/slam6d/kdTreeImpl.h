@@ -23,15 +23,6 @@
 #include <omp.h>
 #endif
 
-class PointCompare {
-public:
-    bool operator() (const std::pair<Point, double>& left,
-				 const std::pair<Point, double>& right)
-  {
-    return left.second > right.second;
-  }
-};
-
 /**
  * @brief The optimized k-d tree. 
  * 
@@ -288,23 +279,15 @@ protected:
 
     // Leaf nodes
     if (npts) {
-	 for (int i = 0; i < npts; i++) {
-	   double myd2 = Dist2(params[threadNum].p, point(pts, leaf.p[i]));
-	   if (myd2 < params[threadNum].closest_d2) {
-		params[threadNum].closest = point(pts, leaf.p[i]);
-
-		Point newPt;
-		double* currPt = point(pts, leaf.p[i]);
-		newPt.x = currPt[0];
-		newPt.y = currPt[1];
-		newPt.z = currPt[2];
-		params[threadNum].heap.push_back(std::make_pair(newPt, myd2));
-		std::push_heap(params[threadNum].heap.begin(),
-					params[threadNum].heap.end(),
-					PointCompare());
-	   }
-	 }
-	 return;
+      for (int i = 0; i < npts; i++) {
+        double *q = point(pts, leaf.p[i]);
+        double myd2 = Dist2(params[threadNum].p, q);
+        if (myd2 < params[threadNum].closest_d2) {
+          params[threadNum].range->push_back(q);
+          params[threadNum].range_d2->push_back(myd2);
+        }
+      }
+      return;
     }
 
     // Quick check of whether to abort
@@ -331,55 +314,82 @@ protected:
     }
   }
 
-
+  /**
+   * Bounded k nearest neighbor search. Once k neighbors are known the
+   * search radius shrinks to the distance of the farthest of them, so the
+   * tree is pruned like in _FindClosest.
+   */
   void _KNNSearch(const PointData& pts, int threadNum) const {
     AccessorFunc point;
+    KDParams &kp = params[threadNum];
 
     // Leaf nodes
     if (npts) {
-	 for (int i = 0; i < npts; i++) {
-	   double myd2 = Dist2(params[threadNum].p, point(pts, leaf.p[i]));
-
-	   if (myd2 < params[threadNum].closest_d2) {
-		Point newPt;
-		double* currPt = point(pts, leaf.p[i]);
-		newPt.x = currPt[0];
-		newPt.y = currPt[1];
-		newPt.z = currPt[2];
-		params[threadNum].heap.push_back(std::make_pair(newPt, myd2));
-		std::push_heap(params[threadNum].heap.begin(),
-					params[threadNum].heap.end(),
-					PointCompare());
-
-		params[threadNum].closest = point(pts, leaf.p[i]);
-	   }
-	 }
-	 return;
+      for (int i = 0; i < npts; i++) {
+        double *q = point(pts, leaf.p[i]);
+        double myd2 = Dist2(kp.p, q);
+        if (myd2 < kp.closest_d2) {
+          kp.found = insertNeighbor(q, myd2, kp.neighbors, kp.neighbors_d2, kp.found, kp.k);
+          if (kp.found == kp.k) kp.closest_d2 = kp.neighbors_d2[kp.k-1];
+        }
+      }
+      return;
     }
 
     // Quick check of whether to abort
     double approx_dist_bbox =
-	 max(max(fabs(params[threadNum].p[0]-node.center[0])-node.dx,
-		    fabs(params[threadNum].p[1]-node.center[1])-node.dy),
-		fabs(params[threadNum].p[2]-node.center[2])-node.dz);
+	 max(max(fabs(kp.p[0]-node.center[0])-node.dx,
+		    fabs(kp.p[1]-node.center[1])-node.dy),
+		fabs(kp.p[2]-node.center[2])-node.dz);
     if (approx_dist_bbox >= 0 &&
-	   sqr(approx_dist_bbox) >= params[threadNum].closest_d2)
+	   sqr(approx_dist_bbox) >= kp.closest_d2)
 	 return;
 
     // Recursive case
-    double myd = node.center[node.splitaxis] - params[threadNum].p[node.splitaxis];
+    double myd = node.center[node.splitaxis] - kp.p[node.splitaxis];
     if (myd >= 0.0) {
 	 node.child1->_KNNSearch(pts, threadNum);
-	 if (sqr(myd) < params[threadNum].closest_d2) {
+	 if (sqr(myd) < kp.closest_d2) {
 	   node.child2->_KNNSearch(pts, threadNum);
 	 }
     } else {
 	 node.child2->_KNNSearch(pts, threadNum);
-	 if (sqr(myd) < params[threadNum].closest_d2) {
+	 if (sqr(myd) < kp.closest_d2) {
 	   node.child1->_KNNSearch(pts, threadNum);
 	 }
     }
   }
+
+  /**
+   * Sets up the parameters of the calling thread and runs _KNNSearch
+   */
+  int _FindKClosest(const PointData& pts, double *_p, int k, double maxdist2,
+                    double **neighbors, double *dist2, int threadNum) const {
+    if (k <= 0) return 0;
+    params[threadNum].p = _p;
+    params[threadNum].closest_d2 = maxdist2;
+    params[threadNum].neighbors = neighbors;
+    params[threadNum].neighbors_d2 = dist2;
+    params[threadNum].k = k;
+    params[threadNum].found = 0;
+    _KNNSearch(pts, threadNum);
+    return params[threadNum].found;
+  }
+
+  /**
+   * Sets up the parameters of the calling thread and runs _FixedRangeSearch
+   */
+  int _FindInRadius(const PointData& pts, double *_p, double maxdist2,
+                    std::vector<double*> &neighbors, std::vector<double> &dist2, int threadNum) const {
+    neighbors.clear();
+    dist2.clear();
+    params[threadNum].p = _p;
+    params[threadNum].closest_d2 = maxdist2;
+    params[threadNum].range = &neighbors;
+    params[threadNum].range_d2 = &dist2;
+    _FixedRangeSearch(pts, threadNum);
+    return neighbors.size();
+  }
 };
 
 
@@ -42,14 +42,24 @@ public:
   double *dir;
 
   /**
-   * heap for KNN.
+   * caller provided buffers of the k nearest neighbors, sorted by distance
    */
-  std::vector<std::pair<Point, double> > heap;
+  double **neighbors;
+  double *neighbors_d2;
+  int k;
+  int found;
+
+  /**
+   * caller provided result vectors of the fixed range search
+   */
+  std::vector<double*> *range;
+  std::vector<double> *range_d2;
   
   /** 
-   * expand to 128 bytes to avoid false-sharing, 16 bytes from above + 28*4 bytes = 128 bytes
+   * expand to 128 bytes to avoid false-sharing, 72 bytes from above on 64 bit
+   * machines + 14*4 bytes = 128 bytes
    */
-  int padding[28];
+  int padding[14];
 };
 
 #endif
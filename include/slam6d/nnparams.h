@@ -1,6 +1,8 @@
 #ifndef __NNPARAMS_H__
 #define __NNPARAMS_H__
 
+#include <vector>
+
 struct NNParams {
 /** 
    * pointer to the closest point.  size = 4 bytes of 32 bit machines 
@@ -33,6 +35,16 @@ struct NNParams {
   int count;
   int max_count;
 
+  // caller provided buffers of the k nearest neighbors, sorted by distance
+  double **neighbors;
+  double *neighbors_d2;
+  int k;
+  int found;
+
+  // caller provided result vectors of the fixed range search
+  std::vector<double*> *range;
+  std::vector<double> *range_d2;
+
 };
 
 #endif
@@ -83,6 +83,41 @@ public:
 
   virtual double *FindClosestAlongDir(double *_p, double *_dir, double maxdist2, int threadNum) const;
 
+  /**
+   * Finds the k closest points of the query point within maxdist2, which
+   * covers both the k nearest neighbor search (maxdist2 = DBL_MAX) and
+   * the k nearest neighbors within a radius. The results are written into
+   * the buffers of the caller, sorted by ascending distance, so that
+   * repeated queries do not allocate any memory.
+   *
+   * @param _p Pointer to query point
+   * @param k Maximal number of neighbors
+   * @param maxdist2 Maximal squared distance of the neighbors
+   * @param neighbors Buffer of at least k pointers receiving the neighbors
+   * @param dist2 Buffer of at least k doubles receiving the squared distances
+   * @param threadNum If parallel threads share the search tree the thread num must be given
+   * @return Number of neighbors found
+   */
+  virtual int FindKClosest(double *_p, int k, double maxdist2,
+                           double **neighbors, double *dist2,
+                           int threadNum = 0) const;
+
+  /**
+   * Finds all points within maxdist2 of the query point in no particular
+   * order. The vectors are cleared first but keep their capacity, so they
+   * should be reused by the caller.
+   *
+   * @param _p Pointer to query point
+   * @param maxdist2 Squared search radius
+   * @param neighbors Receives the pointers to the points
+   * @param dist2 Receives the squared distances of the points
+   * @param threadNum If parallel threads share the search tree the thread num must be given
+   * @return Number of points found
+   */
+  virtual int FindInRadius(double *_p, double maxdist2,
+                           vector<double*> &neighbors, vector<double> &dist2,
+                           int threadNum = 0) const;
+
   virtual void getPtPairs(vector <PtPair> *pairs, 
 				  double *source_alignxf, 
           double * const *q_points, unsigned int startindex, unsigned int endindex,
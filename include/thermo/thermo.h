@@ -23,11 +23,11 @@ IplImage* detectCorners(IplImage *orgimage, int &corner_exp, int board_h, int bo
 void CalibFunc(int board_w, int board_h, int start, int end, bool optical, bool chess, bool quiet, string dir, int scale=1);
 void writeCalibParam(int images, int corner_exp, int board_w, CvMat* image_points, CvSize size, string dir);
 
-void loadIntrinsicCalibration(CvMat * intrinsic, CvMat * distortion, string dir, bool optical=false) ;
-void loadExtrinsicCalibration(CvMat * Translation, CvMat * Rotation, string dir, int method, bool optical=false) ;
+void loadIntrinsicCalibration(CvMat *&intrinsic, CvMat *&distortion, string dir, bool optical=false) ;
+void loadExtrinsicCalibration(CvMat *&Translation, CvMat *&Rotation, string dir, int method, bool optical=false) ;
 void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
 IOType type, int scale, double rot_angle, double minDist, double maxDist,
-bool correction, int neighborhood, int method=0);
+bool correction, int neighborhood, double depthThresh=4, int method=0);
 
 bool readPoints(string filename, CvPoint3D32f *corners, int size) ;
 void sortElementByElement(CvMat * vectors, int nr_elems, int nr_vectors); 
@@ -30,9 +30,79 @@ typedef std::vector<charv> charvv;
 #define CELL_TYPE_MOVING        0x00000400
 #define CELL_TYPE_GROUND        0x00000800
 
-typedef std::vector<Point*> cell;
-typedef std::vector<cell> cellColumn;
-typedef std::vector<cellColumn> cellArray;
+/**
+ * The points of one cell of a cellArray. A cell does not own its points,
+ * it refers to a range of the point index array of the grid.
+ */
+class cell
+{
+public:
+	cell() : points(0), index(0), count(0) {}
+
+	inline int size() const { return count; }
+	inline Point* operator[](int k) const { return points + index[k]; }
+
+	Point *points;
+	const int *index;
+	int count;
+};
+
+/**
+ * Polar grid of a scan with columnSize columns around the y axis and
+ * cellNumber rings of width cellSize between minRad and maxRad.
+ *
+ * The cells are stored flat, cell (column, ring) has the number
+ * column * cellNumber + ring. The indices of the points of all cells are
+ * kept in one array sorted by cell, which is filled by a counting sort.
+ * Clearing the grid keeps its memory, so a grid that is built again for
+ * the next scan does not allocate.
+ */
+class cellArray
+{
+public:
+	cellArray();
+
+	/**
+	 * Sorts the points into the grid. The points are referred to, so they
+	 * must not be moved as long as the grid is in use.
+	 */
+	int build(vector<Point>& points, int columnSize, int cellNumber,
+			  float minRad, float maxRad, float cellSize);
+
+	/** The column of the direction (x, z) without evaluating atan2 */
+	int columnIndex(double x, double z) const;
+
+	inline int getColumnSize() const { return columnSize; }
+	inline int getCellNumber() const { return cellNumber; }
+	inline int getCellCount() const { return (int)cells.size(); }
+	inline bool empty() const { return cells.empty(); }
+
+	inline cell& operator()(int column, int ring)
+	{ return cells[column * cellNumber + ring]; }
+	inline cell& operator[](int c) { return cells[c]; }
+
+	/** Empties the grid but keeps the allocated memory */
+	void clear();
+	void swap(cellArray& other);
+
+private:
+	int columnSize;
+	int cellNumber;
+	int sectionSize;
+
+	/** tan of the column borders within one octant */
+	vector<float> tanv;
+	/** column within an octant for equally spaced values of the tangent */
+	vector<int> lut;
+
+	/** cell of each point, -1 if the point is outside of the grid */
+	vector<int> cellOf;
+	/** first entry of each cell in index, cellCount + 1 entries */
+	vector<int> start;
+	/** indices of the points sorted by cell */
+	vector<int> index;
+	vector<cell> cells;
+};
 
 class cellFeature
 {
@@ -0,0 +1,74 @@
+/**
+ * @file
+ * @brief Linear assignment on sparse cost matrices
+ *
+ * Only the gated pairs of trackers and clusters enter the cost matrix. Rows
+ * may stay unassigned at a fixed cost, so the matrix need not be square.
+ * The bipartite graph of the entries falls apart into connected components
+ * in scenes with many objects, they are solved independently of each other.
+ *
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifndef __SPARSELAP_H__
+#define __SPARSELAP_H__
+
+#include <vector>
+
+#include "veloslam/lap.h"
+
+/**
+ * @brief Cost matrix in compressed row storage
+ *
+ * Entries are added row by row, rows that are skipped stay empty.
+ */
+class SparseCostMatrix {
+public:
+  SparseCostMatrix(int rows = 0, int cols = 0);
+
+  /** Removes all entries and sets the size */
+  void reset(int rows, int cols);
+
+  /** Adds an entry, row must not be smaller than the one of the last entry */
+  void add(row i, col j, cost c);
+
+  inline int getRows() const { return rows; }
+  inline int getCols() const { return cols; }
+  inline int getEntries() const { return (int)column.size(); }
+
+  /** The entries of row i are first(i) to first(i + 1) - 1 */
+  inline int first(row i) const { return i < filled ? start[i] : (int)column.size(); }
+  inline col getCol(int e) const { return column[e]; }
+  inline cost getCost(int e) const { return value[e]; }
+
+private:
+  int rows, cols;
+  //! the rows before this one have been started
+  int filled;
+  std::vector<int> start;
+  std::vector<col> column;
+  std::vector<cost> value;
+};
+
+/**
+ * Solves the assignment problem on a sparse cost matrix.
+ *
+ * Each row is assigned to at most one column by one of its entries, each
+ * column to at most one row. A row that is left unassigned costs
+ * missCost, the sum of the costs is minimized. The connected components
+ * are solved in parallel by shortest augmenting paths, in the sparse
+ * variant of the algorithm of Jonker and Volgenant.
+ *
+ * @param assigncost the cost matrix
+ * @param missCost the cost of a row without a column
+ * @param rowsol column assigned to each row, -1 if there is none
+ * @param colsol row assigned to each column, -1 if there is none
+ * @param components if given, set to the number of connected components
+ * @return the cost of the assignment, including the unassigned rows
+ */
+cost sparse_lap(const SparseCostMatrix &assigncost, cost missCost,
+                col *rowsol, row *colsol, int *components = 0);
+
+#endif
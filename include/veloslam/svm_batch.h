@@ -0,0 +1,58 @@
+#ifndef _SVM_BATCH_H
+#define _SVM_BATCH_H
+
+#include <vector>
+
+#include "veloslam/svm.h"
+
+/**
+ * @brief Prediction of many dense feature vectors with a libsvm model
+ *
+ * The support vectors are unpacked into a dense matrix that is stored by
+ * feature, the values of one feature of all support vectors are
+ * contiguous. The kernel values of a block of samples against all support
+ * vectors are accumulated feature by feature, so the inner loop runs over
+ * the support vectors and is vectorized by the compiler, while each kernel
+ * value is still summed in the order of the features. The labels and
+ * decision values are the same as the ones of svm_predict(), as long as
+ * both are compiled without fused multiply-add contraction.
+ *
+ * Blocks of samples are predicted in parallel with OpenMP.
+ */
+class SVMBatchPredictor
+{
+public:
+	SVMBatchPredictor(const svm_model *model);
+
+	/** The highest feature index used by the support vectors */
+	inline int getDimension() const { return dim; }
+
+	/**
+	 * Predicts n samples with features values each, stored one after the
+	 * other. Features missing from a sample are zero.
+	 *
+	 * @param labels the predicted labels, as of svm_predict()
+	 * @param dec_values if given, the decision values of each sample,
+	 *        one for regression and one class models, nr_class*(nr_class-1)/2
+	 *        for classification
+	 */
+	void predict(const double *x, int n, int features, double *labels,
+				 double *dec_values = 0) const;
+
+	/** Predicts a single sample with features values */
+	double predict(const double *x, int features) const;
+
+private:
+	void kernelBlock(const double *x, int n, int features, double *kvalue) const;
+	double decide(const double *kvalue, double *dec_values) const;
+
+	const svm_model *model;
+	int l;
+	int dim;
+	//! sv[d * l + i] is feature d + 1 of support vector i
+	std::vector<double> sv;
+	//! the first support vector of each class
+	std::vector<int> start;
+};
+
+#endif /* _SVM_BATCH_H */
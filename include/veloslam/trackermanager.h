@@ -4,6 +4,7 @@
 #include <vector>
 #include "slam6d/scan.h"
 #include "veloslam/tracker.h"
+#include "veloslam/sparselap.h"
 
 //#define NO_SLIDING_WINDOW
 
@@ -64,7 +65,7 @@ public:
 
 	int FilterObject(VeloScan& scanRef);
 
-	CMatrix ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex);
+	void ConstructCostMatrix(VeloScan &scanRef, SparseCostMatrix &costMatrix, vector<int> &clusterIndex);
 
 	int MatchTracksWithClusters(VeloScan &scanRef);
 
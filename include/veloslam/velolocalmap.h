@@ -0,0 +1,170 @@
+/**
+ * @file
+ * @brief Local map of the sliding window for registering velodyne scans
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifndef __VELOLOCALMAP_H__
+#define __VELOLOCALMAP_H__
+
+#include <vector>
+#include <deque>
+
+#include "slam6d/scan.h"
+#include "slam6d/searchTree.h"
+
+class icp6D;
+
+/**
+ * @brief Points of the local map in a hashed voxel grid
+ *
+ * A point closer than the resolution to a point of the map is not added,
+ * instead that point is passed on to the new owner. So the density of the
+ * map does not grow with the number of overlapping scans.
+ *
+ * The voxels are found in an open addressing hash table with linear
+ * probing. Closest points are searched in the voxels overlapping the search
+ * sphere, starting with the voxel of the query point. During a registration the
+ * closest point of the previous ICP iteration is remembered for every
+ * query point. Its distance bounds the search of the next iteration,
+ * which then mostly stays within a single voxel.
+ */
+class VoxelMapTree : public SearchTree {
+public:
+  VoxelMapTree(double voxelSize, double resolution);
+
+  virtual ~VoxelMapTree() {}
+
+  virtual double *FindClosest(double *_p, double maxdist2, int threadNum = 0) const;
+
+  virtual void getPtPairs(vector <PtPair> *pairs,
+                          double *source_alignxf,
+                          const DataXYZ& xyz_r, const DataNormal& normal_r,
+                          unsigned int startindex, unsigned int endindex,
+                          int thread_num,
+                          int rnd, double max_dist_match2, double &sum,
+                          double *centroid_m, double *centroid_d,
+                          PairingMode pairing_mode = CLOSEST_POINT);
+
+  /** Adds the points of a scan with the given owner */
+  void insert(const DataXYZ& xyz, int owner, std::vector<long long>& keys);
+
+  /** Removes the points still owned by owner from the given voxels */
+  void remove(int owner, const std::vector<long long>& keys);
+
+  /** Prepares the hints for a registration of n points, 0 to drop them */
+  void resetHints(unsigned int n);
+
+  inline unsigned int getNrPoints() const { return nrPoints; }
+  inline unsigned int getNrVoxels() const { return nrVoxels; }
+
+private:
+  struct Voxel {
+    std::vector<double> points;
+    std::vector<int> owners;
+    int lastOwner;   //!< the owner of the last insert() touching the voxel
+  };
+
+  long long key(long long x, long long y, long long z) const;
+  void cell(const double *p, long long c[3]) const;
+  const double *closest(const double *p, double maxdist2, const double *hint) const;
+
+  unsigned int slot(long long key) const;
+  /** The voxel with the key, -1 if there is none */
+  int findVoxel(long long key) const;
+  /** The voxel with the key, created if there is none */
+  int addVoxel(long long key, bool &created);
+  void eraseVoxel(long long key);
+  void rehash(unsigned int size);
+
+  double voxelSize;
+  double resolution2;
+  unsigned int nrPoints;
+
+  std::vector<Voxel> pool;
+  std::vector<int> freeVoxels;
+  unsigned int nrVoxels;
+
+  struct Slot {
+    long long key;
+    int voxel;   //!< index into pool, -1 for an empty slot
+  };
+
+  //! the hash table
+  std::vector<Slot> slots;
+
+  //! closest point of the previous ICP iteration for each query point
+  std::vector<const double*> hints;
+};
+
+/**
+ * @brief The registered static points of the last scans
+ *
+ * Each scan is registered against the reduced points of up to windowSize
+ * previous scans, in world coordinates, instead of the previous scan
+ * only. After the registration its points are added to the map and the
+ * points of the oldest scan are removed, so no search tree has to be
+ * built per scan. The map keeps its own copy of the points, it does not
+ * refer to the scans after insert().
+ *
+ * The map is the model of icp6D::match(), hence a Scan. It is not part of
+ * Scan::allScans and does not write frames.
+ */
+class VeloLocalMap : public Scan {
+public:
+  /**
+   * @param voxelSize side length of the voxels, about twice the maximal matching distance
+   * @param resolution minimal distance of the points of the map
+   * @param windowSize number of scans in the map
+   */
+  VeloLocalMap(double voxelSize, double resolution, unsigned int windowSize);
+  virtual ~VeloLocalMap();
+
+  /**
+   * Registers the scan against the map
+   * @return the number of ICP iterations, 0 if the map is empty
+   */
+  int match(icp6D *my_icp, Scan *scan);
+
+  /** Adds the reduced points of a registered scan */
+  void insert(Scan *scan);
+
+  inline unsigned int getNrPoints() const { return tree->getNrPoints(); }
+  inline unsigned int getNrScans() const { return window.size(); }
+
+  virtual void setRangeFilter(double max, double min) {}
+  virtual void setHeightFilter(double top, double bottom) {}
+
+  virtual const char* getIdentifier() const { return "localmap"; }
+
+  virtual DataPointer get(const std::string& identifier) { return DataPointer(0, 0); }
+  virtual void get(unsigned int types) {}
+  virtual DataPointer create(const std::string& identifier, unsigned int size) { return DataPointer(0, 0); }
+  virtual void clear(const std::string& identifier) {}
+
+  virtual unsigned int readFrames() { return 0; }
+  virtual void saveFrames() {}
+  virtual unsigned int getFrameCount() { return 0; }
+  virtual void getFrame(unsigned int i, const double*& pose_matrix, AlgoType& type) {}
+
+protected:
+  virtual void createSearchTreePrivate() {}
+  virtual void calcReducedOnDemandPrivate() {}
+  virtual void calcNormalsOnDemandPrivate() {}
+  virtual void addFrame(AlgoType type) {}
+
+private:
+  struct Entry {
+    int owner;
+    std::vector<long long> keys;   //!< voxels holding points of the scan
+  };
+
+  VoxelMapTree *tree;
+  unsigned int windowSize;
+  std::deque<Entry> window;
+  int nextOwner;
+};
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * @file
+ * @brief Pipelined processing of velodyne revolutions in veloslam
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifndef __VELOPIPELINE_H__
+#define __VELOPIPELINE_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <ostream>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+
+#include "slam6d/io_types.h"
+
+class VeloScan;
+class VeloLocalMap;
+class icp6D;
+
+/**
+ * @brief Bounded queue between two stages of the pipeline
+ *
+ * push() blocks while the queue is full, pop() while it is empty. After
+ * close() no items are accepted any more and pop() returns false once the
+ * remaining items have been taken.
+ */
+template <class T>
+class PipelineQueue {
+public:
+  PipelineQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+  bool push(const T& item)
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    while (items.size() >= capacity && !closed) notFull.wait(lock);
+    if (closed) return false;
+    items.push_back(item);
+    notEmpty.notify_one();
+    return true;
+  }
+
+  bool pop(T& item)
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    while (items.empty() && !closed) notEmpty.wait(lock);
+    if (items.empty()) return false;
+    item = items.front();
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  /** Takes the oldest item without waiting, false if there is none */
+  bool tryPop(T& item)
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    if (items.empty()) return false;
+    item = items.front();
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+  }
+
+private:
+  std::deque<T> items;
+  size_t capacity;
+  bool closed;
+  boost::mutex mutex;
+  boost::condition notEmpty, notFull;
+};
+
+/**
+ * @brief Histogram of latencies with a resolution of one millisecond
+ */
+class LatencyHistogram {
+public:
+  LatencyHistogram(const std::string& name);
+
+  void add(long ms);
+
+  /** The latency not exceeded by the fraction p of all samples */
+  long percentile(double p) const;
+
+  /** The number of samples above ms */
+  unsigned long countAbove(long ms) const;
+
+  inline unsigned long getCount() const { return count; }
+
+  void print(std::ostream& os) const;
+
+  //! latencies from this value on share the last bin
+  static const long max_ms = 2000;
+
+private:
+  std::string name;
+  std::vector<unsigned long> bins;
+  unsigned long count;
+  long max;
+  double sum;
+};
+
+/**
+ * @brief A revolution of the sensor, decoded by the reader
+ *
+ * The revolutions form a ring buffer, their point arrays are reused.
+ */
+struct VeloRevolution {
+  int index;
+  std::vector<double> xyz;
+  //! the time the revolution has been recorded completely
+  unsigned long arrival;
+  unsigned long decoded;
+};
+
+/**
+ * @brief A scan passed from one stage to the next
+ */
+struct VeloFrame {
+  VeloScan *scan;
+  int index;
+  unsigned long arrival;
+  unsigned long decoded;
+  unsigned long segmented;
+  unsigned long reduced;
+};
+
+/**
+ * @brief Processes the revolutions of a velodyne log in overlapping stages
+ *
+ * A reader thread decodes the revolutions one after the other into a ring
+ * buffer. The segmentation and tracking, the reduction and search tree
+ * build and the ICP matching run in their own threads, each working on a
+ * different revolution. Stages are connected by bounded queues, so the
+ * number of revolutions in flight, and thus the latency, is limited.
+ *
+ * Tracking uses the poses of the previous scans, in this mode it waits
+ * for the matching of the previous scan to finish, which gives the same
+ * results as processing the scans one after the other. Only the
+ * segmentation adds scans to Scan::allScans and deletes the oldest one
+ * once its successor has been matched; the ICP, which adds frames to all
+ * scans, runs under the same mutex.
+ *
+ * If a replay rate is given, revolutions arrive at the rate of the sensor
+ * and the oldest one waiting is dropped if the pipeline does not keep up.
+ * Otherwise the reader waits for the pipeline.
+ *
+ * With a local map of the last scans the scans are registered against the
+ * map and need no search tree of their own.
+ */
+class VeloPipeline {
+public:
+  VeloPipeline(icp6D *my_icp, bool eP, int tracking, int trackingAlgo,
+               int maxDist, int minDist, double red, int octree,
+               int nns_method, bool cuda_enabled,
+               int ringSize = 4, double rate = 0.0,
+               int localmap = 0, double mapVoxelSize = 50.0);
+  ~VeloPipeline();
+
+  /** Processes the revolutions start to end, all of them if end < 0 */
+  void run(const std::string& dir, IOType type, int start, int end);
+
+  void printStatistics(std::ostream& os) const;
+
+private:
+  void readRevolutions();
+  void segment();
+  void reduce();
+  void match();
+
+  /** Waits until the scans up to index have been matched */
+  void waitMatched(int index);
+
+  icp6D *my_icp;
+  bool eP;
+  int tracking;
+  int trackingAlgo;
+  int maxDist, minDist;
+  double red;
+  int octree;
+  int nns_method;
+  bool cuda_enabled;
+  int ringSize;
+  double rate;
+  VeloLocalMap *localMap;
+
+  std::string dir;
+  IOType type;
+  int start, end;
+
+  PipelineQueue<VeloRevolution*> freeRevolutions;
+  PipelineQueue<VeloRevolution*> revolutions;
+  PipelineQueue<VeloFrame> segmented;
+  PipelineQueue<VeloFrame> reduced;
+
+  //! guards Scan::allScans between the segmentation and the matching
+  boost::mutex scansMutex;
+
+  //! all scans before this index are matched
+  int matched;
+  boost::mutex matchedMutex;
+  boost::condition matchedCond;
+
+  unsigned long dropped;
+  unsigned long started, finished;
+
+  LatencyHistogram decodeTime, segmentTime, reduceTime, matchTime, endToEnd;
+};
+
+#endif
@@ -40,6 +40,7 @@ class VeloScan : public BasicScan {
 
 public:
   VeloScan();
+  VeloScan(double *rPos, double *rPosTheta, vector<double*> points);
   VeloScan(const VeloScan& s);
   ~VeloScan();
 
@@ -74,6 +75,9 @@ public:
   bool isTrackerHandled;
   long scanid;
 
+  /** points within the range of the grid, referred to by scanCellArray */
+  vector<Point> scanPoints;
+
   /** scanCellFeatureArray */
   cellArray scanCellArray;
   cellFeatureArray scanCellFeatureArray;
@@ -82,6 +86,11 @@ public:
   clusterFeatureArray scanClusterFeatureArray;
 
   int clusterNum;//the number of clusters to be tracked, added by yuanjun
+
+private:
+  /** memory of the grid of a deleted scan, taken over by the next scan */
+  static cellArray spareCellArray;
+  static vector<Point> spareScanPoints;
 };
 
 #endif
@@ -67,7 +67,7 @@ void usage(char* prog)
 	 << "Usage: " << prog << endl
 	 << "       [-s NR] [-e NR] [-m NR] [-M NR] [-f F] [-o DIR] [-t] " << endl
 	 << "       [-h NR] [-H NR] [-r NR] [-w] [-p NR] [-P Nr] [-y] [-n] " <<endl
-	 << "       [-g] [-d] [-l] [-a NR] inputdirectory" << endl << endl;
+	 << "       [-g] [-d] [-l] [-a NR] [-B NR] inputdirectory" << endl << endl;
     
     cout << "  -s NR   start at scan NR (i.e., neglects the first NR scans)" << endl
 	 << "          [ATTENTION: counting starts with 0]" << endl
@@ -104,6 +104,8 @@ void usage(char* prog)
 	 << "  -c      default 50. This is the numbers of scans which " << endl
 	 << "          will be process at a time" << endl
 	 << "  -R      default false, if set the programm will resume " << endl
+	 << "  -B NR   default 512, the memory in MB for the parcels in memory" << endl
+	 << "          (the least recently used parcels are written to disk)" << endl
 	 << endl << endl;
 
     exit(1);
@@ -160,7 +162,7 @@ int parseArgs(int argc, char **argv,
 	      int &parcelWidth, int &parcelHeight,
 	      bool &writeWorld, bool &writeLines, bool &writeGrids,
 	      int &spotradius, bool &writeWorldppm, int& count,
-	      bool &resume)
+	      bool &resume, size_t &memoryBudget)
 {
     int  c;
     
@@ -169,7 +171,7 @@ int parseArgs(int argc, char **argv,
     extern int optind;
     
     cout << endl;
-    while ((c = getopt (argc, argv, "o:s:a:e:m:ncwgidlRM:h:H:f:r:p:P:yt")) != -1)
+    while ((c = getopt (argc, argv, "o:s:a:e:m:nc:wgidlRM:h:H:f:r:p:P:ytB:")) != -1)
     {
       switch (c)
       {
@@ -208,6 +210,13 @@ int parseArgs(int argc, char **argv,
         case 'R':
           resume = true;
           break;
+        case 'B':
+          if (atoi(optarg) < 1) {
+            cerr << "Error: <memory> must be at least 1 MB.\n";
+            exit(1);
+          }
+          memoryBudget = (size_t)atoi(optarg) * 1024 * 1024;
+          break;
         case 'm':
           maxDist = atoi(optarg);
           break;
@@ -360,6 +369,7 @@ int main(int argc, char **argv){
     double isSolidPoint = 0.2;
     int count = 50;
     bool resume = false;
+    size_t memoryBudget = 512 * 1024 * 1024;
     ///////////////////////////////////////
 
 
@@ -371,7 +381,7 @@ int main(int argc, char **argv){
 	      createWaypoints, createNeighbours,
 	      parcelWidth, parcelHeight,
 	      writeWorld, writeLines, writeGrids, spotradius, writeWorldppm,
-	      count, resume);
+	      count, resume, memoryBudget);
 
     // calculate parcel width and height
     parcelWidth /= resolution;
@@ -380,10 +390,17 @@ int main(int argc, char **argv){
     // create parcelmanager
     cout << "Create parcelmanager ..." << endl;
     parcelmanager parcelman(parcelWidth, parcelHeight,
-			    outputdir, resolution, resume);
+			    outputdir, resolution, resume, memoryBudget);
+    cout << "Keeping at most " << parcelman.getMaxLoaded()
+	 << " parcels in memory" << endl;
 
     cout << "Create viewpointlist ... " << endl;
     viewpointinfo viewpoint(outputdir);
+
+    // timing of the phases in milliseconds
+    unsigned long starttime = GetCurrentTimeInMilliSec();
+    unsigned long convertTime = 0, addTime = 0;
+    size_t maxGridMemory = 0;
     
     for (int i = start; i <= end; i+=count)
     {
@@ -413,28 +430,37 @@ int main(int argc, char **argv){
 	// convert scans
 	cout << "Converting " << scanman.getScanCount() <<" scans ... ";
 	
+	unsigned long phasetime = GetCurrentTimeInMilliSec();
 	vector<scanGrid*> grids;
+	size_t gridMemory = 0;
+	cout << endl;
 	for(size_t j = 0; j < scanman.getScanCount(); j++)
 	{
-	    cout << "." << flush;
 	    double* p = scanman.getMatrix(j).back();
 	    scanman.getScan(j).transformAll(p);
+	    unsigned long scantime = GetCurrentTimeInMilliSec();
 	    grids.push_back(stg.convert(scanman.getScan(j), p));
+	    scantime = GetCurrentTimeInMilliSec() - scantime;
+	    gridMemory += grids.back()->getMemoryUsage();
+	    cout << "  scan " << i + j << ": " << grids.back()->getSizeX() << " x "
+		 << grids.back()->getSizeZ() << " cells, rasterized in "
+		 << scantime << " ms" << endl;
 	}
-	cout << "Done." << endl;
+	phasetime = GetCurrentTimeInMilliSec() - phasetime;
+	convertTime += phasetime;
+	if(gridMemory > maxGridMemory) maxGridMemory = gridMemory;
+	cout << "Done (" << phasetime / 1000.0 << " s, "
+	     << gridMemory / (1024.0 * 1024.0) << " MB)." << endl;
 
 	// start writing
 	cout << "Processing from " << i << " to " << endloop << endl;	
+	phasetime = GetCurrentTimeInMilliSec();
+	cout << "Adding scans " << i << " to " << endloop << " ... " << flush;
+	parcelman.addGrids(grids);
 	for(size_t j = 0; j < grids.size(); ++j)
-	{
-	    cout << "Adding scan " << i << " ... " << flush; 
-	    parcelman.addGrid(grids[j],
-			      grids[j]->getViewpointX(),
-			      grids[j]->getViewpointZ());
-	   
 	    viewpoint.addGrid(grids[j]);
-	    cout << "Done."<< endl;
-	}
+	cout << "Done."<< endl;
+	addTime += GetCurrentTimeInMilliSec() - phasetime;
 
 	// print grids for each scan if wished
 	if(writeGrids)
@@ -479,29 +505,40 @@ int main(int argc, char **argv){
 	cout << "Done." << endl;
     }
         
+    // the world ppm is written parcel by parcel
+    if(writeWorldppm) {
+	cout << "Writing world ppm ... " << flush;
+	unsigned long phasetime = GetCurrentTimeInMilliSec();
+	parcelman.writeWorldPPM(outputdir + "world.ppm");
+	cout << "Done (" << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0
+	     << " s)." << endl;
+    }
+
     // write gridlines
-    if(writeLines || writeWorldppm)
+    if(writeLines)
     {	
 	cout << "Creating world grid ... ";
+	unsigned long phasetime = GetCurrentTimeInMilliSec();
 	grid *g = parcelman.createWorldGrid();
-	cout << "Done." << endl;
-
-	if(writeLines) {
-	    cout << "Writing Lines ... ";
-	    gridlines glines(g, maxDistance, isSolidPoint);
-	    glines.writeLin(outputdir + "/lines.plot");
-	    cout << "Done." << endl;
-	}
+	cout << "Done (" << g->getSizeX() << " x " << g->getSizeZ() << " cells, "
+	     << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s, "
+	     << g->getMemoryUsage() / (1024.0 * 1024.0) << " MB)." << endl;
 
-	if(writeWorldppm) {
-	    cout << "Writing world ppm ... ";
-	    ppmWriter writer(outputdir + "world.ppm");
-	    writer.write(*g);
-	    cout << "Done." << endl;
-	}
+	cout << "Writing Lines ... ";
+	gridlines glines(g, maxDistance, isSolidPoint);
+	glines.writeLin(outputdir + "/lines.plot");
+	cout << "Done." << endl;
 	
 	delete g;
     }
 
+    cout << "Converting scans: " << convertTime / 1000.0 << " s" << endl
+	 << "Adding grids to parcels: " << addTime / 1000.0 << " s" << endl
+	 << "Maximal memory of the scan grids: "
+	 << maxGridMemory / (1024.0 * 1024.0) << " MB" << endl
+	 << "Parcels written: " << parcelman.getStores()
+	 << ", read: " << parcelman.getLoads() << endl
+	 << "Total: " << (GetCurrentTimeInMilliSec() - starttime) / 1000.0 << " s" << endl;
+
     cout << "Freeing data ... " << endl;
 } 
@@ -14,7 +14,7 @@
 
 /**
  * CTor.
- * Allocates an array of gridPoints
+ * Allocates the counter arrays of all cells
  * and sets the offsets and sizes
  *
  * @param offsetX the x-offest of the array
@@ -30,24 +30,15 @@ grid::grid(long offsetX, long offsetZ, long sizeX, long sizeZ)
 	exit(1);
     }
  
-    points = NULL;
-
-    // Allocate array
-    this->points = new gridPoint**[sizeX];
-
-    for(int i=0; i < sizeX; ++i)
-    {
-        this->points[i] = new gridPoint*[sizeZ];
-        for(int j=0; j < sizeZ; ++j)
-        {
-            this->points[i][j] = new gridPoint(offsetX + i, offsetZ + j);       
-        }
-    }
-    
     this->offsetX = offsetX;
     this->offsetZ = offsetZ;
     this->sizeX = sizeX;
     this->sizeZ = sizeZ;
+
+    // Allocate arrays, all counters are 0
+    size_t size = (size_t)sizeX * sizeZ;
+    this->counts = new unsigned int[size]();
+    this->occupieds = new unsigned int[size]();
 }
 
 /**
@@ -63,23 +54,11 @@ grid::~grid()
  */
 void grid::clear()
 {
-    if(this->points == NULL)
-        return;
+    delete[] this->counts;
+    delete[] this->occupieds;
 
-    // delete all points
-    for(int i=0; i < getSizeX(); ++i)
-    {
-        for(int j=0; j < getSizeZ(); ++j)
-        {
-            delete this->points[i][j];      
-        }
-        
-        delete[] this->points[i];
-    }
-
-    delete[] this->points;
-
-    this->points = NULL;
+    this->counts = NULL;
+    this->occupieds = NULL;
 }
 
 /**
@@ -92,17 +71,23 @@ void grid::clear()
  */
 void grid::addPoint(long x, long z, unsigned int count, unsigned int occupied)
 {
-    if(this->points == NULL)
+    if(this->counts == NULL)
     {
 	std::cerr << "ERROR: In grid::addPoint, allocate never called!" << std::endl;
 	exit(1);
     }
 
-    // get the absolute gridPoint 
-    gridPoint *p = getAbsolutePoint(x, z);
+    if(!contains(x, z))
+    {
+	std::cerr << "ERROR: In grid::addPoint (" 
+		  << x << "|" << z <<") not in the grid!" << std::endl;
+	exit(1);
+    }
 
     // increase counters 
-    p->addCount(count, occupied);
+    size_t k = index(x - getOffsetX(), z - getOffsetZ());
+    this->counts[k] += count;
+    this->occupieds[k] += occupied;
 }
 
 /**
@@ -112,8 +97,7 @@ void grid::addPoint(long x, long z, unsigned int count, unsigned int occupied)
  */
 void grid::addPoint(const gridPoint& point)
 {
-    gridPoint *p = getAbsolutePoint(point.getX(), point.getZ());
-    p->addCount(point.getCount(), point.getOccupied());
+    addPoint(point.getX(), point.getZ(), point.getCount(), point.getOccupied());
 }
 
 /**
@@ -126,8 +110,42 @@ void grid::addPoint(const gridPoint& point)
  */
 void grid::setPoint(long x, long z, unsigned int count, unsigned int occupied)
 {
-    gridPoint* p = getAbsolutePoint(x, z);
-    p->setFixed(count, occupied);
+    if(!contains(x, z))
+    {
+	std::cerr << "ERROR: In grid::setPoint (" 
+		  << x << "|" << z <<") not in the grid!" << std::endl;
+	exit(1);
+    }
+
+    setFixed(x - getOffsetX(), z - getOffsetZ(), count, occupied);
+}
+
+/**
+ * Adds the cells of the given grid that overlap with this grid.
+ * The counters are added row by row, the rest of the grid is ignored.
+ *
+ * @param g the grid to be added
+ */
+void grid::addGrid(const grid* g)
+{
+    // Calculate the overlapping area in absolute coordinates
+    long startX = g->getOffsetX() < getOffsetX() ? getOffsetX() : g->getOffsetX();
+    long startZ = g->getOffsetZ() < getOffsetZ() ? getOffsetZ() : g->getOffsetZ();
+    long endX = g->getOffsetX() + g->getSizeX() < getOffsetX() + getSizeX() ?
+	g->getOffsetX() + g->getSizeX() : getOffsetX() + getSizeX();
+    long endZ = g->getOffsetZ() + g->getSizeZ() < getOffsetZ() + getSizeZ() ?
+	g->getOffsetZ() + g->getSizeZ() : getOffsetZ() + getSizeZ();
+
+    for(long i = startX; i < endX; ++i)
+    {
+	size_t dst = index(i - getOffsetX(), startZ - getOffsetZ());
+	size_t src = g->index(i - g->getOffsetX(), startZ - g->getOffsetZ());
+	for(long j = startZ; j < endZ; ++j, ++dst, ++src)
+	{
+	    this->counts[dst] += g->counts[src];
+	    this->occupieds[dst] += g->occupieds[src];
+	}
+    }
 }
 
 /**
@@ -137,9 +155,9 @@ void grid::setPoint(long x, long z, unsigned int count, unsigned int occupied)
  * @param x the absolute x coordinate
  * @param z the absolute z coordinate
  *
- * @return gridPoint* pointer to the found gridPoint
+ * @return gridPoint a view of the found cell
  */
-gridPoint* grid::getAbsolutePoint(long x, long z) const
+gridPoint grid::getAbsolutePoint(long x, long z) const
 {
     // Transform to relative coordinates
     x -= getOffsetX();
@@ -152,8 +170,5 @@ gridPoint* grid::getAbsolutePoint(long x, long z) const
 	exit(1);
     }
     
-    return this->points[x][z];
+    return getPoint(x, z);
 }
-
-
- 
@@ -25,6 +25,22 @@ gridPoint::gridPoint(long x, long z)
     this->occupied = 0;
 }
 
+/**
+ * CTor. Sets all values, used for views of the cells of a grid
+ *
+ * @param x the x coordinate
+ * @param z the z coordinate
+ * @param count the visited counter
+ * @param occupied the occupied counter
+ */
+gridPoint::gridPoint(long x, long z, unsigned int count, unsigned int occupied)
+{
+    this->x = x;
+    this->z = z;
+    this->count = count;
+    this->occupied = occupied;
+}
+
 /**
  * The Method increases the internal counter of the point.
  * If only count should be increased, occupied must be 0;
@@ -86,10 +86,11 @@ void ppmWriter::write(const grid& grid)
     {
 	for(long j=0; j < grid.getSizeX(); ++j)
 	{
-	    if(grid.points[j][i]->getPercent() < 0)
+	    float percent = grid.getPercent(j, i);
+	    if(percent < 0)
 		stream << "50 ";
 	    else
-		stream << 100 - (int)(grid.points[j][i]->getPercent() * 100) << " ";
+		stream << 100 - (int)(percent * 100) << " ";
 	}
 	stream << endl;
     }
@@ -126,10 +127,10 @@ void parcelWriter::write(const grid& grid)
 
     for(long i = 0; i < grid.getSizeX(); ++i)
 	for(long j = 0; j < grid.getSizeZ(); j++)
-	    stream << grid.points[i][j]->getX() << " "
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getCount() << " "
-		   << grid.points[i][j]->getOccupied() << endl;
+	    stream << grid.getOffsetX() + i << " "
+		   << grid.getOffsetZ() + j << " "
+		   << grid.getCount(i, j) << " "
+		   << grid.getOccupied(i, j) << endl;
 }
       
 /**
@@ -160,9 +161,9 @@ void gnuplotWriter::write(const grid& grid)
 {
     for(long i=0; i < grid.getSizeX(); ++i)
 	for(long j=0; j < grid.getSizeZ(); ++j)
-	    stream << grid.points[i][j]->getX() << " "
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getPercent() << endl;
+	    stream << grid.getOffsetX() + i << " "
+		   << grid.getOffsetZ() + j << " "
+		   << grid.getPercent(i, j) << endl;
 }
 
 /**
@@ -221,9 +222,9 @@ void worldWriter::write(const grid& grid)
     {
 	for(int j=0; j < grid.getSizeZ(); ++j)
 	{
-	    stream << grid.points[i][j]->getX() << " " 
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getPercent() << endl;
+	    stream << grid.getOffsetX() + i << " " 
+		   << grid.getOffsetZ() + j << " "
+		   << grid.getPercent(i, j) << endl;
 	}
     }
 }
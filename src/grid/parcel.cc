@@ -10,6 +10,7 @@
 #include "grid/parcel.h"
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 using std::cerr;
 using std::endl;
@@ -27,39 +28,6 @@ parcel::parcel(long offSetX, long offSetZ, long sizeX, long sizeZ)
 {
 }
 
-/**
- * Adds a grid to the parcel.
- * Adds just the points belonging to the parcel and
- * ignoring the rest.
- * 
- * @param grid the grid to be added to the parcel
- */
-void parcel::addGrid(const grid* g)
-{
-    // Calculate the startvalue of x
-    long startX = g->getOffsetX() < getOffsetX() ? getOffsetX() : g->getOffsetX();
-    
-    // calculate z-startvalue
-    long startZ = g->getOffsetZ() < getOffsetZ() ? getOffsetZ() : g->getOffsetZ();
-    
-    // calculate x-endvalue
-    long endX = g->getOffsetX() + g->getSizeX() < getOffsetX() + getSizeX() ? g->getOffsetX() + g->getSizeX() 
-	: getOffsetX() + getSizeX();
-
-    // calculate z-endvalue
-    long endZ = g->getOffsetZ() + g->getSizeZ() < getOffsetZ() + getSizeZ() ? g->getOffsetZ() + g->getSizeZ() 
-	: getOffsetZ() + getSizeZ();
-
-    // add every point
-    for(int i = startX; i < endX; i++)
-    {
-	for(int j = startZ; j < endZ; j++)
-	{
-	    this->addPoint(*g->getAbsolutePoint(i, j));
-	}
-    }
-} 
-
 /**
  * The static method reads the file and creates a new parcel.
  * The parcel is allocated with new, so the caller has to make
@@ -104,3 +72,76 @@ parcel* parcel::readParcel(std::string filename)
     
     return p;
 }
+
+/** Identifies binary tile files */
+static const char tileMagic[4] = { 'P', 'C', 'L', '1' };
+
+/**
+ * Writes the parcel to a binary tile file. The file contains the offsets
+ * and sizes followed by the raw counter arrays, so it is read with two
+ * block reads.
+ *
+ * @param filename the filename of the tile
+ * @return true if the tile was written successfully
+ */
+bool parcel::writeTile(const std::string &filename) const
+{
+    std::ofstream outfile(filename.c_str(), std::ios::binary);
+    if(!outfile.good())
+	return false;
+
+    long long header[4] = { getOffsetX(), getOffsetZ(), getSizeX(), getSizeZ() };
+    size_t size = (size_t)getSizeX() * getSizeZ() * sizeof(unsigned int);
+
+    outfile.write(tileMagic, sizeof(tileMagic));
+    outfile.write((const char*)header, sizeof(header));
+    outfile.write((const char*)this->counts, size);
+    outfile.write((const char*)this->occupieds, size);
+
+    return outfile.good();
+}
+
+/**
+ * The static method reads a binary tile file and creates a new parcel.
+ * Files in the text format of parcelWriter are still read via
+ * readParcel. The parcel is allocated with new, so the caller has to make
+ * sure it is deleted properly!
+ *
+ * @param filename the filename of the tile
+ * @return parcel the created parcel
+ */
+parcel* parcel::readTile(const std::string &filename)
+{
+    std::ifstream infile(filename.c_str(), std::ios::binary);
+
+    // Stream ok?
+    if(!infile.good())
+    {
+	std::cerr << "ERROR: In parcel::readTile, couldn't open stream!" << std::endl;
+	exit(1);
+    }
+
+    char magic[4];
+    infile.read(magic, sizeof(magic));
+    if(!infile.good() || std::memcmp(magic, tileMagic, sizeof(magic)) != 0)
+    {
+	infile.close();
+	return readParcel(filename);
+    }
+
+    long long header[4];
+    infile.read((char*)header, sizeof(header));
+
+    parcel* p = new parcel(header[0], header[1], header[2], header[3]);
+    size_t size = (size_t)header[2] * header[3] * sizeof(unsigned int);
+    infile.read((char*)p->counts, size);
+    infile.read((char*)p->occupieds, size);
+
+    if(!infile.good())
+    {
+	std::cerr << "ERROR: In parcel::readTile, " << filename << " is truncated!" << std::endl;
+	exit(1);
+    }
+
+    return p;
+}
@@ -7,6 +7,12 @@
  *
  */
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include "grid/parcelmanager.h"
 #include "slam6d/globals.icc"
 #include "grid/gridWriter.h"
@@ -16,6 +22,12 @@ using std::ofstream;
 #include <iostream>
 using std::cerr;
 using std::endl;
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /**
  * Ctor.
@@ -24,17 +36,18 @@ using std::endl;
  * If the file was read successfully, it contains the parcels created
  * during the last run of the programm. (See the resumeflag in the
  * documentation for more infos)
- * 
- * 
+ *
+ *
  * @param width The width of each parcel
  * @param height The height of each parcel
  * @param path The path of the files
  * @param resolution The resolution of a cell
  * @param resume If true, last parcelinfofile will be loaded
+ * @param memoryBudget The maximal memory of the parcels in memory in bytes
  */
 parcelmanager::parcelmanager(long width, long height,
 			     string path, int resolution,
-			     bool resume)
+			     bool resume, size_t memoryBudget)
 {
     this->parcelwidth = width;
     this->parcelheight = height;
@@ -42,12 +55,19 @@ parcelmanager::parcelmanager(long width, long height,
     this->viewpointZ = 0;
     this->path = path;
     this->resolution = resolution;
-    
+
     this->minX = 0;
     this->maxX = 0;
     this->minZ = 0;
     this->maxZ = 0;
-    
+
+    this->loads = 0;
+    this->stores = 0;
+
+    // a parcel holds two counters per cell
+    size_t parcelMemory = 2 * sizeof(unsigned int) * (size_t)width * height;
+    this->maxLoaded = std::max((size_t)1, memoryBudget / parcelMemory);
+
     parcelinfo::setParcelsize(width, height);
 
     // loadParcelinfo if programm should resume
@@ -57,128 +77,168 @@ parcelmanager::parcelmanager(long width, long height,
 
 /**
  * Dtor.
- * Calls saveParcelinfo for saving infos about 
+ * Calls saveParcelinfo for saving infos about
  * already created parcel.
  * It also clears the internal structur (calls clear())
  */
 parcelmanager::~parcelmanager()
 {
     saveParcelinfo(this->path + PARCELINFOFILE);
-  
+
     clear();
 }
 
 /**
- * This methods removes all parcels with a not set
- * used-flag (in parcelinfo). They are saved to disk
- * before they are freed.
- * If all is set, all parcels are saved and free regardless
- * of their used-flag
+ * Returns the tile coordinate of the absolute coordinate v,
+ * rounding towards negative infinity
  *
- * @param all Delete all parcels or not?
+ * @param v the absolute coordinate
+ * @param size the size of the parcels in this direction
+ * @return the tile coordinate
  */
-void parcelmanager::freeMemory(bool all)
+long parcelmanager::tileCoord(long v, long size)
 {
-    parcelmap::iterator cur = this->parcels.begin();
-    parcelmap::iterator end = this->parcels.end();
-    
-    // iterate through each parcel
-    while(cur != end)
+    long t = v / size;
+    if(v % size != 0 && v < 0)
+	--t;
+    return t;
+}
+
+/**
+ * Packs the tile coordinates into a single key
+ *
+ * @param tileX the x tile coordinate
+ * @param tileZ the z tile coordinate
+ * @return the key of the tile
+ */
+long long parcelmanager::tileKey(long tileX, long tileZ)
+{
+    return (long long)(((unsigned long long)(unsigned int)tileX << 32) |
+		       (unsigned int)tileZ);
+}
+
+/**
+ * The method writes the parcel to its tile file, if it has been
+ * changed, and frees it.
+ *
+ * @param t The tile of the parcel
+ */
+void parcelmanager::evict(tile &t)
+{
+    if(t.data == NULL)
+	return;
+
+    if(t.dirty)
     {
-	// if parcel is loaded and wasnt used (or all free)
-	if(cur->second != NULL &&
-	   (!cur->first->wasUsed() || all))
-	{	    
-	    // saving the parcel using the parcel format
-            // (Must use parcelFormat, otherwise parcel cant be loaded again!)
-	    string filename = cur->first->getFilename();
-	    parcelWriter writer(filename);
-
-	    writer.write(*cur->second);
-	    
-	    delete cur->second;
-	    cur->second = NULL;
-	    
+	if(!t.data->writeTile(t.info->getFilename()))
+	{
+	    cerr << "ERROR: In parcelmanager::evict, couldn't write "
+		 << t.info->getFilename() << endl;
+	    exit(1);
 	}
-	
-	// reset used-flag of parcelinfo
-	parcelinfo *p = cur->first;
-	p->resetUsed();
-	
-	++cur;
+	++this->stores;
+    }
+
+    this->lru.erase(t.lru);
+    delete t.data;
+    t.data = NULL;
+    t.dirty = false;
+}
+
+/**
+ * This method saves and frees all parcels in memory.
+ */
+void parcelmanager::freeMemory()
+{
+    parcelmap::iterator it = this->parcels.begin();
+    parcelmap::iterator end = this->parcels.end();
+
+    while(it != end)
+    {
+	evict(it->second);
+	++it;
     }
 }
 
 /**
  * The method frees all created parcelinfos and clears the map.
- * First it calls freeMemory(true) to save all parcels in memory
- */ 
+ * First it calls freeMemory() to save all parcels in memory
+ */
 void parcelmanager::clear()
 {
-  freeMemory(true);
-  
+  freeMemory();
+
   parcelmap::iterator it = this->parcels.begin();
   parcelmap::iterator end = this->parcels.end();
 
   while(it != end)
   {
-      delete it->first;      
+      delete it->second.info;
       ++it;
   }
 
   this->parcels.clear();
+  this->lru.clear();
 }
 
 /**
- * The methods loads the parcel specified by info
- * into memory. The method does check, if the 
- * parcel is already loaded, so calling this method
- * on an already loaded parcel does nothing.
+ * Returns the parcel of the given tile. A parcel that has been
+ * stored is loaded again, a missing parcel is created if create
+ * is set. The parcel becomes the most recently used one, if the
+ * cache is full the least recently used parcel is evicted first.
  *
- * @param *info A pointer to the parcelinfo 
+ * @param tileX The x tile coordinate
+ * @param tileZ The z tile coordinate
+ * @param create Create the parcel if it does not exist
+ * @return The parcel or NULL if it doesn't exist and create is false
  */
-void parcelmanager::loadParcel(parcelinfo* info)
+parcel* parcelmanager::acquire(long tileX, long tileZ, bool create)
 {
-    if(this->parcels[info] == NULL)
-    	this->parcels[info] = parcel::readParcel(info->getFilename());
+    long long key = tileKey(tileX, tileZ);
+    parcelmap::iterator it = this->parcels.find(key);
 
-    updateOuterPoints(this->parcels[info]);    
-}
+    if(it == this->parcels.end() && !create)
+	return NULL;
 
+    // already in memory, just move to the front
+    if(it != this->parcels.end() && it->second.data != NULL)
+    {
+	this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+	return it->second.data;
+    }
 
-/**
- * The method creates a new parcel. It calculates the offset
- * of the new parcel based on the absolute coordinates it is given.
- * The new parcel is added to the internal map, along with its
- * parcelinfo
- *
- * @param x The absolute x coordinate
- * @param z The absolute z coordinate
- */
-void parcelmanager::createParcel(long x, long z)
-{
-    // calculate offset
-    long offsetX = (long) (x / this->parcelwidth) * this->parcelwidth;
-    if (x < 0) 
-	offsetX = offsetX - this->parcelwidth;
-
-    long offsetZ = (long) (z/ this->parcelheight) * this->parcelheight;
-    if (z < 0)
-	offsetZ = offsetZ - this->parcelheight;
-
-
-    // create parcelinfo and parcel
-    string filename = this->path + "parcel" + to_string(offsetX) + to_string(offsetZ) + ".pcl";
-    
-    parcelinfo *p = new parcelinfo(offsetX, offsetZ, filename);
-    
-    this->parcels[p] = new parcel(offsetX,
-				  offsetZ,
-				  this->parcelwidth,
-				  this->parcelheight);  
+    // make room for the parcel
+    if(this->lru.size() >= this->maxLoaded)
+	evict(this->parcels[this->lru.back()]);
+
+    if(it == this->parcels.end())
+    {
+	// create parcelinfo and parcel
+	long offsetX = tileX * this->parcelwidth;
+	long offsetZ = tileZ * this->parcelheight;
+	string filename = this->path + "parcel" + to_string(offsetX) + "_"
+	    + to_string(offsetZ) + ".tile";
+
+	tile t;
+	t.info = new parcelinfo(offsetX, offsetZ, filename);
+	t.data = new parcel(offsetX, offsetZ, this->parcelwidth, this->parcelheight);
+	t.dirty = true;
+	it = this->parcels.insert(std::make_pair(key, t)).first;
+    }
+    else
+    {
+	it->second.data = parcel::readTile(it->second.info->getFilename());
+	it->second.dirty = false;
+	++this->loads;
+    }
+
+    this->lru.push_front(key);
+    it->second.lru = this->lru.begin();
 
     // update the new borders
-    updateOuterPoints(this->parcels[p]);    
+    updateOuterPoints(it->second.data);
+
+    return it->second.data;
 }
 
 /**
@@ -191,7 +251,7 @@ void parcelmanager::updateOuterPoints(const grid *g)
 	minX = g->getOffsetX();
     if(g->getOffsetZ() < minZ)
 	minZ = g->getOffsetZ();
-    
+
     if(g->getOffsetX() + g->getSizeX() > maxX)
 	maxX = g->getOffsetX() + g->getSizeX();
     if(g->getOffsetZ() + g->getSizeZ() > maxZ)
@@ -201,10 +261,9 @@ void parcelmanager::updateOuterPoints(const grid *g)
 
 /**
  * The method adds the given grid to the needed parcels.
- * It checks which parcels are affected by the grid, loads them if
- * they already exist or creates new ones.
- * Afterwards it adds the information of the grid to each relevant
- * parcels
+ * The parcels covered by the grid are loaded if they already exist
+ * or created. Each parcel integrates the part of the grid that
+ * overlaps with it.
  *
  * @param g The grid which should be addeda
  * @param vpX The x-coordiante of the viewpoint
@@ -212,79 +271,101 @@ void parcelmanager::updateOuterPoints(const grid *g)
  */
 void parcelmanager::addGrid(const grid* g, long vpX, long vpZ)
 {
-  bool parcelFound;
- 
   this->viewpointX = vpX;
   this->viewpointZ = vpZ;
-  
-  long iSize = g->getOffsetX() + g->getSizeX();
-  long jSize = g->getOffsetZ() + g->getSizeZ();
 
-  // iterate through all parcels needed in this grid
-  for(int i=g->getOffsetX() ; i < iSize + this->parcelwidth; i += this->parcelwidth)
+  long startX = tileCoord(g->getOffsetX(), this->parcelwidth);
+  long startZ = tileCoord(g->getOffsetZ(), this->parcelheight);
+  long endX = tileCoord(g->getOffsetX() + g->getSizeX() - 1, this->parcelwidth);
+  long endZ = tileCoord(g->getOffsetZ() + g->getSizeZ() - 1, this->parcelheight);
+
+  for(long i = startX; i <= endX; ++i)
   {
-      for(int j=g->getOffsetZ() ; j < jSize + this->parcelheight; j += this->parcelheight)
+      for(long j = startZ; j <= endZ; ++j)
       {
-	  parcelmap::iterator it = this->parcels.begin();
-	  parcelmap::iterator end = this->parcels.end();
-      
-	  parcelFound = false;
-
-	  // for each point, iterate through the existing parcels
-	  while(it != end)
-	  {
-	      // parcel contains point
-	      if(it->first->contains(i, j))
-	      {
-		  // load Parcel if not in memory
-		  if(it->second == NULL)
-		      loadParcel(it->first);
-		  
-		  // reset the counter
-		  it->first->setUsed();
-		  parcelFound = true;
-	      }	
-
-	      ++it;
-	  }
-	  
-	  // if parcel was not found, create new
-	  if(parcelFound == false)
-	      createParcel(i, j);
+	  acquire(i, j)->addGrid(g);
+	  this->parcels[tileKey(i, j)].dirty = true;
       }
   }
+}
 
-  // remove all parcels not needed for the scan
-  freeMemory(false); 
+/**
+ * The method adds several grids to the parcels. The parcels are
+ * processed one after another, so every parcel is loaded only once
+ * for all grids as long as the parcels fit into the memory budget.
+ * The parcels in memory are independent and are filled in parallel.
+ *
+ * @param grids The grids which should be added
+ */
+void parcelmanager::addGrids(const std::vector<scanGrid*> &grids)
+{
+  if(grids.empty())
+      return;
 
-  
-  // Call addGrid for each parcel in memory
-  // The parcel only integrates the points which are
-  // relevant to it 
-  parcelmap::iterator it = this->parcels.begin();
-  parcelmap::iterator end = this->parcels.end();
-  
-  while(it != end)
+  this->viewpointX = grids.back()->getViewpointX();
+  this->viewpointZ = grids.back()->getViewpointZ();
+
+  // collect the tiles covered by the grids
+  std::vector< std::pair<long, long> > tiles;
+  for(size_t k = 0; k < grids.size(); ++k)
   {
-      if(it->second != NULL)
-	  it->second->addGrid(g);
+      const grid *g = grids[k];
+      long startX = tileCoord(g->getOffsetX(), this->parcelwidth);
+      long startZ = tileCoord(g->getOffsetZ(), this->parcelheight);
+      long endX = tileCoord(g->getOffsetX() + g->getSizeX() - 1, this->parcelwidth);
+      long endZ = tileCoord(g->getOffsetZ() + g->getSizeZ() - 1, this->parcelheight);
+      for(long i = startX; i <= endX; ++i)
+	  for(long j = startZ; j <= endZ; ++j)
+	      tiles.push_back(std::make_pair(i, j));
+  }
+  std::sort(tiles.begin(), tiles.end());
+  tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
 
-      ++it;
+  // as many parcels as fit into memory at a time
+  std::vector<parcel*> loaded;
+  for(size_t first = 0; first < tiles.size(); first += this->maxLoaded)
+  {
+      size_t last = std::min(first + this->maxLoaded, tiles.size());
+
+      loaded.clear();
+      for(size_t t = first; t < last; ++t)
+      {
+	  loaded.push_back(acquire(tiles[t].first, tiles[t].second));
+	  this->parcels[tileKey(tiles[t].first, tiles[t].second)].dirty = true;
+      }
+
+#ifdef _OPENMP
+      omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+      for(int t = 0; t < (int)loaded.size(); ++t)
+      {
+	  parcel *p = loaded[t];
+	  for(size_t k = 0; k < grids.size(); ++k)
+	  {
+	      const grid *g = grids[k];
+	      if(g->getOffsetX() < p->getOffsetX() + p->getSizeX() &&
+		 p->getOffsetX() < g->getOffsetX() + g->getSizeX() &&
+		 g->getOffsetZ() < p->getOffsetZ() + p->getSizeZ() &&
+		 p->getOffsetZ() < g->getOffsetZ() + g->getSizeZ())
+		  p->addGrid(g);
+	  }
+      }
   }
 }
 
 
 /**
- * The method saves the internal parcelinfo map to file,
+ * The method saves the infos about all parcels to file,
  * so it can be restored for later use (e.g. for additional scans
  * based on the same scene)
- * 
+ *
  * @param filename The file where the parcelinfos are stored to
  */
 void parcelmanager::saveParcelinfo(string filename)
 {
   ofstream outfile(filename.c_str());
-  
+
   // Check if stream is open and valid
   if(!outfile.good())
   {
@@ -293,16 +374,16 @@ void parcelmanager::saveParcelinfo(string filename)
       exit(1);
   }
 
- 
+
   // iterate all entries and write them
   parcelmap::iterator it = this->parcels.begin();
   parcelmap::iterator end = this->parcels.end();
-  
+
   while(it != end)
   {
-       outfile << it->first->getOffsetX() << " " 
-	       << it->first->getOffsetZ() << " " 
-	       << it->first->getFilename() << endl; 
+       outfile << it->second.info->getOffsetX() << " "
+	       << it->second.info->getOffsetZ() << " "
+	       << it->second.info->getFilename() << endl;
 
         ++it;
   }
@@ -312,7 +393,7 @@ void parcelmanager::saveParcelinfo(string filename)
 
 /**
  * The method restores the parcelinfos written by saveParcelinfo.
- * 
+ *
  * @param filename The file where the parcelinfos are stored
  */
 void parcelmanager::loadParcelinfo(string filename)
@@ -344,18 +425,27 @@ void parcelmanager::loadParcelinfo(string filename)
     infile >> file;
     if(infile.eof()) continue;
 
-    parcelinfo *p = new parcelinfo(offsetX, offsetZ, file);
-    this->parcels[p] = NULL;
+    tile t;
+    t.info = new parcelinfo(offsetX, offsetZ, file);
+    t.data = NULL;
+    t.dirty = false;
+    this->parcels[tileKey(tileCoord(offsetX, this->parcelwidth),
+			  tileCoord(offsetZ, this->parcelheight))] = t;
+
+    // the parcels of the last run count for the size of the world
+    if(offsetX < minX) minX = offsetX;
+    if(offsetZ < minZ) minZ = offsetZ;
+    if(offsetX + this->parcelwidth > maxX) maxX = offsetX + this->parcelwidth;
+    if(offsetZ + this->parcelheight > maxZ) maxZ = offsetZ + this->parcelheight;
   }
 
   infile.close();
 }
 
 /**
- * This method is able to write the entire world, based on all parcels and create and write lines.
- * Each parcel is loaded and then written into a single file.
- * Afterwards ALL parcels are stored to file and freed from memory.
- * Additionally the world is written in ppm format and lines can be created and written.
+ * This method is able to write the entire world, based on all parcels.
+ * The parcels are loaded one after another and written into a single file,
+ * so only the parcels within the memory budget are kept.
  *
  * The map is written in a format which can be read by the MapViewer of Group2.
  * The specification of the format are listed in the documentation
@@ -367,22 +457,89 @@ void parcelmanager::writeWorld(string file)
 		       this->minX, this->maxX, this->minZ, this->maxZ,
 		       this->resolution,
 		       this->viewpointX, this->viewpointZ);
-  
 
-    parcelmap::iterator it = parcels.begin();
-    parcelmap::iterator end = parcels.end();
-    
-    while(it != end)
-    {
-	if(it->second == NULL)
-	    loadParcel(it->first);
+    // collect the tiles first, acquire must not disturb the iteration
+    std::vector<long long> keys;
+    for(parcelmap::iterator it = parcels.begin(); it != parcels.end(); ++it)
+	keys.push_back(it->first);
+    std::sort(keys.begin(), keys.end());
 
-	writer.write(*it->second);
-	
-	++it;
+    for(size_t k = 0; k < keys.size(); ++k)
+    {
+	tile &t = this->parcels[keys[k]];
+	parcel *p = acquire(tileCoord(t.info->getOffsetX(), this->parcelwidth),
+			    tileCoord(t.info->getOffsetZ(), this->parcelheight));
+	writer.write(*p);
     }
 }
 
+/**
+ * Writes the world in the ppm format of ppmWriter without creating
+ * the world grid. The image is written one row of parcels at a time,
+ * whose lines are collected first, so every parcel is loaded once even
+ * if a row holds more parcels than the memory budget.
+ *
+ * @param filename the filename of the ppm
+ */
+void parcelmanager::writeWorldPPM(string filename)
+{
+    ofstream stream(filename.c_str());
+    if(!stream.good())
+    {
+	cerr << "ERROR: In parcelmanager::writeWorldPPM, couldn't open "
+	     << filename << endl;
+	return;
+    }
+
+    // same extents as the grid of createWorldGrid
+    long sizeX = this->maxX - this->minX + 1;
+    long sizeZ = this->maxZ - this->minZ + 1;
+    stream << "P2" << endl;
+    stream << "#Breite Hoehe" << endl;
+    stream << sizeX << " " << sizeZ << endl;
+    stream << "100" << endl;
+
+    long startTileX = tileCoord(this->minX, this->parcelwidth);
+    long endTileX = tileCoord(this->maxX, this->parcelwidth);
+    long startTileZ = tileCoord(this->minZ, this->parcelheight);
+    long endTileZ = tileCoord(this->maxZ, this->parcelheight);
+
+    std::vector<string> lines;
+    for(long tileZ = endTileZ; tileZ >= startTileZ; --tileZ)
+    {
+	long top = std::min(this->maxZ, (tileZ + 1) * (long)this->parcelheight - 1);
+	long bottom = std::max(this->minZ, tileZ * (long)this->parcelheight);
+	lines.assign(top - bottom + 1, string());
+
+	for(long tileX = startTileX; tileX <= endTileX; ++tileX)
+	{
+	    long first = std::max(this->minX, tileX * (long)this->parcelwidth);
+	    long last = std::min(this->maxX + 1, (tileX + 1) * (long)this->parcelwidth);
+	    parcel *p = acquire(tileX, tileZ, false);
+	    for(long z = top; z >= bottom; --z)
+	    {
+		string &line = lines[top - z];
+		for(long x = first; x < last; ++x)
+		{
+		    float percent = p ? p->getPercent(x - p->getOffsetX(), z - p->getOffsetZ()) : -1.0;
+		    if(percent < 0)
+		    {
+			line += "50 ";
+		    }
+		    else
+		    {
+			char value[8];
+			snprintf(value, sizeof(value), "%d ", 100 - (int)(percent * 100));
+			line += value;
+		    }
+		}
+	    }
+	}
+
+	for(size_t i = 0; i < lines.size(); ++i)
+	    stream << lines[i] << endl;
+    }
+}
 
 
 /**
@@ -394,25 +551,16 @@ grid* parcelmanager::createWorldGrid()
 		       this->maxX - this->minX + 1,
 		       this->maxZ - this->minZ + 1);
 
-    parcelmap::iterator it = parcels.begin();
-    parcelmap::iterator end = parcels.end();
-    
+    std::vector<long long> keys;
+    for(parcelmap::iterator it = parcels.begin(); it != parcels.end(); ++it)
+	keys.push_back(it->first);
+
     // Go through all parcels
-    while(it != end)
+    for(size_t k = 0; k < keys.size(); ++k)
     {
-	if(it->second == NULL)
-	    loadParcel(it->first);
-
-	for(int i=0; i < it->second->getSizeX(); ++i)
-	{
-	    for(int j=0; j < it->second->getSizeZ(); ++j)
-	    {
-		g->addPoint(*(it->second->points[i][j]));
-	    }
-	}
-	
-	++it;
+	tile &t = this->parcels[keys[k]];
+	g->addGrid(acquire(tileCoord(t.info->getOffsetX(), this->parcelwidth),
+			   tileCoord(t.info->getOffsetZ(), this->parcelheight)));
     }
     return g;
 }
-
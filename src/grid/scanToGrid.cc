@@ -7,12 +7,23 @@
  *
  */
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <map>
 
 #include "grid/scanToGrid.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using std::vector;
 using std::map;
 
@@ -53,9 +64,9 @@ scanToGrid::scanToGrid(double resolution,
  * @param p The point to check (not scaled to grid)
  * @return True if the point is relevant
  */
-bool scanToGrid::isPointRelevant(const Point &p) const
+bool scanToGrid::isPointRelevant(const double *p) const
 {
-    if(p.y < this->minRelevantHeight || p.y > this->maxRelevantHeight)
+    if(p[1] < this->minRelevantHeight || p[1] > this->maxRelevantHeight)
     {
 	return false;
     }
@@ -71,44 +82,71 @@ bool scanToGrid::isPointRelevant(const Point &p) const
  *
  * @return the matching coordiante of the gridpoint
  */
-long scanToGrid::scaleToGrid(double point)
+long scanToGrid::scaleToGrid(double point) const
 {
     return (long)(point / this->resolution);
 }
 
 /**
- * The methods calculates the norm vector of the vector given
- * through x and z.
- * The normvector has one direction oflength 1 or -1  and the other
- * length in [-1,1]
- * @param x The x component of the vector
- * @param z the z component of the vector
- * @param xnorm Referenz to the double containing the normalized x value afterwards
- * @param znorm Referenz to the double containing the normalized z value afterwards
+ * Steps along a line with the major direction of length major and the
+ * minor direction of length minor, |minor| <= major. Returns the minor
+ * coordinate of step i, rounded towards zero like the former norm vector
+ * stepping, but computed with integers only.
+ *
+ * @param i the step
+ * @param minor the signed length in the minor direction
+ * @param major the length in the major direction (> 0)
+ * @return the minor coordinate of step i
  */
-void scanToGrid::calculateNormvector(long x, long z,
-				     double& xnorm, double& znorm)
+static inline long minorStep(long i, long minor, long major)
 {
-    xnorm = 0;
-    znorm = 0;
+    return (i * minor) / major;
+}
 
-    // if |X| < |Z|, then norm z to 1 and x to x/z
-    if(abs(x) < abs(z))
-    {
-	if(z == 0)
-	    return;
-	   
-	xnorm = (double)x / (double)abs(z);
-	znorm = z / abs(z); // now znorm is 1 or -1
-    }
-    else
+/**
+ * The method projects all relevant points of the scan to the cells of
+ * the grid. The points are processed in parallel.
+ *
+ * @param scan the scan, transformed to absolute values
+ * @param cells the x and z cell coordinates of the points, interleaved
+ */
+void scanToGrid::projectPoints(Scan& scan, vector<long>& cells) const
+{
+    DataXYZ xyz(scan.get("xyz"));
+
+#ifdef _OPENMP
+    int threads = OPENMP_NUM_THREADS;
+#else
+    int threads = 1;
+#endif
+    vector< vector<long> > parts(threads);
+
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+    for(int i = 0; i < (int)xyz.size(); ++i)
     {
-	if(x == 0)
-	    return;
+#ifdef _OPENMP
+	vector<long> &part = parts[omp_get_thread_num()];
+#else
+	vector<long> &part = parts[0];
+#endif
+	// If the point is not relevant, skip it
+	if(!isPointRelevant(xyz[i]))
+	    continue;
 
-	xnorm = x / abs(x); // now xnorm is 1 or -1
-	znorm = (double)z / (double)abs(x); 
+	part.push_back(scaleToGrid(xyz[i][0]));
+	part.push_back(scaleToGrid(xyz[i][2]));
     }
+
+    size_t size = 0;
+    for(int t = 0; t < threads; ++t)
+	size += parts[t].size();
+    cells.clear();
+    cells.reserve(size);
+    for(int t = 0; t < threads; ++t)
+	cells.insert(cells.end(), parts[t].begin(), parts[t].end());
 }
 
 /**
@@ -118,18 +156,15 @@ void scanToGrid::calculateNormvector(long x, long z,
  * The new scangrid is allocated using new, but the pointer is not stored, 
  * so it must be freed by the calling method.
  *
- * The scan has to be transformed to absolute values before this method is
- * called
- *
- * @param scan the scan to be transformed
+ * @param cells the cells of the relevant points, see projectPoints
  * @param transformation the transformationmatrix needed for calculating
  *                       the viewpoint of the roboter
  *
  * @return pointer to the created grid.
  *         (Just gets allocated, does not get freed)
  */ 
-scanGrid* scanToGrid::createGrid(Scan& scan,
-						   const double* transformation)
+scanGrid* scanToGrid::createGrid(const vector<long>& cells,
+				 const double* transformation)
 {
     // Calculate the viewpoint of the scan
     double rPos[3];
@@ -140,39 +175,25 @@ scanGrid* scanToGrid::createGrid(Scan& scan,
     long vpX = scaleToGrid(rPos[0]);
     long vpZ = scaleToGrid(rPos[2]); 
 
-    // calculate maximal and minimal coordiantes
-    double maxX = 0;
-    double maxZ = 0;
-    double minX = 0;
-    double minZ = 0;
-
-    DataXYZ xyz(scan.get("xyz"));
+    // calculate maximal and minimal coordiantes, the origin is always
+    // part of the grid
+    long maxX = 0;
+    long maxZ = 0;
+    long minX = 0;
+    long minZ = 0;
 
-    for(size_t i = 0; i < xyz.size(); ++i)
+    for(size_t i = 0; i < cells.size(); i += 2)
     {
-	 Point it = xyz[i];
-	
-        // If the scan is not relevant, skip it
-	if(!isPointRelevant(it))
-	    continue;	
-
-	if(it.x < minX) minX = it.x;
-	if(it.x > maxX) maxX = it.x;
-	if(it.z < minZ) minZ = it.z;
-	if(it.z > maxZ) maxZ = it.z;
-
+	if(cells[i] < minX) minX = cells[i];
+	if(cells[i] > maxX) maxX = cells[i];
+	if(cells[i+1] < minZ) minZ = cells[i+1];
+	if(cells[i+1] > maxZ) maxZ = cells[i+1];
     }
     
-    // get offsets and sizes 
-    long offsetX = scaleToGrid(minX);
-    long offsetZ = scaleToGrid(minZ);
-    long sizeX = scaleToGrid(maxX) - offsetX + 1;
-    long sizeZ = scaleToGrid(maxZ) - offsetZ + 1;
-
     //returning new grid
     return new scanGrid(vpX, vpZ,
-			offsetX, offsetZ,
-			sizeX, sizeZ);
+			minX, minZ,
+			maxX - minX + 1, maxZ - minZ + 1);
 }
 
 /**
@@ -190,7 +211,8 @@ scanGrid* scanToGrid::createGrid(Scan& scan,
 void scanToGrid::killAlonePoints(scanGrid* grid,
 				 int distance, int neighbours)
 {
-    std::vector< gridPoint* > exPoints;
+    // relative coordinates of the cells to be deleted
+    std::vector< std::pair<int, int> > exPoints;
 
     
     for(int i=0; i < grid->getSizeX(); ++i)
@@ -206,7 +228,7 @@ void scanToGrid::killAlonePoints(scanGrid* grid,
 		    if(a > 0 && b > 0 &&
 		       a < grid->getSizeX() && b < grid->getSizeZ())
 		    {
-			if(grid->points[a][b]->getPercent() > 0)
+			if(grid->getPercent(a, b) > 0)
 			{
 			    ++found;
 			}
@@ -218,19 +240,18 @@ void scanToGrid::killAlonePoints(scanGrid* grid,
 	    // not enough neigbours found
 	    if(found < neighbours)
 	    {
-		exPoints.push_back(grid->points[i][j]);
+		exPoints.push_back(std::make_pair(i, j));
 	    }
 	    
 	}
     }
     
-    vector<gridPoint*>::iterator it = exPoints.begin();
-    vector<gridPoint*>::iterator end = exPoints.end();
+    vector< std::pair<int, int> >::iterator it = exPoints.begin();
+    vector< std::pair<int, int> >::iterator end = exPoints.end();
 
     while(it != end)
     {
-	//std::cout << "Deleting " << (*it)->getX() << " " << (*it)->getZ() << " " << std::endl;
-	(*it)->setFixed(0, 0);
+	grid->setFixed(it->first, it->second, 0, 0);
 	++it;
     }
 }
@@ -251,10 +272,14 @@ void scanToGrid::createNeighbours(scanGrid *grid, long x, long z, float weightin
     // Calculate direction of the neighbours
     long dx = - (grid->getViewpointZ() - z);
     long dz = grid->getViewpointX() - x;
-    
-    // calculating the normvector of them
-    double xnorm, znorm;
-    calculateNormvector(dx, dz, xnorm, znorm);
+
+    // step one cell per neighbour along the major direction
+    bool zMajor = labs(dx) < labs(dz);
+    long major = zMajor ? labs(dz) : labs(dx);
+    if(major == 0)
+	return;
+    long majorSign = (zMajor ? dz : dx) < 0 ? -1 : 1;
+    long minor = zMajor ? dx : dz;
 
     // calculating number of neighbours to weight    
     int r = (int) (sqrt((double)(dx*dx + dz*dz)) * this->spot);
@@ -265,8 +290,10 @@ void scanToGrid::createNeighbours(scanGrid *grid, long x, long z, float weightin
 	if(i == 0)
 	    continue;
 
-	long px = x + (int) (i * xnorm);
-	long pz = z + (int) (i * znorm);
+	long a = i * majorSign;
+	long b = minorStep(i, minor, major);
+	long px = x + (zMajor ? b : a);
+	long pz = z + (zMajor ? a : b);
 
 	// if calculated point not in grid, skip
 	if( !grid->contains(px, pz))
@@ -303,24 +330,45 @@ void scanToGrid::createWaypoints(scanGrid *grid, long x, long z, float weighting
     long dx = x - grid->getViewpointX();
     long dz = z - grid->getViewpointZ();
 
-    // calculating the normal vector
-    double xnorm, znorm;
-    calculateNormvector(dx, dz, xnorm, znorm);
-
-    int distance = (int)floor(sqrt(pow((double)dx, 2) + pow((double)dz, 2)) /
-			      sqrt(pow(xnorm, 2) + pow(znorm, 2)));
-
-
-    for(int i=0; i < distance; ++i)
+    // integer DDA, one cell per step in the major direction
+    bool zMajor = labs(dx) < labs(dz);
+    long distance = zMajor ? labs(dz) : labs(dx);
+    if(distance == 0)
+	return;
+    long majorSign = (zMajor ? dz : dx) < 0 ? -1 : 1;
+    long minor = zMajor ? dx : dz;
+    long minorSign = minor < 0 ? -1 : 1;
+    minor = labs(minor);
+
+    // the minor coordinate is q, the remainder r of i * minor / distance
+    long q = 0, r = 0;
+    for(long i=0; i < distance; ++i)
     {
-	long px = grid->getViewpointX() + (long)(i * xnorm);
-	long pz = grid->getViewpointZ() + (long)(i * znorm);
+	long a = grid->getViewpointX();
+	long b = grid->getViewpointZ();
+	if(zMajor)
+	{
+	    a += minorSign * q;
+	    b += majorSign * i;
+	}
+	else
+	{
+	    a += majorSign * i;
+	    b += minorSign * q;
+	}
 
 	// due to some problems with the viewpoint lieing outside
         // of the grid, first check if point is in grid
-	if(grid->contains(px, pz))
+	if(grid->contains(a, b))
 	  //grid->addPoint(px, pz, (int)(WAYPOINTWEIGHT * weighting), 0);
-	  grid->addPoint(px, pz, WAYPOINTWEIGHT, 0);
+	  grid->addPoint(a, b, WAYPOINTWEIGHT, 0);
+
+	r += minor;
+	if(r >= distance)
+	{
+	    r -= distance;
+	    ++q;
+	}
     }  
 }
 
@@ -339,6 +387,27 @@ void scanToGrid::createPoint(scanGrid *grid, long x, long z, float weighting)
   grid->addPoint(x, z, SOLIDWEIGHT, SOLIDWEIGHT);
 }
 
+/**
+ * The method adds the occupied cell, the free cells between the
+ * robot and the cell and the neighbours, as far as requested.
+ *
+ * @param grid The grid to add the cells to
+ * @param x The x coordinate (scaled to grid)
+ * @param z The z coordinate (scaled to grid)
+ */
+void scanToGrid::rasterize(scanGrid *grid, long x, long z)
+{
+    float weighting = calculateWeighting(x - grid->getViewpointX(),
+					 z - grid->getViewpointZ());
+    createPoint(grid, x, z, weighting);
+
+    if(this->waypoints)
+	createWaypoints(grid, x, z, weighting);
+
+    if(this->neighbours)
+	createNeighbours(grid, x, z, weighting);
+}
+
 /**
  * Converts a scan(3D) to a grid(2D). It iterates through each
  * found point of the scan, translates it to the grid and adds it
@@ -356,32 +425,47 @@ void scanToGrid::createPoint(scanGrid *grid, long x, long z, float weighting)
  */ 
 scanGrid* scanToGrid::convert(Scan& scan, const double* transformation)
 {
-    scanGrid* grid = createGrid(scan, transformation);
- 
-    DataXYZ xyz(scan.get("xyz"));
-
-    // go through all points and create the grid
-    for(size_t i = 0; i < xyz.size(); ++i)
+    vector<long> cells;
+    projectPoints(scan, cells);
+    scanGrid* grid = createGrid(cells, transformation);
+
+    // the counters are only added up, so every thread can rasterize its
+    // share of the points into a grid of its own, merged in the end
+#ifdef _OPENMP
+    int threads = OPENMP_NUM_THREADS;
+#else
+    int threads = 1;
+#endif
+    vector<scanGrid*> partial(threads, (scanGrid*)0);
+    partial[0] = grid;
+    int nrCells = cells.size() / 2;
+
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 1024)
+#endif
+    for(int i = 0; i < nrCells; ++i)
     {
-	 Point p = xyz[i];
-
-	// if the scan is in the relevant area, create Point for it
-	if(isPointRelevant(p))
+#ifdef _OPENMP
+	int thread_num = omp_get_thread_num();
+#else
+	int thread_num = 0;
+#endif
+	if(partial[thread_num] == 0)
 	{
-	    long x = scaleToGrid(p.x);
-	    long z = scaleToGrid(p.z);
-
-	     float weighting = calculateWeighting(x - grid->getViewpointX(),
-						  z - grid->getViewpointZ());
-	     createPoint(grid, x, z, weighting);
-	     
-	     if(this->waypoints)
-		 createWaypoints(grid, x, z, weighting);
-
-	     if(this->neighbours)
-		 createNeighbours(grid, x, z, weighting);
-	     
+	    partial[thread_num] = new scanGrid(grid->getViewpointX(), grid->getViewpointZ(),
+					       grid->getOffsetX(), grid->getOffsetZ(),
+					       grid->getSizeX(), grid->getSizeZ());
 	}
+	rasterize(partial[thread_num], cells[2*i], cells[2*i+1]);
+    }
+
+    for(int t = 1; t < threads; ++t)
+    {
+	if(partial[t] == 0)
+	    continue;
+	grid->addGrid(partial[t]);
+	delete partial[t];
     }
 
     // Kill all points which have less then 8 out of 25 neighbours
@@ -391,15 +475,15 @@ scanGrid* scanToGrid::convert(Scan& scan, const double* transformation)
     {
 	for(int j = 0; j < grid->getSizeZ(); ++j)
 	{
-	    gridPoint *p = grid->points[i][j];
+	    gridPoint p = grid->getPoint(i, j);
 	    
-	    float weighting = calculateWeighting(p->getX() - grid->getViewpointX(), p->getZ() - grid->getViewpointZ());
+	    float weighting = calculateWeighting(p.getX() - grid->getViewpointX(), p.getZ() - grid->getViewpointZ());
 	    
 	     if(this->waypoints)
-		createWaypoints(grid, p->getX(), p->getZ(), weighting);
+		createWaypoints(grid, p.getX(), p.getZ(), weighting);
 
 	     if(this->neighbours)
-		 createNeighbours(grid, p->getX(), p->getZ(), weighting);
+		 createNeighbours(grid, p.getX(), p.getZ(), weighting);
 	}
 	}*/
 
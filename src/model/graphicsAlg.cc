@@ -207,162 +207,34 @@ vector<model::Plane3d> model::GraphicsAlg::getConcaveHull(std::vector<model::Pla
     return result;
 }
 
+namespace {
+
+/**
+ * Collects the points of a discrete line.
+ */
+struct DiscreteLineCollector {
+    vector<model::Point3d>& line;
+    double coef;
+
+    DiscreteLineCollector(vector<model::Point3d>& line, const double& coef) :
+        line(line),
+        coef(coef)
+    {};
+
+    bool operator()(const double& x, const double& y, const double& z) {
+        line.push_back(model::Point3d(x / coef, y / coef, z / coef));
+        return false;
+    }
+};
+
+}
+
 void model::GraphicsAlg::getDiscreteLine(Point3d src, Point3d dest, double precision, const double& extraDist,
         vector<Point3d>& line)
 {
     // clear the result just in case it contains something
     line.clear();
 
-    // add the extra distance
-    double len = src.distance(dest);
-    double temp = (len + extraDist) / len;
-    dest.x = src.x + (dest.x - src.x) * temp;
-    dest.y = src.y + (dest.y - src.y) * temp;
-    dest.z = src.z + (dest.z - src.z) * temp;
-
-    // round up the values
-    precision = round(precision);
-
-    src.x = round(src.x);
-    src.y = round(src.y);
-    src.z = round(src.z);
-
-    dest.x = round(dest.x);
-    dest.y = round(dest.y);
-    dest.z = round(dest.z);
-
-    // adjust according to precision
-    const double coef = pow(10.0, precision);
-    src  *= coef;
-    dest *= coef;
-
-//    Point3d diff = dest - src;
-//    diff.x = fabs(diff.x);
-//    diff.y = fabs(diff.y);
-//    diff.z = fabs(diff.z);
-//    diff += Point3d(1.0, 1.0, 1.0);
-//    double temp[] = {diff.x, diff.y, diff.z};
-//
-//    double d = *max_element(temp, temp + 3);
-
-    double x1 = src.x;
-    double y1 = src.y;
-    double z1 = src.z;
-
-    double x2 = dest.x;
-    double y2 = dest.y;
-    double z2 = dest.z;
-
-    double dx = x2 - x1;
-    double dy = y2 - y1;
-    double dz = z2 - z1;
-
-    double ax = 2 * fabs(dx);
-    double ay = 2 * fabs(dy);
-    double az = 2 * fabs(dz);
-
-    double sx = dx > 0 ? +1.0 : -1.0;
-    double sy = dy > 0 ? +1.0 : -1.0;
-    double sz = dz > 0 ? +1.0 : -1.0;
-
-    double x = x1;
-    double y = y1;
-    double z = z1;
-
-    if (ax >= max(ay, az)) {
-        // x dominant
-        double yd = ay - ax / 2.0;
-        double zd = az - ax / 2.0;
-
-        while (1) {
-            line.push_back(Point3d(x, y, z));
-
-            if (x == x2) {
-                break;
-            }
-
-            // move along y
-            if (yd >= 0) {
-                y  += sy;
-                yd -= ax;
-            }
-
-            // move along z
-            if (zd >= 0) {
-                z  += sz;
-                zd -= ax;
-            }
-
-            // move along x
-            x  += sx;
-            yd += ay;
-            zd += az;
-        }
-    } else if (ay >= max(ax, az)) {
-        // y dominant
-        double xd = ax - ay / 2.0;
-        double zd = az - ay / 2.0;
-
-        while (1) {
-            line.push_back(Point3d(x, y, z));
-
-            if (y == y2) {
-                break;
-            }
-
-            // move along x
-            if (xd >= 0) {
-                x  += sx;
-                xd -= ay;
-            }
-
-            // move along z
-            if (zd >= 0) {
-                z  += sz;
-                zd -= ay;
-            }
-
-            // move along y
-            y  += sy;
-            xd += ax;
-            zd += az;
-        }
-    } else if (az >= max(ax, ay)) {
-        // z dominant
-        double xd = ax - az / 2.0;
-        double yd = ay - az / 2.0;
-
-        while (1) {
-            line.push_back(Point3d(x, y, z));
-
-            if (z == z2) {
-                break;
-            }
-
-            // move along x
-            if (xd >= 0) {
-                x  += sx;
-                xd -= az;
-            }
-
-            // move along y
-            if (yd >= 0) {
-                y  += sy;
-                yd -= az;
-            }
-
-            // move along x
-            z  += sz;
-            xd += ax;
-            yd += ay;
-        }
-    } else {
-        throw logic_error("invalid branch taken while computing discrete line");
-    }
-
-    for (vector<Point3d>::iterator it = line.begin(); it != line.end(); ++it) {
-        it->x /= coef;
-        it->y /= coef;
-        it->z /= coef;
-    }
+    DiscreteLineCollector collect(line, pow(10.0, round(precision)));
+    walkDiscreteLine(src, dest, precision, extraDist, collect);
 }
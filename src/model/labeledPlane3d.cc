@@ -19,6 +19,8 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
 using namespace std;
 
 //==============================================================================
@@ -50,16 +52,16 @@ const double model::LabeledPlane3d::MAX_TOTAL_AREA      = 0.400;
 //==============================================================================
 //  Class implementation
 //==============================================================================
-model::LabeledPlane3d::LabeledPlane3d() : Plane3d() {}
+model::LabeledPlane3d::LabeledPlane3d() : Plane3d(), index(0) {}
 
 model::LabeledPlane3d::LabeledPlane3d(const Point3d& pt, const Vector3d& normal) :
-        Plane3d(pt, normal)
+        Plane3d(pt, normal), index(0)
 {
 
 }
 
 model::LabeledPlane3d::LabeledPlane3d(const Point3d& pt, const Vector3d& normal, const std::vector<Point3d>& hull) :
-        Plane3d(pt, normal, hull)
+        Plane3d(pt, normal, hull), index(0)
 {}
 
 model::LabeledPlane3d::LabeledPlane3d(const LabeledPlane3d& other) : Plane3d(other) {
@@ -68,6 +70,7 @@ model::LabeledPlane3d::LabeledPlane3d(const LabeledPlane3d& other) : Plane3d(oth
     this->depthImg = other.depthImg;
     this->correctedDepthImg = other.correctedDepthImg;
     this->depthMapDistances = other.depthMapDistances;
+    this->index = other.index;
 }
 
 model::LabeledPlane3d::~LabeledPlane3d() {}
@@ -80,11 +83,18 @@ model::LabeledPlane3d& model::LabeledPlane3d::operator=(const LabeledPlane3d& ot
         this->depthImg = other.depthImg;
         this->correctedDepthImg = other.correctedDepthImg;
         this->depthMapDistances = other.depthMapDistances;
+        this->index = other.index;
     }
 
     return *this;
 }
 
+std::string model::LabeledPlane3d::imageName(const std::string& name) const {
+    ostringstream file;
+    file << "./img/surface" << setw(3) << setfill('0') << this->index << "_" << name << ".png";
+    return file.str();
+}
+
 void model::LabeledPlane3d::detectEdges(cv::Mat& canny, cv::Mat& hSobel, cv::Mat& vSobel, cv::Mat& combined) const {
     int imgHeight = static_cast<int>(this->depthMap.size());
     int imgWidth  = static_cast<int>(this->depthMap.front().size());
@@ -106,10 +116,10 @@ void model::LabeledPlane3d::detectEdges(cv::Mat& canny, cv::Mat& hSobel, cv::Mat
     cv::addWeighted(combined, 0.5, vSobel, 0.5, 0, combined);
     cv::threshold(combined, combined, 1, MAX_IMG_VAL, CV_8UC1);
 
-    cv::imwrite("./img/edgeCanny.png", canny);
-    cv::imwrite("./img/edgeSobelHoriz.png", hSobel);
-    cv::imwrite("./img/edgeSobelVert.png", vSobel);
-    cv::imwrite("./img/edgeCombined.png", combined);
+    writeImage(this->imageName("edgeCanny"), canny);
+    writeImage(this->imageName("edgeSobelHoriz"), hSobel);
+    writeImage(this->imageName("edgeSobelVert"), vSobel);
+    writeImage(this->imageName("edgeCombined"), combined);
 }
 
 void model::LabeledPlane3d::computeLines(std::vector<int>& verticalResult, std::vector<int>& horizontalResult) const {
@@ -185,15 +195,15 @@ void model::LabeledPlane3d::computeLines(std::vector<int>& verticalResult, std::
     cv::line(imgLines, cv::Point(0, 0), cv::Point(0, imgLines.rows-1), cv::Scalar(0, 0, MAX_IMG_VAL), 1);
     cv::line(imgLines, cv::Point(imgWidth - 1, 0), cv::Point(imgWidth - 1, imgLines.rows-1), cv::Scalar(0, 0, MAX_IMG_VAL), 1);
 
-    cv::imwrite("./img/edgeLines.png", imgLines);
-    if (!quiet) cout << "** Total lines: " << verticalSet.size() << " vertical, " << horizontalSet.size() << " horizontal" << endl;
+    writeImage(this->imageName("edgeLines"), imgLines);
+    if (!quiet) ProgressLine() << "** Total lines: " << verticalSet.size() << " vertical, " << horizontalSet.size() << " horizontal" << endl;
 
     horizontalResult.assign(horizontalSet.begin(), horizontalSet.end());
     verticalResult.assign(verticalSet.begin(), verticalSet.end());
 }
 
 void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpening>& result) const {
-    if (!quiet) cout << endl << "== Computing opening candidates for surface centered at " << this->pt << endl;
+    if (!quiet) ProgressLine() << endl << "== Computing opening candidates for surface " << this->index << " centered at " << this->pt << endl;
 
     // make sure the result is empty
     result.clear();
@@ -269,8 +279,8 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
         }
     }
 
-    if (!quiet) cout << "** Total opening candidates: " << candidates.size()  << endl;
-    if (!quiet) cout << "** Discarded openings relative size to wall: " << discarded << endl;
+    if (!quiet) ProgressLine() << "** Total opening candidates: " << candidates.size()  << endl;
+    if (!quiet) ProgressLine() << "** Discarded openings relative size to wall: " << discarded << endl;
     discarded = 0;
 
     // determine the features of each candidate opening
@@ -386,6 +396,6 @@ void model::LabeledPlane3d::computeOpeningCandidates(std::vector<CandidateOpenin
         result.push_back(*it);
     }
 
-    if (!quiet) cout << "** Discarded openings due to small empty area: " << discarded << endl;
-    if (!quiet) cout << "** Done computing features for all opening candidates" << endl;
+    if (!quiet) ProgressLine() << "** Discarded openings due to small empty area: " << discarded << endl;
+    if (!quiet) ProgressLine() << "** Done computing features for all opening candidates" << endl;
 }
@@ -244,26 +244,38 @@ int main(int argc, char* argv[]) {
     scene = new model::Scene(type, start, end, dir, scanserver,
 					    maxDist, minDist, alg, octree, red, poses);
     scene->detectWalls();
-    scene->applyLabels(scene->walls[0]);
-    scene->applyLabels(scene->walls[1]);
-    scene->applyLabels(scene->walls[2]);
-    scene->applyLabels(scene->walls[3]);
-    scene->applyLabels(scene->ceiling);
-    scene->applyLabels(scene->floor);
-
-    vector<model::CandidateOpening> openings;
-    scene->addFinalOpenings(scene->walls[0], openings);
-    scene->correct(scene->walls[0], openings);
-    scene->addFinalOpenings(scene->walls[1], openings);
-    scene->correct(scene->walls[1], openings);
-    scene->addFinalOpenings(scene->walls[2], openings);
-    scene->correct(scene->walls[2], openings);
-    scene->addFinalOpenings(scene->walls[3], openings);
-    scene->correct(scene->walls[3], openings);
-    scene->addFinalOpenings(scene->ceiling, openings);
-    scene->correct(scene->ceiling, openings);
-    scene->addFinalOpenings(scene->floor, openings);
-    scene->correct(scene->floor, openings);
+
+    // the surfaces in the order they are reported, walls, ceiling and floor
+    vector<model::LabeledPlane3d*> surfaces;
+    vector<string> names;
+    for (unsigned int i = 0; i < scene->walls.size(); ++i) {
+        surfaces.push_back(&scene->walls[i]);
+        names.push_back("wall " + to_string(i));
+    }
+    surfaces.push_back(&scene->ceiling);
+    names.push_back("ceiling");
+    surfaces.push_back(&scene->floor);
+    names.push_back("floor");
+
+    // the patches are labeled one surface after the other, the rays of each surface are cast in parallel
+    vector<unsigned long> labelTimes;
+    for (unsigned int i = 0; i < surfaces.size(); ++i) {
+        unsigned long start = GetCurrentTimeInMilliSec();
+        scene->applyLabels(*surfaces[i]);
+        labelTimes.push_back(GetCurrentTimeInMilliSec() - start);
+    }
+
+    // the openings are detected for all surfaces in parallel
+    vector<unsigned long> correctTimes;
+    scene->correctAllSurfaces(correctTimes);
+
+    if (!quiet) {
+        cout << endl << "== Time spent on each surface [ms]:" << endl;
+        for (unsigned int i = 0; i < surfaces.size(); ++i) {
+            cout << "** " << names[i] << ": labeling " << labelTimes[i]
+                 << ", openings and correction " << correctTimes[i] << endl;
+        }
+    }
 
     scene->writeCorrectedWalls(dir);
     scene->writeModel(dir);
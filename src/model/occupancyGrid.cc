@@ -0,0 +1,125 @@
+/**
+ * @file occupancyGrid.cc
+ *
+ * A bit-packed occupancy grid used for ray casting in the scene.
+ */
+
+//==============================================================================
+//  Includes
+//==============================================================================
+#include "model/occupancyGrid.h"
+
+#include <math.h>
+#include <limits>
+#include <algorithm>
+using namespace std;
+
+//==============================================================================
+//  Implementation
+//==============================================================================
+namespace {
+
+/**
+ * Returns true if no coordinate of the point is infinite or NaN.
+ */
+inline bool isFinite(const model::Point3d& pt) {
+    const double max = numeric_limits<double>::max();
+    return fabs(pt.x) <= max && fabs(pt.y) <= max && fabs(pt.z) <= max;
+}
+
+}
+
+model::OccupancyGrid::OccupancyGrid() {
+    this->built = false;
+    for (int k = 0; k < 3; ++k) {
+        this->minBlock[k] = 0;
+        this->maxBlock[k] = -1;
+    }
+}
+
+void model::OccupancyGrid::cellRange(const double& p, const double& halfWidth, const double& coef,
+        long& lo, long& hi)
+{
+    // the lattice point c = i / coef covers p if c - halfWidth < p < c + halfWidth,
+    // the bounds are tested in exactly this form so no point is lost to rounding
+    lo = static_cast<long>(floor((p - halfWidth) * coef)) - 1;
+    while (!(p < lo / coef + halfWidth)) {
+        ++lo;
+    }
+
+    hi = static_cast<long>(ceil((p + halfWidth) * coef)) + 1;
+    while (hi >= lo && !(p > hi / coef - halfWidth)) {
+        --hi;
+    }
+}
+
+void model::OccupancyGrid::build(const vector<Point3d>& points, const double& width, const double& coef) {
+    const double halfWidth = width / 2.0;
+
+    this->built = true;
+    this->blockIndex.clear();
+    this->bits.clear();
+
+    // the bounding box of all occupied lattice points
+    long lower[3], upper[3];
+    for (int k = 0; k < 3; ++k) {
+        lower[k] = numeric_limits<long>::max();
+        upper[k] = numeric_limits<long>::min();
+    }
+
+    for (vector<Point3d>::const_iterator it = points.begin(); it != points.end(); ++it) {
+        if (!isFinite(*it)) {
+            continue;
+        }
+
+        double p[] = {it->x, it->y, it->z};
+        for (int k = 0; k < 3; ++k) {
+            long lo, hi;
+            cellRange(p[k], halfWidth, coef, lo, hi);
+            lower[k] = min(lower[k], lo);
+            upper[k] = max(upper[k], hi);
+        }
+    }
+
+    if (lower[0] > upper[0] || lower[1] > upper[1] || lower[2] > upper[2]) {
+        for (int k = 0; k < 3; ++k) {
+            this->minBlock[k] = 0;
+            this->maxBlock[k] = -1;
+        }
+        return;
+    }
+
+    // the bounding box only rejects rays early, the blocks are hashed
+    for (int k = 0; k < 3; ++k) {
+        this->minBlock[k] = lower[k] >> BLOCK_BITS;
+        this->maxBlock[k] = upper[k] >> BLOCK_BITS;
+    }
+
+    // mark the lattice points of each point, allocating blocks as needed
+    for (vector<Point3d>::const_iterator it = points.begin(); it != points.end(); ++it) {
+        if (!isFinite(*it)) {
+            continue;
+        }
+
+        long lo[3], hi[3];
+        cellRange(it->x, halfWidth, coef, lo[0], hi[0]);
+        cellRange(it->y, halfWidth, coef, lo[1], hi[1]);
+        cellRange(it->z, halfWidth, coef, lo[2], hi[2]);
+
+        for (long z = lo[2]; z <= hi[2]; ++z) {
+            for (long y = lo[1]; y <= hi[1]; ++y) {
+                for (long x = lo[0]; x <= hi[0]; ++x) {
+                    BlockKey key(x >> BLOCK_BITS, y >> BLOCK_BITS, z >> BLOCK_BITS);
+                    pair<BlockMap::iterator, bool> inserted =
+                        this->blockIndex.insert(make_pair(key, static_cast<int>(this->bits.size() / BLOCK_WORDS)));
+                    if (inserted.second) {
+                        this->bits.resize(this->bits.size() + BLOCK_WORDS, 0);
+                    }
+
+                    int bit = (((z & BLOCK_MASK) << BLOCK_BITS | (y & BLOCK_MASK)) << BLOCK_BITS) | (x & BLOCK_MASK);
+                    this->bits[static_cast<size_t>(inserted.first->second) * BLOCK_WORDS + (bit >> 6)] |= 1ULL << (bit & 63);
+                }
+            }
+        }
+    }
+}
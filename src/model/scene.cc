@@ -9,6 +9,12 @@
 //==============================================================================
 //  Includes
 //==============================================================================
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include "model/scene.h"
 
 #include "model/graphicsAlg.h"
@@ -25,11 +31,16 @@
 #include <errno.h>
 
 #include <limits>
+#include <algorithm>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 using namespace std;
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 //==============================================================================
 //  Static fields initialization
 //==============================================================================
@@ -190,6 +201,7 @@ model::Scene::Scene(const Scene& other) {
     this->walls   = other.walls;
     this->ceiling = other.ceiling;
     this->floor   = other.floor;
+    this->occupancy = other.occupancy;
 }
 
 model::Scene::~Scene() {
@@ -433,6 +445,7 @@ void model::Scene::detectWalls() {
         if (!quiet) cout << "** Adding wall centered at " << center << endl;
         this->walls.push_back(LabeledPlane3d(center, Vector3d(), hull));
         this->walls.back().normal = this->walls.back().computeAverageNormal();
+        this->walls.back().index = static_cast<int>(this->walls.size()) - 1;
 
         // compute the floor and the ceiling
         ceilingHull.push_back(it->first);
@@ -455,26 +468,54 @@ void model::Scene::detectWalls() {
     if (!quiet) cout << "** Adding ceiling centered at " << ceilingCenter << endl;
     this->ceiling = LabeledPlane3d(ceilingCenter, dummy, ceilingHull);
     this->ceiling.normal = this->ceiling.computeAverageNormal();
+    this->ceiling.index = static_cast<int>(this->walls.size());
 
     if (!quiet) cout << "** Adding floor centered at " << floorCenter << endl;
     this->floor = LabeledPlane3d(floorCenter, dummy, floorHull);
     this->floor.normal = this->floor.computeAverageNormal();
+    this->floor.index = static_cast<int>(this->walls.size()) + 1;
+}
+
+namespace {
+
+/**
+ * Stops the walk along a discrete line at the first occupied point.
+ */
+struct OccupiedVisitor {
+    const model::OccupancyGrid& grid;
+    double coef;
+    model::Point3d hit;
+
+    OccupiedVisitor(const model::OccupancyGrid& grid, const double& coef) :
+        grid(grid),
+        coef(coef)
+    {};
+
+    bool operator()(const double& x, const double& y, const double& z) {
+        if (grid.isOccupied(static_cast<long>(x), static_cast<long>(y), static_cast<long>(z))) {
+            hit = model::Point3d(x / coef, y / coef, z / coef);
+            return true;
+        }
+
+        return false;
+    }
+};
+
 }
 
 bool model::Scene::castRay(const Point3d& src, const Point3d& dest, const double& extraDist,
         Point3d& ptHit)
 {
-    // put the Bresenham line in here, we need some extra distance in case the points are close
-    // but after the detected wall, therefore we need to go a bit further than the wall to check
-    vector<Point3d> line;
-    GraphicsAlg::getDiscreteLine(src, dest, PRECISION, extraDist, line);
+    if (!this->occupancy.isBuilt()) {
+        buildOccupancy();
+    }
 
-    // loop through all the points in the Bresenham line and decide if it hits something
-    for (vector<Point3d>::iterator it = line.begin(); it != line.end(); ++it) {
-        if (this->isOccupied(*it, RAY_DIST)) {
-            ptHit = *it;
-            return true;
-        }
+    // walk the Bresenham line, we need some extra distance in case the points are close
+    // but after the detected wall, therefore we need to go a bit further than the wall to check
+    OccupiedVisitor visit(this->occupancy, pow(10.0, round(PRECISION)));
+    if (GraphicsAlg::walkDiscreteLine(src, dest, PRECISION, extraDist, visit)) {
+        ptHit = visit.hit;
+        return true;
     }
 
     // no occlusion took place
@@ -509,8 +550,28 @@ void model::Scene::applyLabels(LabeledPlane3d& surf) {
 
     if (!quiet) cout << endl << "== Performing ray casting for surface centered at " << surf.pt << endl;
 
-    for (vector<Pose6d>::iterator srcPose = this->poses.begin(); srcPose != this->poses.end(); ++srcPose) {
-        for (unsigned int i = 0; i < surf.patches.size(); ++i) {
+    // the rays are cast in parallel, the grid has to exist before
+    if (!this->occupancy.isBuilt()) {
+        buildOccupancy();
+    }
+
+    if (surf.hull.empty()) {
+        throw runtime_error("hull cannot be empty");
+    }
+
+    // The ray through the wall does not depend on the pose. A patch it hits is
+    // occupied, otherwise the patch is empty as soon as the ray from one pose
+    // reaches it, which are the labels the poses assign one after the other.
+    int nrRows = static_cast<int>(surf.patches.size());
+    bool failed = false;
+    string error;
+
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < nrRows; ++i) {
+        try {
             for (unsigned int j = 0; j <  surf.patches[i].size(); ++j) {
                 // prepare two points for ray casting through wall
                 Point3d ptOnWall  = surf.patches[i][j].first;
@@ -530,14 +591,35 @@ void model::Scene::applyLabels(LabeledPlane3d& surf) {
                 if (insideHull(surf.patches[i][j].first, surf.hull) && castRay(src, ptOnWall, WALL_DIST, ptHit)) {
                     surf.patches[i][j].second = OCCUPIED;
                     surf.depthMap[i][j] = maxDist - src.distance(ptHit);
-                } else if (!castRay(srcPose->first, surf.patches[i][j].first, 0, ptHit)) {
-                    surf.patches[i][j].second = EMPTY;
-                    surf.depthMap[i][j] = 0.0;
+                    continue;
+                }
+
+                for (vector<Pose6d>::const_iterator srcPose = this->poses.begin(); srcPose != this->poses.end(); ++srcPose) {
+                    if (!castRay(srcPose->first, surf.patches[i][j].first, 0, ptHit)) {
+                        surf.patches[i][j].second = EMPTY;
+                        surf.depthMap[i][j] = 0.0;
+                        break;
+                    }
+                }
+            }
+        } catch (const exception& e) {
+            // exceptions must not leave the parallel region
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
+                if (!failed) {
+                    failed = true;
+                    error = e.what();
                 }
             }
         }
     }
 
+    if (failed) {
+        throw runtime_error(error);
+    }
+
     // create the OpenCV depth image
     int imgHeight = static_cast<int>(surf.depthMap.size());
     int imgWidth  = static_cast<int>(surf.depthMap.front().size());
@@ -587,7 +669,7 @@ void model::Scene::applyLabels(LabeledPlane3d& surf) {
 			}
         }
     }
-    cv::imwrite("./img/labels.png", labels);
+    writeImage(surf.imageName("labels"), labels);
 
     // copy the image
     surf.depthImg = img.clone();
@@ -607,7 +689,7 @@ void model::Scene::applyAllLabels() {
 void model::Scene::detectPotentialOpenings(const LabeledPlane3d& surf,
         std::vector<CandidateOpening>& openings)
 {
-    if (!quiet) cout << endl << "== Determining openings for surface centered at " << surf.pt << endl;
+    if (!quiet) ProgressLine() << endl << "== Determining openings for surface " << surf.index << " centered at " << surf.pt << endl;
 
     // get the candidate openings for current plane
     vector<CandidateOpening> candidates;
@@ -854,7 +936,7 @@ void model::Scene::detectPotentialOpenings(const LabeledPlane3d& surf,
         }
     }
 
-    if (!quiet) cout << "** Discarded openings due to relative size to average candidate: " << discarded << endl;
+    if (!quiet) ProgressLine() << "** Discarded openings due to relative size to average candidate: " << discarded << endl;
 
     // draw the chosen rectangles, and also the occupancy map
     cv::Mat imgWithOpenings = surf.depthImg;
@@ -869,13 +951,13 @@ void model::Scene::detectPotentialOpenings(const LabeledPlane3d& surf,
         cv::rectangle(imgWithOpenings, cv::Point(x1, y1), cv::Point(x2, y2), cv::Scalar(0, 0, MAX_IMG_VAL), 1);
     }
 
-    cv::imwrite("./img/depthCandidates.png", imgWithOpenings);
+    writeImage(surf.imageName("depthCandidates"), imgWithOpenings);
 
-    if (!quiet) cout << "** Detected " << openings.size() << " potential openings" << endl;
+    if (!quiet) ProgressLine() << "** Detected " << openings.size() << " potential openings" << endl;
 }
 
 void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<CandidateOpening>& openings,
-        std::vector<CandidateOpening>& result) const
+        std::vector<CandidateOpening>& result, cv::RNG& rng) const
 {
     // clear the result just in case
     result.clear();
@@ -889,7 +971,7 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
         return;
     }
 
-    if (!quiet) cout << endl << "== Clustering openings for surface centered at " << surf.pt << endl;
+    if (!quiet) ProgressLine() << endl << "== Clustering openings for surface " << surf.index << " centered at " << surf.pt << endl;
 
     size_t nrSamples = openings.size();
     unsigned int dim = 7;
@@ -927,16 +1009,16 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
     int nrClusters = 2;                                             // from how many clusters to start
     double prev, compactness;                                       // previous compactness, and current compactness
     CvMat *centers = cvCreateMat(nrClusters - 1, dim, CV_32FC1);    // place where we compute the centers of each cluster
-    cvKMeans2(points, nrClusters - 1, clusters, term, 1, 0, 0, centers, &prev);
+    cvKMeans2(points, nrClusters - 1, clusters, term, 1, &rng.state, 0, centers, &prev);
 
     while (1) {
         cvReleaseMat(&centers);
         centers = cvCreateMat(nrClusters, dim, CV_32FC1);
-        cvKMeans2(points, nrClusters, clusters, term, 1, 0, 0, centers, &compactness);
+        cvKMeans2(points, nrClusters, clusters, term, 1, &rng.state, 0, centers, &compactness);
 
         // TODO put somewhere everything in class
         double deltaCompactness = compactness - prev;
-        if (!quiet) cout << "** Delta compactness: " << deltaCompactness << endl;
+        if (!quiet) ProgressLine() << "** Delta compactness: " << deltaCompactness << endl;
         if (fabs(deltaCompactness) < 1.0 || nrClusters >= maxNrClusters) {
             break;
         }
@@ -945,7 +1027,7 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
         nrClusters++;
     }
 
-    if (!quiet) cout << "** Detected " << static_cast<unsigned int>(nrClusters) << " clusters of potential openings" << endl;
+    if (!quiet) ProgressLine() << "** Detected " << static_cast<unsigned int>(nrClusters) << " clusters of potential openings" << endl;
 
     // generate colors for each cluster
     int r, g, b;
@@ -1014,11 +1096,12 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
     }
 
     if (!quiet) {
-        cout << "** The count for each cluster is [";
+        ProgressLine line;
+        line << "** The count for each cluster is [";
         for (unsigned int i = 0; i < clusterCount.size() - 1; ++i) {
-            cout << clusterCount[i] << ", ";
+            line << clusterCount[i] << ", ";
         }
-        cout << clusterCount.back() << "]" << endl;
+        line << clusterCount.back() << "]" << endl;
     }
 
     // display the center of the cluster only for the clusters that have candidates
@@ -1031,8 +1114,8 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
         }
     }
 
-    cv::imwrite("./img/depthClusters.png", clusterImg);
-    cv::imwrite("./img/depthOpenings.png", finalImg);
+    writeImage(surf.imageName("depthClusters"), clusterImg);
+    writeImage(surf.imageName("depthOpenings"), finalImg);
 
     cvReleaseMat(&points);
     cvReleaseMat(&centers);
@@ -1041,13 +1124,24 @@ void model::Scene::clusterOpenings(const LabeledPlane3d& surf, const vector<Cand
 
 void model::Scene::addFinalOpenings(const LabeledPlane3d& surf,
         std::vector<CandidateOpening>& result)
+{
+    vector<Plane3d> surfOpenings;
+    cv::RNG rng(surf.index);
+    computeFinalOpenings(surf, result, surfOpenings, rng);
+    this->finalOpenings.insert(this->finalOpenings.end(), surfOpenings.begin(), surfOpenings.end());
+
+    if (!quiet) cout << "** Final openings found so far: " << this->finalOpenings.size() << endl;
+}
+
+void model::Scene::computeFinalOpenings(const LabeledPlane3d& surf,
+        std::vector<CandidateOpening>& result, std::vector<Plane3d>& surfOpenings, cv::RNG& rng)
 {
     int imgHeight = static_cast<int>(surf.depthMap.size());
     int imgWidth  = static_cast<int>(surf.depthMap.front().size());
 
     vector<CandidateOpening> openings, candidates;
     this->detectPotentialOpenings(surf, openings);
-    this->clusterOpenings(surf, openings, candidates);
+    this->clusterOpenings(surf, openings, candidates, rng);
 
     // sweep across the wall and see which candidates overlap
     for (int i = 0; i < imgHeight; ++i) {
@@ -1114,19 +1208,76 @@ void model::Scene::addFinalOpenings(const LabeledPlane3d& surf,
         hull.push_back(surf.patches[y2][x1].first);
 
         Plane3d toPush(pt, surf.normal, hull);
-        this->finalOpenings.push_back(toPush);
+        surfOpenings.push_back(toPush);
     }
 
-    cv::imwrite("./img/depthOpeningsFinal.png", finalOpeningsImg);
-    if (!quiet) cout << "** Final openings found on current surface: " << candidates.size() << endl;
-    if (!quiet) cout << "** Final openings found so far: " << this->finalOpenings.size() << endl;
+    writeImage(surf.imageName("depthOpeningsFinal"), finalOpeningsImg);
+    if (!quiet) ProgressLine() << "** Final openings found on current surface: " << candidates.size() << endl;
 
     // copy the result
     result = candidates;
 }
 
-void model::Scene::correct(LabeledPlane3d& surf, const vector<CandidateOpening>& openings) {
-    if (!quiet) cout << endl << "== Correcting surface centered at " << surf.pt << endl;
+void model::Scene::correctAllSurfaces(std::vector<unsigned long>& times) {
+    if (!quiet) cout << endl << "== Detecting openings and correcting all surfaces..." << endl;
+
+    // walls first, then ceiling and floor
+    vector<LabeledPlane3d*> surfaces;
+    for (vector<LabeledPlane3d>::iterator it = this->walls.begin(); it != this->walls.end(); ++it) {
+        surfaces.push_back(&(*it));
+    }
+    surfaces.push_back(&this->ceiling);
+    surfaces.push_back(&this->floor);
+
+    // every surface keeps its own openings, they are added in order afterwards
+    int nrSurfaces = static_cast<int>(surfaces.size());
+    vector<vector<Plane3d> > surfOpenings(nrSurfaces);
+    times.assign(nrSurfaces, 0);
+    bool failed = false;
+    string error;
+
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int k = 0; k < nrSurfaces; ++k) {
+        try {
+            unsigned long start = GetCurrentTimeInMilliSec();
+
+            // the same numbers for a surface, whichever thread takes it
+            cv::RNG rng(surfaces[k]->index);
+            vector<CandidateOpening> openings;
+            computeFinalOpenings(*surfaces[k], openings, surfOpenings[k], rng);
+            correct(*surfaces[k], openings, rng);
+
+            times[k] = GetCurrentTimeInMilliSec() - start;
+        } catch (const exception& e) {
+            // exceptions must not leave the parallel region
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+            {
+                if (!failed) {
+                    failed = true;
+                    error = e.what();
+                }
+            }
+        }
+    }
+
+    if (failed) {
+        throw runtime_error(error);
+    }
+
+    for (int k = 0; k < nrSurfaces; ++k) {
+        this->finalOpenings.insert(this->finalOpenings.end(), surfOpenings[k].begin(), surfOpenings[k].end());
+    }
+
+    if (!quiet) cout << "** Final openings found: " << this->finalOpenings.size() << endl;
+}
+
+void model::Scene::correct(LabeledPlane3d& surf, const vector<CandidateOpening>& openings, cv::RNG& rng) {
+    if (!quiet) ProgressLine() << endl << "== Correcting surface " << surf.index << " centered at " << surf.pt << endl;
 
     int imgHeight = static_cast<int>(surf.depthMap.size());
     int imgWidth  = static_cast<int>(surf.depthMap.front().size());
@@ -1227,22 +1378,22 @@ void model::Scene::correct(LabeledPlane3d& surf, const vector<CandidateOpening>&
         }
     }
 
-    cv::imwrite("./img/labelsWithOpenings.png", labelsImg);
-    cv::imwrite("./img/depthMask.png", depthImgMask);
-    cv::imwrite("./img/depthSimple.png", depthImg);
+    writeImage(surf.imageName("labelsWithOpenings"), labelsImg);
+    writeImage(surf.imageName("depthMask"), depthImgMask);
+    writeImage(surf.imageName("depthSimple"), depthImg);
 
     // TODO add values as part of class
-    if (!quiet) cout << "** Filling in missing data using inpaint algorithm" << endl;
+    if (!quiet) ProgressLine() << "** Filling in missing data using inpaint algorithm" << endl;
     cv::inpaint(depthImg, depthImgMask, depthImg, 0.05 * (imgWidth + imgHeight), cv::INPAINT_NS);
-    cv::imwrite("./img/depthInpaint.png", depthImg);
+    writeImage(surf.imageName("depthInpaint"), depthImg);
 
     // add some gaussian noise to make the image look more real
-    if (!quiet) cout << "** Adding gaussian noise: mean = " << mean << ", stdDev = " << stdDev << endl;
+    if (!quiet) ProgressLine() << "** Adding gaussian noise: mean = " << mean << ", stdDev = " << stdDev << endl;
     cv::Mat noise(imgHeight, imgWidth, CV_8UC1);
-    cv::randn(noise, mean, stdDev);
+    rng.fill(noise, cv::RNG::NORMAL, mean, stdDev);
     cv::addWeighted(depthImg, 0.9, noise, 0.1, 0.0, depthImg);
     cv::GaussianBlur(depthImg, depthImg, cv::Size(3, 3), 0.5, 0.5);
-    cv::imwrite("./img/depthInpaintNoise.png", depthImg);
+    writeImage(surf.imageName("depthInpaintNoise"), depthImg);
     surf.correctedDepthImg = depthImg.clone();
 
     // TODO apply the inverse transform from 2D to 3D and create a new point cloud using UOS RGB
@@ -1450,50 +1601,64 @@ void model::Scene::flood(LabeledPlane3d& surf,
         return;
     }
 
-    pair<int, int> north = make_pair(i-1, j);
-    pair<int, int> south = make_pair(i+1, j);
-    pair<int, int> east = make_pair(i, j+1);
-    pair<int, int> west = make_pair(i, j-1);
+    int nrRows = static_cast<int>(surf.patches.size());
+    if (i < 0 || i >= nrRows || j < 0 || j >= static_cast<int>(surf.patches[i].size()) ||
+            surf.patches[i][j].second != target)
+    {
+        return;
+    }
 
-    vector<pair<int, int> > neigh;
-    neigh.push_back(north);
-    neigh.push_back(south);
-    neigh.push_back(east);
-    neigh.push_back(west);
+    // the seeds of the spans left to fill, one for each span found on a row
+    vector<pair<int, int> > seeds;
+    seeds.push_back(make_pair(i, j));
 
-    if (surf.patches[i][j].second == target) {
-        surf.patches[i][j].second = replacement;
-    }
+    while (!seeds.empty()) {
+        int row = seeds.back().first;
+        int col = seeds.back().second;
+        seeds.pop_back();
 
-    for (vector<pair<int, int> >::iterator it = neigh.begin(); it != neigh.end(); ++it) {
-        if ((it->first > 0 && it->second > 0) &&
-                surf.patches[it->first][it->second].second == target)
-        {
-            flood(surf, it->first, it->second, target, replacement);
+        vector<pair<Point3d, Label> >& line = surf.patches[row];
+        if (line[col].second != target) {
+            continue;
+        }
+
+        // extend the span to both sides and fill it
+        int left = col, right = col;
+        while (left > 0 && line[left - 1].second == target) {
+            left--;
+        }
+        while (right + 1 < static_cast<int>(line.size()) && line[right + 1].second == target) {
+            right++;
+        }
+        for (int k = left; k <= right; ++k) {
+            line[k].second = replacement;
+        }
+
+        // the spans touching this one on the rows above and below
+        for (int next = row - 1; next <= row + 1; next += 2) {
+            if (next < 0 || next >= nrRows) {
+                continue;
+            }
+
+            vector<pair<Point3d, Label> >& nextLine = surf.patches[next];
+            int last = min(right, static_cast<int>(nextLine.size()) - 1);
+            bool inSpan = false;
+            for (int k = left; k <= last; ++k) {
+                if (nextLine[k].second != target) {
+                    inSpan = false;
+                } else if (!inSpan) {
+                    seeds.push_back(make_pair(next, k));
+                    inSpan = true;
+                }
+            }
         }
     }
 }
 
-bool model::Scene::isOccupied(const Point3d& center, const double& width) {
-    // look for a close point
-    double pt[] = {center.x, center.y, center.z};
-    double* closest = this->octTree->FindClosest(pt, pow(sqrt(3) * (width / 2.0), 2.0), 0);
-
-    // bounding box limits
-    double xUppLim = center.x + width / 2.0;
-    double xLowLim = center.x - width / 2.0;
-    double yUppLim = center.y + width / 2.0;
-    double yLowLim = center.y - width / 2.0;
-    double zUppLim = center.z + width / 2.0;
-    double zLowLim = center.z - width / 2.0;
-
-    if (closest != NULL &&
-            (closest[0] > xLowLim && closest[0] < xUppLim) &&
-            (closest[1] > yLowLim && closest[1] < yUppLim) &&
-            (closest[2] > zLowLim && closest[2] < zUppLim))
-    {
-        return true;
-    }
+void model::Scene::buildOccupancy() {
+    if (!quiet) cout << endl << "== Building occupancy grid of " << this->points.size() << " points..." << endl;
 
-    return false;
+    this->occupancy.build(this->points, RAY_DIST, pow(10.0, round(PRECISION)));
+
+    if (!quiet) cout << "** Allocated " << this->occupancy.getNrAllocatedBlocks() << " blocks" << endl;
 }
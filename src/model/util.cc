@@ -9,13 +9,22 @@
 //==============================================================================
 //  Includes
 //==============================================================================
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include "model/util.h"
 
+#include <opencv2/highgui/highgui.hpp>
+
 #include <sys/stat.h>       // stat()
 #include <unistd.h>
 #include <math.h>
 
 #include <stdexcept>
+#include <iostream>
 using namespace std;
 
 //==============================================================================
@@ -166,3 +175,17 @@ bool model::makeDir(const string& path) {
 
 	return (mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IRWXO) == 0 ? true : false);
 }
+
+void model::writeImage(const string& file, const cv::Mat& img) {
+#ifdef _OPENMP
+#pragma omp critical (writeImage)
+#endif
+    cv::imwrite(file, img);
+}
+
+model::ProgressLine::~ProgressLine() {
+#ifdef _OPENMP
+#pragma omp critical (progress)
+#endif
+    cout << line.str() << flush;
+}
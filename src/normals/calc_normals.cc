@@ -234,6 +234,9 @@ int main(int argc, char** argv)
       points.push_back(Point(xyz[j][0], xyz[j][1], xyz[j][2]));
     }
 
+    unsigned long starttime = GetCurrentTimeInMilliSec();
+    size_t nr_points = points.size();
+
     if(ntype == AKNN)
       calculateNormalsApxKNN(normals,points, k1, rPos);
     else if(ntype == ADAPTIVE_AKNN)
@@ -255,6 +258,13 @@ int main(int argc, char** argv)
       //   calculateNormalsFAST(normals,points,img,fPanorama.getExtendedMap());
     }
 
+    unsigned long endtime = GetCurrentTimeInMilliSec() - starttime;
+    cout << "Calculated normals of " << nr_points << " points in "
+         << endtime / 1000.0 << " s";
+    if (endtime > 0)
+      cout << " (" << (unsigned long)(nr_points * 1000.0 / endtime) << " points/s)";
+    cout << endl;
+
     // pose file (repeated for the number of segments
     writePoseFiles(normdir, rPos, rPosTheta, scanNumber);
     // scan files for all segments
@@ -8,7 +8,7 @@
  */
 
 #include <vector>
-#include <ANN/ANN.h>
+#include <limits>
 #include "slam6d/io_types.h"
 #include "slam6d/globals.icc"
 #include "slam6d/scan.h"
@@ -20,92 +20,174 @@
 
 #include "normals/normals.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace NEWMAT;
 using namespace std;
 
-//////////////////////////////////////////////////////
-/////////////NORMALS USING AKNN METHOD ////////////////
-///////////////////////////////////////////////////////
-void calculateNormalsApxKNN(vector<Point> &normals,
-					   vector<Point> &points,
-					   int k,
-					   const double _rPos[3],
-					   double eps)
+/**
+ * Sums of the coordinates and their products over a neighborhood, so that
+ * the neighborhood can be grown one point at a time. The coordinates are
+ * taken relative to the query point to avoid cancellation far away from the
+ * origin.
+ */
+struct NeighborhoodSums {
+  double origin[3];
+  double s[3];
+  double xx, xy, xz, yy, yz, zz;
+  int n;
+
+  void reset(const double *p) {
+    origin[0] = p[0];
+    origin[1] = p[1];
+    origin[2] = p[2];
+    s[0] = s[1] = s[2] = 0.0;
+    xx = xy = xz = yy = yz = zz = 0.0;
+    n = 0;
+  }
+
+  void add(const double *q) {
+    double x = q[0] - origin[0];
+    double y = q[1] - origin[1];
+    double z = q[2] - origin[2];
+    s[0] += x;
+    s[1] += y;
+    s[2] += z;
+    xx += x*x; xy += x*y; xz += x*z;
+    yy += y*y; yz += y*z; zz += z*z;
+    n++;
+  }
+
+  void covariance(double C[3][3]) const {
+    double mx = s[0] / n, my = s[1] / n, mz = s[2] / n;
+    C[0][0] = xx / n - mx*mx;
+    C[0][1] = C[1][0] = xy / n - mx*my;
+    C[0][2] = C[2][0] = xz / n - mx*mz;
+    C[1][1] = yy / n - my*my;
+    C[1][2] = C[2][1] = yz / n - my*mz;
+    C[2][2] = zz / n - mz*mz;
+  }
+};
+
+/**
+ * The normal is the eigenvector of the smallest eigenvalue of the
+ * covariance, oriented away from the scanner position
+ */
+static inline Point orientedNormal(const double evec[3], const double *p, const double *rPos)
+{
+  double n[3] = { evec[0], evec[1], evec[2] };
+  double point_vector[3] = { p[0] - rPos[0], p[1] - rPos[1], p[2] - rPos[2] };
+  if (Dot(n, point_vector) < 0) {
+    n[0] = -n[0];
+    n[1] = -n[1];
+    n[2] = -n[2];
+  }
+  return Point(n[0], n[1], n[2]);
+}
+
+/**
+ * Common implementation of the k nearest neighbor methods. Each query
+ * retrieves the kmax nearest neighbors once through the k-d tree into a
+ * buffer of its thread. With adaptive set, the neighborhood is grown from
+ * kmin + 1 neighbors one point at a time until its eigenvalues indicate a
+ * plane, otherwise all kmax neighbors are used.
+ */
+static void calculateNormalsKNNTree(vector<Point> &normals,
+                                    vector<Point> &points,
+                                    int kmin,
+                                    int kmax,
+                                    bool adaptive,
+                                    const double rPos[3])
 {
   cout<<"Total number of points: "<<points.size()<<endl;
-  int nr_neighbors = k;
+  size_t offset = normals.size();
+  normals.resize(offset + points.size());
+  if (points.empty()) return;
 
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
+  if (kmax > (int)points.size()) kmax = points.size();
+  if (kmax < 1) kmax = 1;
+  if (kmin >= kmax) kmin = kmax - 1;
+  if (kmin < 0) kmin = 0;
 
-  ANNpointArray pa = annAllocPts(points.size(), 3);
-  for (size_t i=0; i<points.size(); ++i)
+  double *coords = new double[3 * points.size()];
+  double **pa = new double*[points.size()];
+  for (size_t i = 0; i < points.size(); ++i)
   {
+    pa[i] = coords + 3*i;
     pa[i][0] = points[i].x;
     pa[i][1] = points[i].y;
     pa[i][2] = points[i].z;
-
   }
-  ANNkd_tree t(pa, points.size(), 3);
-  ANNidxArray nidx = new ANNidx[nr_neighbors];
-  ANNdistArray d = new ANNdist[nr_neighbors];
+  // the tree reorders the pointer array, so query the contiguous coordinates
+  KDtree t(pa, points.size());
 
-  for (size_t i=0; i<points.size(); ++i)
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
   {
-    ANNpoint p = pa[i];
-    //ANN search for k nearest neighbors
-    //indexes of the neighbors along with the query point
-    //stored in the array n
-    t.annkSearch(p, nr_neighbors, nidx, d, eps);
-    Point mean(0.0,0.0,0.0);
-    Matrix X(nr_neighbors,3);
-    SymmetricMatrix A(3);
-    Matrix U(3,3);
-    DiagonalMatrix D(3);
-    //calculate mean for all the points
-    for (int j=0; j<nr_neighbors; ++j)
+    int thread_num = 0;
+#ifdef _OPENMP
+    thread_num = omp_get_thread_num();
+#endif
+    vector<double*> neighbors(kmax);
+    vector<double> dist2(kmax);
+    NeighborhoodSums sums;
+    double C[3][3], eval[3], evec[3][3];
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1000)
+#endif
+    for (long i = 0; i < (long)points.size(); ++i)
     {
-      mean.x += points[nidx[j]].x;
-      mean.y += points[nidx[j]].y;
-      mean.z += points[nidx[j]].z;
-    }
-    mean.x /= nr_neighbors;
-    mean.y /= nr_neighbors;
-    mean.z /= nr_neighbors;
-    //calculate covariance = A for all the points
-    for (int i = 0; i < nr_neighbors; ++i) {
-      X(i+1, 1) = points[nidx[i]].x - mean.x;
-      X(i+1, 2) = points[nidx[i]].y - mean.y;
-      X(i+1, 3) = points[nidx[i]].z - mean.z;
-    }
+      double *p = coords + 3*i;
+      int found = t.FindKClosest(p, kmax, numeric_limits<double>::max(),
+                                 &neighbors[0], &dist2[0], thread_num);
+
+      sums.reset(p);
+      if (!adaptive) {
+        for (int j = 0; j < found; ++j) sums.add(neighbors[j]);
+        sums.covariance(C);
+        EigenSym3(C, eval, evec);
+      } else {
+        int j = 0;
+        for (int k = kmin + 1; k <= found; ++k) {
+          while (j < k) sums.add(neighbors[j++]);
+          sums.covariance(C);
+          EigenSym3(C, eval, evec);
+
+          //We take the particular k if the second maximum eigen value
+          //is at least 25 percent of the maximum eigen value
+          if ((eval[0] > 0.25 * eval[1]) && (fabs(1.0 - eval[1]/eval[2]) < 0.25))
+            break;
+        }
+        if (j == 0) {
+          for (; j < found; ++j) sums.add(neighbors[j]);
+          sums.covariance(C);
+          EigenSym3(C, eval, evec);
+        }
+      }
 
-    A << 1.0/nr_neighbors * X.t() * X;
-
-    EigenValues(A, D, U);
-
-    //normal = eigenvector corresponding to lowest
-    //eigen value that is the 1st column of matrix U
-    ColumnVector n(3);
-    n(1) = U(1,1);
-    n(2) = U(2,1);
-    n(3) = U(3,1);
-    ColumnVector point_vector(3);
-    point_vector(1) = p[0] - rPos(1);
-    point_vector(2) = p[1] - rPos(2);
-    point_vector(3) = p[2] - rPos(3);
-    point_vector = point_vector / point_vector.NormFrobenius();
-    Real angle = (n.t() * point_vector).AsScalar();
-    if (angle < 0) {
-      n *= -1.0;
+      normals[offset + i] = orientedNormal(evec[0], p, rPos);
     }
-    n = n / n.NormFrobenius();
-    normals.push_back(Point(n(1), n(2), n(3)));
   }
 
-  delete[] nidx;
-  delete[] d;
-  annDeallocPts(pa);
+  delete[] pa;
+  delete[] coords;
+}
+
+//////////////////////////////////////////////////////
+/////////////NORMALS USING AKNN METHOD ////////////////
+///////////////////////////////////////////////////////
+void calculateNormalsApxKNN(vector<Point> &normals,
+					   vector<Point> &points,
+					   int k,
+					   const double _rPos[3],
+					   double eps)
+{
+  calculateNormalsKNNTree(normals, points, k, k, false, _rPos);
 }
 ////////////////////////////////////////////////////////////////
 /////////////NORMALS USING ADAPTIVE AKNN METHOD ////////////////
@@ -117,98 +199,7 @@ void calculateNormalsAdaptiveApxKNN(vector<Point> &normals,
 							 const double _rPos[3],
 							 double eps)
 {
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-
-  cout<<"Total number of points: "<<points.size()<<endl;
-  int nr_neighbors;
-  ANNpointArray pa = annAllocPts(points.size(), 3);
-  for (size_t i=0; i<points.size(); ++i)
-
-  {
-    pa[i][0] = points[i].x;
-    pa[i][1] = points[i].y;
-    pa[i][2] = points[i].z;
-
-  }
-  ANNkd_tree t(pa, points.size(), 3);
-
-  Point mean(0.0,0.0,0.0);
-  double e1,e2,e3;
-
-  for (size_t i=0; i<points.size(); ++i)
-  {
-    Matrix U(3,3);
-    ANNpoint p = pa[i];
-    for(int kidx = kmin; kidx < kmax; kidx++)
-    {
-      nr_neighbors=kidx+1;
-      ANNidxArray nidx = new ANNidx[nr_neighbors];
-      ANNdistArray d = new ANNdist[nr_neighbors];
-      //ANN search for k nearest neighbors
-      //indexes of the neighbors along with the query point
-      //stored in the array n
-      t.annkSearch(p, nr_neighbors, nidx, d, eps);
-      mean.x=0,mean.y=0,mean.z=0;
-      //calculate mean for all the points
-      for (int j=0; j<nr_neighbors; ++j)
-      {
-        mean.x += points[nidx[j]].x;
-        mean.y += points[nidx[j]].y;
-        mean.z += points[nidx[j]].z;
-      }
-      mean.x /= nr_neighbors;
-      mean.y /= nr_neighbors;
-      mean.z /= nr_neighbors;
-
-      Matrix X(nr_neighbors,3);
-      SymmetricMatrix A(3);
-      DiagonalMatrix D(3);
-
-      //calculate covariance = A for all the points
-      for (int j = 0; j < nr_neighbors; ++j) {
-        X(j+1, 1) = points[nidx[j]].x - mean.x;
-        X(j+1, 2) = points[nidx[j]].y - mean.y;
-        X(j+1, 3) = points[nidx[j]].z - mean.z;
-      }
-
-      A << 1.0/nr_neighbors * X.t() * X;
-
-      EigenValues(A, D, U);
-
-      e1 = D(1);
-      e2 = D(2);
-      e3 = D(3);
-
-      delete[] nidx;
-      delete[] d;
-
-      //We take the particular k if the second maximum eigen value
-      //is at least 25 percent of the maximum eigen value
-      if ((e1 > 0.25 * e2) && (fabs(1.0 - (double)e2/(double)e3) < 0.25))
-        break;
-    }
-
-    //normal = eigenvector corresponding to lowest
-    //eigen value that is the 1rd column of matrix U
-    ColumnVector n(3);
-    n(1) = U(1,1);
-    n(2) = U(2,1);
-    n(3) = U(3,1);
-    ColumnVector point_vector(3);
-    point_vector(1) = p[0] - rPos(1);
-    point_vector(2) = p[1] - rPos(2);
-    point_vector(3) = p[2] - rPos(3);
-    point_vector = point_vector / point_vector.NormFrobenius();
-    Real angle = (n.t() * point_vector).AsScalar();
-    if (angle < 0) {
-      n *= -1.0;
-    }
-    n = n / n.NormFrobenius();
-    normals.push_back(Point(n(1), n(2), n(3)));
-  }
-  annDeallocPts(pa);
+  calculateNormalsKNNTree(normals, points, kmin, kmax, true, _rPos);
 }
 
 
@@ -221,91 +212,7 @@ void calculateNormalsKNN(vector<Point> &normals,
 					int k,
 					const double _rPos[3] )
 {
-  cout<<"Total number of points: "<<points.size()<<endl;
-  int nr_neighbors = k;
-
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-  
-  double** pa = new double*[points.size()];
-  for (size_t i = 0; i < points.size(); ++i)
-  {
-      pa[i] = new double[3];
-      pa[i][0] = points[i].x;
-      pa[i][1] = points[i].y;
-      pa[i][2] = points[i].z;
-  }
-
-  KDtree t(pa, points.size());
-
-  for (size_t i=0; i<points.size(); ++i)
-    {
-	 double p[3] = {pa[i][0], pa[i][1], pa[i][2]};
-
-	 //ANN search for k nearest neighbors 
-	 //indexes of the neighbors along with the query point 
-	 //stored in the array n
-
-	 vector<Point> temp = t.kNearestNeighbors(p,
-									  nr_neighbors,
-									  numeric_limits<double>::max());
-	 nr_neighbors = temp.size();
-
-	 Point mean(0.0,0.0,0.0);
-	 Matrix X(nr_neighbors,3);
-	 SymmetricMatrix A(3);
-	 Matrix U(3,3);
-	 DiagonalMatrix D(3);
-
-	 //calculate mean for all the points	    	
-	 for (int j = 0; j < nr_neighbors; ++j)
-	   {
-		mean.x += temp[j].x;
-		mean.y += temp[j].y;
-		mean.z += temp[j].z;
-	   }
-	 mean.x /= nr_neighbors;
-	 mean.y /= nr_neighbors;
-	 mean.z /= nr_neighbors;
-
-	 //calculate covariance = A for all the points
-	 for (int i = 0; i < nr_neighbors; ++i) {
-	   X(i+1, 1) = temp[i].x - mean.x;
-	   X(i+1, 2) = temp[i].y - mean.y;
-	   X(i+1, 3) = temp[i].z - mean.z;
-	 }
-    
-	 A << 1.0/nr_neighbors * X.t() * X;
-
-	 EigenValues(A, D, U);
-
-	 //normal = eigenvector corresponding to lowest 
-	 //eigen value that is the 1st column of matrix U
-	 ColumnVector n(3);
-	 n(1) = U(1,1);
-	 n(2) = U(2,1);
-	 n(3) = U(3,1);
-	 ColumnVector point_vector(3);
-	 point_vector(1) = p[0] - rPos(1);
-	 point_vector(2) = p[1] - rPos(2);
-	 point_vector(3) = p[2] - rPos(3);
-	 point_vector = point_vector / point_vector.NormFrobenius();
-	 Real angle = (n.t() * point_vector).AsScalar();
-	 if (angle < 0) {
-	   n *= -1.0;
-	 }
-	 n = n / n.NormFrobenius();
-	 normals.push_back(Point(n(1), n(2), n(3)));  	
-    }
-
-
-  for (size_t i = 0; i < points.size(); ++i)
-  {
-      delete[] pa[i];
-  }
-  delete[] pa;
-
+  calculateNormalsKNNTree(normals, points, k, k, false, _rPos);
 }
 ////////////////////////////////////////////////////////////////
 /////////////NORMALS USING ADAPTIVE AKNN METHOD ////////////////
@@ -316,108 +223,7 @@ void calculateNormalsAdaptiveKNN(vector<Point> &normals,
 						   int kmax,
 						   const double _rPos[3])
 {
-  ColumnVector rPos(3);
-  for (int i = 0; i < 3; ++i)
-    rPos(i+1) = _rPos[i];
-
-  cout<<"Total number of points: "<<points.size()<<endl;
-  int nr_neighbors;	
-
-  double** pa = new double*[points.size()];
-  for (size_t i = 0; i < points.size(); ++i)
-  {
-      pa[i] = new double[3];
-      pa[i][0] = points[i].x;
-      pa[i][1] = points[i].y;
-      pa[i][2] = points[i].z;
-  }
-
-  KDtree t(pa, points.size());
-
-  Point mean(0.0,0.0,0.0);
-  double e1,e2,e3;	
-		
-  for (size_t i=0; i<points.size(); ++i)
-    {
-	 Matrix U(3,3);
-
-	 double p[3] = {pa[i][0], pa[i][1], pa[i][2]};
-
-	 for(int kidx = kmin; kidx < kmax; kidx++)
-	   {
-		nr_neighbors=kidx+1;
-
-		//ANN search for k nearest neighbors 
-		//indexes of the neighbors along with the query point 
-		//stored in the array n
-
-		vector<Point> temp = t.kNearestNeighbors(p,
-										 nr_neighbors,
-										 numeric_limits<double>::max());
-		nr_neighbors = temp.size();
-
-		mean.x=0,mean.y=0,mean.z=0;
-		//calculate mean for all the points	    	
-		for (int j=0; j<nr_neighbors; ++j)
-		  {
-		    mean.x += temp[j].x;
-		    mean.y += temp[j].y;
-		    mean.z += temp[j].z;
-		  }
-		mean.x /= nr_neighbors;
-		mean.y /= nr_neighbors;
-		mean.z /= nr_neighbors;
-
-		Matrix X(nr_neighbors,3);
-		SymmetricMatrix A(3);
-		DiagonalMatrix D(3);
-
-		//calculate covariance = A for all the points
-		for (int j = 0; j < nr_neighbors; ++j) {
-		  X(j+1, 1) = temp[j].x - mean.x;
-		  X(j+1, 2) = temp[j].y - mean.y;
-		  X(j+1, 3) = temp[j].z - mean.z;
-		}
-			
-		A << 1.0/nr_neighbors * X.t() * X;
-			
-		EigenValues(A, D, U);
-
-		e1 = D(1);
-		e2 = D(2);
-		e3 = D(3);
-		
-		//We take the particular k if the second maximum eigen value 
-		//is at least 25 percent of the maximum eigen value
-		if ((e1 > 0.25 * e2) && (fabs(1.0 - (double)e2/(double)e3) < 0.25)) 
-		  break;
-	   }
-	 
-	 //normal = eigenvector corresponding to lowest 
-	 //eigen value that is the 1rd column of matrix U
-	 ColumnVector n(3);
-	 n(1) = U(1,1);
-	 n(2) = U(2,1);
-	 n(3) = U(3,1);
-	 ColumnVector point_vector(3);
-	 point_vector(1) = p[0] - rPos(1);
-	 point_vector(2) = p[1] - rPos(2);
-	 point_vector(3) = p[2] - rPos(3);
-	 point_vector = point_vector / point_vector.NormFrobenius();
-	 Real angle = (n.t() * point_vector).AsScalar();
-	 if (angle < 0) {
-	   n *= -1.0;
-	 }
-	 n = n / n.NormFrobenius();
-	 normals.push_back(Point(n(1), n(2), n(3)));  
-    }
-
-  for (size_t i = 0; i < points.size(); ++i)
-  {
-      delete[] pa[i];
-  }
-  delete[] pa;
-
+  calculateNormalsKNNTree(normals, points, kmin, kmax, true, _rPos);
 }
 
 
@@ -40,6 +40,11 @@ using namespace std;
 
 #ifdef _MSC_VER
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -172,6 +177,8 @@ double distCorrection[VELODYNE_NUM_LASERS];
 double vertoffsetCorrection[VELODYNE_NUM_LASERS];
 double horizdffsetCorrection[VELODYNE_NUM_LASERS];
 double enabled[VELODYNE_NUM_LASERS];	//New variable to change enabling and disabling of data.
+double sinVertCorrection[VELODYNE_NUM_LASERS];
+double cosVertCorrection[VELODYNE_NUM_LASERS];
 
 int physical2logical[VELODYNE_NUM_LASERS];
 int logical2physical[VELODYNE_NUM_LASERS];
@@ -251,6 +258,8 @@ int velodyne_calib_precompute()
         vertoffsetCorrection[i] = velodyne_calibrated[i][3] * METERS_PER_CM;
         horizdffsetCorrection[i] = velodyne_calibrated[i][4] * METERS_PER_CM;
 	enabled[i] = velodyne_calibrated[i][5];
+        sinVertCorrection[i] = sin(vertCorrection[i]);
+        cosVertCorrection[i] = cos(vertCorrection[i]);
     }
 
     return 0;
@@ -318,66 +327,47 @@ int calibrate(string filename)
 }
 
 
+/**
+ * Decodes one revolution of CIRCLELENGTH packets from memory. Returns -1 if
+ * the data ends before the revolution is complete, the points of the
+ * complete packets are kept.
+ */
 int read_one_packet (
-    FILE *fp,
+    const BYTE *data,
+    size_t length,
     PointFilter& filter,
-    std::vector<double>* xyz,
-    std::vector<unsigned char>* rgb,
-    std::vector<float>* reflectance,
-    std::vector<float>* amplitude,
-    std::vector<int>* type,
-    std::vector<float>* deviation)
+    std::vector<double>* xyz)
 {
-
-	int  c, i, j;
-    unsigned char Head;
-    BYTE buf[BLOCK_SIZE];
-    Point point;
-    BYTE *p;
-    unsigned short *ps;
-    unsigned short *pt;
-    unsigned short *pshort;
+    int  c, i, j;
+    unsigned char Head = 0;
+    const BYTE *buf;
+    const BYTE *p;
+    const unsigned short *ps;
+    const unsigned short *pt;
+    const unsigned short *pshort;
 
     double ctheta;
-    double theta, phi;
+    double theta;
 
     double sin_ctheta, cos_ctheta;
     double sin_theta, cos_theta;
-    double sin_phi, cos_phi;
 
     unsigned short physicalNO;
-    unsigned short logicalNO;
 
     float rotational;
     float distance;
     float corredistance;
-    int intensity;
-    int physical;
-    int size;
 
-    unsigned short rot;
     double x, y, z;
 
-    int circle_col = 0;
-    int circle_row = 0;
-
 	for ( c = 0 ; c < CIRCLELENGTH; c++ )
 	{
-#ifdef _MSC_VER 
-		fseek(fp , BLOCK_OFFSET, SEEK_CUR);
-#else
-#ifdef __CYGWIN__
-		fseek(fp , BLOCK_OFFSET, SEEK_CUR);
-#else		
-		fseeko(fp , BLOCK_OFFSET, SEEK_CUR);
-#endif
-#endif		
-		size=fread ( buf, 1, BLOCK_SIZE, fp );
-
-		if(size<BLOCK_SIZE)
+		size_t offset = (size_t)c * (BLOCK_SIZE + BLOCK_OFFSET) + (BLOCK_OFFSET);
+		if(offset + BLOCK_SIZE > length)
 			return -1;
+		buf = data + offset;
 
-		ps = ( unsigned short * ) buf;
+		ps = ( const unsigned short * ) buf;
 		p = buf;
 		physicalNO = 0;
 
@@ -389,85 +379,69 @@ int read_one_packet (
 			else if ( *ps == 0xDDFF )
 				Head = 32;
 
-			pshort = ( unsigned short * ) ( p + 2 );
-			rot = ( ( unsigned short ) ( *pshort ) / 100.0 );
-
-			circle_col =  c * 6 + i / 2;
+			pshort = ( const unsigned short * ) ( p + 2 );
 			rotational = ( ( float ) ( *pshort ) ) / 100.0;
 
+			// the rotation is the same for all lasers of a block
+			ctheta = 2 * M_PI - rotational * RADIANS_PER_LSB;
+			if ( ctheta == 2*M_PI )
+				ctheta = 0;
+
+			sin_ctheta = sin ( ctheta );
+			cos_ctheta = cos ( ctheta );
+
 			for ( j = 0; j < 32; j++ )
 			{
 				physicalNO  = j + Head;
-				logicalNO = velodyne_physical_to_logical ( physicalNO );
-
-				circle_col =  c * 6 + i / 2;
-				circle_row =  logicalNO;
 
-				pt = ( unsigned short * ) ( p + 4 + j * 3 );
+				pt = ( const unsigned short * ) ( p + 4 + j * 3 );
 				distance = absf ( ( *pt ) * 0.002 );
 
-				if( distance < 120   &&	   distance > 2.2 )
+				if( distance < 120   &&	   distance > 2.2 && enabled[physicalNO]==1 )
 				{
-					BYTE *inty = ( BYTE * ) ( p + 4 + j * 3 + 2 );
-					intensity = *inty;
-
-					ctheta = 2 * M_PI - rotational * RADIANS_PER_LSB;
-					if ( ctheta == 2*M_PI )
-						ctheta = 0;
-
-					sin_ctheta = sin ( ctheta );
-					cos_ctheta = cos ( ctheta );
-
 					//vertCorrection  rotCorrection  distCorrection  vertOffsetCorrection  horizOffsetCorrection
 					//                corredistance = ( distance + distCorrection[physicalNO] ) * ( 1.0 + vertoffsetCorrection[physicalNO] );
 					corredistance = ( distance + distCorrection[physicalNO] ) ;
-					theta     = mod2pi_ref ( M_PI, ctheta + rotCorrection[physicalNO] ); /////////????////////
-					phi    = vertCorrection[physicalNO];  ////////?????/////////////////
+					theta     = mod2pi_ref ( M_PI, ctheta + rotCorrection[physicalNO] );
 
 					sin_theta = sin ( theta );
 					cos_theta = cos ( theta );
-					sin_phi = sin ( phi );
-					cos_phi = cos ( phi );
 
-					/////////////////////?a???/////////////////////
-					x = corredistance * cos_theta * cos_phi;
-					y = corredistance * sin_theta * cos_phi;
-					z = corredistance * sin_phi +vertoffsetCorrection[physicalNO]*cos_phi;
+					x = corredistance * cos_theta * cosVertCorrection[physicalNO];
+					y = corredistance * sin_theta * cosVertCorrection[physicalNO];
+					z = corredistance * sinVertCorrection[physicalNO] +vertoffsetCorrection[physicalNO]*cosVertCorrection[physicalNO];
 
 					x -= horizdffsetCorrection[physicalNO] * cos_ctheta;
 					y -= horizdffsetCorrection[physicalNO] * sin_ctheta;
 
-					point.rad  = sqrt(  x*x 	+  y*y );
-					point.tan_theta  = y/x;
+				        double point[3];
+				        point[0] = x*100;
+				        point[1] = z*100;
+				        point[2] = -y*100;
 
-					point.type = POINT_TYPE_GROUND;
-					point.x=x*100;
-					point.y=z*100;
-					point.z=-y*100;
-
-				        double p[3];
-				        p[0] = point.x;
-				        p[1] = point.y;
-				        p[2] = point.z;
-
-					//Enable Check. Could be moved earlier to remove all the unnecessary calculations.
-					//Here to simplify the implementation
-			                if(filter.check(p) && (enabled[physicalNO]==1))
+			                if(filter.check(point))
    					{
-						 for(int ii = 0; ii < 3; ++ii) xyz->push_back(p[ii]);
+						 for(int ii = 0; ii < 3; ++ii) xyz->push_back(point[ii]);
 					}
 				}
 			}
             p = p + 100;
-            ps = ( unsigned short * ) p;
+            ps = ( const unsigned short * ) p;
         }
-
-
     }
 
     return 0;
 }
 
+ScanIO_velodyne::ScanIO_velodyne()
+  : fileCounter(0)
+{
+}
+
+ScanIO_velodyne::~ScanIO_velodyne()
+{
+}
+
 std::list<std::string> ScanIO_velodyne::readDirectory(const char* dir_path, unsigned int start, unsigned int end)
 {
 	//Calling the calibration method with the file name "calibration.txt" in the same folder as the scan.bin
@@ -511,6 +485,14 @@ bool ScanIO_velodyne::supports(IODataType type)
   return !!(type & (DATA_XYZ));
 }
 
+std::list<std::string> ScanIO_velodyne::readFiles(const char* dir_path, const char* identifier)
+{
+  // all revolutions are read from the same file
+  std::list<std::string> files;
+  files.push_back(std::string(dir_path) + DATA_PATH_PREFIX + DATA_PATH_SUFFIX);
+  return files;
+}
+
 
 void ScanIO_velodyne::readScan(
     const char* dir_path,
@@ -524,9 +506,6 @@ void ScanIO_velodyne::readScan(
     std::vector<int>* type,
     std::vector<float>* deviation)
 {
-    unsigned int i;
-    FILE *scan_in;
-
     path data_path(dir_path);
     data_path /= path(std::string(DATA_PATH_PREFIX) +  DATA_PATH_SUFFIX);
     if(!exists(data_path))
@@ -535,59 +514,56 @@ void ScanIO_velodyne::readScan(
 	char filename[256];
 	sprintf(filename, "%s%s%s",dir_path ,DATA_PATH_PREFIX,  DATA_PATH_SUFFIX );
 
-#ifdef _MSC_VER 
-    scan_in = fopen(filename,"rb");
-#else
-#ifdef __CYGWIN__
-    scan_in = fopen(filename,"rb");
-#else    
-    scan_in = fopen64(filename,"rb");
-#endif
-#endif
-
-    if(scan_in == NULL)
-    {
-      cerr<<data_path <<endl;
-      cerr << "ERROR: Missing file " << data_path <<" "<<strerror(errno)<< endl;
-      exit(1);
-      return;
-    }
-
     cout << "Processing Scan " << data_path;
     cout.flush();
 
     xyz->reserve(12*32*CIRCLELENGTH);
 
-	fileCounter=  atoi(identifier);
+    int revolutionNr = atoi(identifier);
 
-#ifdef _MSC_VER 
-    fseek(scan_in, 24, SEEK_SET);
-    fseek(scan_in, (BLOCK_SIZE+BLOCK_OFFSET)*CIRCLELENGTH*fileCounter, SEEK_CUR);
-#else
-#ifdef __CYGWIN__     
-    fseek(scan_in, 24, SEEK_SET);
-    fseek(scan_in, (BLOCK_SIZE+BLOCK_OFFSET)*CIRCLELENGTH*fileCounter, SEEK_CUR);
+    // the revolutions follow a header of 24 bytes
+    size_t revolution = (size_t)(BLOCK_SIZE+BLOCK_OFFSET)*CIRCLELENGTH;
+    size_t offset = 24 + revolution*revolutionNr;
+
+    // the file is opened per call, so concurrent reads do not interfere
+#ifndef _MSC_VER
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+      cerr << "ERROR: Missing file " << data_path << " " << strerror(errno) << endl;
+      exit(1);
+    }
+    size_t length = st.st_size;
+    if(offset < length)
+    {
+      // map only the pages of this revolution
+      size_t begin = offset - offset % sysconf(_SC_PAGESIZE);
+      size_t size = min(length, offset + revolution) - begin;
+      void* image = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, begin);
+      if(image != MAP_FAILED)
+      {
+        read_one_packet(reinterpret_cast<unsigned char*>(image) + (offset - begin), size - (offset - begin), filter, xyz);
+        munmap(image, size);
+      }
+    }
+    close(fd);
 #else
-    fseeko(scan_in, 24, SEEK_SET);
-    fseeko(scan_in, (BLOCK_SIZE+BLOCK_OFFSET)*CIRCLELENGTH*fileCounter, SEEK_CUR);
-#endif    
+    FILE* file = fopen(filename, "rb");
+    if(file == NULL)
+    {
+      cerr << "ERROR: Missing file " << data_path << " " << strerror(errno) << endl;
+      exit(1);
+    }
+    std::vector<unsigned char> buffer(revolution);
+    _fseeki64(file, offset, SEEK_SET);
+    size_t length = fread(&buffer[0], 1, revolution, file);
+    fclose(file);
+    read_one_packet(&buffer[0], length, filter, xyz);
 #endif
 
-    read_one_packet(
-                scan_in,
-                filter,
-                xyz,
-                rgb,
-                reflectance,
-                amplitude,
-                type,
-                deviation);
-
     cout << " with " << xyz->size() << " Points";
-    cout << " done " << fileCounter<<endl;
-
-    fclose(scan_in);
-    // process next frames
+    cout << " done " << revolutionNr<<endl;
 }
 
 /**
@@ -8,20 +8,34 @@
   * @author Mihai-Cotizo Sima
   */
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include <segmentation/FHGraph.h>
+#include <slam6d/kd.h>
 #include <map>
-#include <omp.h>
 #include <algorithm>
 
-using namespace std;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+using namespace std;
 
+template<typename T>
+void vectorFree(T& t) {
+    T tmp;
+    t.swap(tmp);
+}
 
 FHGraph::FHGraph(std::vector< Point >& ps, double weight(Point, Point), double sigma, double eps, int neighbors, float radius) :
-    points( ps ), V( ps.size() )
+    edges( 0 ), points( ps ), V( ps.size() ), E( 0 )
 {
     /*
-     * 1. create adjency list using a map<int, vector<half_edge> >
+     * 1. create adjacency arrays of the neighbors of each point
      * 2. use get_neighbors(e, max_dist) to get all the edges e' that are at a distance smaller than max_dist than e
      * 3. using all these edges, compute the gaussian smoothed weight
      * 4. insert the edges in a new list
@@ -41,109 +55,143 @@ FHGraph::FHGraph(std::vector< Point >& ps, double weight(Point, Point), double s
         without_gauss();
     }
 
-    adjency_list.clear();
+    vectorFree(first);
+    vectorFree(adjacency);
 }
 
-void FHGraph::compute_neighbors(double weight(Point, Point), double eps)
+FHGraph::~FHGraph()
 {
+    delete[] edges;
+}
 
-    adjency_list.reserve(points.size());
-    adjency_list.resize(points.size());
+/**
+ * xorshift generator for picking a random subset of the neighbors, seeded
+ * with the index of the point so the graph does not depend on the threads
+ */
+static inline unsigned int next_random(unsigned long long &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (unsigned int)((state * 0x2545F4914F6CDD1DULL) >> 32);
+}
 
-    ANNpointArray pa = annAllocPts(points.size(), 3);
-    for (size_t i=0; i<points.size(); ++i)
+void FHGraph::compute_neighbors(double weight(Point, Point), double eps)
+{
+    // the k-d tree reorders the pointer array, so query the contiguous
+    // coordinates; ANN keeps its search state in globals and cannot be
+    // queried from several threads, eps is not used anymore
+    double *coords = new double[3 * V];
+    double **pa = new double*[V];
+    for (int i=0; i<V; ++i)
     {
-        pa[i] = new ANNcoord[3];
+        pa[i] = coords + 3*i;
         pa[i][0] = points[i].x;
         pa[i][1] = points[i].y;
         pa[i][2] = points[i].z;
     }
 
-    ANNkd_tree t(pa, points.size(), 3);
+    KDtree t(pa, V);
 
     if ( radius < 0 ) // Using knn search
-    {
         nr_neighbors++;
-        ANNidxArray n = new ANNidx[nr_neighbors];
-        ANNdistArray d = new ANNdist[nr_neighbors];
-
-        for (size_t i=0; i<points.size(); ++i)
-        {
-            ANNpoint p = pa[i];
-
-            t.annkSearch(p, nr_neighbors, n, d, eps);
+    double sqradius = radius*radius;
 
-            for (int j=0; j<nr_neighbors; ++j)
-            {
-                if ( n[j] == (int)i ) continue;
+    vector<int> degree(V);
+    first.resize(V + 1);
+    long total = 0;
 
-                he e;
-                e.x = n[j];
-                e.w = weight(points[i], points[n[j]]);
-
-                adjency_list[i].push_back(e);
-            }
-
-        }
-
-        delete[] n;
-        delete[] d;
-    }
-    else // Using radius search
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel reduction(+:total)
+#endif
     {
-        float sqradius = radius*radius;
-
-
-        ANNidxArray n;
-        ANNdistArray d;
-        int nret;
-        int total = 0;
-
-        const int MOD = 1000;
-        int TMP = MOD;
-
-        for (size_t i=0; i<points.size(); ++i)
+        int thread_num = 0;
+#ifdef _OPENMP
+        thread_num = omp_get_thread_num();
+#endif
+        // buffers of this thread, reused for all of its points
+        vector<double*> n;
+        vector<double> d;
+        if ( radius < 0 )
         {
-            ANNpoint p = pa[i];
-
-            nret = t.annkFRSearch(p, sqradius, 0, NULL, NULL, eps);
-            total += nret;
-
-            n = new ANNidx[nret];
-            d = new ANNdist[nret];
-            t.annkFRSearch(p, sqradius, nret, n, d, eps);
+            n.resize(nr_neighbors);
+            d.resize(nr_neighbors);
+        }
+        vector<he> local;
+        int begin = -1;
+
+        // static schedule, so the points of each thread are consecutive
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int i=0; i<V; ++i)
+        {
+            if ( begin < 0 ) begin = i;
+            double *p = coords + 3*i;
+            int nret;
 
-            if ( nr_neighbors > 0 && nr_neighbors < nret )
+            if ( radius < 0 )
+            {
+                nret = t.FindKClosest(p, nr_neighbors, numeric_limits<double>::max(),
+                                      &n[0], &d[0], thread_num);
+            }
+            else
             {
-                random_shuffle(n, n+nret);
-                nret = nr_neighbors;
+                nret = t.FindInRadius(p, sqradius, n, d, thread_num);
+                total += nret;
+
+                if ( nr_neighbors > 0 && nr_neighbors < nret )
+                {
+                    // partial Fisher-Yates shuffle of the first nr_neighbors;
+                    // random_shuffle used the global rand() state, which is
+                    // not thread safe, so the subset differs from the one it
+                    // picked, but it is reproducible for any number of threads
+                    unsigned long long state = (i + 1) * 0x9E3779B97F4A7C15ULL;
+                    for (int j=0; j<nr_neighbors; ++j)
+                    {
+                        int r = j + next_random(state) % (nret - j);
+                        swap(n[j], n[r]);
+                    }
+                    nret = nr_neighbors;
+                }
             }
 
+            int count = 0;
             for (int j=0; j<nret; ++j)
             {
-                if ( n[j] == (int)i ) continue;
+                int x = (n[j] - coords) / 3;
+                if ( x == i ) continue;
 
                 he e;
-                e.x = n[j];
-                e.w = weight(points[i], points[n[j]]);
+                e.x = x;
+                e.w = weight(points[i], points[x]);
 
-                adjency_list[i].push_back(e);
+                local.push_back(e);
+                count++;
             }
+            degree[i] = count;
+        }
 
-            delete[] n;
-            delete[] d;
-            if ( TMP==0 )
-            {
-                TMP = MOD;
-                cout << "Point " << i << "/" << V << ", or "<< (i*100.0 / V) << "%\r"; cout.flush();
-            }
-            TMP --;
+#ifdef _OPENMP
+#pragma omp single
+#endif
+        {
+            first[0] = 0;
+            for (int i=0; i<V; ++i)
+                first[i+1] = first[i] + degree[i];
+            adjacency.resize(first[V]);
         }
-        cout << "Average nr of neighbors: " << (float) total / points.size() << endl;
 
+        if ( begin >= 0 )
+            copy(local.begin(), local.end(), adjacency.begin() + first[begin]);
     }
 
-    annDeallocPts(pa);
+    if ( radius >= 0 && V > 0 )
+        cout << "Average nr of neighbors: " << (float) total / V << endl;
+
+    delete[] pa;
+    delete[] coords;
 }
 
 static double gauss(double x, double miu, double sigma)
@@ -170,45 +218,45 @@ string tostr(int x)
 
 void FHGraph::do_gauss(double sigma)
 {
-    edges.reserve( V * nr_neighbors);
-    list<he>::iterator k, j;
-    vector<double> gauss_weight, edge_weight;
-    edge e;
-#pragma omp parallel for private(j, k, e, gauss_weight, edge_weight) schedule(dynamic)
-    for (int i=0; i<V; ++i)
-    {
-        for (j=adjency_list[i].begin();
-             j!=adjency_list[i].end();
-             j++)
-        {
-
-            gauss_weight.clear();
-            edge_weight.clear();
-
-            for (k=adjency_list[i].begin();
-                 k!=adjency_list[i].end();
-                 ++k)
-            {
-                gauss_weight.push_back(gauss(k->w, j->w, sigma));
-                edge_weight.push_back(k->w);
-            }
-            for (k=adjency_list[j->x].begin();
-                 k!=adjency_list[j->x].end();
-                 ++k)
-            {
-                gauss_weight.push_back(gauss(k->w, j->w, sigma));
-                edge_weight.push_back(k->w);
-            }
-            normalize(gauss_weight);
+    E = adjacency.size();
+    edges = new edge[E];
 
-            e.a = i; e.b = j->x;
-            e.w = 0;
-            for (size_t k=0; k<edge_weight.size(); ++k)
-                e.w += gauss_weight[k] * edge_weight[k];
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+    {
+        vector<double> gauss_weight, edge_weight;
 
-#pragma omp critical
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1000)
+#endif
+        for (int i=0; i<V; ++i)
+        {
+            for (int j=first[i]; j<first[i+1]; ++j)
             {
-                edges.push_back(e);
+                const he &ej = adjacency[j];
+
+                gauss_weight.clear();
+                edge_weight.clear();
+
+                for (int k=first[i]; k<first[i+1]; ++k)
+                {
+                    gauss_weight.push_back(gauss(adjacency[k].w, ej.w, sigma));
+                    edge_weight.push_back(adjacency[k].w);
+                }
+                for (int k=first[ej.x]; k<first[ej.x+1]; ++k)
+                {
+                    gauss_weight.push_back(gauss(adjacency[k].w, ej.w, sigma));
+                    edge_weight.push_back(adjacency[k].w);
+                }
+                normalize(gauss_weight);
+
+                edge &e = edges[j];
+                e.a = i; e.b = ej.x;
+                e.w = 0;
+                for (size_t k=0; k<edge_weight.size(); ++k)
+                    e.w += gauss_weight[k] * edge_weight[k];
             }
         }
     }
@@ -216,27 +264,22 @@ void FHGraph::do_gauss(double sigma)
 
 void FHGraph::without_gauss()
 {
-    edges.reserve( V * nr_neighbors);
-    list<he>::iterator j;
-    edge e;
+    E = adjacency.size();
+    edges = new edge[E];
 
     for (int i=0; i<V; ++i)
     {
-        for (j=adjency_list[i].begin();
-             j!=adjency_list[i].end();
-             j++)
+        for (int j=first[i]; j<first[i+1]; ++j)
         {
-            e.a = i; e.b = j->x; e.w = j->w;
-            edges.push_back(e);
+            edges[j].a = i; edges[j].b = adjacency[j].x; edges[j].w = adjacency[j].w;
         }
     }
 }
 
 edge* FHGraph::getGraph()
 {
-    edge* ret = new edge[edges.size()];
-    for (size_t i=0; i<edges.size(); ++i)
-        ret[i] = edges[i];
+    edge* ret = edges;
+    edges = 0;
     return ret;
 }
 
@@ -252,18 +295,14 @@ int FHGraph::getNumPoints()
 
 int FHGraph::getNumEdges()
 {
-    return edges.size();
-}
-
-template<typename T>
-void vectorFree(T& t) {
-    T tmp;
-    t.swap(tmp);
+    return E;
 }
 
 void FHGraph::dispose() {
-    vectorFree(edges);
+    delete[] edges;
+    edges = 0;
     vectorFree(points);
-    vectorFree(adjency_list);
+    vectorFree(first);
+    vectorFree(adjacency);
 }
 
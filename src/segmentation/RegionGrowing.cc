@@ -0,0 +1,492 @@
+/**
+  * Point Cloud Segmentation by Region Growing over Voxels
+  *
+  * Copyright (C) Jacobs University Bremen
+  *
+  * Released under the GPL version 3.
+  *
+  */
+
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <segmentation/RegionGrowing.h>
+#include <slam6d/globals.icc>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+static inline bool isFinite(const double* p)
+{
+    return fabs(p[0]) <= DBL_MAX && fabs(p[1]) <= DBL_MAX && fabs(p[2]) <= DBL_MAX;
+}
+
+/**
+ * Sums over the points of a voxel for fitting a plane.
+ */
+struct VoxelSums {
+    double n;
+    double s[3];
+    double ss[6];   // xx xy xz yy yz zz
+    double reflectance;
+
+    void reset() {
+        n = 0;
+        reflectance = 0;
+        for (int k = 0; k < 3; ++k) s[k] = 0;
+        for (int k = 0; k < 6; ++k) ss[k] = 0;
+    }
+
+    void add(const double* p) {
+        n++;
+        s[0] += p[0]; s[1] += p[1]; s[2] += p[2];
+        ss[0] += p[0]*p[0]; ss[1] += p[0]*p[1]; ss[2] += p[0]*p[2];
+        ss[3] += p[1]*p[1]; ss[4] += p[1]*p[2]; ss[5] += p[2]*p[2];
+    }
+
+    void add(const VoxelSums& o) {
+        n += o.n;
+        reflectance += o.reflectance;
+        for (int k = 0; k < 3; ++k) s[k] += o.s[k];
+        for (int k = 0; k < 6; ++k) ss[k] += o.ss[k];
+    }
+};
+
+RegionGrowing::RegionGrowing(const RegionGrowingParams& params) :
+    params( params )
+{
+    cosAngle = cos(rad(params.maxAngle));
+    useReflectance = false;
+    layer = 0;
+}
+
+void RegionGrowing::computeBounds(const DataXYZ& xyz)
+{
+    double max[3];
+    for (int k = 0; k < 3; ++k) {
+        min[k] = HUGE_VAL;
+        max[k] = -HUGE_VAL;
+    }
+    for (unsigned int i = 0; i < xyz.size(); ++i) {
+        const double* p = xyz[i];
+        if (!isFinite(p)) continue;
+        for (int k = 0; k < 3; ++k) {
+            if (p[k] < min[k]) min[k] = p[k];
+            if (p[k] > max[k]) max[k] = p[k];
+        }
+    }
+
+    blockVoxels = (int)(params.blockSize / params.voxelSize + 0.5);
+    if (blockVoxels < 1) blockVoxels = 1;
+    for (int k = 0; k < 3; ++k) {
+        if (min[k] > max[k]) {
+            voxels[k] = 0;
+            blocks[k] = 0;
+            continue;
+        }
+        voxels[k] = (long long)((max[k] - min[k]) / params.voxelSize) + 1;
+        blocks[k] = (int)((voxels[k] + blockVoxels - 1) / blockVoxels);
+    }
+}
+
+bool RegionGrowing::voxelOf(const double* p, long long v[3]) const
+{
+    if (!isFinite(p)) return false;
+    for (int k = 0; k < 3; ++k) {
+        v[k] = (long long)((p[k] - min[k]) / params.voxelSize);
+        if (v[k] >= voxels[k]) v[k] = voxels[k] - 1;
+    }
+    return true;
+}
+
+long long RegionGrowing::voxelKey(long long x, long long y, long long z) const
+{
+    return (x * voxels[1] + y) * voxels[2] + z;
+}
+
+bool RegionGrowing::compatible(const Voxel& a, const Voxel& b) const
+{
+    if (useReflectance && fabs(a.reflectance - b.reflectance) > params.maxReflectance)
+        return false;
+    if (!a.hasNormal || !b.hasNormal)
+        return false;
+    return fabs(a.normal[0]*b.normal[0] + a.normal[1]*b.normal[1] + a.normal[2]*b.normal[2]) >= cosAngle;
+}
+
+void RegionGrowing::growBlock(const DataXYZ& xyz, const DataReflectance& reflectance,
+                              const unsigned int* indices, int n, Block& block) const
+{
+    // sort the points into their voxels
+    vector< pair<long long, unsigned int> > keyed(n);
+    for (int i = 0; i < n; ++i) {
+        long long v[3];
+        voxelOf(xyz[indices[i]], v);
+        keyed[i] = make_pair(voxelKey(v[0], v[1], v[2]), indices[i]);
+    }
+    sort(keyed.begin(), keyed.end());
+
+    vector<Voxel> voxel;
+    vector<long long> keys;
+    vector<VoxelSums> sums;
+    for (int i = 0; i < n; ) {
+        int j = i;
+        VoxelSums s;
+        s.reset();
+        while (j < n && keyed[j].first == keyed[i].first) {
+            s.add(xyz[keyed[j].second]);
+            if (useReflectance) s.reflectance += reflectance[keyed[j].second];
+            ++j;
+        }
+        Voxel v;
+        v.key = keyed[i].first;
+        v.first = i;
+        v.count = j - i;
+        v.reflectance = (float)(s.reflectance / s.n);
+        v.segment = -1;
+        voxel.push_back(v);
+        keys.push_back(v.key);
+        sums.push_back(s);
+        i = j;
+    }
+
+    const long long plane = voxels[1] * voxels[2];
+    const int nv = voxel.size();
+    vector<int> neighbors;
+    neighbors.reserve(26);
+
+    // fit the normals to the points of each voxel and its neighbors
+    for (int i = 0; i < nv; ++i) {
+        long long x = voxel[i].key / plane, y = (voxel[i].key / voxels[2]) % voxels[1], z = voxel[i].key % voxels[2];
+        VoxelSums s = sums[i];
+        for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy)
+                for (int dz = -1; dz <= 1; ++dz) {
+                    if (!dx && !dy && !dz) continue;
+                    long long nx = x + dx, ny = y + dy, nz = z + dz;
+                    if (nx < 0 || ny < 0 || nz < 0 || nx >= voxels[0] || ny >= voxels[1] || nz >= voxels[2]) continue;
+                    vector<long long>::const_iterator it = lower_bound(keys.begin(), keys.end(), voxelKey(nx, ny, nz));
+                    if (it != keys.end() && *it == voxelKey(nx, ny, nz))
+                        s.add(sums[it - keys.begin()]);
+                }
+
+        voxel[i].hasNormal = false;
+        if (s.n < 3) continue;
+        double m[3] = { s.s[0] / s.n, s.s[1] / s.n, s.s[2] / s.n };
+        double C[3][3], eval[3], evec[3][3];
+        C[0][0] = s.ss[0] / s.n - m[0]*m[0];
+        C[0][1] = C[1][0] = s.ss[1] / s.n - m[0]*m[1];
+        C[0][2] = C[2][0] = s.ss[2] / s.n - m[0]*m[2];
+        C[1][1] = s.ss[3] / s.n - m[1]*m[1];
+        C[1][2] = C[2][1] = s.ss[4] / s.n - m[1]*m[2];
+        C[2][2] = s.ss[5] / s.n - m[2]*m[2];
+        EigenSym3(C, eval, evec);
+        // collinear points do not define a plane
+        if (eval[2] <= 0 || eval[1] <= 1e-9 * eval[2]) continue;
+        for (int k = 0; k < 3; ++k) voxel[i].normal[k] = evec[0][k];
+        voxel[i].hasNormal = true;
+    }
+
+    // grow the regions over the 26-neighborhood of the voxels
+    int nrSegments = 0;
+    vector<int> stack;
+    for (int i = 0; i < nv; ++i) {
+        if (voxel[i].segment >= 0) continue;
+        voxel[i].segment = nrSegments;
+        stack.push_back(i);
+        while (!stack.empty()) {
+            int c = stack.back();
+            stack.pop_back();
+            long long x = voxel[c].key / plane, y = (voxel[c].key / voxels[2]) % voxels[1], z = voxel[c].key % voxels[2];
+            for (int dx = -1; dx <= 1; ++dx)
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dz = -1; dz <= 1; ++dz) {
+                        if (!dx && !dy && !dz) continue;
+                        long long nx = x + dx, ny = y + dy, nz = z + dz;
+                        if (nx < 0 || ny < 0 || nz < 0 || nx >= voxels[0] || ny >= voxels[1] || nz >= voxels[2]) continue;
+                        long long key = voxelKey(nx, ny, nz);
+                        vector<long long>::const_iterator it = lower_bound(keys.begin(), keys.end(), key);
+                        if (it == keys.end() || *it != key) continue;
+                        int w = it - keys.begin();
+                        if (voxel[w].segment < 0 && compatible(voxel[c], voxel[w])) {
+                            voxel[w].segment = nrSegments;
+                            stack.push_back(w);
+                        }
+                    }
+        }
+        nrSegments++;
+    }
+
+    // group the points by region
+    block.nrSegments = nrSegments;
+    block.segmentStart.assign(nrSegments + 1, 0);
+    for (int i = 0; i < nv; ++i)
+        block.segmentStart[voxel[i].segment + 1] += voxel[i].count;
+    for (int s = 0; s < nrSegments; ++s)
+        block.segmentStart[s + 1] += block.segmentStart[s];
+    vector<int> next(block.segmentStart.begin(), block.segmentStart.end() - 1);
+    block.points.resize(n);
+    for (int i = 0; i < nv; ++i)
+        for (int j = voxel[i].first; j < voxel[i].first + voxel[i].count; ++j)
+            block.points[next[voxel[i].segment]++] = keyed[j].second;
+
+    // keep the voxels on the faces of the block for merging
+    block.border.clear();
+    for (int i = 0; i < nv; ++i) {
+        long long c[3] = { voxel[i].key / plane, (voxel[i].key / voxels[2]) % voxels[1], voxel[i].key % voxels[2] };
+        for (int k = 0; k < 3; ++k) {
+            long long l = c[k] % blockVoxels;
+            if (l == 0 || l == blockVoxels - 1) {
+                block.border.push_back(voxel[i]);
+                break;
+            }
+        }
+    }
+}
+
+const RegionGrowing::Voxel* RegionGrowing::findBorder(const Block& block, long long key) const
+{
+    int lo = 0, hi = block.border.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (block.border[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < (int)block.border.size() && block.border[lo].key == key)
+        return &block.border[lo];
+    return 0;
+}
+
+void RegionGrowing::mergeBorders(const vector<Block>& current, const vector<int>& currentAt,
+                                 const vector<Block>& previous, const vector<int>& previousAt)
+{
+    const long long plane = voxels[1] * voxels[2];
+    for (int b = 0; b < (int)current.size(); ++b) {
+        const Block& block = current[b];
+        for (size_t i = 0; i < block.border.size(); ++i) {
+            const Voxel& v = block.border[i];
+            long long x = v.key / plane, y = (v.key / voxels[2]) % voxels[1], z = v.key % voxels[2];
+            for (int dx = -1; dx <= 1; ++dx)
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dz = -1; dz <= 1; ++dz) {
+                        if (!dx && !dy && !dz) continue;
+                        long long nx = x + dx, ny = y + dy, nz = z + dz;
+                        if (nx < 0 || ny < 0 || nz < 0 || nx >= voxels[0] || ny >= voxels[1] || nz >= voxels[2]) continue;
+                        int bx = nx / blockVoxels, by = ny / blockVoxels, bz = nz / blockVoxels;
+                        int at = by * blocks[2] + bz;
+
+                        // each pair of blocks of this layer is merged once,
+                        // the next layer merges with this one
+                        const Block* other;
+                        if (bx == layer) {
+                            if (currentAt[at] <= b) continue;
+                            other = &current[currentAt[at]];
+                        } else if (bx == layer - 1) {
+                            if (previousAt[at] < 0) continue;
+                            other = &previous[previousAt[at]];
+                        } else {
+                            continue;
+                        }
+
+                        const Voxel* w = findBorder(*other, voxelKey(nx, ny, nz));
+                        if (w && compatible(v, *w))
+                            join(block.base + v.segment, other->base + w->segment);
+                    }
+        }
+    }
+}
+
+int RegionGrowing::find(int x)
+{
+    int y = x;
+    while (y != parent[y])
+        y = parent[y];
+    while (x != y) {
+        int next = parent[x];
+        parent[x] = y;
+        x = next;
+    }
+    return y;
+}
+
+void RegionGrowing::join(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+    if (rank[a] < rank[b]) swap(a, b);
+    parent[b] = a;
+    if (rank[a] == rank[b]) rank[a]++;
+    lastLayer[a] = max(lastLayer[a], lastLayer[b]);
+
+    // the root keeps the larger buffer
+    if (members[a].size() < members[b].size()) members[a].swap(members[b]);
+    members[a].insert(members[a].end(), members[b].begin(), members[b].end());
+    vector<unsigned int>().swap(members[b]);
+}
+
+/**
+ * Renumbers the regions after a layer has been merged and the complete
+ * regions have been written. Only the open roots and the regions of the
+ * current layer are kept, the next layer merges with nothing else. So the
+ * forest does not grow with the number of regions of the scan.
+ */
+void RegionGrowing::compact(vector<Block>& current, int firstCurrent, vector<int>& open)
+{
+    const int n = parent.size();
+    vector<int> newId(n, -1);
+    int next = 0;
+    for (size_t i = 0; i < open.size(); ++i)
+        if (open[i] < firstCurrent) newId[open[i]] = next++;
+    for (int id = firstCurrent; id < n; ++id)
+        newId[id] = next++;
+
+    // the root of a kept region is open, hence kept as well
+    vector<int> newParent(next), newRank(next), newLastLayer(next);
+    vector< vector<unsigned int> > newMembers(next);
+    for (int id = 0; id < n; ++id) {
+        int m = newId[id];
+        if (m < 0) continue;
+        newParent[m] = newId[find(id)];
+        newRank[m] = rank[id];
+        newLastLayer[m] = lastLayer[id];
+        newMembers[m].swap(members[id]);
+    }
+    parent.swap(newParent);
+    rank.swap(newRank);
+    lastLayer.swap(newLastLayer);
+    members.swap(newMembers);
+
+    for (size_t i = 0; i < open.size(); ++i)
+        open[i] = newId[open[i]];
+    for (size_t i = 0; i < current.size(); ++i)
+        current[i].base = newId[current[i].base];
+}
+
+int RegionGrowing::segment(const DataXYZ& xyz, const DataReflectance& reflectance, SegmentWriter& writer)
+{
+    const unsigned int n = xyz.size();
+    useReflectance = params.maxReflectance >= 0 && n > 0 && reflectance.size() == n;
+    parent.clear();
+    rank.clear();
+    lastLayer.clear();
+    members.clear();
+
+    computeBounds(xyz);
+    if (voxels[0] == 0) return 0;
+
+    // sort the point indices into the layers of blocks along x
+    long long v[3];
+    vector<unsigned int> layerStart(blocks[0] + 1, 0);
+    for (unsigned int i = 0; i < n; ++i)
+        if (voxelOf(xyz[i], v))
+            layerStart[v[0] / blockVoxels + 1]++;
+    for (int l = 0; l < blocks[0]; ++l)
+        layerStart[l + 1] += layerStart[l];
+    vector<unsigned int> order(layerStart[blocks[0]]);
+    {
+        vector<unsigned int> next(layerStart.begin(), layerStart.end() - 1);
+        for (unsigned int i = 0; i < n; ++i)
+            if (voxelOf(xyz[i], v))
+                order[next[v[0] / blockVoxels]++] = i;
+    }
+
+    const int layerBlocks = blocks[1] * blocks[2];
+    vector<Block> current, previous;
+    vector<int> currentAt(layerBlocks, -1), previousAt(layerBlocks, -1);
+    vector<unsigned int> blockStart(layerBlocks + 1), blockOrder;
+    vector<int> open, stillOpen;
+    int written = 0;
+
+    for (layer = 0; layer <= blocks[0]; ++layer) {
+        const int firstCurrent = parent.size();
+        if (layer < blocks[0]) {
+            // sort the points of the layer into its blocks
+            const unsigned int begin = layerStart[layer], end = layerStart[layer + 1];
+            fill(blockStart.begin(), blockStart.end(), 0);
+            for (unsigned int j = begin; j < end; ++j) {
+                voxelOf(xyz[order[j]], v);
+                blockStart[(v[1] / blockVoxels) * blocks[2] + v[2] / blockVoxels + 1]++;
+            }
+            for (int b = 0; b < layerBlocks; ++b)
+                blockStart[b + 1] += blockStart[b];
+            blockOrder.resize(end - begin);
+            vector<unsigned int> next(blockStart.begin(), blockStart.end() - 1);
+            for (unsigned int j = begin; j < end; ++j) {
+                voxelOf(xyz[order[j]], v);
+                blockOrder[next[(v[1] / blockVoxels) * blocks[2] + v[2] / blockVoxels]++] = order[j];
+            }
+
+            current.clear();
+            fill(currentAt.begin(), currentAt.end(), -1);
+            for (int b = 0; b < layerBlocks; ++b) {
+                if (blockStart[b + 1] == blockStart[b]) continue;
+                currentAt[b] = current.size();
+                current.push_back(Block());
+                current.back().by = b / blocks[2];
+                current.back().bz = b % blocks[2];
+            }
+
+#ifdef _OPENMP
+            omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < (int)current.size(); ++i) {
+                int b = current[i].by * blocks[2] + current[i].bz;
+                growBlock(xyz, reflectance, &blockOrder[blockStart[b]],
+                          blockStart[b + 1] - blockStart[b], current[i]);
+            }
+
+            // the regions of the blocks get consecutive ids
+            for (size_t i = 0; i < current.size(); ++i) {
+                Block& block = current[i];
+                block.base = parent.size();
+                for (int s = 0; s < block.nrSegments; ++s) {
+                    int id = block.base + s;
+                    parent.push_back(id);
+                    rank.push_back(0);
+                    lastLayer.push_back(layer);
+                    members.push_back(vector<unsigned int>(block.points.begin() + block.segmentStart[s],
+                                                           block.points.begin() + block.segmentStart[s + 1]));
+                    open.push_back(id);
+                }
+                vector<unsigned int>().swap(block.points);
+                vector<int>().swap(block.segmentStart);
+            }
+
+            mergeBorders(current, currentAt, previous, previousAt);
+        }
+
+        // regions that do not reach into this layer are complete
+        stillOpen.clear();
+        for (size_t i = 0; i < open.size(); ++i) {
+            int id = open[i];
+            if (find(id) != id) continue;
+            if (lastLayer[id] >= layer) {
+                stillOpen.push_back(id);
+                continue;
+            }
+            if (members[id].size() >= params.minSize && !members[id].empty()) {
+                sort(members[id].begin(), members[id].end());
+                writer.write(members[id]);
+                written++;
+            }
+            vector<unsigned int>().swap(members[id]);
+        }
+        open.swap(stillOpen);
+        compact(current, firstCurrent, open);
+
+        previous.swap(current);
+        previousAt.swap(currentAt);
+    }
+
+    return written;
+}
@@ -29,7 +29,12 @@ int universe::find(int x) {
     int y = x;
     while (y != elts[y].p)
         y = elts[y].p;
-    elts[x].p = y;
+    // point the whole path at the root
+    while (x != y) {
+        int next = elts[x].p;
+        elts[x].p = y;
+        x = next;
+    }
     return y;
 }
 
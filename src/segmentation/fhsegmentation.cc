@@ -259,13 +259,13 @@ int main(int argc, char** argv)
         for (int i=0; i<nr; ++i)
             clouds.push_back( new vector<Point> );
 
-        map<int, int> components2cloud;
+        vector<int> components2cloud(sgraph.getNumPoints(), -1);
         int kk = 0;
 
         for (int i = 0; i < sgraph.getNumPoints(); ++i)
         {
             int component = segmented->find(i);
-            if ( components2cloud.find(component)==components2cloud.end() )
+            if ( components2cloud[component] < 0 )
             {
                 components2cloud[component] = kk++;
                 clouds[components2cloud[component]]->reserve(segmented->size(component));
@@ -281,6 +281,9 @@ int main(int argc, char** argv)
         outscan += clouds.size();
 
         /// clean up
+        for (size_t i=0; i<clouds.size(); ++i)
+            delete clouds[i];
+        delete segmented;
         sgraph.dispose();
     }
 
@@ -0,0 +1,223 @@
+/**
+  * Point Cloud Segmentation by Region Growing over Voxels
+  *
+  * Copyright (C) Jacobs University Bremen
+  *
+  * Released under the GPL version 3.
+  *
+  * @file regiongrowing.cc
+  */
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <errno.h>
+
+#include <boost/program_options.hpp>
+
+#include <slam6d/io_types.h>
+#include <slam6d/globals.icc>
+#include <slam6d/scan.h>
+#include <scanserver/clientInterface.h>
+
+#include <segmentation/RegionGrowing.h>
+
+#ifdef _MSC_VER
+#define strcasecmp _stricmp
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
+
+namespace po = boost::program_options;
+using namespace std;
+
+/// validate IO types
+void validate(boost::any& v, const std::vector<std::string>& values,
+    IOType*, int) {
+    if (values.size() == 0)
+        throw std::runtime_error("Invalid model specification");
+    string arg = values.at(0);
+    try {
+        v = formatname_to_io_type(arg.c_str());
+    } catch (...) { // runtime_error
+        throw std::runtime_error("Format " + arg + " unknown.");
+    }
+}
+
+/// Parse commandline options
+void parse_options(int argc, char **argv, int &start, int &end, bool &scanserver, int &max_dist, int &min_dist, string &dir,
+                   IOType &iotype, RegionGrowingParams &params)
+{
+    /// ----------------------------------
+    /// set up program commandline options
+    /// ----------------------------------
+    po::options_description cmd_options("Usage: regiongrowing <options> where options are (default values in brackets)");
+    cmd_options.add_options()
+            ("help,?", "Display this help message")
+            ("start,s", po::value<int>(&start)->default_value(0), "Start at scan number <arg>")
+            ("end,e", po::value<int>(&end)->default_value(-1), "Stop at scan number <arg>")
+            ("scanserver,S", po::value<bool>(&scanserver)->default_value(false), "Use the scanserver as an input method")
+            ("format,f", po::value<IOType>(&iotype)->default_value(UOS),
+             "using shared library <arg> for input. (chose format from [uos|uosr|uos_map|"
+             "uos_rgb|uos_frames|uos_map_frames|old|rts|rts_map|ifp|"
+             "riegl_txt|riegl_rgb|riegl_bin|zahn|ply])")
+            ("max,M", po::value<int>(&max_dist)->default_value(-1),"neglegt all data points with a distance larger than <arg> 'units")
+            ("min,m", po::value<int>(&min_dist)->default_value(-1), "neglegt all data points with a distance smaller than <arg> 'units")
+            ("voxel,x", po::value<double>(&params.voxelSize)->default_value(5.0), "Set the side length of the voxels to <arg>")
+            ("block,b", po::value<double>(&params.blockSize)->default_value(500.0), "Process blocks of side length <arg> at once")
+            ("angle,a", po::value<double>(&params.maxAngle)->default_value(10.0), "Join neighboring voxels whose normals differ by at most <arg> degrees")
+            ("reflectance,R", po::value<double>(&params.maxReflectance)->default_value(-1.0), "Join neighboring voxels whose reflectance differs by at most <arg>, ignored if negative")
+            ("minsize,z", po::value<unsigned int>(&params.minSize)->default_value(0), "Keep segments of size at least <arg>")
+            ;
+
+    po::options_description hidden("Hidden options");
+    hidden.add_options()
+        ("input-dir", po::value<string>(&dir), "input dir");
+
+    po::positional_options_description pd;
+    pd.add("input-dir", 1);
+
+    po::options_description all;
+    all.add(cmd_options).add(hidden);
+
+    po::variables_map vmap;
+    po::store(po::command_line_parser(argc, argv).options(all).positional(pd).run(), vmap);
+    po::notify(vmap);
+
+    if (vmap.count("help")) {
+        cout << cmd_options << endl;
+        exit(-1);
+    }
+
+    // read scan path
+    if (dir[dir.length()-1] != '/') dir = dir + "/";
+
+}
+
+/**
+ * Writes each segment to a scan file and a pose file as soon as it is
+ * complete, numbered consecutively over all scans.
+ */
+class SegmentFiles : public SegmentWriter {
+public:
+    SegmentFiles(const string& dir, const DataXYZ& xyz, const double* rPos, const double* rPosTheta, int outnum) :
+        dir(dir), xyz(xyz), rPos(rPos), rPosTheta(rPosTheta), outnum(outnum) {}
+
+    void write(const vector<unsigned int>& points)
+    {
+        string poseFileName = dir + "segments/scan" + to_string(outnum, 3) + ".pose";
+        ofstream posout(poseFileName.c_str());
+        posout << rPos[0] << " "
+               << rPos[1] << " "
+               << rPos[2] << endl
+               << deg(rPosTheta[0]) << " "
+               << deg(rPosTheta[1]) << " "
+               << deg(rPosTheta[2]) << endl;
+        posout.close();
+
+        string scanFileName = dir + "segments/scan" + to_string(outnum, 3) + ".3d";
+        ofstream scanout(scanFileName.c_str());
+        for (size_t k = 0; k < points.size(); k++) {
+            const double* p = xyz[points[k]];
+            scanout << p[0] << " " << p[1] << " " << p[2] << endl;
+        }
+        scanout.close();
+
+        outnum++;
+    }
+
+    int next() const { return outnum; }
+
+private:
+    string dir;
+    const DataXYZ& xyz;
+    const double* rPos;
+    const double* rPosTheta;
+    int outnum;
+};
+
+
+/// =============================================
+/// Main
+/// =============================================
+int main(int argc, char** argv)
+{
+    int start, end;
+    bool scanserver;
+    int max_dist, min_dist;
+    string dir;
+    IOType iotype;
+    RegionGrowingParams params;
+
+    parse_options(argc, argv, start, end, scanserver, max_dist, min_dist,
+                  dir, iotype, params);
+
+    /// ----------------------------------
+    /// Prepare and read scans
+    /// ----------------------------------
+    if (scanserver) {
+        try {
+            ClientInterface::create();
+        } catch(std::runtime_error& e) {
+            cerr << "ClientInterface could not be created: " << e.what() << endl;
+            cerr << "Start the scanserver first." << endl;
+            exit(-1);
+        }
+    }
+
+    /// Make directory for saving the scan segments
+    string segdir = dir + "segments";
+
+#ifdef _MSC_VER
+    int success = mkdir(segdir.c_str());
+#else
+    int success = mkdir(segdir.c_str(), S_IRWXU|S_IRWXG|S_IRWXO);
+#endif
+    if(success == 0) {
+        cout << "Writing segments to " << segdir << endl;
+    } else if(errno == EEXIST) {
+        cout << "WARN: Directory " << segdir << " exists already. Contents will be overwriten" << endl;
+    } else {
+        cerr << "Creating directory " << segdir << " failed" << endl;
+        exit(1);
+    }
+
+    /// Read the scans
+    Scan::openDirectory(scanserver, dir, iotype, start, end);
+    if(Scan::allScans.size() == 0) {
+        cerr << "No scans found. Did you use the correct format?" << endl;
+        exit(-1);
+    }
+
+    /// --------------------------------------------
+    /// Perform segmentation
+    /// --------------------------------------------
+    RegionGrowing growing(params);
+    int outscan = start;
+
+    for(std::vector<Scan*>::iterator it = Scan::allScans.begin(); it != Scan::allScans.end(); ++it) {
+        Scan* scan = *it;
+        scan->setRangeFilter(max_dist, min_dist);
+
+        DataXYZ xyz(scan->get("xyz"));
+        // the reflectance is only read if it is compared
+        DataReflectance reflectance(params.maxReflectance >= 0 ? scan->get("reflectance") : DataPointer(0, 0));
+
+        SegmentFiles files(dir, xyz, scan->get_rPos(), scan->get_rPosTheta(), outscan);
+        int nr = growing.segment(xyz, reflectance, files);
+        cout << "Obtained " << nr << " segment(s)" << endl;
+
+        outscan = files.next();
+    }
+
+    // shutdown everything
+    if (scanserver)
+        ClientInterface::destroy();
+    else
+        Scan::closeDirectory();
+
+    cout << "Normal program end" << endl;
+
+    return 0;
+}
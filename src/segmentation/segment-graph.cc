@@ -9,15 +9,65 @@
   */
 
 #include <segmentation/segment-graph.h>
+#include <string.h>
 
 bool operator<(const edge &a, const edge &b) {
     return a.w < b.w;
 }
 
+/**
+ * Maps the weight to an unsigned integer of the same order. The bits of a
+ * positive float already compare like the float, negative ones are inverted.
+ */
+static inline unsigned int weight_key(float w) {
+    unsigned int k;
+    memcpy(&k, &w, sizeof(k));
+    return (k & 0x80000000u) ? ~k : (k | 0x80000000u);
+}
+
+/**
+ * Sorts the edges by weight with a stable radix sort over the integer keys
+ * of the weights, in three passes of 11 bits. Passes in which all edges
+ * have the same digit are skipped.
+ */
+static void sort_edges(edge *edges, int num_edges) {
+    const int BITS = 11;
+    const int BUCKETS = 1 << BITS;
+    edge *buffer = new edge[num_edges];
+    edge *from = edges, *to = buffer;
+    int *count = new int[BUCKETS];
+
+    for (int shift = 0; shift < 32; shift += BITS) {
+        memset(count, 0, BUCKETS * sizeof(int));
+        for (int i = 0; i < num_edges; i++)
+            count[(weight_key(from[i].w) >> shift) & (BUCKETS - 1)]++;
+
+        if (num_edges == 0 ||
+                count[(weight_key(from[0].w) >> shift) & (BUCKETS - 1)] == num_edges)
+            continue;
+
+        int sum = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            int tmp = count[b];
+            count[b] = sum;
+            sum += tmp;
+        }
+        for (int i = 0; i < num_edges; i++)
+            to[count[(weight_key(from[i].w) >> shift) & (BUCKETS - 1)]++] = from[i];
+
+        std::swap(from, to);
+    }
+
+    if (from != edges)
+        memcpy(edges, from, num_edges * sizeof(edge));
+    delete[] count;
+    delete[] buffer;
+}
+
 universe *segment_graph(int num_vertices, int num_edges, edge *edges,
                         float c) {
     // sort edges by weight
-    std::sort(edges, edges + num_edges);
+    sort_edges(edges, num_edges);
 
     // make a disjoint-set forest
     universe *u = new universe(num_vertices);
@@ -45,6 +95,6 @@ universe *segment_graph(int num_vertices, int num_edges, edge *edges,
     }
 
     // free up
-    delete threshold;
+    delete[] threshold;
     return u;
 }
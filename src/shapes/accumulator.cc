@@ -7,11 +7,22 @@
  *
  */
 
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include "shapes/accumulator.h"
 #include <math.h>
+#include <string.h>
 #include "slam6d/globals.icc"
 #include <iostream>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 #ifdef _MSC_VER
 #define isnan(_X) ((_X) != (_X))
@@ -26,19 +37,231 @@ double* polar2normal(double theta, double phi) {
   return n;
 }
 
+/**
+ * Calculates the rho cells whose center may lie within maxDist of the
+ * distance, scale being the number of rho cells per unit. The range contains
+ * all of them and maybe one more at each end, the cells still have to be
+ * checked. first > last if there are none.
+ */
+static inline void rhoRange(double distance, double maxDist, double scale, int rhoNum, int &first, int &last) {
+  double lo = (distance - maxDist) * scale - 0.5;
+  double hi = (distance + maxDist) * scale - 0.5;
+  // written so that NaN gives an empty range
+  if(!(lo < rhoNum && hi > -1.0)) {
+    first = 1;
+    last = 0;
+    return;
+  }
+  first = lo > 0.0 ? (int)lo : 0;
+  last = hi < rhoNum - 1 ? (int)hi + 1 : rhoNum - 1;
+}
+
+Accumulator::Accumulator() {
+  nrDirections = 0;
+  normals = 0;
+  polars = 0;
+  indices = 0;
+  rhos = 0;
+  counters = 0;
+  cellOffset = 0;
+  rhoStride = 0;
+  nrCounters = 0;
+}
+
+Accumulator::~Accumulator() {
+  delete[] normals;
+  delete[] polars;
+  delete[] indices;
+  delete[] rhos;
+  delete[] counters;
+  delete[] cellOffset;
+}
+
+void Accumulator::initAccumulator(int directions, bool rhoInner) {
+  unsigned int rhoNum = myConfigFileHough.Get_RhoNum();
+  nrDirections = directions;
+  normals = new double[3 * nrDirections];
+  polars = new double[2 * nrDirections];
+  indices = new int[3 * nrDirections];
+
+  rhos = new double[rhoNum];
+  for(unsigned int k = 0; k < rhoNum; k++) {
+    rhos[k] = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
+  }
+
+  nrCounters = (long)nrDirections * rhoNum;
+  counters = new int[nrCounters];
+  memset(counters, 0, nrCounters * sizeof(int));
+
+  cellOffset = new long[nrDirections];
+  rhoStride = rhoInner ? 1 : nrDirections;
+  for(int d = 0; d < nrDirections; d++) {
+    cellOffset[d] = rhoInner ? (long)d * rhoNum : d;
+  }
+}
+
+void Accumulator::resetAccumulator() {
+  count = 0;
+  memset(counters, 0, nrCounters * sizeof(int));
+}
+
+void Accumulator::accumulate(Point p) {
+  double maxDist = myConfigFileHough.Get_MaxPointPlaneDist();
+  double scale = (double)myConfigFileHough.Get_RhoNum() / (double)myConfigFileHough.Get_RhoMax();
+  int rhoNum = myConfigFileHough.Get_RhoNum();
+  for(int d = 0; d < nrDirections; d++) {
+    const double *n = normals + 3 * d;
+    double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
+    int first, last;
+    rhoRange(distance, maxDist, scale, rhoNum, first, last);
+    for(int k = first; k <= last; k++) {
+      if(fabs(distance-rhos[k]) < maxDist) {
+        counter(d, k)++;
+      }
+    }
+  }
+}
+
+void Accumulator::accumulate(const vector<Point> &points) {
+  // the points of one block stay in the cache while all directions are voted
+  const int blockSize = 4096;
+  int nrPoints = (int)points.size();
+  double maxDist = myConfigFileHough.Get_MaxPointPlaneDist();
+  double scale = (double)myConfigFileHough.Get_RhoNum() / (double)myConfigFileHough.Get_RhoMax();
+  int rhoNum = myConfigFileHough.Get_RhoNum();
+  const double *rhoCenters = rhos;
+  const long stride = rhoStride;
+  // number of cells after the first one that may lie within maxDist
+  const int width = (int)(2.0 * maxDist * scale) + 2;
+
+  double *xyz = new double[3 * nrPoints];
+  for(int i = 0; i < nrPoints; i++) {
+    xyz[3*i] = points[i].x;
+    xyz[3*i + 1] = points[i].y;
+    xyz[3*i + 2] = points[i].z;
+  }
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+  {
+    for(int start = 0; start < nrPoints; start += blockSize) {
+      int end = start + blockSize < nrPoints ? start + blockSize : nrPoints;
+      // static schedule: every block hands the same directions to the same
+      // thread, so each counter is only ever written by one thread
+#ifdef _OPENMP
+#pragma omp for schedule(static) nowait
+#endif
+      for(int d = 0; d < nrDirections; d++) {
+        const double n0 = normals[3*d], n1 = normals[3*d + 1], n2 = normals[3*d + 2];
+        int *cells = counters + cellOffset[d];
+        for(int i = start; i < end; i++) {
+          const double *p = xyz + 3 * i;
+          double distance = p[0] * n0 + p[1] * n1 + p[2] * n2;
+          int first, last;
+          rhoRange(distance, maxDist, scale, rhoNum, first, last);
+          if(first > last) continue;
+          // a fixed number of cells without branches, the order of the
+          // points is not known and the branches would be mispredicted
+          last = first + width < rhoNum ? first + width : rhoNum - 1;
+          for(int k = first; k <= last; k++) {
+            cells[k * stride] += fabs(distance-rhoCenters[k]) < maxDist;
+          }
+        }
+      }
+    }
+  }
+
+  delete[] xyz;
+}
+
+bool Accumulator::accumulateUntil(const Point &p, unsigned int peak, int &direction, int &k) {
+  double maxDist = myConfigFileHough.Get_MaxPointPlaneDist();
+  double scale = (double)myConfigFileHough.Get_RhoNum() / (double)myConfigFileHough.Get_RhoMax();
+  int rhoNum = myConfigFileHough.Get_RhoNum();
+  for(int d = 0; d < nrDirections; d++) {
+    const double *n = normals + 3 * d;
+    double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
+    int first, last;
+    rhoRange(distance, maxDist, scale, rhoNum, first, last);
+    for(int l = first; l <= last; l++) {
+      if(fabs(distance-rhos[l]) < maxDist) {
+        unsigned int c = ++counter(d, l);
+        if((c > myConfigFileHough.Get_AccumulatorMax() && c > count*myConfigFileHough.Get_PlaneRatio())
+        || c > peak) {
+          direction = d;
+          k = l;
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+int Accumulator::accumulateMax(const Point &p, int &direction, int &k) {
+  double maxDist = myConfigFileHough.Get_MaxPointPlaneDist();
+  double scale = (double)myConfigFileHough.Get_RhoNum() / (double)myConfigFileHough.Get_RhoMax();
+  int rhoNum = myConfigFileHough.Get_RhoNum();
+  int tmpMax = 0;
+  direction = 0;
+  k = 0;
+  for(int d = 0; d < nrDirections; d++) {
+    const double *n = normals + 3 * d;
+    double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
+    int first, last;
+    rhoRange(distance, maxDist, scale, rhoNum, first, last);
+    for(int l = first; l <= last; l++) {
+      if(fabs(distance-rhos[l]) < maxDist) {
+        int c = ++counter(d, l);
+        if(c > tmpMax) {
+          direction = d;
+          k = l;
+          tmpMax = c;
+        }
+      }
+    }
+  }
+  return tmpMax;
+}
+
 AccumulatorSimple::AccumulatorSimple(ConfigFileHough myCfg) {
  
   count = 0;
   myConfigFileHough = myCfg;
+  initAccumulator(myConfigFileHough.Get_PhiNum() * myConfigFileHough.Get_ThetaNum(), false);
   accumulator = new int**[myConfigFileHough.Get_RhoNum()];
 
   for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
     accumulator[i] = new int*[myConfigFileHough.Get_PhiNum()];
     for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      accumulator[i][j] = new int[myConfigFileHough.Get_ThetaNum()];
-      for(unsigned int k = 0; k < myConfigFileHough.Get_ThetaNum(); k++) {
-        accumulator[i][j][k] = 0;
+      accumulator[i][j] = counters + i * nrDirections + j * myConfigFileHough.Get_ThetaNum();
+    }
+  }
+
+  int d = 0;
+  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
+    //TODO 0.99 vielleicht nicht gut
+    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.99999999999);
+  
+    for(unsigned int j = 0; j < myConfigFileHough.Get_ThetaNum(); j++) {
+      double theta = (j+0.5) * 2*M_PI / myConfigFileHough.Get_ThetaNum();
+      if(theta > 2*M_PI) theta = 2*M_PI;
+      if(phi > M_PI) {
+        phi = M_PI;
       }
+      double *n = normals + 3 * d;
+      n[0] = cos(theta)*sin(phi);
+      n[1] = sin(theta)*sin(phi);
+      n[2] = cos(phi);
+      Normalize3(n);
+      polars[2*d] = theta;
+      polars[2*d + 1] = phi;
+      indices[3*d] = i;
+      indices[3*d + 1] = j;
+      indices[3*d + 2] = 0;
+      d++;
     }
   }
 }
@@ -46,11 +269,7 @@ AccumulatorSimple::AccumulatorSimple(ConfigFileHough myCfg) {
 AccumulatorSimple::~AccumulatorSimple() {
 
   for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
-    for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      delete[] accumulator[i][j];
-    }
     delete[] accumulator[i];
-    
   }
   delete[] accumulator;
   
@@ -94,17 +313,6 @@ void AccumulatorSimple::printAccumulator() {
 
 }
 
-void AccumulatorSimple::resetAccumulator() {
-  count = 0;
-  for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
-    for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      for(unsigned int k = 0; k < myConfigFileHough.Get_ThetaNum(); k++) {
-        accumulator[i][j][k] = 0;
-      }
-    }
-  }
-}
-
 bool AccumulatorSimple::accumulate(double theta, double phi, double rho) {
   count++;
   //cout << phi << " " << theta << " " << rho << " ";
@@ -123,73 +331,16 @@ bool AccumulatorSimple::accumulate(double theta, double phi, double rho) {
   return ((unsigned int)accumulator[rhoindex][phiindex][thetaindex] >= myConfigFileHough.Get_AccumulatorMax());
 }
 
-void AccumulatorSimple::accumulate(Point p) {
-//  cout << p.x << " " << p.y << " " << p.z << endl;
-
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    //TODO 0.99 vielleicht nicht gut
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.99999999999);
-  
-    for(unsigned int j = 0; j < myConfigFileHough.Get_ThetaNum(); j++) {
-      double theta = (j+0.5) * 2*M_PI / myConfigFileHough.Get_ThetaNum();
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-        double n[3];
-        n[0] = cos(theta)*sin(phi);
-        n[1] = sin(theta)*sin(phi);
-        n[2] = cos(phi);
-        Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-        }
-
-      }
-    }
-  }
-
-//  cout << "fertig" << endl;
-  
-}
-
 double* AccumulatorSimple::accumulateRet(Point p) {
   count++;
   // rho theta phi
   double* angles = new double[3]; 
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.9999999);
-  
-    for(unsigned int j = 0; j < myConfigFileHough.Get_ThetaNum(); j++) {
-      double theta = (j+0.5) * 2*M_PI / myConfigFileHough.Get_ThetaNum();
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-        double n[3];
-        n[0] = cos(theta)*sin(phi);
-        n[1] = sin(theta)*sin(phi);
-        n[2] = cos(phi);
-        Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-          if(((unsigned int)accumulator[k][i][j] > myConfigFileHough.Get_AccumulatorMax() && (unsigned int)accumulator[k][i][j] > count*myConfigFileHough.Get_PlaneRatio())
-          || (unsigned int)accumulator[k][i][j] > myConfigFileHough.Get_AccumulatorMax()) { 
-            angles[0] = rho;
-            angles[1] = theta;
-            angles[2] = phi;
-            return angles;
-          }
-        }
-
-      }
-    }
+  int d, k;
+  if(accumulateUntil(p, myConfigFileHough.Get_AccumulatorMax(), d, k)) {
+    angles[0] = rhos[k];
+    angles[1] = polars[2*d];
+    angles[2] = polars[2*d + 1];
+    return angles;
   }
 
   angles[0] = -1;
@@ -199,40 +350,13 @@ double* AccumulatorSimple::accumulateRet(Point p) {
 
 int* AccumulatorSimple::accumulateAPHT(Point p) {
 
-  int tmpInt = 0;
   // rho theta phi
   int* angles = new int[3]; 
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.99999999);
-  
-    for(unsigned int j = 0; j < myConfigFileHough.Get_ThetaNum(); j++) {
-      double theta = (j+0.5) * 2*M_PI / myConfigFileHough.Get_ThetaNum();
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-        double n[3];
-        n[0] = cos(theta)*sin(phi);
-        n[1] = sin(theta)*sin(phi);
-        n[2] = cos(phi);
-        Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-          if(accumulator[k][i][j] > tmpInt) {
-            angles[0] = k;
-            angles[1] = j;
-            angles[2] = i;
-            tmpInt = accumulator[k][i][j];
-          }
-        }
-
-      }
-    }
-  }
-
+  int d, k;
+  accumulateMax(p, d, k);
+  angles[0] = k;
+  angles[1] = indices[3*d + 1];
+  angles[2] = indices[3*d];
   return angles;
   
 }
@@ -357,29 +481,52 @@ AccumulatorBall::AccumulatorBall(ConfigFileHough myCfg) {
   }
 
   
+  int *ballOffset = new int[myConfigFileHough.Get_PhiNum()];
+  for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
+    ballOffset[j] = countCells;
+    countCells += ballNr[j];
+  }
+  initAccumulator(countCells, false);
+
   accumulator = new int**[myConfigFileHough.Get_RhoNum()];
 
   for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
     accumulator[i] = new int*[myConfigFileHough.Get_PhiNum()];
     for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      accumulator[i][j] = new int[ballNr[j]];
-      for(int k = 0; k < ballNr[j]; k++) {
-        accumulator[i][j][k] = 0;
-        countCells++;
+      accumulator[i][j] = counters + i * nrDirections + ballOffset[j];
+    }
+  }
+  delete[] ballOffset;
+
+  int d = 0;
+  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
+    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.999999999);
+    for(int j = 0; j < ballNr[i]; j++) {
+      double theta = (j+0.5) * 2*M_PI / ballNr[i];
+      if(theta > 2*M_PI) theta = 2*M_PI;
+      if(phi > M_PI) {
+        phi = M_PI;
       }
+      double *n = normals + 3 * d;
+      n[0] = cos(theta)*sin(phi);
+      n[1] = sin(theta)*sin(phi);
+      n[2] = cos(phi);
+      Normalize3(n);
+      polars[2*d] = theta;
+      polars[2*d + 1] = phi;
+      indices[3*d] = i;
+      indices[3*d + 1] = j;
+      indices[3*d + 2] = 0;
+      d++;
     }
   }
-  cout << "CountCells " << countCells << endl;
+  cout << "CountCells " << countCells * myConfigFileHough.Get_RhoNum() << endl;
 }
 
 AccumulatorBall::~AccumulatorBall() {
   
   for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
-    for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      delete[] accumulator[i][j];
-    }
     delete[] accumulator[i];
-    
   }
   delete[] accumulator;
   delete[] ballNr;
@@ -419,19 +566,6 @@ void AccumulatorBall::printAccumulator() {
   }
 }
 
-void AccumulatorBall::resetAccumulator() {
-
-  count = 0;
-  for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
-    for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      int bNr = ballNr[j];
-      for(int k = 0; k < bNr; k++) {
-        accumulator[i][j][k] = 0;
-      }
-    }
-  }
-}
-
 bool AccumulatorBall::accumulate(double theta, double phi, double rho) {
   count++;
   int rhoindex = myConfigFileHough.Get_RhoNum() - 1;
@@ -451,68 +585,16 @@ bool AccumulatorBall::accumulate(double theta, double phi, double rho) {
   return ((unsigned int)accumulator[rhoindex][phiindex][thetaindex] >= myConfigFileHough.Get_AccumulatorMax());
 }
 
-void AccumulatorBall::accumulate(Point p) {
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.999999999);
-    for(int j = 0; j < ballNr[i]; j++) {
-      double theta = (j+0.5) * 2*M_PI / ballNr[i];
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-      double n[3];
-      n[0] = cos(theta)*sin(phi);
-      n[1] = sin(theta)*sin(phi);
-      n[2] = cos(phi);
-      Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-        }
-
-      }
-    }
-  }
-
-}
 double* AccumulatorBall::accumulateRet(Point p) {
   count++;
   // rho theta phi
   double* angles = new double[3]; 
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.99999999);
-    for(int j = 0; j < ballNr[i]; j++) {
-      double theta = (j+0.5) * 2*M_PI / ballNr[i];
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-      double n[3];
-      n[0] = cos(theta)*sin(phi);
-      n[1] = sin(theta)*sin(phi);
-      n[2] = cos(phi);
-      Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-          if(
-          ((unsigned int)accumulator[k][i][j] > myConfigFileHough.Get_AccumulatorMax() && 
-          (unsigned int)accumulator[k][i][j] > count*myConfigFileHough.Get_PlaneRatio()) || 
-          (unsigned int)accumulator[k][i][j] > 10*myConfigFileHough.Get_AccumulatorMax()) {
-            angles[0] = rho;
-            angles[0] = rho;
-            angles[1] = theta;
-            angles[2] = phi;
-            return angles;
-          }
-        }
-
-      }
-    }
+  int d, k;
+  if(accumulateUntil(p, 10*myConfigFileHough.Get_AccumulatorMax(), d, k)) {
+    angles[0] = rhos[k];
+    angles[1] = polars[2*d];
+    angles[2] = polars[2*d + 1];
+    return angles;
   }
   angles[0] = -1;
   return angles;
@@ -521,37 +603,12 @@ double* AccumulatorBall::accumulateRet(Point p) {
 int* AccumulatorBall::accumulateAPHT(Point p) {
 
   // rho theta phi
-  int tmpMax = 0;
   int* angles = new int[4]; 
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.9999999999);
-    for(int j = 0; j < ballNr[i]; j++) {
-      double theta = (j+0.5) * 2*M_PI / ballNr[i];
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-      double n[3];
-      n[0] = cos(theta)*sin(phi);
-      n[1] = sin(theta)*sin(phi);
-      n[2] = cos(phi);
-      Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-          if(accumulator[k][i][j] > tmpMax) {
-            angles[1] = k;
-            angles[2] = j;
-            angles[3] = i;
-            angles[0] = tmpMax = accumulator[k][i][j];
-          }
-        }
-
-      }
-    }
-  }
+  int d, k;
+  angles[0] = accumulateMax(p, d, k);
+  angles[1] = k;
+  angles[2] = indices[3*d + 1];
+  angles[3] = indices[3*d];
   return angles;
 }
 
@@ -645,25 +702,48 @@ void AccumulatorBall::peakWindow(int size) {
 
 
 AccumulatorCube::AccumulatorCube(ConfigFileHough myCfg) {
-  int countCells = 0;
   count = 0;
   myConfigFileHough = myCfg;
   nrCells = myConfigFileHough.Get_ThetaNum()/4;
+  initAccumulator(6 * nrCells * nrCells, true);
   accumulator = new int***[6];
   for(int i = 0; i < 6; i++) {
     accumulator[i] = new int**[nrCells];
     for(int j = 0; j < nrCells; j++) {
       accumulator[i][j] = new int*[nrCells];
       for(int k = 0; k < nrCells; k++) {
-        accumulator[i][j][k] = new int[myConfigFileHough.Get_RhoNum()];
-        for(unsigned int l = 0; l < myConfigFileHough.Get_RhoNum(); l++) {
-          accumulator[i][j][k][l] = 0;
-          countCells++;
+        accumulator[i][j][k] = counters + cellOffset[(i * nrCells + j) * nrCells + k];
+      }
+    }
+  }
+
+  int d = 0;
+  for(int i = 0; i < 6; i++) {
+    for(int j = 1; j <= nrCells; j++) {
+      for(int k = 1; k <= nrCells; k++) {
+        buffer_point bptmp;
+        bptmp.face = i + 1;
+        bptmp.i = j;
+        bptmp.j = k;
+
+        double* n = coords_cube_to_s2(bptmp, nrCells);
+        Normalize3(n);
+        double polar[3];
+        for(int l = 0; l < 3; l++) {
+          normals[3*d + l] = n[l];
         }
+        toPolar(n, polar);
+        polars[2*d] = polar[1];
+        polars[2*d + 1] = polar[0];
+        indices[3*d] = i;
+        indices[3*d + 1] = j;
+        indices[3*d + 2] = k;
+        delete[] n;
+        d++;
       }
     }
   }
-  cout << "countCells " << countCells << endl;
+  cout << "countCells " << nrCounters << endl;
 }
 
 AccumulatorCube::~AccumulatorCube() {
@@ -671,9 +751,6 @@ AccumulatorCube::~AccumulatorCube() {
   
   for(unsigned int i = 0; i < 6; i++) {
     for(int j = 0; j < nrCells; j++) {
-      for(int k = 0; k < nrCells; k++) {
-        delete[] accumulator[i][j][k];
-      }
       delete[] accumulator[i][j];
     }
     delete[] accumulator[i];
@@ -1205,19 +1282,6 @@ void AccumulatorCube::printAccumulator() {
 
 }
 
-void AccumulatorCube::resetAccumulator() {
-  count = 0;
-  for(int i = 0; i < 6; i++) {
-    for(int j = 0; j < nrCells; j++) {
-      for(int k = 0; k < nrCells; k++) {
-        for(unsigned int l = 0; l < myConfigFileHough.Get_RhoNum(); l++) {
-          accumulator[i][j][k][l] = 0;
-        }
-      }
-    }
-  }
-}
-
 bool AccumulatorCube::accumulate(double theta, double phi, double rho) {
   count++;
   double n[3];
@@ -1252,68 +1316,16 @@ double* AccumulatorCube::getMax(double &rho, double &theta, double &phi) {
   return result;
 }
 
-void AccumulatorCube::accumulate(Point p) {
-  for(int i = 0; i < 6; i++) {
-    for(int j = 1; j <= nrCells; j++) {
-      for(int k = 1; k <= nrCells; k++) {
-        buffer_point bptmp;
-        bptmp.face = i + 1;
-        bptmp.i = j;
-        bptmp.j = k;
-
-        double* n = coords_cube_to_s2(bptmp, nrCells);
-        Normalize3(n);
-        for(unsigned int l = 0; l < myConfigFileHough.Get_RhoNum(); l++) {
-          double rho = (l + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-          double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-          if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-            accumulator[i][j-1][k-1][l]++;
-          }
-
-        }
-        delete[] n;
-      }
-    }
-  }
-}
-
 double* AccumulatorCube::accumulateRet(Point p) {
   // rho theta phi
   count++;
   double * angles = new double[3];
-  for(int i = 0; i < 6; i++) {
-    for(int j = 1; j <= nrCells; j++) {
-      for(int k = 1; k <= nrCells; k++) {
-        buffer_point bptmp;
-        bptmp.face = i + 1;
-        bptmp.i = j;
-        bptmp.j = k;
-
-        double* n = coords_cube_to_s2(bptmp, nrCells);
-        Normalize3(n);
-        for(unsigned int l = 0; l < myConfigFileHough.Get_RhoNum(); l++) {
-          double rho = (l + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-          double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-          if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-            accumulator[i][j-1][k-1][l]++;
-            if(((unsigned int)accumulator[i][j-1][k-1][l] > myConfigFileHough.Get_AccumulatorMax() 
-            && (unsigned int)accumulator[i][j-1][k-1][l] >
-            count*myConfigFileHough.Get_PlaneRatio()) ||
-          (unsigned int)accumulator[i][j-1][k-1][l] > 10*myConfigFileHough.Get_AccumulatorMax() 
-            ) {
-              double polar[3];
-              toPolar(n, polar);
-              angles[0] = rho;
-              angles[1] = polar[1];
-              angles[2] = polar[0];
-              return angles;
-            }
-          }
-
-        }
-        delete[] n;
-      }
-    }
+  int d, l;
+  if(accumulateUntil(p, 10*myConfigFileHough.Get_AccumulatorMax(), d, l)) {
+    angles[0] = rhos[l];
+    angles[1] = polars[2*d];
+    angles[2] = polars[2*d + 1];
+    return angles;
   }
   angles[0] = -1.0;
   return angles;
@@ -1321,37 +1333,13 @@ double* AccumulatorCube::accumulateRet(Point p) {
 
 int* AccumulatorCube::accumulateAPHT(Point p) {
   // rho theta phi
-  int tmpMax = 0;
   int * angles = new int[4];
-  for(int i = 0; i < 6; i++) {
-    for(int j = 1; j <= nrCells; j++) {
-      for(int k = 1; k <= nrCells; k++) {
-        buffer_point bptmp;
-        bptmp.face = i + 1;
-        bptmp.i = j;
-        bptmp.j = k;
-
-        double* n = coords_cube_to_s2(bptmp, nrCells);
-        Normalize3(n);
-        for(unsigned int l = 0; l < myConfigFileHough.Get_RhoNum(); l++) {
-          double rho = (l + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-          double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-          if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-            accumulator[i][j-1][k-1][l]++;
-            if(accumulator[i][j-1][k-1][l] > tmpMax) {
-              angles[0] = l;
-              angles[1] = i;
-              angles[2] = j;
-              angles[3] = k;
-              tmpMax = accumulator[i][j-1][k-1][l];
-            }
-          }
-
-        }
-        delete[] n;
-      }
-    }
-  }
+  int d, l;
+  accumulateMax(p, d, l);
+  angles[0] = l;
+  angles[1] = indices[3*d];
+  angles[2] = indices[3*d + 1];
+  angles[3] = indices[3*d + 2];
   return angles;
 }
 
@@ -1467,29 +1455,64 @@ AccumulatorBallI::AccumulatorBallI(ConfigFileHough myCfg) {
   cout << "BallNR erzeugt" << endl; 
   */
 
+  int *ballOffset = new int[myConfigFileHough.Get_PhiNum()];
+  for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
+    ballOffset[j] = countCells;
+    countCells += ballNr[j];
+  }
+  initAccumulator(countCells, false);
+
   accumulator = new int**[myConfigFileHough.Get_RhoNum()];
 
   for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
     accumulator[i] = new int*[myConfigFileHough.Get_PhiNum()];
     for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      accumulator[i][j] = new int[ballNr[j]];
-      for(int k = 0; k < ballNr[j]; k++) {
-        accumulator[i][j][k] = 0;
-        countCells++;
+      accumulator[i][j] = counters + i * nrDirections + ballOffset[j];
+    }
+  }
+  delete[] ballOffset;
+
+  int d = 0;
+  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
+    double phi = phi_top_rad + (i-0.5) * rad(step);
+    for(int j = 0; j < ballNr[i]; j++) {
+      double theta = (j+0.5) * 2*M_PI / ballNr[i];
+      if(theta > 2*M_PI) theta = 2*M_PI;
+      if(phi > M_PI) {
+        phi = M_PI;
       }
+      double *n = normals + 3 * d;
+      polars[2*d] = theta;
+      if(i == 0) {
+        n[0] = 0.0;
+        n[1] = 0.0;
+        n[2] = 1.0;
+        polars[2*d + 1] = 0.0;
+      } else if (i == myConfigFileHough.Get_PhiNum() - 1) {
+        n[0] = 0.0;
+        n[1] = 0.0;
+        n[2] = -1.0;
+        polars[2*d + 1] = M_PI;
+      } else {
+        n[0] = cos(theta)*sin(phi);
+        n[1] = sin(theta)*sin(phi);
+        n[2] = cos(phi);
+        Normalize3(n);
+        polars[2*d + 1] = phi;
+      }
+      indices[3*d] = i;
+      indices[3*d + 1] = j;
+      indices[3*d + 2] = 0;
+      d++;
     }
   }
-  cout << "CountCells " << countCells << endl;
+  cout << "CountCells " << countCells * myConfigFileHough.Get_RhoNum() << endl;
 }
 
 AccumulatorBallI::~AccumulatorBallI() {
   
   for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
-    for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      delete[] accumulator[i][j];
-    }
     delete[] accumulator[i];
-    
   }
   delete[] accumulator;
   delete[] ballNr;
@@ -1531,20 +1554,6 @@ void AccumulatorBallI::printAccumulator() {
   }
 }
 
-void AccumulatorBallI::resetAccumulator() {
-
-//TODO
-  count = 0;
-  for(unsigned int i = 0; i < myConfigFileHough.Get_RhoNum(); i++) {
-    for(unsigned int j = 0; j < myConfigFileHough.Get_PhiNum(); j++) {
-      int bNr = ballNr[j];
-      for(int k = 0; k < bNr; k++) {
-        accumulator[i][j][k] = 0;
-      }
-    }
-  }
-}
-
 bool AccumulatorBallI::accumulate(double theta, double phi, double rho) {
 //TODO
   count++;
@@ -1565,78 +1574,16 @@ bool AccumulatorBallI::accumulate(double theta, double phi, double rho) {
   return ((unsigned int)accumulator[rhoindex][phiindex][thetaindex] >= myConfigFileHough.Get_AccumulatorMax());
 }
 
-void AccumulatorBallI::accumulate(Point p) {
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = phi_top_rad + (i-0.5) * rad(step);
-    for(int j = 0; j < ballNr[i]; j++) {
-      double theta = (j+0.5) * 2*M_PI / ballNr[i];
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-      double n[3];
-      if(i == 0) {
-        n[0] = 0.0;
-        n[1] = 0.0;
-        n[2] = 1.0;
-      } else if (i == myConfigFileHough.Get_RhoNum() - 1) {
-        n[0] = 0.0;
-        n[1] = 0.0;
-        n[2] = -1.0;
-      } else {
-        n[0] = cos(theta)*sin(phi);
-        n[1] = sin(theta)*sin(phi);
-        n[2] = cos(phi);
-        Normalize3(n);
-      }
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * (double)myConfigFileHough.Get_RhoMax() / (double)myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-        }
-
-      }
-    }
-  }
-
-}
 double* AccumulatorBallI::accumulateRet(Point p) {
   count++;
-//TODO
   // rho theta phi
   double* angles = new double[3]; 
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.999999999);
-    for(int j = 0; j < ballNr[i]; j++) {
-      double theta = (j+0.5) * 2*M_PI / ballNr[i];
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-      double n[3];
-      n[0] = cos(theta)*sin(phi);
-      n[1] = sin(theta)*sin(phi);
-      n[2] = cos(phi);
-      Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-          if(((unsigned int)accumulator[k][i][j] >
-          myConfigFileHough.Get_AccumulatorMax() && (unsigned
-          int)accumulator[k][i][j] > count*myConfigFileHough.Get_PlaneRatio())  
-          || (unsigned int)accumulator[k][i][j] > 10*myConfigFileHough.Get_AccumulatorMax() ) { 
-            angles[0] = rho;
-            angles[1] = theta;
-            angles[2] = phi;
-            return angles;
-          }
-        }
-
-      }
-    }
+  int d, k;
+  if(accumulateUntil(p, 10*myConfigFileHough.Get_AccumulatorMax(), d, k)) {
+    angles[0] = rhos[k];
+    angles[1] = polars[2*d];
+    angles[2] = polars[2*d + 1];
+    return angles;
   }
   angles[0] = -1;
   return angles;
@@ -1644,39 +1591,13 @@ double* AccumulatorBallI::accumulateRet(Point p) {
 
 int* AccumulatorBallI::accumulateAPHT(Point p) {
 
-//TODO
   // rho theta phi
-  int tmpMax = 0;
   int* angles = new int[4]; 
-  for(unsigned int i = 0; i < myConfigFileHough.Get_PhiNum(); i++) {
-    double phi = (i+0.5) * M_PI / (myConfigFileHough.Get_PhiNum()*0.9999999);
-    for(int j = 0; j < ballNr[i]; j++) {
-      double theta = (j+0.5) * 2*M_PI / ballNr[i];
-      if(theta > 2*M_PI) theta = 2*M_PI;
-      if(phi > M_PI) {
-        phi = M_PI;
-      }
-      double n[3];
-      n[0] = cos(theta)*sin(phi);
-      n[1] = sin(theta)*sin(phi);
-      n[2] = cos(phi);
-      Normalize3(n);
-      for(unsigned int k = 0; k < myConfigFileHough.Get_RhoNum(); k++) {
-        double rho = (k + 0.5) * myConfigFileHough.Get_RhoMax() / myConfigFileHough.Get_RhoNum(); 
-        double distance = p.x * n[0] + p.y * n[1] + p.z * n[2];
-        if(fabs(distance-rho) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-          accumulator[k][i][j]++;
-          if(accumulator[k][i][j] > tmpMax) {
-            angles[1] = k;
-            angles[2] = j;
-            angles[3] = i;
-            angles[0] = tmpMax = accumulator[k][i][j];
-          }
-        }
-
-      }
-    }
-  }
+  int d, k;
+  angles[0] = accumulateMax(p, d, k);
+  angles[1] = k;
+  angles[2] = indices[3*d + 1];
+  angles[3] = indices[3*d];
   return angles;
 }
 
@@ -17,6 +17,7 @@ using namespace NEWMAT;
 #include "shapes/quadtree.h"
 #include <errno.h>
 #include <iterator>
+#include <algorithm>
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -40,6 +41,9 @@ using namespace NEWMAT;
 Hough::Hough(bool q, std::string configFile)
 {
   quiet = q;
+  acc = 0;
+  allPoints = 0;
+  pointTree = 0;
 
   // If the user has specified a configFile, load it
   if(configFile.size() > 0) {
@@ -55,6 +59,7 @@ Hough::Hough(Scan * GlobalScan, bool q, std::string configFile)
 {
  
   quiet = q;
+  pointTree = 0;
   if(configFile.size() > 0) {
     myConfigFileHough.LoadCfg(configFile.c_str());
     if(!quiet) {
@@ -83,6 +88,14 @@ void Hough::SetScan(Scan* scan)
     allPoints->push_back(p);
     }
 
+  remaining.resize(allPoints->size());
+  position.resize(allPoints->size());
+  for(unsigned int i = 0; i < allPoints->size(); i++) {
+    remaining[i] = i;
+    position[i] = i;
+  }
+  pointTree = new SlabTree(*allPoints);
+
   switch(myConfigFileHough.Get_AccumulatorType()) {
     case 0:
       acc = new AccumulatorSimple(myConfigFileHough);
@@ -117,6 +130,7 @@ Hough::~Hough() {
       delete tmp;
   }
   delete acc;
+  delete pointTree;
   delete allPoints;
   
 }
@@ -136,16 +150,16 @@ int Hough::RHT() {
   long start, end;
   start = GetCurrentTimeInMilliSec(); 
   int counter = 0;
-  while( allPoints->size() > stop && 
+  while( remaining.size() > stop && 
           planes.size() < (unsigned int)myConfigFileHough.Get_MaxPlanes() &&
           counter < (int)myConfigFileHough.Get_TrashMax()) { 
-    unsigned int pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
+    unsigned int pint = (int) ((remaining.size())*(rand()/(RAND_MAX+1.0)));
 
-    p1 = (*allPoints)[pint];
-    pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
-    p2 = (*allPoints)[pint];
-    pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
-    p3 = (*allPoints)[pint];
+    p1 = (*allPoints)[remaining[pint]];
+    pint = (int) ((remaining.size())*(rand()/(RAND_MAX+1.0)));
+    p2 = (*allPoints)[remaining[pint]];
+    pint = (int) ((remaining.size())*(rand()/(RAND_MAX+1.0)));
+    p3 = (*allPoints)[remaining[pint]];
 
     // check distance
     if(!distanceOK(p1, p2, p3)) continue;
@@ -191,16 +205,17 @@ int Hough::RHT() {
  * Standard Hough Transform
  */
 void Hough::SHT() {
-  vector<Point>::iterator itr = allPoints->begin();
- 
-  Point p;
   long start, end;
   start = GetCurrentTimeInMilliSec(); 
-  while(itr != allPoints->end()) {
-    p = *(itr);
-    acc->accumulate(p);
-    itr++;
-  } 
+  if(remaining.size() == allPoints->size()) {
+    acc->accumulate(*allPoints);
+  } else {
+    vector<Point> points;
+    for(unsigned int i = 0; i < remaining.size(); i++) {
+      points.push_back((*allPoints)[remaining[i]]);
+    }
+    acc->accumulate(points);
+  }
   end = GetCurrentTimeInMilliSec() - start;
   start = GetCurrentTimeInMilliSec();
   if (!quiet) cout << "Time for SHT: " << end << endl; 
@@ -215,7 +230,7 @@ void Hough::SHT() {
   unsigned int stop = (int)(allPoints->size()/100.0)*myConfigFileHough.Get_MinSizeAllPoints();
   
   while(it != maxlist->end() && 
-        stop < allPoints->size() && 
+        stop < remaining.size() && 
         planes.size() < (unsigned int)myConfigFileHough.Get_MaxPlanes() && 
         (*it)[0] > threshold) {
     int* tmp = (*it);
@@ -240,10 +255,10 @@ void Hough::SHT() {
   * @return points that do not lie on an already detected plane
   */
 double * const* Hough::getPoints(int &size) {
-  size = allPoints->size();
-  double ** returnPoints = new double*[allPoints->size()];
-  for(unsigned int i = 0; i < allPoints->size(); i++) {
-    Point p = (*allPoints)[i];
+  size = remaining.size();
+  double ** returnPoints = new double*[remaining.size()];
+  for(unsigned int i = 0; i < remaining.size(); i++) {
+    Point p = (*allPoints)[remaining[i]];
     returnPoints[i] = new double[3];
     returnPoints[i][0] = p.x;
     returnPoints[i][1] = p.y;
@@ -262,15 +277,15 @@ double * const* Hough::deletePoints(vector<ConvexPlane*> &model, int &size) {
   for(unsigned int i = 0; i < model.size(); i++) {
     deletePoints(model[i]->n, model[i]->rho); 
   }
-  double ** returnPoints = new double*[allPoints->size()];
-  for(unsigned int i = 0; i < allPoints->size(); i++) {
-    Point p = (*allPoints)[i];
+  double ** returnPoints = new double*[remaining.size()];
+  for(unsigned int i = 0; i < remaining.size(); i++) {
+    Point p = (*allPoints)[remaining[i]];
     returnPoints[i] = new double[3];
     returnPoints[i][0] = p.x;
     returnPoints[i][1] = p.y;
     returnPoints[i][2] = p.z;
   }
-  size = allPoints->size();
+  size = remaining.size();
   return returnPoints;
 }
 
@@ -281,22 +296,23 @@ double * const* Hough::deletePoints(vector<ConvexPlane*> &model, int &size) {
 void Hough::PHT() {
   unsigned int stop =
   (int)(allPoints->size()/100.0)*myConfigFileHough.Get_MinSizeAllPoints();
-  bool *voted = new bool[allPoints->size()];
-  for(unsigned int i = 0; i < allPoints->size(); i++) {
+  bool *voted = new bool[remaining.size()];
+  for(unsigned int i = 0; i < remaining.size(); i++) {
     voted[i] = false;
   }
 
   unsigned int i = 0;
+  vector<Point> samples;
   while(i < stop && planes.size() < (unsigned int)myConfigFileHough.Get_MaxPlanes()) {
-    unsigned int pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
+    unsigned int pint = (int) ((remaining.size())*(rand()/(RAND_MAX+1.0)));
 
     if(!voted[i]) {
-      Point p = (*allPoints)[pint];
-      acc->accumulate(p);
+      samples.push_back((*allPoints)[remaining[pint]]);
       i++;
     }
     
   }
+  acc->accumulate(samples);
   // List of Maxima
   if(myConfigFileHough.Get_PeakWindow()) {
     acc->peakWindow(myConfigFileHough.Get_WindowSize());
@@ -308,7 +324,7 @@ void Hough::PHT() {
   multiset<int*, maxcompare>::iterator it = maxlist->begin();
   int threshold = ((*it)[0] * myConfigFileHough.Get_PlaneRatio());
   while(it != maxlist->end() && 
-        stop < allPoints->size() && 
+        stop < remaining.size() && 
         planes.size() < (unsigned int)myConfigFileHough.Get_MaxPlanes() && 
         (*it)[0] > threshold) {
      
@@ -335,18 +351,18 @@ void Hough::PHT() {
 void Hough::PPHT() {
   unsigned int stop =
   (int)(allPoints->size()/100.0)*myConfigFileHough.Get_MinSizeAllPoints();
-  while(stop < allPoints->size() && 
+  while(stop < remaining.size() && 
         planes.size() < (unsigned int)myConfigFileHough.Get_MaxPlanes()) {
-    bool *voted = new bool[allPoints->size()];
-    for(unsigned int i = 0; i < allPoints->size(); i++) {
+    bool *voted = new bool[remaining.size()];
+    for(unsigned int i = 0; i < remaining.size(); i++) {
       voted[i] = false;
     }
    
     unsigned int pint;
     do { 
-      pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
+      pint = (int) ((remaining.size())*(rand()/(RAND_MAX+1.0)));
 
-      Point p = (*allPoints)[pint];
+      Point p = (*allPoints)[remaining[pint]];
       if(!voted[pint]) {
         double * angles = acc->accumulateRet(p);
         if(angles[0] > -0.0001) {
@@ -383,8 +399,8 @@ void Hough::APHT() {
     mergelist = vector<int*>(); 
     multiset<int*,valuecompare> maxlist = multiset<int*,valuecompare>();
     for(int i = 0; i < 10; i++) {
-      unsigned int pint = (int) (((*allPoints).size())*(rand()/(RAND_MAX+1.0)));
-      Point p = (*allPoints)[pint];
+      unsigned int pint = (int) ((remaining.size())*(rand()/(RAND_MAX+1.0)));
+      Point p = (*allPoints)[remaining[pint]];
       int * max = acc->accumulateAPHT(p);
       // store the maximum cell touched by the HT
       maxlist.insert(max);
@@ -584,31 +600,80 @@ bool Hough::calculatePlane(Point p1, Point p2, Point p3, double &theta, double &
   return true;
 }
 
+/**
+  * Collects the remaining points whose distance to the given plane is below
+  * MaxPointPlaneDist. The points are looked up in the k-d tree and sorted
+  * into the order in which they are sampled.
+  *
+  * @param n normal vector of the plane
+  * @param rho distance between plane and origin
+  * @param band the indices of the points in allPoints
+  */
+void Hough::planeBand(double * n, double rho, vector<unsigned int> &band) {
+  pointTree->query(n, rho, myConfigFileHough.Get_MaxPointPlaneDist(), band);
+  for(unsigned int i = 0; i < band.size(); i++) {
+    band[i] = position[band[i]];
+  }
+  sort(band.begin(), band.end());
+  for(unsigned int i = 0; i < band.size(); i++) {
+    band[i] = remaining[band[i]];
+  }
+}
+
+/**
+  * Removes the points of a band from the remaining points. The kept points
+  * stay remaining and are moved to the end, all others are removed from the
+  * k-d tree as well.
+  *
+  * @param band the points as returned by planeBand
+  * @param kept the points of the band that stay
+  */
+void Hough::removeBand(const vector<unsigned int> &band, const vector<unsigned int> &kept) {
+  if(band.empty()) return;
+
+  // the band is sorted by position, so the survivors are shifted in one pass
+  unsigned int next = position[band[0]];
+  unsigned int j = 0;
+  for(unsigned int i = next; i < remaining.size(); i++) {
+    if(j < band.size() && remaining[i] == band[j]) {
+      j++;
+    } else {
+      remaining[next] = remaining[i];
+      position[remaining[next]] = next;
+      next++;
+    }
+  }
+  remaining.resize(next);
+
+  for(unsigned int i = 0; i < kept.size(); i++) {
+    position[kept[i]] = remaining.size();
+    remaining.push_back(kept[i]);
+  }
+
+  for(unsigned int i = 0; i < band.size(); i++) {
+    unsigned int id = band[i];
+    if(position[id] >= remaining.size() || remaining[position[id]] != id) {
+      pointTree->remove(id);
+    }
+  }
+}
+
 /**
   * Improved function for point deletion.
   */
 int Hough::deletePointsQuad(double * n, double rho) {
 
-  if (!quiet) cout << allPoints->size() ;
+  if (!quiet) cout << remaining.size() ;
   Normalize3(n);
-  vector<Point> *nallPoints = new vector<Point>();
+
+  vector<unsigned int> band;
+  planeBand(n, rho, band);
 
   vector<Point> planePoints;
   out << n[0] << " " << n[1] << " " << n[2] << " " << rho << " ";
   
-  Point p;
-  vector<Point>::iterator itr = allPoints->begin();
-  
-  while(itr != allPoints->end()) {
-    p = *(itr);
-    // if point close to plane, delete it
-    double distance = p.x * n[0] + p.y * n[1] + p.z*n[2] - rho;
-    if( fabs(distance) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-   
-      planePoints.push_back(p);
-
-    } 
-   itr++;
+  for(unsigned int i = 0; i < band.size(); i++) {
+    planePoints.push_back((*allPoints)[band[i]]);
   }
   double n2[4];
 
@@ -616,37 +681,22 @@ int Hough::deletePointsQuad(double * n, double rho) {
   calcPlane(planePoints, n2);
   out << n2[0] << " " << n2[1] << " " << n2[2] << " " << n2[3] << " " ;
   
-  itr = allPoints->begin();
   planePoints.clear();  
- 
-  while(itr != allPoints->end()) {
-    p = *(itr);
-    // if point close to plane, delete it
-    double distance = p.x * n2[0] + p.y * n2[1] + p.z*n2[2] - n2[3];
-    if( fabs(distance) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-   
-      planePoints.push_back(p);
-
-    } else {
-      nallPoints->push_back(p);
-    }
-   itr++;
-  }
-  delete allPoints;
-  allPoints = nallPoints;
+  planeBand(n2, n2[3], band);
   
-  if (!quiet) cout << "Planepoints " << planePoints.size() << endl;
-  int nr_points = planePoints.size();
+  if (!quiet) cout << "Planepoints " << band.size() << endl;
+  int nr_points = band.size();
   // TODO Clustering
   double min_angle = rad(1.0);
   double _phi, _theta;
 	double **pppoints;
 	pppoints = new double*[nr_points];
 
-  for (unsigned int i = 0; i < planePoints.size(); i++) {
-    pppoints[i] = new double[3];
+  for (unsigned int i = 0; i < band.size(); i++) {
+    // the fourth entry refers back to the point
+    pppoints[i] = new double[4];
 
-    Point p(planePoints[i]);
+    Point p((*allPoints)[band[i]]);
     double m[3];
     m[0] = p.x;
     m[1] = p.y;
@@ -670,8 +720,8 @@ int Hough::deletePointsQuad(double * n, double rho) {
     pppoints[i][0] = _phi;
     pppoints[i][1] = _theta;
     pppoints[i][2] = sqrt(p.x*p.x + p.y*p.y + p.z*p.z);
+    pppoints[i][3] = i;
   }
-  planePoints.clear();
 
   QuadTree tree(pppoints, nr_points , 0.3, min_angle);
 	vector<set<double *> > cps;
@@ -685,20 +735,19 @@ int Hough::deletePointsQuad(double * n, double rho) {
       index = i;
     }
   }
+  vector<unsigned int> kept;
   for (unsigned int i = 0; i < cps.size(); i++) {
     for (set<double *>::iterator it = cps[i].begin(); 
         it != cps[i].end(); it++) {
-      Point p;
-      p.x = (*it)[2] * cos( (*it)[1] ) * sin( (*it)[0] );
-      p.y = (*it)[2] * sin( (*it)[1] ) * sin( (*it)[0] );
-      p.z = (*it)[2] * cos( (*it)[0] );
+      unsigned int id = band[(unsigned int)(*it)[3]];
       if ((int)i != index) {
-        allPoints->push_back(p);
+        kept.push_back(id);
       } else {
-        planePoints.push_back(p);
+        planePoints.push_back((*allPoints)[id]);
       }
     }
   }
+  removeBand(band, kept);
 
   double n4[4];
   calcPlane(planePoints, n4);
@@ -728,23 +777,15 @@ int Hough::deletePointsQuad(double * n, double rho) {
 int Hough::deletePoints(double * n, double rho) {
   char direction = ' ';
   Normalize3(n);
-  vector<Point> *nallPoints = new vector<Point>();
+
+  vector<unsigned int> band;
+  planeBand(n, rho, band);
 
   vector<Point> planePoints;
   
   Point p;
-  vector<Point>::iterator itr = allPoints->begin();
- 
-  while(itr != allPoints->end()) {
-    p = *(itr);
-    // if point close to plane, delete it
-    double distance = p.x * n[0] + p.y * n[1] + p.z*n[2] - rho;
-    if( fabs(distance) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-   
-      planePoints.push_back(p);
-
-    } 
-   itr++;
+  for(unsigned int i = 0; i < band.size(); i++) {
+    planePoints.push_back((*allPoints)[band[i]]);
   }
   double n2[4];
   // calculating the best fit plane
@@ -768,8 +809,8 @@ int Hough::deletePoints(double * n, double rho) {
     direction = 'z';
   }
 
-  itr = allPoints->begin();
   planePoints.clear();  
+  planeBand(n2, n2[3], band);
  
   vPtPair planePairs;
   double minx, maxx, miny, maxy;
@@ -777,45 +818,34 @@ int Hough::deletePoints(double * n, double rho) {
   miny = 1000000;
   maxx = -1000000;
   maxy= -1000000;
-  while(itr != allPoints->end()) {
-    p = *(itr);
-    // if point close to plane, delete it
+  for(unsigned int i = 0; i < band.size(); i++) {
+    p = (*allPoints)[band[i]];
+    Point tmp, p2;
     double distance = p.x * n2[0] + p.y * n2[1] + p.z*n2[2] - n2[3];
-    if( fabs(distance) < myConfigFileHough.Get_MaxPointPlaneDist()) {
-   
-      Point tmp, p2;
-      double distance = p.x * n2[0] + p.y * n2[1] + p.z*n2[2] - n2[3];
-      tmp.x = p.x - distance * n2[0];
-      tmp.y = p.y - distance * n2[1];
-      tmp.z = p.z - distance * n2[2];
-      switch(direction) {
-        case 'x': p2.x = tmp.y;
-                  p2.y = tmp.z;
-                  break; 
-        case 'y': p2.x = tmp.x;
-                  p2.y = tmp.z;
-                  break;
-        case 'z': p2.x = tmp.x;
-                  p2.y = tmp.y; 
-                  break;
-        default: cout << "OHOH" << endl;
-      }
-      p2.z = -1;
-      if(p2.x < minx) minx = p2.x; 
-      if(p2.y < miny) miny = p2.y; 
-      if(p2.x > maxx) maxx = p2.x; 
-      if(p2.y > maxy) maxy = p2.y; 
-      PtPair myPair(p,p2);
-      
-      planePairs.push_back(myPair);
-
-    } else {
-      nallPoints->push_back(p);
+    tmp.x = p.x - distance * n2[0];
+    tmp.y = p.y - distance * n2[1];
+    tmp.z = p.z - distance * n2[2];
+    switch(direction) {
+      case 'x': p2.x = tmp.y;
+                p2.y = tmp.z;
+                break; 
+      case 'y': p2.x = tmp.x;
+                p2.y = tmp.z;
+                break;
+      case 'z': p2.x = tmp.x;
+                p2.y = tmp.y; 
+                break;
+      default: cout << "OHOH" << endl;
     }
-    itr++;
+    p2.z = -1;
+    if(p2.x < minx) minx = p2.x; 
+    if(p2.y < miny) miny = p2.y; 
+    if(p2.x > maxx) maxx = p2.x; 
+    if(p2.y > maxy) maxy = p2.y; 
+    PtPair myPair(p,p2);
+    
+    planePairs.push_back(myPair);
   }
-  delete allPoints;
-  allPoints = nallPoints;
 
   int region = -1;
   if(planePairs.size() > 2) {
@@ -824,13 +854,13 @@ int Hough::deletePoints(double * n, double rho) {
   // delete points from this list
   list< double*> point_list;
   
-  vPtPair::iterator vitr;  
   vector<Point> tmp_points;
-  for(vitr = planePairs.begin(); vitr != planePairs.end(); vitr++) {
+  vector<unsigned int> kept;
+  for(unsigned int i = 0; i < planePairs.size(); i++) {
     
   // Case distinction x-z or x-y or y-z
-    p = (*vitr).p1;
-    Point p2 = (*vitr).p2;
+    p = planePairs[i].p1;
+    Point p2 = planePairs[i].p2;
     if(fabs(p2.z - region) < 0.1) {
       double * point = new double[2];
       point[0] = p2.x;
@@ -838,9 +868,10 @@ int Hough::deletePoints(double * n, double rho) {
       point_list.push_back(point);
       tmp_points.push_back(p);
     } else {
-      allPoints->push_back(p);
+      kept.push_back(band[i]);
     }
   }
+  removeBand(band, kept);
   D = calcPlane(tmp_points, n2);
   
   nocluster = false;
@@ -855,7 +886,7 @@ int Hough::deletePoints(double * n, double rho) {
   for(int x = 0; x < 3; x++) {
     rgb[x] = (unsigned char)((255)*(rand()/(RAND_MAX+1.0)));
   }
-  for(itr = tmp_points.begin(); itr != tmp_points.end(); itr++) {
+  for(vector<Point>::iterator itr = tmp_points.begin(); itr != tmp_points.end(); itr++) {
       p = (*itr);
       if(nocluster || maxPlane >= myConfigFileHough.Get_MinPlaneSize()) {
         p.rgb[0] = 0;
@@ -906,7 +937,7 @@ int Hough::deletePoints(double * n, double rho) {
   plane1->pointsize = maxPlane;
   planes.push_back(plane1);
 
-  if(!quiet) cout << "Points left " << allPoints->size() << "\n";
+  if(!quiet) cout << "Points left " << remaining.size() << "\n";
   return maxPlane;
   // ENDE
 }
@@ -1137,12 +1168,9 @@ void Hough::writePlanePoints(string filename) {
     out << p.x << " " << p.y << " " << p.z << " " << (int)p.rgb[0] << " " << (int)(p.rgb[1]) << " " << (int)(p.rgb[2]) << endl;
     itr++;
   }
-  itr = allPoints->begin();
-  
-  while(itr != allPoints->end()) {
-    p = *(itr);
+  for(unsigned int i = 0; i < remaining.size(); i++) {
+    p = (*allPoints)[remaining[i]];
     out << p.x << " " << p.y << " " << p.z << " " << 255 << " " << 255 << " " << 255 << endl;
-    itr++;
   }
   out.close();
 }
@@ -0,0 +1,202 @@
+/*
+ * hough_bench implementation
+ *
+ * Copyright (C) Dorit Borrmann
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Benchmark of the accumulator designs of the Hough Transform
+ *
+ * Creates synthetic scenes of a few noisy planes in a box and votes all
+ * points into each of the accumulator types, once point by point as the
+ * PPHT and APHT do, once as a batch as the SHT and PHT do. The counters of
+ * both have to be equal.
+ *
+ * @author Dorit Borrmann. Institute of Computer Science, University of Osnabrueck, Germany.
+ */
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <vector>
+using std::vector;
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#else
+#include "XGetopt.h"
+#endif
+
+#include "shapes/accumulator.h"
+#include "slam6d/globals.icc"
+
+void usage(char* prog)
+{
+  cout << endl
+       << "USAGE " << endl
+       << "   " << prog << " [options] [points ...]" << endl << endl
+       << "OPTIONS" << endl
+       << "  -c FILE, --config=FILE" << endl
+       << "         configuration of the accumulators (default: bin/hough.cfg)" << endl << endl
+       << "  -s NR, --single=NR" << endl
+       << "         vote point by point up to NR points (default: 100000)" << endl << endl
+       << "  -r NR, --seed=NR" << endl
+       << "         seed of the random numbers (default: 1)" << endl << endl
+       << "Runs 1000 10000 100000 1000000 points if none are given." << endl
+       << endl;
+  exit(1);
+}
+
+static double uniform()
+{
+  return rand() / (RAND_MAX + 1.0);
+}
+
+/**
+ * Gives the benchmark access to the counters of an accumulator.
+ */
+template <class A>
+class CountedAccumulator : public A {
+  public:
+    CountedAccumulator(ConfigFileHough myCfg) : A(myCfg) { }
+    bool equals(CountedAccumulator<A> &other) {
+      return this->nrCounters == other.nrCounters &&
+        memcmp(this->counters, other.counters, this->nrCounters * sizeof(int)) == 0;
+    }
+    long getNrCounters() {
+      return this->nrCounters;
+    }
+};
+
+/**
+ * Points on the six walls of a box around the origin and on a tilted
+ * plane through it, with uniform noise of the given amplitude. The points
+ * of each plane follow each other as in a scan.
+ */
+static void createScene(int n, double size, double noise, vector<Point> &points)
+{
+  points.clear();
+  for (int i = 0; i < n; i++) {
+    double u = (uniform() - 0.5) * 2.0 * size;
+    double v = (uniform() - 0.5) * 2.0 * size;
+    double w = (uniform() - 0.5) * noise;
+    double p[3];
+    int plane = (int)((long)i * 7 / n);
+    if (plane < 6) {
+      int axis = plane / 2;
+      double side = plane % 2 ? size : -size;
+      p[axis] = side + w;
+      p[(axis + 1) % 3] = u;
+      p[(axis + 2) % 3] = v;
+    } else {
+      p[0] = u * 0.6 + w * 0.8;
+      p[1] = v;
+      p[2] = u * 0.8 - w * 0.6;
+    }
+    points.push_back(Point(p));
+  }
+}
+
+template <class A>
+static void run(const char *name, ConfigFileHough &cfg, vector<Point> &points, int maxSingle)
+{
+  CountedAccumulator<A> batch(cfg);
+  double batchTime = GetCurrentTimeInMilliSec();
+  batch.accumulate(points);
+  batchTime = GetCurrentTimeInMilliSec() - batchTime;
+
+  double singleTime = -1.0;
+  if ((int)points.size() <= maxSingle) {
+    CountedAccumulator<A> single(cfg);
+    singleTime = GetCurrentTimeInMilliSec();
+    for (unsigned int i = 0; i < points.size(); i++)
+      single.accumulate(points[i]);
+    singleTime = GetCurrentTimeInMilliSec() - singleTime;
+
+    if (!single.equals(batch)) {
+      cerr << "counters of the batch differ from the single votes in "
+           << name << endl;
+    }
+  }
+
+  cout << std::setw(8) << points.size() << std::setw(8) << name
+       << std::setw(12) << batch.getNrCounters() << std::fixed << std::setprecision(1);
+  if (singleTime >= 0.0) {
+    cout << std::setw(12) << singleTime << std::setw(12) << batchTime;
+    if (batchTime > 0.0) cout << std::setw(10) << singleTime / batchTime;
+  } else {
+    cout << std::setw(12) << "-" << std::setw(12) << batchTime;
+  }
+  cout << endl;
+}
+
+int main(int argc, char **argv)
+{
+  const char *config = "bin/hough.cfg";
+  int maxSingle = 100000;
+  int seed = 1;
+
+  static struct option longopts[] = {
+    { "config",          required_argument,   0,  'c' },
+    { "single",          required_argument,   0,  's' },
+    { "seed",            required_argument,   0,  'r' },
+    { 0,           0,   0,   0}                    // needed, cf. getopt.h
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "c:s:r:", longopts, NULL)) != -1) {
+    switch (c) {
+      case 'c': config = optarg; break;
+      case 's': maxSingle = atoi(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  vector<int> sizes;
+  for (int i = optind; i < argc; i++) sizes.push_back(atoi(argv[i]));
+  if (sizes.empty()) {
+    int defaults[] = { 1000, 10000, 100000, 1000000 };
+    sizes.assign(defaults, defaults + 4);
+  }
+
+  ConfigFileHough cfg;
+  if (!cfg.LoadCfg(config)) {
+    cerr << "could not read " << config << ", using the default configuration" << endl;
+  }
+  // the planes fill the range of rho
+  double size = cfg.Get_RhoMax() / 2.0;
+  double noise = cfg.Get_MaxPointPlaneDist();
+
+  srand(seed);
+  cout << std::setw(8) << "points" << std::setw(8) << "type"
+       << std::setw(12) << "counters" << std::setw(12) << "single ms"
+       << std::setw(12) << "batch ms" << std::setw(10) << "speedup" << endl;
+
+  for (unsigned int s = 0; s < sizes.size(); s++) {
+    vector<Point> points;
+    createScene(sizes[s], size, noise, points);
+    run<AccumulatorSimple>("simple", cfg, points, maxSingle);
+    run<AccumulatorBall>("ball", cfg, points, maxSingle);
+    run<AccumulatorCube>("cube", cfg, points, maxSingle);
+    run<AccumulatorBallI>("balli", cfg, points, maxSingle);
+  }
+
+  return 0;
+}
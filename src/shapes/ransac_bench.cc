@@ -0,0 +1,191 @@
+/*
+ * ransac_bench implementation
+ *
+ * Copyright (C) Dorit Borrmann
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Benchmark of the RANSAC shape detection
+ *
+ * Fits a plane and a bounded plane to the points of a scan file or of a
+ * synthetic scene with a fixed number of hypotheses each scored on the
+ * octree, with preemptive scoring on a subset of the points first, and
+ * with adaptive termination in addition.
+ *
+ * @author Dorit Borrmann. Institute of Computer Science, University of Osnabrueck, Germany.
+ */
+
+#include <vector>
+using std::vector;
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <fstream>
+#include <string>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#else
+#include "XGetopt.h"
+#endif
+
+#include "shapes/shape.h"
+#include "shapes/ransac.h"
+
+void usage(char* prog)
+{
+  cout << endl
+       << "USAGE " << endl
+       << "   " << prog << " [options] [file]" << endl << endl
+       << "OPTIONS" << endl
+       << "  -n NR, --points=NR" << endl
+       << "         number of points of the synthetic scene (default: 100000)" << endl << endl
+       << "  -i NR, --iterations=NR" << endl
+       << "         maximal number of hypotheses (default: 5000)" << endl << endl
+       << "  -d NR, --dist=NR" << endl
+       << "         maximal distance of a point to the shape (default: 1.0)" << endl << endl
+       << "  -r NR, --seed=NR" << endl
+       << "         seed of the random numbers (default: 1)" << endl << endl
+       << "Reads the points of a scan in the uos format (e.g. dat/scan000.3d) if" << endl
+       << "a file is given, otherwise a box of five walls and a tilted plane." << endl
+       << endl;
+  exit(1);
+}
+
+static double uniform()
+{
+  return rand() / (RAND_MAX + 1.0);
+}
+
+/**
+ * Points on five walls of a box around the origin and on a tilted plane
+ * through it, with uniform noise of the given amplitude.
+ */
+static void createScene(int n, double size, double noise, vector<double *> &points)
+{
+  for (int i = 0; i < n; i++) {
+    double u = (uniform() - 0.5) * 2.0 * size;
+    double v = (uniform() - 0.5) * 2.0 * size;
+    double w = (uniform() - 0.5) * noise;
+    double *p = new double[3];
+    int plane = (int)((long)i * 6 / n);
+    if (plane < 5) {
+      int axis = plane / 2;
+      double side = plane % 2 ? size : -size;
+      p[axis] = side + w;
+      p[(axis + 1) % 3] = u;
+      p[(axis + 2) % 3] = v;
+    } else {
+      p[0] = u * 0.6 + w * 0.8;
+      p[1] = v;
+      p[2] = u * 0.8 - w * 0.6;
+    }
+    points.push_back(p);
+  }
+}
+
+/**
+ * Reads a scan file of the uos format, a header line followed by one
+ * point per line.
+ */
+static bool readScan(const char *filename, vector<double *> &points)
+{
+  std::ifstream in(filename);
+  if (!in.good()) return false;
+  std::string line;
+  std::getline(in, line);
+  while (std::getline(in, line)) {
+    double *p = new double[3];
+    if (sscanf(line.c_str(), "%lf %lf %lf", &p[0], &p[1], &p[2]) != 3) {
+      delete[] p;
+      continue;
+    }
+    points.push_back(p);
+  }
+  return !points.empty();
+}
+
+static void run(const char *name, CollisionShape<double> &shape, RansacOctTree<double> &oct,
+    long iterations, double confidence, bool preemptive, int seed)
+{
+  srand(seed);
+  double time = GetCurrentTimeInMilliSec();
+  Ransac(shape, oct, (vector<double *> *)0, iterations, confidence, preemptive);
+  time = GetCurrentTimeInMilliSec() - time;
+  unsigned long score = oct.PointsOnShape(shape);
+
+  const char *mode = confidence < 1.0 ? "adaptive" : preemptive ? "preempt" : "fixed";
+  cout << "==> " << std::setw(10) << name << std::setw(10) << mode
+       << std::setw(10) << score << std::fixed << std::setprecision(1)
+       << std::setw(10) << time << " ms" << endl;
+}
+
+int main(int argc, char **argv)
+{
+  int nrPoints = 100000;
+  long iterations = 5000;
+  double maxDist = 1.0;
+  int seed = 1;
+
+  static struct option longopts[] = {
+    { "points",          required_argument,   0,  'n' },
+    { "iterations",      required_argument,   0,  'i' },
+    { "dist",            required_argument,   0,  'd' },
+    { "seed",            required_argument,   0,  'r' },
+    { 0,           0,   0,   0}                    // needed, cf. getopt.h
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "n:i:d:r:", longopts, NULL)) != -1) {
+    switch (c) {
+      case 'n': nrPoints = atoi(optarg); break;
+      case 'i': iterations = atol(optarg); break;
+      case 'd': maxDist = atof(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  vector<double *> points;
+  srand(seed);
+  if (optind < argc) {
+    if (!readScan(argv[optind], points)) {
+      cerr << "could not read " << argv[optind] << endl;
+      return 1;
+    }
+  } else {
+    createScene(nrPoints, 500.0, maxDist, points);
+  }
+
+  RansacOctTree<double> oct(&points[0], points.size(), 50.0);
+  cout << points.size() << " points" << endl;
+
+  vector<std::string> names;
+  vector<CollisionShape<double> *> shapes;
+  names.push_back("plane");
+  shapes.push_back(new CollisionPlane<double>(maxDist));
+  names.push_back("lightbulb");
+  shapes.push_back(new LightBulbPlane<double>(maxDist, 100.0));
+
+  for (unsigned int i = 0; i < shapes.size(); i++) {
+    run(names[i].c_str(), *shapes[i], oct, iterations, 1.0, false, seed);
+    run(names[i].c_str(), *shapes[i], oct, iterations, 1.0, true, seed);
+    run(names[i].c_str(), *shapes[i], oct, iterations, 0.99, true, seed);
+    delete shapes[i];
+  }
+
+  for (unsigned int i = 0; i < points.size(); i++) {
+    delete[] points[i];
+  }
+  return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * slabtree implementation
+ *
+ * Copyright (C) Dorit Borrmann
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#include "shapes/slabtree.h"
+#include <math.h>
+#include <algorithm>
+
+namespace {
+
+/** Orders point indices by one coordinate. */
+struct AxisLess {
+  const vector<Point> &points;
+  int axis;
+  AxisLess(const vector<Point> &p, int a) : points(p), axis(a) { }
+  bool operator()(unsigned int i, unsigned int j) const {
+    const Point &a = points[i];
+    const Point &b = points[j];
+    return axis == 0 ? a.x < b.x : axis == 1 ? a.y < b.y : a.z < b.z;
+  }
+};
+
+}
+
+SlabTree::SlabTree(const vector<Point> &p, int bucketSize) : points(p) {
+  order.resize(points.size());
+  for(unsigned int i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  leafOf.resize(points.size(), -1);
+  removed.resize(points.size(), false);
+  if(bucketSize < 1) bucketSize = 1;
+  if(!points.empty()) {
+    nodes.reserve(4 * points.size() / bucketSize + 1);
+    build(0, (int)points.size(), -1, bucketSize);
+  }
+}
+
+int SlabTree::build(int begin, int end, int parent, int bucketSize) {
+  int index = (int)nodes.size();
+  nodes.push_back(Node());
+  Node &node = nodes[index];
+  node.begin = begin;
+  node.end = end;
+  node.left = node.right = -1;
+  node.parent = parent;
+  node.alive = end - begin;
+
+  double min[3], max[3];
+  for(int k = 0; k < 3; k++) {
+    min[k] = HUGE_VAL;
+    max[k] = -HUGE_VAL;
+  }
+  for(int i = begin; i < end; i++) {
+    const Point &p = points[order[i]];
+    double c[3] = {p.x, p.y, p.z};
+    for(int k = 0; k < 3; k++) {
+      if(c[k] < min[k]) min[k] = c[k];
+      if(c[k] > max[k]) max[k] = c[k];
+    }
+  }
+  for(int k = 0; k < 3; k++) {
+    node.min[k] = min[k];
+    node.max[k] = max[k];
+  }
+
+  if(end - begin <= bucketSize) {
+    for(int i = begin; i < end; i++) {
+      leafOf[order[i]] = index;
+    }
+    return index;
+  }
+
+  // split the longest side at the median
+  int axis = 0;
+  for(int k = 1; k < 3; k++) {
+    if(max[k] - min[k] > max[axis] - min[axis]) axis = k;
+  }
+  int mid = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                   AxisLess(points, axis));
+
+  // the reference is not valid anymore after the children are added
+  int left = build(begin, mid, index, bucketSize);
+  int right = build(mid, end, index, bucketSize);
+  nodes[index].left = left;
+  nodes[index].right = right;
+  return index;
+}
+
+void SlabTree::query(const double *n, double rho, double maxDist, vector<unsigned int> &result) const {
+  result.clear();
+  if(nodes.empty()) return;
+
+  // the boxes are tested with some slack, the points exactly
+  double slack = 1e-9 * (fabs(rho) + maxDist) + 1e-9;
+  vector<int> stack;
+  stack.push_back(0);
+  while(!stack.empty()) {
+    const Node &node = nodes[stack.back()];
+    stack.pop_back();
+    if(node.alive == 0) continue;
+
+    double lo = 0.0, hi = 0.0;
+    for(int k = 0; k < 3; k++) {
+      double a = n[k] * node.min[k];
+      double b = n[k] * node.max[k];
+      lo += a < b ? a : b;
+      hi += a < b ? b : a;
+    }
+    if(hi - rho <= -maxDist - slack || lo - rho >= maxDist + slack) continue;
+
+    if(node.left >= 0) {
+      stack.push_back(node.right);
+      stack.push_back(node.left);
+      continue;
+    }
+
+    for(int i = node.begin; i < node.end; i++) {
+      unsigned int index = order[i];
+      if(removed[index]) continue;
+      const Point &p = points[index];
+      double distance = p.x * n[0] + p.y * n[1] + p.z*n[2] - rho;
+      if(fabs(distance) < maxDist) {
+        result.push_back(index);
+      }
+    }
+  }
+}
+
+void SlabTree::remove(unsigned int index) {
+  if(removed[index]) return;
+  removed[index] = true;
+  for(int node = leafOf[index]; node >= 0; node = nodes[node].parent) {
+    nodes[node].alive--;
+  }
+}
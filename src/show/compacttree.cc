@@ -197,6 +197,7 @@ void compactTree::displayOctTreeAll( cbitoct &node, double *center, double size)
       if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
         tshort *point = children->getPoints();
         lint length = children->getLength();
+        drawn_points += length;
         glBegin(GL_POINTS);
         for(unsigned int iterator = 0; iterator < length; iterator++ ) {
           if(cm) cm->setColor(point);
@@ -235,6 +236,7 @@ void compactTree::displayOctTreeAllCulled( cbitoct &node, double *center, double
         if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
           tshort *point = children->getPoints();
           lint length = children->getLength();
+          drawn_points += length;
           glBegin(GL_POINTS);
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
             if(cm) cm->setColor(point);
@@ -284,10 +286,12 @@ void compactTree::displayOctTreeCulledLOD(long targetpts, cbitoct &node, double
           lint length = children->getLength();
           glBegin(GL_POINTS);
           if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
+            drawn_points++;
             if(cm) cm->setColor(point);
             //glVertex3f( point[0], point[1], point[2]);
             glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
           } else if (length <= newtargetpts) {        // more points requested than possible, plot all
+            drawn_points += length;
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
               if(cm) cm->setColor(point);
               //glVertex3f( point[0], point[1], point[2]);
@@ -299,6 +303,7 @@ void compactTree::displayOctTreeCulledLOD(long targetpts, cbitoct &node, double
             double each = (double)POINTDIM * (double)((double)length/(double)newtargetpts);
             tshort *p;
             int index;
+            drawn_points += newtargetpts;
             for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
               index = (double)iterator * each;
               p = point + index - index%POINTDIM;
@@ -346,6 +351,7 @@ void compactTree::displayOctTreeLOD(long targetpts, cbitoct &node, double *cente
         //glVertex3f( point[0], point[1], point[2]);
         glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
         } else*/ if (length <= newtargetpts) {        // more points requested than possible, plot all
+          drawn_points += length;
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
             if(cm) cm->setColor(point);
             //glVertex3f( point[0], point[1], point[2]);
@@ -357,6 +363,7 @@ void compactTree::displayOctTreeLOD(long targetpts, cbitoct &node, double *cente
           double each = (double)POINTDIM * (double)((double)length/(double)newtargetpts);
           tshort *p;
           int index;
+          drawn_points += newtargetpts;
           for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
             index = (double)iterator * each;
             p = point + index - index%POINTDIM;
@@ -404,6 +411,7 @@ void compactTree::displayOctTreeCulledLOD2(float ratio, cbitoct &node, double *c
               double each = (double)POINTDIM * (double)((double)length/(double)l);
               tshort *p;
               int index;
+              drawn_points += l;
               for(int iterator = 0; iterator < l; iterator++ ) {
                 index = (double)iterator * each;
                 p = point + index - index%POINTDIM;
@@ -411,12 +419,14 @@ void compactTree::displayOctTreeCulledLOD2(float ratio, cbitoct &node, double *c
                 glVertex3f( p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2]);
               }
             } else if ((int)length <= l) { 
+              drawn_points += length;
               for(unsigned int iterator = 0; iterator < length; iterator++ ) {
                 if(cm) cm->setColor(point);
                 glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
                 point+=POINTDIM;
               }
             } else if (l == 1) {
+                drawn_points++;
                 if(cm) cm->setColor(point);
                 glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
             }
@@ -454,6 +464,7 @@ void compactTree::displayOctTreeLOD2(float ratio, cbitoct &node, double *center,
             double each = (double)POINTDIM * (double)((double)length/(double)l);
             tshort *p;
             int index;
+            drawn_points += l;
             for(int iterator = 0; iterator < l; iterator++ ) {
               index = (double)iterator * each;
               p = point + index - index%POINTDIM;
@@ -461,6 +472,7 @@ void compactTree::displayOctTreeLOD2(float ratio, cbitoct &node, double *center,
               glVertex3f( p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2]);
             }
           } else if ((int)length <= l) { 
+            drawn_points += length;
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
               if(cm) cm->setColor(point);
               glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
@@ -468,6 +480,7 @@ void compactTree::displayOctTreeLOD2(float ratio, cbitoct &node, double *center,
             }
           }
         } else {
+          drawn_points++;
           if(cm) cm->setColor(point);
           glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
         }
@@ -641,6 +654,7 @@ long compactTree::countLeaves() { return 1 + countLeaves(*root); }
 void compactTree::setColorManager(ColorManager *_cm) { cm = _cm; }
 
 void compactTree::drawLOD(float ratio) { 
+    drawn_points = 0;
     switch (current_lod_mode) {
       case 1:
         glBegin(GL_POINTS);
@@ -674,6 +688,7 @@ void compactTree::drawLOD(float ratio) {
 }
 
 void compactTree::draw() { 
+  drawn_points = 0;
   displayOctTreeAllCulled(*root, center, size); 
 }
 
@@ -0,0 +1,166 @@
+/*
+ * framescheduler implementation
+ *
+ * Copyright (C) Jan Elseberg
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Point budget scheduling of the frames drawn by show
+ *
+ * @author Jan Elseberg. Automation Group, Jacobs University Bremen gGmbH, Germany.
+ */
+
+#include "show/framescheduler.h"
+
+#include <iostream>
+using std::cerr;
+using std::endl;
+
+const unsigned long FrameScheduler::min_budget;
+const float FrameScheduler::smoothing = 0.3;
+const float FrameScheduler::min_lod = 0.000000001;
+
+FrameScheduler::FrameScheduler()
+  : target_ms(50.0), ms_per_point(0.0),
+    budget(0), moving_budget(0), drawn(0), last_drawn(0), frame_ms(0.0),
+    level(0), refining(false), complete(false), frame_nr(0), log(0)
+{
+}
+
+FrameScheduler::~FrameScheduler()
+{
+  if (log) {
+    log->close();
+    delete log;
+  }
+}
+
+void FrameScheduler::setTargetTime(double ms)
+{
+  if (ms > 0.0) target_ms = ms;
+}
+
+bool FrameScheduler::openLog(const std::string &filename)
+{
+  if (log) delete log;
+  log = new std::ofstream(filename.c_str());
+  if (!log->good()) {
+    cerr << "Could not open scheduler log " << filename << endl;
+    delete log;
+    log = 0;
+    return false;
+  }
+  *log << "# frame target_ms budget drawn_points frame_ms ms_per_point refinement" << endl;
+  return true;
+}
+
+void FrameScheduler::beginFrame(unsigned int nr_scans)
+{
+  if (points_per_lod.size() != nr_scans) {
+    points_per_lod.assign(nr_scans, 0.0);
+  }
+  assigned.assign(nr_scans, min_lod);
+
+  if (ms_per_point > 0.0) {
+    moving_budget = (unsigned long)(target_ms / ms_per_point);
+  } else {
+    // nothing measured yet, start with the default of show
+    moving_budget = 10 * min_budget;
+  }
+  if (moving_budget < min_budget) moving_budget = min_budget;
+
+  if (refining) {
+    budget = moving_budget << level;
+  } else {
+    // the view has changed, start over with the budget for moving cameras
+    level = 0;
+    complete = false;
+    last_drawn = 0;
+    budget = moving_budget;
+  }
+  refining = false;
+}
+
+void FrameScheduler::allocate(const std::vector<float> &coverage, std::vector<float> &lods)
+{
+  lods.resize(coverage.size());
+  double total = 0.0;
+  for (unsigned int i = 0; i < coverage.size(); i++) {
+    total += coverage[i];
+  }
+
+  for (unsigned int i = 0; i < coverage.size(); i++) {
+    if (coverage[i] <= 0.0 || total <= 0.0) {
+      lods[i] = min_lod;
+    } else {
+      double share = budget * coverage[i] / total;
+      // without any experience start with a small level and learn from it
+      double lod = 0.001;
+      if (i < points_per_lod.size() && points_per_lod[i] > 0.0) {
+        lod = share / points_per_lod[i];
+      }
+      if (lod > 1.0) lod = 1.0;
+      else if (lod < min_lod) lod = min_lod;
+      lods[i] = lod;
+    }
+    if (i < assigned.size()) assigned[i] = lods[i];
+  }
+}
+
+void FrameScheduler::endFrame(double ms, const std::vector<unsigned long> &points)
+{
+  drawn = 0;
+  bool saturated = true;
+  for (unsigned int i = 0; i < points.size() && i < assigned.size(); i++) {
+    drawn += points[i];
+    if (assigned[i] <= min_lod) continue;
+    if (assigned[i] < 1.0) saturated = false;
+
+    // an empty scan counts as one point, so its level grows next time
+    double sample = (points[i] > 0 ? points[i] : 1) / (double)assigned[i];
+    if (points_per_lod[i] > 0.0) {
+      points_per_lod[i] = (1.0 - smoothing) * points_per_lod[i] + smoothing * sample;
+    } else {
+      points_per_lod[i] = sample;
+    }
+  }
+  frame_ms = ms;
+
+  // frames with only a few points are dominated by other costs
+  if (drawn >= 1000 && ms > 0.0) {
+    double sample = ms / drawn;
+    if (ms_per_point > 0.0) {
+      ms_per_point = (1.0 - smoothing) * ms_per_point + smoothing * sample;
+    } else {
+      ms_per_point = sample;
+    }
+  }
+
+  // refinement has ended when the scans do not deliver any more points
+  if (saturated || (level > 0 && drawn <= last_drawn + last_drawn / 100)) {
+    complete = true;
+  }
+  last_drawn = drawn;
+
+  if (log) {
+    *log << frame_nr << " " << target_ms << " " << budget << " " << drawn << " "
+         << frame_ms << " " << ms_per_point << " " << level << endl;
+  }
+  frame_nr++;
+}
+
+bool FrameScheduler::refine()
+{
+  // a refined frame has been requested but not drawn yet
+  if (refining) return false;
+  if (complete) return false;
+  // the budget is shifted by the level
+  if (level >= 20) return false;
+  level++;
+  refining = true;
+  return true;
+}
@@ -0,0 +1,89 @@
+/*
+ * pointbatch implementation
+ *
+ * Copyright (C) Jan Elseberg
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Drawing of point batches via vertex arrays and buffer objects
+ *
+ * @author Jan Elseberg. Automation Group, Jacobs University Bremen gGmbH, Germany.
+ */
+
+#ifdef WITH_GLEE
+#include <GLee.h>
+#endif
+
+#include "show/pointbatch.h"
+
+#ifdef WITH_GLEE
+static void uploadPointBatch(PointBatch &batch) {
+  size_t vsize = batch.vertices.size() * sizeof(float);
+  size_t csize = batch.colors.size() * sizeof(float);
+  if (batch.vbo == 0) {
+    GLuint name;
+    glGenBuffersARB(1, &name);
+    batch.vbo = name;
+  }
+  glBindBufferARB(GL_ARRAY_BUFFER_ARB, batch.vbo);
+  // vertices first, colors appended in the same buffer
+  glBufferDataARB(GL_ARRAY_BUFFER_ARB, vsize + csize, 0, GL_STATIC_DRAW_ARB);
+  if (vsize) glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, 0, vsize, &batch.vertices[0]);
+  if (csize) glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, vsize, csize, &batch.colors[0]);
+  batch.uploaded = true;
+}
+#endif
+
+void drawPointBatch(PointBatch &batch)
+{
+  if (batch.size() == 0) return;
+  bool colored = !batch.colors.empty();
+
+  // colors are given per vertex, the color texture must not interfere
+  GLboolean texture = glIsEnabled(GL_TEXTURE_1D);
+  if (colored && texture) glDisable(GL_TEXTURE_1D);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  if (colored) glEnableClientState(GL_COLOR_ARRAY);
+
+#ifdef WITH_GLEE
+  if (GLEE_ARB_vertex_buffer_object) {
+    if (!batch.uploaded) {
+      uploadPointBatch(batch);
+    } else {
+      glBindBufferARB(GL_ARRAY_BUFFER_ARB, batch.vbo);
+    }
+    glVertexPointer(3, GL_FLOAT, 0, 0);
+    if (colored)
+      glColorPointer(3, GL_FLOAT, 0, (GLvoid*)(batch.vertices.size() * sizeof(float)));
+    glDrawArrays(GL_POINTS, 0, batch.size());
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+  } else
+#endif
+  {
+    glVertexPointer(3, GL_FLOAT, 0, &batch.vertices[0]);
+    if (colored) glColorPointer(3, GL_FLOAT, 0, &batch.colors[0]);
+    glDrawArrays(GL_POINTS, 0, batch.size());
+  }
+
+  if (colored) glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+
+  if (colored && texture) glEnable(GL_TEXTURE_1D);
+}
+
+void releasePointBatch(PointBatch &batch)
+{
+#ifdef WITH_GLEE
+  if (batch.vbo != 0 && GLEE_ARB_vertex_buffer_object) {
+    GLuint name = batch.vbo;
+    glDeleteBuffersARB(1, &name);
+  }
+#endif
+  batch.vbo = 0;
+  batch.uploaded = false;
+}
@@ -0,0 +1,376 @@
+/*
+ * show_bench implementation
+ *
+ * Copyright (C) Jan Elseberg
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Headless benchmark of the octree culling and LOD traversal of show
+ *
+ * Replays a camera path saved by show ("Save path") without opening a
+ * window. For every frame the display octrees of all scans are traversed
+ * into point batches, exactly as show --batch does, and the traversal time
+ * and the number of emitted points are reported.
+ *
+ * @author Jan Elseberg. Automation Group, Jacobs University Bremen gGmbH, Germany.
+ */
+
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <fstream>
+using std::ifstream;
+#include <stdexcept>
+using std::runtime_error;
+
+#include "show/show_Boctree.h"
+#include "show/pointbatch.h"
+#include "slam6d/scan.h"
+#include "slam6d/point.h"
+#include "slam6d/io_utils.h"
+#include "slam6d/globals.icc"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#include <sys/time.h>
+#else
+#include "XGetopt.h"
+#endif
+
+typedef float sfloat;
+
+void usage(char* prog)
+{
+#ifndef _MSC_VER
+  const string bold("\033[1m");
+  const string normal("\033[m");
+#else
+  const string bold("");
+  const string normal("");
+#endif
+  cout << endl
+	  << bold << "USAGE " << normal << endl
+	  << "   " << prog << " [options] -p pathfile directory" << endl << endl;
+  cout << bold << "OPTIONS" << normal << endl
+	  << bold << "  -s" << normal << " NR, " << bold << "--start=" << normal << "NR" << endl
+	  << "         start at scan NR" << endl << endl
+	  << bold << "  -e" << normal << " NR, " << bold << "--end=" << normal << "NR" << endl
+	  << "         end after scan NR" << endl << endl
+	  << bold << "  -f" << normal << " F, " << bold << "--format=" << normal << "F" << endl
+	  << "         using shared library F for input" << endl << endl
+	  << bold << "  -r" << normal << " NR, " << bold << "--reduce=" << normal << "NR" << endl
+	  << "         turns on octree based point reduction (voxel size=<NR>)" << endl << endl
+	  << bold << "  -m" << normal << " NR, " << bold << "--max=" << normal << "NR" << endl
+	  << "         neglegt all data points with a distance larger than NR 'units'" << endl << endl
+	  << bold << "  -C" << normal << " NR, " << bold << "--scale=" << normal << "NR" << endl
+	  << "         scale factor to use (default: 0.01), as in show" << endl << endl
+	  << bold << "  -p" << normal << " FILE, " << bold << "--path=" << normal << "FILE" << endl
+	  << "         camera path as written by show (default: path.dat)" << endl << endl
+	  << bold << "  -i" << normal << " NR, " << bold << "--interpolate=" << normal << "NR" << endl
+	  << "         frames between two cameras of the path (default: 10)" << endl << endl
+	  << bold << "  -l" << normal << " NR, " << bold << "--lod=" << normal << "NR" << endl
+	  << "         level of detail ratio handed to the traversal (default: 1.0)" << endl << endl
+	  << bold << "  -L" << normal << " NR, " << bold << "--lodmode=" << normal << "NR" << endl
+	  << "         0 = point budget LOD, 1 = screen size LOD (default: 0)" << endl << endl
+	  << bold << "  -W" << normal << " NR, " << bold << "-H" << normal << " NR" << endl
+	  << "         viewport width and height (default: 960x540)" << endl << endl
+	  << bold << "  -R, --reuse" << normal << endl
+	  << "         reuse the batches of the previous frame if the view did not change" << endl
+	  << endl << endl;
+  exit(1);
+}
+
+static double getTimeInMilliSec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Reads the camera path in the format written by savePath in show
+ */
+bool readPath(const string &filename, vector<Point> &cams, vector<Point> &lookats, vector<Point> &ups)
+{
+  ifstream pathfile(filename.c_str());
+  if (!pathfile.good()) return false;
+  unsigned int length;
+  pathfile >> length;
+  for (unsigned int i = 0; i < length; i++) {
+    Point c, l, u;
+    pathfile >> c.x >> c.y >> c.z >> l.x >> l.y >> l.z >> u.x >> u.y >> u.z;
+    if (!pathfile.good()) return false;
+    cams.push_back(c);
+    lookats.push_back(l);
+    ups.push_back(u);
+  }
+  return cams.size() > 0;
+}
+
+/**
+ * Column-major view matrix, identical to the one set by gluLookAt
+ */
+void lookAt(const Point &eye, const Point &center, const Point &up, double *m)
+{
+  double f[3] = { center.x - eye.x, center.y - eye.y, center.z - eye.z };
+  double u[3] = { up.x, up.y, up.z };
+  double e[3] = { eye.x, eye.y, eye.z };
+  double s[3];
+  Normalize3(f);
+  Cross(f, u, s);
+  Normalize3(s);
+  Cross(s, f, u);
+
+  M4identity(m);
+  m[0] = s[0];  m[4] = s[1];  m[8]  = s[2];
+  m[1] = u[0];  m[5] = u[1];  m[9]  = u[2];
+  m[2] = -f[0]; m[6] = -f[1]; m[10] = -f[2];
+  m[12] = -Dot(s, e);
+  m[13] = -Dot(u, e);
+  m[14] =  Dot(f, e);
+}
+
+/**
+ * Column-major projection matrix, identical to the one set by gluPerspective
+ */
+void perspective(double fovy, double aspect, double znear, double zfar, float *m)
+{
+  double f = 1.0 / tan(rad(fovy) / 2.0);
+  for (int i = 0; i < 16; i++) m[i] = 0.0;
+  m[0]  = f / aspect;
+  m[5]  = f;
+  m[10] = (zfar + znear) / (znear - zfar);
+  m[11] = -1.0;
+  m[14] = 2.0 * zfar * znear / (znear - zfar);
+}
+
+Point interpolate(const Point &a, const Point &b, double t)
+{
+  return Point(a.x + t*(b.x - a.x), a.y + t*(b.y - a.y), a.z + t*(b.z - a.z));
+}
+
+int main(int argc, char **argv)
+{
+  int start = 0, end = -1, maxDist = -1, minDist = -1;
+  double red = -1.0;
+  double scale = 0.01;
+  IOType type = UOS;
+  string pathfile = "path.dat";
+  int interpolations = 10;
+  float lod = 1.0;
+  int lodmode = 0;
+  int width = 960, height = 540;
+  bool reuse = false;
+
+  static struct option longopts[] = {
+    { "format",          required_argument,   0,  'f' },
+    { "start",           required_argument,   0,  's' },
+    { "end",             required_argument,   0,  'e' },
+    { "reduce",          required_argument,   0,  'r' },
+    { "max",             required_argument,   0,  'm' },
+    { "min",             required_argument,   0,  'M' },
+    { "scale",           required_argument,   0,  'C' },
+    { "path",            required_argument,   0,  'p' },
+    { "interpolate",     required_argument,   0,  'i' },
+    { "lod",             required_argument,   0,  'l' },
+    { "lodmode",         required_argument,   0,  'L' },
+    { "reuse",           no_argument,         0,  'R' },
+    { 0,           0,   0,   0}                    // needed, cf. getopt.h
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "f:s:e:r:m:M:C:p:i:l:L:W:H:R", longopts, NULL)) != -1) {
+    switch (c) {
+      case 's': start = atoi(optarg); break;
+      case 'e': end = atoi(optarg); break;
+      case 'r': red = atof(optarg); break;
+      case 'm': maxDist = atoi(optarg); break;
+      case 'M': minDist = atoi(optarg); break;
+      case 'C': scale = atof(optarg); break;
+      case 'p': pathfile = optarg; break;
+      case 'i': interpolations = atoi(optarg); break;
+      case 'l': lod = atof(optarg); break;
+      case 'L': lodmode = atoi(optarg); break;
+      case 'W': width = atoi(optarg); break;
+      case 'H': height = atoi(optarg); break;
+      case 'R': reuse = true; break;
+      case 'f':
+        try {
+          type = formatname_to_io_type(optarg);
+        } catch (...) { // runtime_error
+          cerr << "Format " << optarg << " unknown." << endl;
+          abort();
+        }
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if (optind != argc-1) {
+    cerr << "\n*** Directory missing ***" << endl;
+    usage(argv[0]);
+  }
+  string dir = argv[optind];
+#ifndef _MSC_VER
+  if (dir[dir.length()-1] != '/') dir = dir + "/";
+#else
+  if (dir[dir.length()-1] != '\\') dir = dir + "\\";
+#endif
+
+  vector<Point> cams, lookats, ups;
+  if (!readPath(pathfile, cams, lookats, ups)) {
+    cerr << "Could not read camera path " << pathfile << endl;
+    exit(1);
+  }
+
+  // same scale dependant values as in show
+  scale = 1.0 / scale;
+  double neardistance = 0.10 * scale;
+  double fardistance = 400.0 * scale;
+  double voxelSize = 0.20 * scale;
+
+  Scan::openDirectory(false, dir, type, start, end);
+  if(Scan::allScans.size() == 0) {
+    cerr << "No scans found. Did you use the correct format?" << endl;
+    exit(-1);
+  }
+
+  // convert to the OpenGL coordinate system like show does
+  double mirror[16];
+  M4identity(mirror);
+  mirror[10] = -1.0;
+
+  vector<Show_BOctTree<sfloat>*> trees;
+  vector<double*> poses;
+  unsigned long build_start = GetCurrentTimeInMilliSec();
+  for(unsigned int i = 0; i < Scan::allScans.size(); ++i) {
+    Scan* scan = Scan::allScans[i];
+    scan->setRangeFilter(maxDist, minDist);
+    if (red > 0) scan->setReductionParameter(red);
+    scan->setOcttreeParameter(red, voxelSize, PointType(), false, false);
+
+    DataOcttree* data_oct;
+    try {
+      data_oct = new DataOcttree(scan->get("octtree"));
+    } catch(runtime_error& e) {
+      cout << "Scan " << i << " could not be loaded into memory, stopping here." << endl;
+      break;
+    }
+    Show_BOctTree<sfloat>* tree = new Show_BOctTree<sfloat>(scan, data_oct);
+    for (int m = 0; m < lodmode; m++) tree->cycleLOD();
+    trees.push_back(tree);
+
+    // use the last frame if available, the pose otherwise
+    const double* transformation = scan->get_transMat();
+    Scan::AlgoType algoType;
+    unsigned int frame_count = 0;
+    try {
+      frame_count = scan->readFrames();
+    } catch(std::ios_base::failure& e) {
+    }
+    if (frame_count > 0) scan->getFrame(frame_count - 1, transformation, algoType);
+    double* pose = new double[16];
+    MMult(mirror, transformation, pose);
+    poses.push_back(pose);
+  }
+  cout << trees.size() << " octrees built in "
+       << (GetCurrentTimeInMilliSec() - build_start) / 1000.0 << " s" << endl;
+
+  int viewport[4] = { 0, 0, width, height };
+  float proj[16];
+  perspective(60.0, (double)width / (double)height, neardistance, fardistance, proj);
+
+  vector<PointBatch> batches(trees.size());
+  vector<show::ViewFrustum> views(trees.size());
+
+  double total_time = 0.0, min_time = 0.0, max_time = 0.0;
+  unsigned long total_points = 0;
+  unsigned int nr_frames = 0;
+
+  unsigned int steps = max(interpolations, 1);
+  unsigned int last = cams.size() > 1 ? (cams.size() - 1) * steps : 0;
+  for (unsigned int frame = 0; frame <= last; frame++) {
+    unsigned int k = frame / steps;
+    double t = (double)(frame % steps) / steps;
+    if (k >= cams.size() - 1) { k = cams.size() - 1; t = 0.0; }
+    unsigned int k2 = min(k + 1, (unsigned int)cams.size() - 1);
+    Point eye = interpolate(cams[k], cams[k2], t);
+    Point center = interpolate(lookats[k], lookats[k2], t);
+    Point up = interpolate(ups[k], ups[k2], t);
+    up.x -= eye.x; up.y -= eye.y; up.z -= eye.z;
+
+    double view[16];
+    lookAt(eye, center, up, view);
+
+    // the culling state of every scan depends on its pose
+    for (unsigned int i = 0; i < trees.size(); i++) {
+      double modl[16];
+      float fmodl[16];
+      MMult(view, poses[i], modl);
+      for (int j = 0; j < 16; j++) fmodl[j] = modl[j];
+      views[i].set(fmodl, proj, viewport, 1);
+    }
+
+    unsigned int reused = 0;
+    double time = getTimeInMilliSec();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+:reused)
+#endif
+    for (int i = 0; i < (int)trees.size(); i++) {
+      if (reuse && batches[i].reusable(views[i], lod)) {
+        reused++;
+      } else {
+        trees[i]->collectLOD(lod, views[i], batches[i]);
+      }
+    }
+    time = getTimeInMilliSec() - time;
+
+    unsigned long points = 0;
+    for (unsigned int i = 0; i < batches.size(); i++) {
+      points += batches[i].size();
+    }
+
+    cout << "frame " << frame << ": " << time << " ms, "
+         << points << " points";
+    if (reuse) cout << ", " << reused << " of " << trees.size() << " batches reused";
+    cout << endl;
+
+    if (nr_frames == 0 || time < min_time) min_time = time;
+    if (nr_frames == 0 || time > max_time) max_time = time;
+    total_time += time;
+    total_points += points;
+    nr_frames++;
+  }
+
+  cout << endl << nr_frames << " frames, traversal time per frame: "
+       << total_time / nr_frames << " ms (min " << min_time << " ms, max " << max_time << " ms)" << endl
+       << "points per frame: " << total_points / nr_frames << endl;
+  if (total_time > 0.0)
+    cout << "points per second: " << (total_points / total_time) * 1000.0 << endl;
+
+  for (unsigned int i = 0; i < trees.size(); i++) {
+    delete trees[i];
+    delete[] poses[i];
+  }
+  Scan::closeDirectory();
+  return 0;
+}
@@ -16,6 +16,8 @@
 #include "show/compacttree.h"
 #include "show/NurbsPath.h"
 #include "show/vertexarray.h"
+#include "show/pointbatch.h"
+#include "show/framescheduler.h"
 #ifndef DYNAMIC_OBJECT_REMOVAL
 #include "slam6d/scan.h"
 #include "slam6d/managedScan.h"
@@ -70,6 +72,26 @@ vector< ::SDisplay*> displays;
  */
 //Show_BOctTree **octpts;
 vector<colordisplay*> octpts;
+/**
+ * the point batches drawn for each scan in the last frame
+ */
+vector<PointBatch> batches;
+/**
+ * Draw from point batches instead of traversing the octrees with GL calls
+ */
+bool batchDrawing = false;
+/**
+ * Distributes a point budget over the scans to keep the frame time
+ */
+FrameScheduler scheduler;
+/**
+ * If 1 the frame scheduler instead of the global level of detail is used
+ */
+int frameScheduling = 0;
+/**
+ * the frame time in ms the frame scheduler aims at
+ */
+float frametime = 50.0;
 /**
  * Storing the base directory
  */
@@ -401,13 +423,23 @@ void usage(char* prog)
 	  << "         map all measurements on a sphere (of radius NRcm)" << endl
     << bold << "  --saveOct" << endl << normal
 	  << "         stores all used scans as octrees in the given directory" << endl
+	  << "         as images that are mapped into memory when loaded" << endl
 	  << "         All reflectivity/amplitude/deviation/type settings are stored as well." << endl
 	  << "         only works when using octree display" << endl
     << bold << "  --loadOct" << endl << normal
 	  << "         only reads octrees from the given directory" << endl
 	  << "         All reflectivity/amplitude/deviation/type settings are read from file." << endl
 	  << "         --reflectance/--amplitude and similar parameters are therefore ignored." << endl
+	  << "         Images built with other parameters or from changed scans are rebuilt." << endl
 	  << "         only works when using octree display" << endl
+    << bold << "  --batch" << endl << normal
+	  << "         traverse the octrees of all scans in parallel into vertex arrays" << endl
+	  << "         and reuse them while the camera does not move" << endl
+    << bold << "  --frametime=" << normal << "MS" << endl
+	  << "         distribute a point budget over the scans so that a frame takes MS" << endl
+	  << "         milliseconds, refine the view progressively while the camera rests" << endl
+    << bold << "  --schedulelog=" << normal << "FILE" << endl
+	  << "         write budget and achieved frame time of every frame to FILE" << endl
     << endl << endl;
 
   exit(1);
@@ -471,6 +503,9 @@ int parseArgs(int argc,char **argv, string &dir, int& start, int& end, int& maxD
     { "advanced",        no_argument,         0,  '2' },
     { "scanserver",      no_argument,         0,  'S' },
     { "sphere",          required_argument,   0,  'b' },
+    { "batch",           no_argument,         0,  '3' },
+    { "frametime",       required_argument,   0,  '4' },
+    { "schedulelog",     required_argument,   0,  '5' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
@@ -567,6 +602,16 @@ int parseArgs(int argc,char **argv, string &dir, int& start, int& end, int& maxD
       case 'b':
         sphereMode = atof(optarg);
         break;
+      case '3':
+        batchDrawing = true;
+        break;
+      case '4':
+        frametime = atof(optarg);
+        frameScheduling = 1;
+        break;
+      case '5':
+        scheduler.openLog(optarg);
+        break;
       default:
         abort ();
     }
@@ -778,6 +823,7 @@ void cycleLOD() {
   LevelOfDetail = 0.00001;
   for (unsigned int i = 0; i < octpts.size(); i++)
     octpts[i]->cycleLOD();
+  invalidateBatches();
 }
 
 
@@ -1060,6 +1106,10 @@ void deinitShow()
   done = true;
   
   cout << "Cleaning up octtrees and scans." << endl;
+  for (unsigned int i = 0; i < batches.size(); i++) {
+    releasePointBatch(batches[i]);
+  }
+
   if(octpts.size()) {
     // delete octtrees to release the cache locks within
     for(vector<colordisplay*>::iterator it = octpts.begin(); it!= octpts.end(); ++it) {
@@ -25,6 +25,129 @@ int    pointmode      = -1;
 bool   smallfont      = true;
 bool   label          = true;
 
+/**
+ * Looks up the frame of each scan in \a sequence for the current frame and
+ * extracts the view the scan is seen with. Scans that are not to be drawn
+ * get a null frame.
+ */
+void calcSequenceViews(const vector<int> &sequence, vector<double*> &frames,
+                       vector<ViewFrustum> &views)
+{
+  frames.assign(sequence.size(), (double*)0);
+  views.resize(sequence.size());
+
+  for(unsigned int i = 0; i < sequence.size(); i++) {
+    int iterator = sequence[i];
+    // ignore scans that don't have any frames associated with them
+    if((unsigned int)iterator >= MetaMatrix.size()) continue;
+    Scan::AlgoType type;
+    if((unsigned int)current_frame >= MetaMatrix[iterator].size()) {
+      frames[i] = MetaMatrix[iterator].back();
+      type = MetaAlgoType[iterator].back();
+    } else {
+      frames[i] = MetaMatrix[iterator][current_frame];
+      type = MetaAlgoType[iterator][current_frame];
+    }
+    if (type == Scan::INVALID) {
+      frames[i] = 0;
+      continue;
+    }
+    glPushMatrix();
+    glMultMatrixd(frames[i]);
+    ExtractFrustum(pointsize);
+    views[i].fromGlobals();
+    glPopMatrix();
+  }
+}
+
+/**
+ * Asks the frame scheduler for the level of detail of each scan, based on
+ * how much of the screen the scan covers in its view
+ */
+void scheduleSequence(const vector<int> &sequence, const vector<double*> &frames,
+                      const vector<ViewFrustum> &views, vector<float> &lods)
+{
+  vector<float> coverage(sequence.size(), 0.0);
+  for(unsigned int i = 0; i < sequence.size(); i++) {
+    if (frames[i] == 0) continue;
+    float center[3], size;
+    if (octpts[sequence[i]]->getBoundingCube(center, size)) {
+      coverage[i] = views[i].ScreenCoverage(center[0], center[1], center[2], size);
+    } else {
+      coverage[i] = 1.0;
+    }
+  }
+  scheduler.allocate(coverage, lods);
+}
+
+/**
+ * Draws the scans in \a sequence from point batches. The octrees are
+ * traversed in parallel with the level of detail in \a lods for those
+ * scans whose batch from the previous frame cannot be reused, and then all
+ * batches are handed to GL. The number of points drawn per scan is stored
+ * in \a points.
+ */
+void DrawPointBatches(const vector<int> &sequence, const vector<double*> &frames,
+                      const vector<ViewFrustum> &views, const vector<float> &lods,
+                      vector<unsigned long> &points)
+{
+  if (batches.size() < octpts.size()) batches.resize(octpts.size());
+
+  // traversal only, no GL calls in here
+  vector<bool> collected(sequence.size(), false);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int i = 0; i < (int)sequence.size(); i++) {
+    if (frames[i] == 0) continue;
+    PointBatch &batch = batches[sequence[i]];
+    if (batch.reusable(views[i], lods[i])) {
+      collected[i] = true;
+    } else {
+      collected[i] = octpts[sequence[i]]->collectLOD(lods[i], views[i], batch);
+    }
+  }
+
+  for(unsigned int i = 0; i < sequence.size(); i++) {
+    if (frames[i] == 0) continue;
+    int iterator = sequence[i];
+    glPushMatrix();
+    if (invert)                               // default: white points on black background
+      glColor4d(1.0, 1.0, 1.0, 0.0);
+    else                                      // black points on white background
+      glColor4d(0.0, 0.0, 0.0, 0.0);
+    glMultMatrixd(frames[i]);
+    if (collected[i]) {
+      drawPointBatch(batches[iterator]);
+      points[i] = batches[iterator].size();
+    } else {
+      ExtractFrustum(pointsize);
+      octpts[iterator]->displayLOD(lods[i]);
+      points[i] = octpts[iterator]->drawnPoints();
+    }
+    if (!selected_points[iterator].empty()) {
+      glColor4f(1.0, 0.0, 0.0, 1.0);
+      glPointSize(pointsize + 2.0);
+      glBegin(GL_POINTS);
+      for ( set<sfloat*>::iterator it = selected_points[iterator].begin();
+          it != selected_points[iterator].end(); it++) {
+        glVertex3d((*it)[0], (*it)[1], (*it)[2]);
+      }
+      glEnd();
+      glPointSize(pointsize);
+    }
+    glPopMatrix();
+  }
+}
+
+//! Forces the next frame to traverse the octrees again
+void invalidateBatches()
+{
+  for (unsigned int i = 0; i < batches.size(); i++) {
+    batches[i].invalidate();
+  }
+}
+
 /**
  * Displays all data (i.e., points) that are to be displayed
  * @param mode spezification for drawing to screen or in selection mode
@@ -32,6 +155,8 @@ bool   label          = true;
 void DrawPoints(GLenum mode, bool interruptable)
 {
   long time = GetCurrentTimeInMilliSec();
+  bool scheduled = false;
+  vector<unsigned long> points;
   double min = 0.000000001;
   double max = 1.0;
   LevelOfDetail *= 1.0 + adaption_rate*(lastfps - idealfps)/idealfps;
@@ -111,7 +236,26 @@ void DrawPoints(GLenum mode, bool interruptable)
 
       vector<int> sequence;
       calcPointSequence(sequence, current_frame);
-      for(unsigned int i = 0; i < sequence.size(); i++) {
+      // batches are only used for the final poses
+      bool batched = batchDrawing && pointmode != 1 && !interruptable
+        && current_frame == (int)MetaMatrix.back().size() - 1;
+      scheduled = frameScheduling && pointmode != 1 && !interruptable;
+      vector<float> lods(sequence.size(), LevelOfDetail);
+      points.assign(sequence.size(), 0);
+      if (batched || scheduled) {
+        vector<double*> frames;
+        vector<ViewFrustum> views;
+        calcSequenceViews(sequence, frames, views);
+        if (scheduled) {
+          scheduler.setTargetTime(frametime);
+          scheduler.beginFrame(sequence.size());
+          scheduleSequence(sequence, frames, views, lods);
+        }
+        if (batched) {
+          DrawPointBatches(sequence, frames, views, lods, points);
+        }
+      }
+      for(unsigned int i = 0; !batched && i < sequence.size(); i++) {
         int iterator = sequence[i];
         // ignore scans that don't have any frames associated with them
         if((unsigned int)iterator >= MetaMatrix.size()) continue;
@@ -153,7 +297,8 @@ void DrawPoints(GLenum mode, bool interruptable)
           }
           octpts[iterator]->display();
         } else {
-          octpts[iterator]->displayLOD(LevelOfDetail);
+          octpts[iterator]->displayLOD(lods[i]);
+          points[i] = octpts[iterator]->drawnPoints();
         }
         if (!selected_points[iterator].empty()) {
           glColor4f(1.0, 0.0, 0.0, 1.0);
@@ -173,8 +318,17 @@ void DrawPoints(GLenum mode, bool interruptable)
   }
 
 
+  if (scheduled) {
+    // measure the time until the points have actually been drawn
+    glFinish();
+    scheduler.endFrame(GetCurrentTimeInMilliSec() - time, points);
+    updateBudgetText();
+  }
+
   if (pointmode == 1 ) {
     fullydisplayed = true;
+  } else if (scheduled) {
+    fullydisplayed = scheduler.isComplete();
   } else {
     unsigned long td = (GetCurrentTimeInMilliSec() - time);
     if (td > 0)
@@ -806,7 +960,11 @@ void CallBackIdleFunc(void)
 	 
   // return as nothing has to be updated
   if (haveToUpdate == 0) {
-    if (!fullydisplayed && !mousemoving && !keypressed && pointmode == 0
+    if (frameScheduling) {
+      // refine over the next frames instead of drawing everything at once
+      if (!mousemoving && !keypressed && pointmode == 0 && scheduler.refine())
+        glutPostRedisplay();
+    } else if (!fullydisplayed && !mousemoving && !keypressed && pointmode == 0
         ) {
       glDrawBuffer(buffermode);
       //Call the display function
@@ -1928,10 +2086,12 @@ void changeColorMap(int dummy) {
     default:
       break;
   }
+  invalidateBatches();
 }
 
 void minmaxChanged(int dummy) {
   cm->setMinMax(mincolor_value, maxcolor_value);
+  invalidateBatches();
 }
 
 void resetMinMax(int dummy) {
@@ -1954,6 +2114,7 @@ void setScansColored(int dummy) {
     default:
       break;
   }
+  invalidateBatches();
 }
 
 
@@ -40,6 +40,9 @@ GLUI_Spinner    *fps_spinner;
 GLUI_Spinner    *farplane_spinner;
 GLUI_Spinner    *nearplane_spinner;
 GLUI_Spinner    *lod_spinner;
+GLUI_Spinner    *frametime_spinner;
+/** GLUI text showing budget and frame time of the frame scheduler */
+GLUI_StaticText *budget_text;
 
 int window_id_menu1, ///< menue window ids
     window_id_menu2; ///< menue window ids
@@ -408,6 +411,14 @@ GLUI_SPINNER_INT, &factor);
     lod_spinner->set_float_limits( 0, 3.0 );
     lod_spinner->set_speed( 0.1 );
     lod_spinner->set_alignment(GLUI_ALIGN_RIGHT);
+
+    glui1->add_checkbox_to_panel(advanced_panel, "Point budget", &frameScheduling);
+    frametime_spinner = glui1->add_spinner_to_panel(advanced_panel, "frame ms :   ",
+        GLUI_SPINNER_FLOAT, &frametime);
+    frametime_spinner->set_float_limits( 1, 1000 );
+    frametime_spinner->set_speed( 1 );
+    frametime_spinner->set_alignment(GLUI_ALIGN_RIGHT);
+    budget_text = glui1->add_statictext_to_panel(advanced_panel, "");
     
     glui1->add_separator();
   }
@@ -444,6 +455,18 @@ void pathAnimate(int dummy) {
 }
 
 
+/**
+ * Shows the budget and the achieved frame time of the frame scheduler
+ */
+void updateBudgetText() {
+  if (!budget_text) return;
+  char text[128];
+  snprintf(text, 128, "%lu pts, %.0f ms (%.0f ms)",
+           scheduler.getDrawnPoints(), scheduler.getFrameTime(), scheduler.getTargetTime());
+  budget_text->set_text(text);
+}
+
+
 /**
  * This function clears the selected points  
  */
@@ -82,42 +82,15 @@ void calcRay(int x, int y, double znear, double zfar)  {
   remViewport();
 }
 
-void remViewport() {
-  GLdouble modelMatrix[16];
-  GLdouble projMatrix[16];
-  int viewport[4];
-  glGetDoublev(GL_MODELVIEW_MATRIX,modelMatrix);
-  glGetDoublev(GL_PROJECTION_MATRIX,projMatrix);
-  glGetIntegerv(GL_VIEWPORT,viewport);
-
-  MMult( projMatrix, modelMatrix, matrix );
-  VP[0] = 0.5*viewport[2];
-  VP[1] = 0.5*viewport[2] + viewport[0];
-
-  VP[2] = 0.5*viewport[3];
-  VP[3] = 0.5*viewport[3] + viewport[1];
-
-  right[0] = modelMatrix[0];
-  right[1] = modelMatrix[4];
-  right[2] = modelMatrix[8];
-}
-
-void ExtractFrustum(short detail)
+/**
+ * Computes the normalized clipping planes of the view volume given by the
+ * modelview and projection matrices (column-major, as used by OpenGL).
+ */
+static void calcFrustum(const float *modl, const float *proj, float fr[6][4])
 {
-   DETAIL = detail + 1;
-   remViewport();
-
-   float   proj[16];
-   float   modl[16];
    float   clip[16];
    float   t;
 
-   /* Get the current PROJECTION matrix from OpenGL */
-   glGetFloatv( GL_PROJECTION_MATRIX, proj );
-
-   /* Get the current MODELVIEW matrix from OpenGL */
-   glGetFloatv( GL_MODELVIEW_MATRIX, modl );
-
    /* Combine the two matrices (multiply projection by modelview) */
    clip[ 0] = modl[ 0] * proj[ 0] + modl[ 1] * proj[ 4] + modl[ 2] * proj[ 8] + modl[ 3] * proj[12];
    clip[ 1] = modl[ 0] * proj[ 1] + modl[ 1] * proj[ 5] + modl[ 2] * proj[ 9] + modl[ 3] * proj[13];
@@ -139,95 +112,60 @@ void ExtractFrustum(short detail)
    clip[14] = modl[12] * proj[ 2] + modl[13] * proj[ 6] + modl[14] * proj[10] + modl[15] * proj[14];
    clip[15] = modl[12] * proj[ 3] + modl[13] * proj[ 7] + modl[14] * proj[11] + modl[15] * proj[15];
 
-   /* Extract the numbers for the RIGHT plane */
-   frustum[0][0] = clip[ 3] - clip[ 0];
-   frustum[0][1] = clip[ 7] - clip[ 4];
-   frustum[0][2] = clip[11] - clip[ 8];
-   frustum[0][3] = clip[15] - clip[12];
-
-   /* Normalize the result */
-   t = sqrt( frustum[0][0] * frustum[0][0] + frustum[0][1] * frustum[0][1] + frustum[0][2] * frustum[0][2] );
-   frustum[0][0] /= t;
-   frustum[0][1] /= t;
-   frustum[0][2] /= t;
-   frustum[0][3] /= t;
-
-   /* Extract the numbers for the LEFT plane */
-   frustum[1][0] = clip[ 3] + clip[ 0];
-   frustum[1][1] = clip[ 7] + clip[ 4];
-   frustum[1][2] = clip[11] + clip[ 8];
-   frustum[1][3] = clip[15] + clip[12];
-
-   /* Normalize the result */
-   t = sqrt( frustum[1][0] * frustum[1][0] + frustum[1][1] * frustum[1][1] + frustum[1][2] * frustum[1][2] );
-   frustum[1][0] /= t;
-   frustum[1][1] /= t;
-   frustum[1][2] /= t;
-   frustum[1][3] /= t;
-
-   /* Extract the BOTTOM plane */
-   frustum[2][0] = clip[ 3] + clip[ 1];
-   frustum[2][1] = clip[ 7] + clip[ 5];
-   frustum[2][2] = clip[11] + clip[ 9];
-   frustum[2][3] = clip[15] + clip[13];
-
-   /* Normalize the result */
-   t = sqrt( frustum[2][0] * frustum[2][0] + frustum[2][1] * frustum[2][1] + frustum[2][2] * frustum[2][2] );
-   frustum[2][0] /= t;
-   frustum[2][1] /= t;
-   frustum[2][2] /= t;
-   frustum[2][3] /= t;
-
-   /* Extract the TOP plane */
-   frustum[3][0] = clip[ 3] - clip[ 1];
-   frustum[3][1] = clip[ 7] - clip[ 5];
-   frustum[3][2] = clip[11] - clip[ 9];
-   frustum[3][3] = clip[15] - clip[13];
-
-   /* Normalize the result */
-   t = sqrt( frustum[3][0] * frustum[3][0] + frustum[3][1] * frustum[3][1] + frustum[3][2] * frustum[3][2] );
-   frustum[3][0] /= t;
-   frustum[3][1] /= t;
-   frustum[3][2] /= t;
-   frustum[3][3] /= t;
-
-   /* Extract the FAR plane */
-   frustum[4][0] = clip[ 3] - clip[ 2];
-   frustum[4][1] = clip[ 7] - clip[ 6];
-   frustum[4][2] = clip[11] - clip[10];
-   frustum[4][3] = clip[15] - clip[14];
-
-   /* Normalize the result */
-   t = sqrt( frustum[4][0] * frustum[4][0] + frustum[4][1] * frustum[4][1] + frustum[4][2] * frustum[4][2] );
-   frustum[4][0] /= t;
-   frustum[4][1] /= t;
-   frustum[4][2] /= t;
-   frustum[4][3] /= t;
-
-   /* Extract the NEAR plane */
-   frustum[5][0] = clip[ 3] + clip[ 2];
-   frustum[5][1] = clip[ 7] + clip[ 6];
-   frustum[5][2] = clip[11] + clip[10];
-   frustum[5][3] = clip[15] + clip[14];
-
-   /* Normalize the result */
-   t = sqrt( frustum[5][0] * frustum[5][0] + frustum[5][1] * frustum[5][1] + frustum[5][2] * frustum[5][2] );
-   frustum[5][0] /= t;
-   frustum[5][1] /= t;
-   frustum[5][2] /= t;
-   frustum[5][3] /= t;
+   /* Extract the RIGHT, LEFT, BOTTOM, TOP, FAR and NEAR planes */
+   static const int   row[6]  = {  0,   0,   1,   1,   2,   2  };
+   static const float sign[6] = { -1.0, 1.0, 1.0, -1.0, -1.0, 1.0 };
+   for (int p = 0; p < 6; p++) {
+     for (int k = 0; k < 4; k++) {
+       fr[p][k] = clip[4*k + 3] + sign[p] * clip[4*k + row[p]];
+     }
+
+     /* Normalize the result */
+     t = sqrt( fr[p][0] * fr[p][0] + fr[p][1] * fr[p][1] + fr[p][2] * fr[p][2] );
+     fr[p][0] /= t;
+     fr[p][1] /= t;
+     fr[p][2] /= t;
+     fr[p][3] /= t;
+   }
+}
+
+/**
+ * Computes the matrix mapping a model point to screen coordinates and the
+ * viewport constants used by myProject.
+ */
+static void calcViewport(const double *modelMatrix, const double *projMatrix, const int *viewport,
+                         float *mat, short *vp, float *r)
+{
+  MMult( projMatrix, modelMatrix, mat );
+  vp[0] = 0.5*viewport[2];
+  vp[1] = 0.5*viewport[2] + viewport[0];
+
+  vp[2] = 0.5*viewport[3];
+  vp[3] = 0.5*viewport[3] + viewport[1];
 
+  r[0] = modelMatrix[0];
+  r[1] = modelMatrix[4];
+  r[2] = modelMatrix[8];
 }
 
+void remViewport() {
+  GLdouble modelMatrix[16];
+  GLdouble projMatrix[16];
+  int viewport[4];
+  glGetDoublev(GL_MODELVIEW_MATRIX,modelMatrix);
+  glGetDoublev(GL_PROJECTION_MATRIX,projMatrix);
+  glGetIntegerv(GL_VIEWPORT,viewport);
 
-void ExtractFrustum(float *frust[6])
+  calcViewport(modelMatrix, projMatrix, viewport, matrix, VP, right);
+}
+
+void ExtractFrustum(short detail)
 {
+   DETAIL = detail + 1;
    remViewport();
 
    float   proj[16];
    float   modl[16];
-   float   clip[16];
-   float   t;
 
    /* Get the current PROJECTION matrix from OpenGL */
    glGetFloatv( GL_PROJECTION_MATRIX, proj );
@@ -235,110 +173,36 @@ void ExtractFrustum(float *frust[6])
    /* Get the current MODELVIEW matrix from OpenGL */
    glGetFloatv( GL_MODELVIEW_MATRIX, modl );
 
-   /* Combine the two matrices (multiply projection by modelview) */
-   clip[ 0] = modl[ 0] * proj[ 0] + modl[ 1] * proj[ 4] + modl[ 2] * proj[ 8] + modl[ 3] * proj[12];
-   clip[ 1] = modl[ 0] * proj[ 1] + modl[ 1] * proj[ 5] + modl[ 2] * proj[ 9] + modl[ 3] * proj[13];
-   clip[ 2] = modl[ 0] * proj[ 2] + modl[ 1] * proj[ 6] + modl[ 2] * proj[10] + modl[ 3] * proj[14];
-   clip[ 3] = modl[ 0] * proj[ 3] + modl[ 1] * proj[ 7] + modl[ 2] * proj[11] + modl[ 3] * proj[15];
+   calcFrustum(modl, proj, frustum);
+}
 
-   clip[ 4] = modl[ 4] * proj[ 0] + modl[ 5] * proj[ 4] + modl[ 6] * proj[ 8] + modl[ 7] * proj[12];
-   clip[ 5] = modl[ 4] * proj[ 1] + modl[ 5] * proj[ 5] + modl[ 6] * proj[ 9] + modl[ 7] * proj[13];
-   clip[ 6] = modl[ 4] * proj[ 2] + modl[ 5] * proj[ 6] + modl[ 6] * proj[10] + modl[ 7] * proj[14];
-   clip[ 7] = modl[ 4] * proj[ 3] + modl[ 5] * proj[ 7] + modl[ 6] * proj[11] + modl[ 7] * proj[15];
 
-   clip[ 8] = modl[ 8] * proj[ 0] + modl[ 9] * proj[ 4] + modl[10] * proj[ 8] + modl[11] * proj[12];
-   clip[ 9] = modl[ 8] * proj[ 1] + modl[ 9] * proj[ 5] + modl[10] * proj[ 9] + modl[11] * proj[13];
-   clip[10] = modl[ 8] * proj[ 2] + modl[ 9] * proj[ 6] + modl[10] * proj[10] + modl[11] * proj[14];
-   clip[11] = modl[ 8] * proj[ 3] + modl[ 9] * proj[ 7] + modl[10] * proj[11] + modl[11] * proj[15];
+void ExtractFrustum(float *frust[6])
+{
+   remViewport();
 
-   clip[12] = modl[12] * proj[ 0] + modl[13] * proj[ 4] + modl[14] * proj[ 8] + modl[15] * proj[12];
-   clip[13] = modl[12] * proj[ 1] + modl[13] * proj[ 5] + modl[14] * proj[ 9] + modl[15] * proj[13];
-   clip[14] = modl[12] * proj[ 2] + modl[13] * proj[ 6] + modl[14] * proj[10] + modl[15] * proj[14];
-   clip[15] = modl[12] * proj[ 3] + modl[13] * proj[ 7] + modl[14] * proj[11] + modl[15] * proj[15];
+   float   proj[16];
+   float   modl[16];
+   float   fr[6][4];
 
-   /* Extract the numbers for the RIGHT plane */
-   frust[0][0] = clip[ 3] - clip[ 0];
-   frust[0][1] = clip[ 7] - clip[ 4];
-   frust[0][2] = clip[11] - clip[ 8];
-   frust[0][3] = clip[15] - clip[12];
-
-   /* Normalize the result */
-   t = sqrt( frust[0][0] * frust[0][0] + frust[0][1] * frust[0][1] + frust[0][2] * frust[0][2] );
-   frust[0][0] /= t;
-   frust[0][1] /= t;
-   frust[0][2] /= t;
-   frust[0][3] /= t;
-
-   /* Extract the numbers for the LEFT plane */
-   frust[1][0] = clip[ 3] + clip[ 0];
-   frust[1][1] = clip[ 7] + clip[ 4];
-   frust[1][2] = clip[11] + clip[ 8];
-   frust[1][3] = clip[15] + clip[12];
-
-   /* Normalize the result */
-   t = sqrt( frust[1][0] * frust[1][0] + frust[1][1] * frust[1][1] + frust[1][2] * frust[1][2] );
-   frust[1][0] /= t;
-   frust[1][1] /= t;
-   frust[1][2] /= t;
-   frust[1][3] /= t;
-
-   /* Extract the BOTTOM plane */
-   frust[2][0] = clip[ 3] + clip[ 1];
-   frust[2][1] = clip[ 7] + clip[ 5];
-   frust[2][2] = clip[11] + clip[ 9];
-   frust[2][3] = clip[15] + clip[13];
-
-   /* Normalize the result */
-   t = sqrt( frust[2][0] * frust[2][0] + frust[2][1] * frust[2][1] + frust[2][2] * frust[2][2] );
-   frust[2][0] /= t;
-   frust[2][1] /= t;
-   frust[2][2] /= t;
-   frust[2][3] /= t;
-
-   /* Extract the TOP plane */
-   frust[3][0] = clip[ 3] - clip[ 1];
-   frust[3][1] = clip[ 7] - clip[ 5];
-   frust[3][2] = clip[11] - clip[ 9];
-   frust[3][3] = clip[15] - clip[13];
-
-   /* Normalize the result */
-   t = sqrt( frust[3][0] * frust[3][0] + frust[3][1] * frust[3][1] + frust[3][2] * frust[3][2] );
-   frust[3][0] /= t;
-   frust[3][1] /= t;
-   frust[3][2] /= t;
-   frust[3][3] /= t;
-
-   /* Extract the FAR plane */
-   frust[4][0] = clip[ 3] - clip[ 2];
-   frust[4][1] = clip[ 7] - clip[ 6];
-   frust[4][2] = clip[11] - clip[10];
-   frust[4][3] = clip[15] - clip[14];
-
-   /* Normalize the result */
-   t = sqrt( frust[4][0] * frust[4][0] + frust[4][1] * frust[4][1] + frust[4][2] * frust[4][2] );
-   frust[4][0] /= t;
-   frust[4][1] /= t;
-   frust[4][2] /= t;
-   frust[4][3] /= t;
-
-   /* Extract the NEAR plane */
-   frust[5][0] = clip[ 3] + clip[ 2];
-   frust[5][1] = clip[ 7] + clip[ 6];
-   frust[5][2] = clip[11] + clip[10];
-   frust[5][3] = clip[15] + clip[14];
-
-   /* Normalize the result */
-   t = sqrt( frust[5][0] * frust[5][0] + frust[5][1] * frust[5][1] + frust[5][2] * frust[5][2] );
-   frust[5][0] /= t;
-   frust[5][1] /= t;
-   frust[5][2] /= t;
-   frust[5][3] /= t;
+   /* Get the current PROJECTION matrix from OpenGL */
+   glGetFloatv( GL_PROJECTION_MATRIX, proj );
+
+   /* Get the current MODELVIEW matrix from OpenGL */
+   glGetFloatv( GL_MODELVIEW_MATRIX, modl );
 
+   calcFrustum(modl, proj, fr);
+   for (int p = 0; p < 6; p++) {
+     for (int k = 0; k < 4; k++) {
+       frust[p][k] = fr[p][k];
+     }
+   }
 }
 
 
 
-void myProject(float x, float y, float z, short &Xi ) {
+static inline void myProject(const float *matrix, const short *VP,
+                             float x, float y, float z, short &Xi ) {
   float pn[2];
   // x coordinate on screen, not normalized
   pn[0] = x * matrix[0] + y * matrix[4] + z * matrix[8]  + matrix[12];
@@ -352,7 +216,8 @@ void myProject(float x, float y, float z, short &Xi ) {
   Xi = pn[0]*VP[0] + VP[1];
 }
 
-int LOD2(float x, float y, float z, float size)
+static int calcLOD2(const float *matrix, const short *VP, const float *right,
+                    float x, float y, float z, float size)
 {
   size = sqrt(3*size*size);
 
@@ -360,9 +225,9 @@ int LOD2(float x, float y, float z, float size)
   short X2;
  
   // onscreen position of the leftmost point
-  myProject(x - size*right[0], y - size*right[1], z - size*right[2], X1);
+  myProject(matrix, VP, x - size*right[0], y - size*right[1], z - size*right[2], X1);
   // onscreen position of the rightmost point
-  myProject(x + size*right[0], y + size*right[1], z + size*right[2], X2);
+  myProject(matrix, VP, x + size*right[0], y + size*right[1], z + size*right[2], X2);
 
   if (X1 > X2) {
     return (X1-X2);
@@ -371,7 +236,8 @@ int LOD2(float x, float y, float z, float size)
   }
 }
 
-bool LOD(float x, float y, float z, float size)
+static bool calcLOD(const float *matrix, const short *VP, const float *right, short DETAIL,
+                    float x, float y, float z, float size)
 {
   size = sqrt(3*size*size);
 
@@ -379,9 +245,9 @@ bool LOD(float x, float y, float z, float size)
   short X2;
  
   // onscreen position of the leftmost point
-  myProject(x - size*right[0], y - size*right[1], z - size*right[2], X1);
+  myProject(matrix, VP, x - size*right[0], y - size*right[1], z - size*right[2], X1);
   // onscreen position of the rightmost point
-  myProject(x + size*right[0], y + size*right[1], z + size*right[2], X2);
+  myProject(matrix, VP, x + size*right[0], y + size*right[1], z + size*right[2], X2);
 
   if (X1 > X2) {
     return (X1-X2) > DETAIL;
@@ -391,12 +257,22 @@ bool LOD(float x, float y, float z, float size)
 }
 
 
+int LOD2(float x, float y, float z, float size)
+{
+  return calcLOD2(matrix, VP, right, x, y, z, size);
+}
+
+bool LOD(float x, float y, float z, float size)
+{
+  return calcLOD(matrix, VP, right, DETAIL, x, y, z, size);
+}
+
 /**
  * 0 if not in frustrum
  * 1 if partial overlap
  * 2 if entirely within frustrum
  */
-int CubeInFrustum2( float x, float y, float z, float size )
+static int calcCubeInFrustum2( const float frustum[6][4], float x, float y, float z, float size )
 {
    int p;
 
@@ -792,7 +668,7 @@ int QuadInFrustrum2old( float x, float y, float z, float size )
 
 }
 
-bool CubeInFrustum( float x, float y, float z, float size )
+static bool calcCubeInFrustum( const float frustum[6][4], float x, float y, float z, float size )
 {
    int p;
 
@@ -842,6 +718,97 @@ bool CubeInFrustum( float x, float y, float z, float size )
 
 
 
+int CubeInFrustum2( float x, float y, float z, float size )
+{
+  return calcCubeInFrustum2(frustum, x, y, z, size);
+}
+
+bool CubeInFrustum( float x, float y, float z, float size )
+{
+  return calcCubeInFrustum(frustum, x, y, z, size);
+}
+
+
+void ViewFrustum::fromGlobals()
+{
+  for (int p = 0; p < 6; p++) {
+    for (int k = 0; k < 4; k++) {
+      frustum[p][k] = show::frustum[p][k];
+    }
+  }
+  for (int i = 0; i < 16; i++) {
+    matrix[i] = show::matrix[i];
+  }
+  for (int i = 0; i < 4; i++) {
+    VP[i] = show::VP[i];
+  }
+  for (int i = 0; i < 3; i++) {
+    right[i] = show::right[i];
+  }
+  DETAIL = show::DETAIL;
+}
+
+void ViewFrustum::set(const float *modl, const float *proj, const int *viewport, short detail)
+{
+  double modelMatrix[16];
+  double projMatrix[16];
+  for (int i = 0; i < 16; i++) {
+    modelMatrix[i] = modl[i];
+    projMatrix[i] = proj[i];
+  }
+
+  DETAIL = detail + 1;
+  calcViewport(modelMatrix, projMatrix, viewport, matrix, VP, right);
+  calcFrustum(modl, proj, frustum);
+}
+
+bool ViewFrustum::similar(const ViewFrustum &other, float eps) const
+{
+  if (DETAIL != other.DETAIL) return false;
+  for (int i = 0; i < 4; i++) {
+    if (VP[i] != other.VP[i]) return false;
+  }
+  for (int i = 0; i < 16; i++) {
+    if (fabs(matrix[i] - other.matrix[i]) > eps) return false;
+  }
+  return true;
+}
+
+bool ViewFrustum::CubeInFrustum( float x, float y, float z, float size ) const
+{
+  return calcCubeInFrustum(frustum, x, y, z, size);
+}
+
+int ViewFrustum::CubeInFrustum2( float x, float y, float z, float size ) const
+{
+  return calcCubeInFrustum2(frustum, x, y, z, size);
+}
+
+bool ViewFrustum::LOD(float x, float y, float z, float size) const
+{
+  return calcLOD(matrix, VP, right, DETAIL, x, y, z, size);
+}
+
+int ViewFrustum::LOD2(float x, float y, float z, float size) const
+{
+  return calcLOD2(matrix, VP, right, x, y, z, size);
+}
+
+float ViewFrustum::ScreenCoverage(float x, float y, float z, float size) const
+{
+  if (calcCubeInFrustum2(frustum, x, y, z, size) == 0) return 0.0;
+
+  // distance of the center along the viewing direction
+  float w = x * matrix[3] + y * matrix[7] + z * matrix[11] + matrix[15];
+  // the camera is inside or very close to the cube
+  if (w <= sqrt(3.0) * size) return 1.0;
+
+  float extent = calcLOD2(matrix, VP, right, x, y, z, size) / (2.0 * VP[0]);
+  if (extent >= 1.0) return 1.0;
+  return extent * extent;
+}
+
+
 float minB[NUMDIM], maxB[NUMDIM];    /*box */
 float coord[NUMDIM];       /* hit point */
 }
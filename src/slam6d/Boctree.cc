@@ -9,6 +9,13 @@
 
 #include "slam6d/Boctree.h"
 
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 //! Start-of-the-program initializer for the sequence map.
 struct Initializer {
   Initializer() {
@@ -54,3 +61,50 @@ char imap[8][8] = {
   {5, 3, 7, 6, 1, 0, 4, 2 },
   {5, 7, 3, 6, 1, 4, 0, 2 },
   {7, 5, 6, 3, 4, 1, 2, 0 } };
+
+bool readOcttreeImageHeader(const std::string& filename, OcttreeImageHeader& header)
+{
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file.good()) return false;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if(!file.good()) return false;
+  return header.magic[0] == 'X' && header.magic[1] == 'I';
+}
+
+unsigned char* mapOcttreeImage(const std::string& filename, size_t& length)
+{
+#ifndef _MSC_VER
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd < 0) return 0;
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    close(fd);
+    return 0;
+  }
+  length = st.st_size;
+  // private mapping, pages are only copied if a point is changed
+  void* image = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(image == MAP_FAILED) return 0;
+  return reinterpret_cast<unsigned char*>(image);
+#else
+  // no mapping, but still a single read without parsing
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!file.good()) return 0;
+  file.seekg(0, std::ios::end);
+  length = file.tellg();
+  file.seekg(0, std::ios::beg);
+  unsigned char* image = new unsigned char[length];
+  file.read(reinterpret_cast<char*>(image), length);
+  return image;
+#endif
+}
+
+void unmapOcttreeImage(unsigned char* image, size_t length)
+{
+#ifndef _MSC_VER
+  munmap(image, length);
+#else
+  delete[] image;
+#endif
+}
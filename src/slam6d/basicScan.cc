@@ -13,6 +13,7 @@
 #include "slam6d/kd.h"
 #include "slam6d/Boctree.h"
 #include "slam6d/ann_kd.h"
+#include "slam6d/io_utils.h"
 
 #ifdef WITH_METRICS
 #include "slam6d/metrics.h"
@@ -361,19 +362,33 @@ void BasicScan::createOcttree()
   string scanFileName = m_path + "scan" + m_identifier + ".oct";
   BOctTree<float>* btree = 0;
 
+  // the filters change the points as well as the scan files do
+  unsigned long long source = scanFingerprint(m_path, m_identifier, m_type);
+  double filter[4] = { m_filter_range_set ? m_filter_max : 0.0, m_filter_range_set ? m_filter_min : 0.0,
+                       m_filter_height_set ? m_filter_top : 0.0, m_filter_height_set ? m_filter_bottom : 0.0 };
+  source = fingerprint(source, filter, sizeof(filter));
+  bool outdated = false;
+
   // try to load from file, if successful return
+  // octree images are checked against the parameters, serialized octrees are taken as they are
   if(octtree_loadOct && exists(scanFileName)) {
-    btree = new BOctTree<float>(scanFileName);
-    m_data.insert(
-      std::make_pair(
-        "octtree",
+    if(!BOctTree<float>::isImage(scanFileName) ||
+       BOctTree<float>::isCurrentImage(scanFileName, octtree_voxelSize, octtree_reduction_voxelSize,
+                                       octtree_pointtype, source)) {
+      btree = new BOctTree<float>(scanFileName);
+      m_data.insert(
         std::make_pair(
-          reinterpret_cast<unsigned char*>(btree),
-          0 // or memorySize()?
+          "octtree",
+          std::make_pair(
+            reinterpret_cast<unsigned char*>(btree),
+            0 // or memorySize()?
+          )
         )
-      )
-    );
-    return;
+      );
+      return;
+    }
+    cout << "Octree " << scanFileName << " is outdated, rebuilding it" << endl;
+    outdated = true;
   }
 
   // create octtree from scan
@@ -388,9 +403,9 @@ void BasicScan::createOcttree()
   }
 
   // save created octtree
-  if(octtree_saveOct) {
+  if(octtree_saveOct || outdated) {
     cout << "Saving octree " << scanFileName << endl;
-    btree->serialize(scanFileName);
+    btree->serializeImage(scanFileName, octtree_reduction_voxelSize, source);
   }
 
   m_data.insert(
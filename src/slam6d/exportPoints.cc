@@ -10,25 +10,50 @@
 
 /**
  * @file
+ * @brief Exports all registered scans as a single point cloud
+ *
+ * The scans are read, reduced and transformed with their last frame in
+ * parallel. The points are formatted in chunks of bounded size and written
+ * to one output file, either in the order of the scans or as soon as a
+ * chunk is ready.
+ *
  * @author Jochen Sprickerhof. Institute of Computer Science, University of Osnabrueck, Germany.
  */
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include <string>
 using std::string;
 #include <iostream>
 using std::cout;
 using std::cerr;
 using std::endl;
-#include <fstream>
-using std::ifstream;
 #include <stdexcept>
 using std::exception;
+#include <cstdio>
+#include <cstring>
 
 #include <vector>
-#include <map>
+using std::vector;
+#include <list>
+#include <algorithm>
 
 #include "slam6d/scan.h"
+#include "slam6d/Boctree.h"
+#include "slam6d/point_type.h"
 #include "slam6d/globals.icc"
+#include "scanserver/clientInterface.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifndef _MSC_VER
 #include <getopt.h>
@@ -43,6 +68,8 @@ using std::exception;
 #include <strings.h>
 #endif
 
+enum export_format { EXPORT_UOS, EXPORT_XYZ, EXPORT_PLY };
+
 /**
  * Explains the usage of this program's command line parameters
  */
@@ -60,6 +87,9 @@ void usage(char* prog)
 	  << "   " << prog << " [options] directory" << endl << endl;
   cout << bold << "OPTIONS" << normal << endl
 
+	  << endl
+	  << bold << "  -c" << normal << " NR, " << bold << "--chunk=" << normal << "NR" << endl
+	  << "         format and write the points in chunks of NR points [default: 1000000]" << endl
 	  << endl
 	  << bold << "  -e" << normal << " NR, " << bold << "--end=" << normal << "NR" << endl
 	  << "         end after scan NR" << endl
@@ -74,17 +104,20 @@ void usage(char* prog)
 	  << bold << "  -M" << normal << " NR, " << bold << "--min=" << normal << "NR" << endl
 	  << "         neglegt all data points with a distance smaller than NR 'units'" << endl
 	  << endl
+	  << bold << "  -o" << normal << " FILE, " << bold << "--output=" << normal << "FILE" << endl
+	  << "         write the points to FILE [default: points.pts]" << endl
+	  << endl
 	  << bold << "  -O" << normal << " NR (optional), " << bold << "--octree=" << normal << "NR (optional)" << endl
-	  << "         use randomized octree based point reduction (pts per voxel=<NR>)" << endl
+	  << "         keep NR randomly chosen points per voxel [default: 1]" << endl
 	  << "         requires -r or --reduce" << endl
 	  << endl
 	  << bold << "  -p, --trustpose" << normal << endl
-	  << "         Trust the pose file, do not extrapolate the last transformation." << endl
+	  << "         Trust the pose file, do not use the .frames files." << endl
 	  << "         (just for testing purposes, or gps input.)" << endl
 	  << endl
-	  << endl
 	  << bold << "  -r" << normal << " NR, " << bold << "--reduce=" << normal << "NR" << endl
 	  << "         turns on octree based point reduction (voxel size=<NR>)" << endl
+	  << "         the exported points are points of the scan, so their attributes are kept" << endl
 	  << endl
 	  << bold << "  -R" << normal << " NR, " << bold << "--random=" << normal << "NR" << endl
 	  << "         turns on randomized reduction, using about every <NR>-th point only" << endl
@@ -93,10 +126,25 @@ void usage(char* prog)
 	  << "         start at scan NR (i.e., neglects the first NR scans)" << endl
 	  << "         [ATTENTION: counting naturally starts with 0]" << endl
 	  << endl
+	  << bold << "  -S, --scanserver" << normal << endl
+	  << "         Use the scanserver as an input method and handling of scan data" << endl
+	  << endl
+	  << bold << "  -t" << normal << " F, " << bold << "--target=" << normal << "F" << endl
+	  << "         output format F, one of" << endl
+	  << "         uos  text, one point per line, preceded by a header line [default]" << endl
+	  << "         xyz  text, one point per line" << endl
+	  << "         ply  binary PLY with double coordinates" << endl
+	  << endl
+	  << bold << "  -u, --unordered" << normal << endl
+	  << "         write the chunks as soon as they are ready instead of in the order of the scans" << endl
+	  << endl
+	  << bold << "  --reflectance, --color, --temperature, --amplitude, --type, --deviation" << normal << endl
+	  << "         export the attribute with every point, 0 if a scan does not provide it" << endl
     	  << endl << endl;
   
   cout << bold << "EXAMPLES " << normal << endl
-	  << "   " << prog << " -s 2 -e 3 dat" << endl << endl;
+	  << "   " << prog << " -s 2 -e 3 dat" << endl
+	  << "   " << prog << " -r 10 -t ply --reflectance -o campaign.ply dat" << endl << endl;
   exit(1);
 }
 
@@ -107,32 +155,27 @@ void usage(char* prog)
  * @param dir the directory
  * @param red using point reduction?
  * @param rand use randomized point reduction?
- * @param mdm maximal distance match
- * @param mdml maximal distance match for SLAM
- * @param mni maximal number of iterations
  * @param start starting at scan number 'start'
  * @param end stopping at scan number 'end'
  * @param maxDist - maximal distance of points being loaded
  * @param minDist - minimal distance of points being loaded
- * @param quiet switches on/off the quiet mode
- * @param veryQuiet switches on/off the 'very quiet' mode
- * @param extrapolate_pose - i.e., extrapolating the odometry by the last transformation
+ * @param use_frames - i.e., use the last transformation of the .frames files
  *        (vs. taking the pose file as <b>exact</b>)
- * @param meta match against all scans (= meta scan), or against the last scan only???
- * @param anim selects the rotation representation for the matching algorithm
- * @param mni_lum sets the maximal number of iterations for SLAM
- * @param net specifies the file that includes the net structure for SLAM
- * @param cldist specifies the maximal distance for closed loops
- * @param epsilonICP stop ICP iteration if difference is smaller than this value
- * @param epsilonSLAM stop SLAM iteration if average difference is smaller than this value
- * @param algo specfies the used algorithm for rotation computation
- * @param lum6DAlgo specifies the used algorithm for global SLAM correction
- * @param loopsize defines the minimal loop size
+ * @param octree number of points kept per voxel
+ * @param type the input format
+ * @param types the attributes to export as PointType flags
+ * @param output the output file
+ * @param format the output format
+ * @param ordered write the scans in order
+ * @param chunk points per chunk
+ * @param scanserver use the scanserver
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
-		    int &start, int &end, int &maxDist, int &minDist, bool &extrapolate_pose,
-		    int &octree, IOType &type)
+		    int &start, int &end, int &maxDist, int &minDist, bool &use_frames,
+		    int &octree, IOType &type, unsigned int &types, string &output,
+		    export_format &format, bool &ordered, unsigned int &chunk,
+		    bool &scanserver)
 {
   int  c;
   // from unistd.h:
@@ -148,12 +191,25 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     { "reduce",          required_argument,   0,  'r' },
     { "octree",          optional_argument,   0,  'O' },
     { "random",          required_argument,   0,  'R' },
+    { "max",             required_argument,   0,  'm' },
+    { "min",             required_argument,   0,  'M' },
     { "trustpose",       no_argument,         0,  'p' },
+    { "output",          required_argument,   0,  'o' },
+    { "target",          required_argument,   0,  't' },
+    { "unordered",       no_argument,         0,  'u' },
+    { "chunk",           required_argument,   0,  'c' },
+    { "scanserver",      no_argument,         0,  'S' },
+    { "reflectance",     no_argument,         0,  '0' },
+    { "color",           no_argument,         0,  '1' },
+    { "temperature",     no_argument,         0,  '2' },
+    { "amplitude",       no_argument,         0,  '3' },
+    { "type",            no_argument,         0,  '4' },
+    { "deviation",       no_argument,         0,  '5' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
   cout << endl;
-  while ((c = getopt_long(argc, argv, "f:s:e:r:O:R:p", longopts, NULL)) != -1)
+  while ((c = getopt_long(argc, argv, "f:s:e:r:O:R:m:M:po:t:uc:S", longopts, NULL)) != -1)
     switch (c)
 	 {
 	 case 'r':
@@ -185,7 +241,44 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
 	   minDist = atoi(optarg);
 	   break;
 	 case 'p':
-	   extrapolate_pose = false;
+	   use_frames = false;
+	   break;
+	 case 'o':
+	   output = optarg;
+	   break;
+	 case 't':
+	   if (strcasecmp(optarg, "uos") == 0) format = EXPORT_UOS;
+	   else if (strcasecmp(optarg, "xyz") == 0) format = EXPORT_XYZ;
+	   else if (strcasecmp(optarg, "ply") == 0) format = EXPORT_PLY;
+	   else { cerr << "Error: Output format " << optarg << " unknown.\n"; exit(1); }
+	   break;
+	 case 'u':
+	   ordered = false;
+	   break;
+	 case 'c':
+	   chunk = atoi(optarg);
+	   if (chunk < 1) { cerr << "Error: A chunk must hold at least one point.\n"; exit(1); }
+	   break;
+	 case 'S':
+	   scanserver = true;
+	   break;
+	 case '0':
+	   types |= PointType::USE_REFLECTANCE;
+	   break;
+	 case '1':
+	   types |= PointType::USE_COLOR;
+	   break;
+	 case '2':
+	   types |= PointType::USE_TEMPERATURE;
+	   break;
+	 case '3':
+	   types |= PointType::USE_AMPLITUDE;
+	   break;
+	 case '4':
+	   types |= PointType::USE_TYPE;
+	   break;
+	 case '5':
+	   types |= PointType::USE_DEVIATION;
 	   break;
 	 case 'f':
     try {
@@ -217,48 +310,273 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
   return 0;
 }
 
-void readFrames(string dir, int start, int end, IOType &type)
-{
-  ifstream frame_in;
-  int  fileCounter = start;
-  string frameFileName;
-  for (;;) {
-    if (end > -1 && fileCounter > end) break; // 'nuf read
-    frameFileName = dir + "scan" + to_string(fileCounter++,3) + ".frames";
+/**
+ * @brief Writes the chunks of all scans into a single file
+ *
+ * The chunks are formatted concurrently by the threads handling the scans.
+ * Unordered, every chunk is written as soon as it arrives. Ordered, only the
+ * chunks of the first unfinished scan are written right away, the chunks of
+ * later scans are kept until it is their turn. If the kept chunks exceed
+ * max_pending bytes, the threads of later scans wait, so the memory stays
+ * bounded. As OpenMP hands out the scans in order, the first unfinished
+ * scan is always being processed and the threads cannot deadlock.
+ */
+class ChunkWriter {
+public:
+  ChunkWriter(FILE *_out, unsigned int nr_scans, bool _ordered, size_t _max_pending)
+    : out(_out), ordered(_ordered), max_pending(_max_pending), pending_bytes(0),
+      next(0), pending(nr_scans), done(nr_scans, false), bytes(0), failed(false)
+  {
+  }
 
-    frame_in.open(frameFileName.c_str());
+  //! Writes or keeps \a chunk of scan number \a scan, leaves \a chunk empty
+  void write(unsigned int scan, std::string &chunk) {
+    boost::mutex::scoped_lock lock(mutex);
+    while (ordered && scan != next && pending_bytes > 0 &&
+           pending_bytes + chunk.size() > max_pending) {
+      cond.wait(lock);
+    }
+    if (!ordered || scan == next) {
+      put(chunk);
+      chunk.clear();
+    } else {
+      pending_bytes += chunk.size();
+      pending[scan].push_back(std::string());
+      pending[scan].back().swap(chunk);
+    }
+  }
 
-    // read 3D scan
-    if (!frame_in.good()) break; // no more files in the directory
+  //! Marks scan number \a scan as complete
+  void finish(unsigned int scan) {
+    boost::mutex::scoped_lock lock(mutex);
+    done[scan] = true;
+    while (ordered && next < done.size() && done[next]) {
+      next++;
+      if (next < done.size()) {
+        // the kept chunks of the new first scan can be written now
+        for (std::list<std::string>::iterator it = pending[next].begin();
+             it != pending[next].end(); ++it) {
+          put(*it);
+          pending_bytes -= it->size();
+        }
+        pending[next].clear();
+      }
+    }
+    cond.notify_all();
+  }
 
-    cout << "Reading Frames for 3D Scan " << frameFileName << "..." << endl;
+  inline unsigned long long bytesWritten() const { return bytes; }
+  inline bool good() const { return !failed; }
 
- //   vector <double*> Matrices;
-//    vector <Scan::AlgoType> algoTypes;
-    double transMat[16];
-    int algoTypeInt;
+private:
+  void put(const std::string &chunk) {
+    if (chunk.empty()) return;
+    if (fwrite(chunk.data(), 1, chunk.size(), out) != chunk.size()) failed = true;
+    bytes += chunk.size();
+  }
 
-    while (frame_in.good()) {
-      try {
-        frame_in >> transMat >> algoTypeInt;
-      }
-      catch (const exception &e) {   
-        break;
-      }
-    }
+  FILE *out;
+  bool ordered;
+  size_t max_pending;
+  size_t pending_bytes;
+  unsigned int next;
+  vector<std::list<std::string> > pending;
+  vector<bool> done;
+  unsigned long long bytes;
+  bool failed;
 
-    if(type == UOS_MAP || type == UOS_MAP_FRAMES || type == RTS_MAP) {
-      Scan::allScans[fileCounter - start]->transformAll(transMat);
-      if(fileCounter == start+1) {
-        Scan::allScans[0]->transformAll(transMat);
-      }
-    } else {
-      Scan::allScans[fileCounter - start - 1]->transformAll(transMat);
+  boost::mutex mutex;
+  boost::condition cond;
+};
+
+/**
+ * Raw attribute arrays of a scan, 0 if the attribute is not exported or
+ * not provided by the scan
+ */
+struct ExportAttributes {
+  float *reflectance;
+  unsigned char *rgb;
+  float *temperature;
+  float *amplitude;
+  int *type;
+  float *deviation;
+};
+
+template <class T>
+static inline void appendBinary(std::string &buf, T value)
+{
+  buf.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * Appends the point i with the attributes selected by \a types to \a buf
+ */
+static inline void appendPoint(std::string &buf, export_format format,
+                               unsigned int types, const double *p,
+                               const ExportAttributes &a, unsigned int i)
+{
+  if (format == EXPORT_PLY) {
+    appendBinary(buf, p[0]);
+    appendBinary(buf, p[1]);
+    appendBinary(buf, p[2]);
+    if (types & PointType::USE_REFLECTANCE)
+      appendBinary(buf, a.reflectance ? a.reflectance[i] : 0.0f);
+    if (types & PointType::USE_COLOR) {
+      for (unsigned int j = 0; j < 3; ++j)
+        appendBinary(buf, a.rgb ? a.rgb[3*i + j] : (unsigned char)0);
     }
+    if (types & PointType::USE_TEMPERATURE)
+      appendBinary(buf, a.temperature ? a.temperature[i] : 0.0f);
+    if (types & PointType::USE_AMPLITUDE)
+      appendBinary(buf, a.amplitude ? a.amplitude[i] : 0.0f);
+    if (types & PointType::USE_TYPE)
+      appendBinary(buf, a.type ? a.type[i] : 0);
+    if (types & PointType::USE_DEVIATION)
+      appendBinary(buf, a.deviation ? a.deviation[i] : 0.0f);
+    return;
+  }
+
+  char line[256];
+  int len = snprintf(line, sizeof(line), "%.3f %.3f %.3f", p[0], p[1], p[2]);
+  if (types & PointType::USE_REFLECTANCE)
+    len += snprintf(line + len, sizeof(line) - len, " %g", a.reflectance ? a.reflectance[i] : 0.0f);
+  if (types & PointType::USE_COLOR) {
+    if (a.rgb)
+      len += snprintf(line + len, sizeof(line) - len, " %d %d %d", a.rgb[3*i], a.rgb[3*i + 1], a.rgb[3*i + 2]);
+    else
+      len += snprintf(line + len, sizeof(line) - len, " 0 0 0");
+  }
+  if (types & PointType::USE_TEMPERATURE)
+    len += snprintf(line + len, sizeof(line) - len, " %g", a.temperature ? a.temperature[i] : 0.0f);
+  if (types & PointType::USE_AMPLITUDE)
+    len += snprintf(line + len, sizeof(line) - len, " %g", a.amplitude ? a.amplitude[i] : 0.0f);
+  if (types & PointType::USE_TYPE)
+    len += snprintf(line + len, sizeof(line) - len, " %d", a.type ? a.type[i] : 0);
+  if (types & PointType::USE_DEVIATION)
+    len += snprintf(line + len, sizeof(line) - len, " %g", a.deviation ? a.deviation[i] : 0.0f);
+  line[len++] = '\n';
+  buf.append(line, len);
+}
+
+/**
+ * Writes the PLY header. The number of vertices is not known before all
+ * scans are exported, so it is padded to a fixed width and its position in
+ * the file is returned for patching it in the end.
+ */
+static long writePlyHeader(FILE *out, unsigned int types)
+{
+  unsigned int one = 1;
+  bool little_endian = *reinterpret_cast<unsigned char*>(&one) == 1;
+  fprintf(out, "ply\nformat %s 1.0\ncomment exported by exportPoints\n",
+          little_endian ? "binary_little_endian" : "binary_big_endian");
+  fprintf(out, "element vertex ");
+  long count_pos = ftell(out);
+  fprintf(out, "%-20d\n", 0);
+  fprintf(out, "property double x\nproperty double y\nproperty double z\n");
+  if (types & PointType::USE_REFLECTANCE) fprintf(out, "property float reflectance\n");
+  if (types & PointType::USE_COLOR)
+    fprintf(out, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+  if (types & PointType::USE_TEMPERATURE) fprintf(out, "property float temperature\n");
+  if (types & PointType::USE_AMPLITUDE) fprintf(out, "property float amplitude\n");
+  if (types & PointType::USE_TYPE) fprintf(out, "property int type\n");
+  if (types & PointType::USE_DEVIATION) fprintf(out, "property float deviation\n");
+  fprintf(out, "end_header\n");
+  return count_pos;
+}
+
+/**
+ * Chooses the points of a scan to export. With reduction an octree of the
+ * point indices is built and ptspervoxel random points are taken from every
+ * voxel, so that the attributes of the chosen points stay valid.
+ */
+static void selectPoints(DataXYZ &xyz, double red, int octree, int rand,
+                         vector<unsigned int> &selected)
+{
+  selected.clear();
+  unsigned int step = rand > 1 ? rand : 1;
+  if (red <= 0.0) {
+    for (unsigned int i = 0; i < xyz.size(); i += step) selected.push_back(i);
+    return;
+  }
+
+  // x, y, z and the index of each point
+  PointType pointtype(PointType::USE_INDEX);
+  double *data = new double[4 * (size_t)xyz.size()];
+  double **pts = new double*[xyz.size()];
+  for (unsigned int i = 0; i < xyz.size(); ++i) {
+    pts[i] = data + 4 * (size_t)i;
+    pts[i][0] = xyz[i][0];
+    pts[i][1] = xyz[i][1];
+    pts[i][2] = xyz[i][2];
+    pts[i][3] = i;
+  }
+  BOctTree<double> *oct = new BOctTree<double>(pts, xyz.size(), red, pointtype);
+  delete[] pts;
+  delete[] data;
+
+  vector<double*> reduced;
+  oct->GetOctTreeRandom(reduced, octree > 0 ? octree : 1);
+  for (unsigned int i = 0; i < reduced.size(); i += step) {
+    selected.push_back((unsigned int)reduced[i][3]);
+  }
+  delete oct;
 
-    frame_in.close();
-    frame_in.clear();
+  // keep the order of the scan for cache friendly access and stable output
+  std::sort(selected.begin(), selected.end());
+}
+
+/**
+ * The attribute of the scan if it is requested in types, empty otherwise
+ */
+static DataPointer getAttribute(Scan *scan, unsigned int types, unsigned int flag,
+                                const char *identifier)
+{
+  if (types & flag) return scan->get(identifier);
+  return DataPointer(0, 0);
+}
+
+/**
+ * Exports one scan in chunks of at most chunk points via the writer
+ *
+ * @return the number of exported points
+ */
+static unsigned long exportScan(Scan *scan, unsigned int index, const double *transMat,
+                                double red, int octree, int rand, unsigned int types,
+                                export_format format, unsigned int chunk,
+                                ChunkWriter &writer)
+{
+  DataXYZ xyz(scan->get("xyz"));
+  DataReflectance reflectance(getAttribute(scan, types, PointType::USE_REFLECTANCE, "reflectance"));
+  DataRGB rgb(getAttribute(scan, types, PointType::USE_COLOR, "rgb"));
+  DataTemperature temperature(getAttribute(scan, types, PointType::USE_TEMPERATURE, "temperature"));
+  DataAmplitude amplitude(getAttribute(scan, types, PointType::USE_AMPLITUDE, "amplitude"));
+  DataType type(getAttribute(scan, types, PointType::USE_TYPE, "type"));
+  DataDeviation deviation(getAttribute(scan, types, PointType::USE_DEVIATION, "deviation"));
+
+  ExportAttributes attributes;
+  attributes.reflectance = reflectance.size() == xyz.size() && xyz.size() ? &reflectance[0] : 0;
+  attributes.rgb = rgb.size() == xyz.size() && xyz.size() ? rgb[0] : 0;
+  attributes.temperature = temperature.size() == xyz.size() && xyz.size() ? &temperature[0] : 0;
+  attributes.amplitude = amplitude.size() == xyz.size() && xyz.size() ? &amplitude[0] : 0;
+  attributes.type = type.size() == xyz.size() && xyz.size() ? &type[0] : 0;
+  attributes.deviation = deviation.size() == xyz.size() && xyz.size() ? &deviation[0] : 0;
+
+  vector<unsigned int> selected;
+  selectPoints(xyz, red, octree, rand, selected);
+
+  std::string buf;
+  buf.reserve((size_t)chunk * (format == EXPORT_PLY ? 48 : 40));
+  double p[3];
+  for (size_t j = 0; j < selected.size(); ++j) {
+    unsigned int i = selected[j];
+    transform3(transMat, xyz[i], p);
+    appendPoint(buf, format, types, p, attributes, i);
+    if ((j + 1) % chunk == 0) writer.write(index, buf);
   }
+  writer.write(index, buf);
+  writer.finish(index);
+
+  return selected.size();
 }
 
 /**
@@ -281,42 +599,121 @@ int main(int argc, char **argv)
   int    start = 0,   end = -1;
   int    maxDist    = -1;
   int    minDist    = -1;
-  bool   eP         = true;  // should we extrapolate the pose??
-  int octree       = 0;  // employ randomized octree reduction?
+  bool   use_frames = true;  // should we use the frames or trust the pose?
+  int octree       = 0;  // points kept per voxel
   IOType type    = UOS;
+  unsigned int types = PointType::USE_NONE;
+  string output = "points.pts";
+  export_format format = EXPORT_UOS;
+  bool ordered = true;
+  unsigned int chunk = 1000000;
+  bool scanserver = false;
 
-//  parseArgs(argc, argv, dir, red, rand, start, end,
-//      maxDist, minDist, eP, octree, type);
-//
-//  // Get Scans
-//  Scan::readScans(type, start, end, dir, maxDist, minDist, true);
-//
-//  int end_reduction = (int)Scan::allScans.size();
-//#ifdef _OPENMP
-//#pragma omp parallel for schedule(dynamic)
-//#endif
-//  for (int iterator = 0; iterator < end_reduction; iterator++) {
-//    if (red > 0) {
-//      cout << "Reducing Scan No. " << iterator << endl;
-//    } else {
-//      cout << "Copying Scan No. " << iterator << endl;
-//    }
-//    // reduction filter for current scan!
-//    Scan::allScans[iterator]->calcReducedPoints(red, octree);
-//  }
-//
-//  if(eP) {
-//    readFrames(dir, start, end, type);
-//  }
-//
-//  cout << "Export all 3D Points to file \"points.pts\"" << endl;
-//  ofstream redptsout("points.pts");
-//  for(unsigned int i = 0; i < Scan::allScans.size(); i++) {
-//    const vector <Point> *points = Scan::allScans[i]->get_points();
-//    for(unsigned int j = 0; j < points->size(); j++) {
-//      redptsout << points->at(j) << endl;
-//    }
-//  }
-//  redptsout.close();
-//  redptsout.clear();
+  parseArgs(argc, argv, dir, red, rand, start, end,
+      maxDist, minDist, use_frames, octree, type, types, output, format,
+      ordered, chunk, scanserver);
+
+  unsigned long starttime = GetCurrentTimeInMilliSec();
+
+  Scan::openDirectory(scanserver, dir, type, start, end);
+  if(Scan::allScans.size() == 0) {
+    cerr << "No scans found. Did you use the correct format?" << endl;
+    exit(-1);
+  }
+  unsigned int nr_scans = Scan::allScans.size();
+
+  // the transformation of every scan, the last frame or the pose
+  vector<double> transMats(16 * nr_scans);
+  for (unsigned int i = 0; i < nr_scans; ++i) {
+    Scan *scan = Scan::allScans[i];
+    scan->setRangeFilter(maxDist, minDist);
+    const double *transMat = scan->get_transMatOrg();
+    if (use_frames) {
+      unsigned int frame_count = 0;
+      try {
+        frame_count = scan->readFrames();
+      } catch (std::ios_base::failure& e) {
+      }
+      if (frame_count > 0) {
+        Scan::AlgoType algoType;
+        scan->getFrame(frame_count - 1, transMat, algoType);
+      } else {
+        cerr << "No frames for scan " << scan->getIdentifier()
+             << ", using its pose instead" << endl;
+      }
+    }
+    memcpy(&transMats[16 * i], transMat, sizeof(double) * 16);
+  }
+
+  FILE *out = fopen(output.c_str(), "wb");
+  if (!out) {
+    cerr << "Could not open " << output << " for writing" << endl;
+    exit(-1);
+  }
+  vector<char> outbuffer(1 << 22);
+  setvbuf(out, &outbuffer[0], _IOFBF, outbuffer.size());
+
+  long count_pos = -1;
+  if (format == EXPORT_PLY) {
+    count_pos = writePlyHeader(out, types);
+  } else if (format == EXPORT_UOS) {
+    fprintf(out, "# exported by exportPoints\n");
+  }
+
+  cout << "Export " << nr_scans << " scans to file \"" << output << "\"" << endl;
+
+  // keep at most two chunks per thread of later scans in memory
+  size_t max_pending = 2 * (size_t)OPENMP_NUM_THREADS * chunk *
+    (format == EXPORT_PLY ? 48 : 40);
+  ChunkWriter writer(out, nr_scans, ordered, max_pending);
+
+  unsigned long long nr_points = 0;
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0; i < (int)nr_scans; i++) {
+    Scan *scan = Scan::allScans[i];
+    unsigned long exported = exportScan(scan, i, &transMats[16 * i], red, octree,
+                                        rand, types, format, chunk, writer);
+    // the data of a scan is not needed anymore
+    scan->clear(DATA_XYZ | DATA_RGB | DATA_REFLECTANCE | DATA_TEMPERATURE |
+                DATA_AMPLITUDE | DATA_TYPE | DATA_DEVIATION);
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    nr_points += exported;
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    cout << "Exported scan " << scan->getIdentifier() << " (" << exported << " points)" << endl;
+  }
+
+  if (count_pos >= 0) {
+    fflush(out);
+    fseek(out, count_pos, SEEK_SET);
+    fprintf(out, "%-20llu", nr_points);
+  }
+  bool good = writer.good() && fclose(out) == 0;
+
+  unsigned long endtime = GetCurrentTimeInMilliSec() - starttime;
+  double seconds = endtime / 1000.0;
+  double mb = writer.bytesWritten() / (1024.0 * 1024.0);
+  cout << "Exported " << nr_points << " points (" << mb << " MB) in "
+       << seconds << " s";
+  if (seconds > 0.0) {
+    cout << ", " << (unsigned long long)(nr_points / seconds) << " points/s, "
+         << mb / seconds << " MB/s";
+  }
+  cout << endl;
+
+  if (scanserver)
+    ClientInterface::destroy();
+  Scan::closeDirectory();
+
+  if (!good) {
+    cerr << "Error writing " << output << endl;
+    return 1;
+  }
+  return 0;
 }
@@ -0,0 +1,498 @@
+/*
+ * feature_based_all_pairs implementation
+ *
+ * Copyright (C) HamidReza Houshiar
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <stdio.h>
+#include <fstream>
+#include <algorithm>
+#include "slam6d/fbr/fbr_global.h"
+#include "slam6d/fbr/feature.h"
+#include "slam6d/fbr/feature_cache.h"
+#include "slam6d/fbr/feature_matcher.h"
+#include "slam6d/fbr/registration.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#else
+#include "XGetopt.h"
+#endif
+
+using namespace std;
+using namespace fbr;
+
+struct information{
+  string dir, outDir, cacheDir;
+  int iWidth, iHeight, nImages, minDistance, minError, minInlier, start, end, topK, knn, minGap, verbose;
+  double pParam, mParam, confidence;
+  IOType sFormat;
+  projection_method pMethod;
+  feature_detector_method fMethod;
+  feature_descriptor_method dMethod;
+  matcher_method mMethod;
+  registration_method rMethod;
+  bool scanServer;
+
+  int cached, computed;
+  double fTime, iTime, rTime;
+} info;
+
+/**
+ * @struct candidate : a pair of scans and the result of its registration
+ */
+struct candidate{
+  int first, second;
+  int votes;
+  int matches;
+  unsigned int inliers;
+  double error;
+  double align[16];
+};
+
+bool moreInliers(const candidate& a, const candidate& b){
+  if(a.inliers != b.inliers) return a.inliers > b.inliers;
+  if(a.votes != b.votes) return a.votes > b.votes;
+  if(a.first != b.first) return a.first < b.first;
+  return a.second < b.second;
+}
+
+/**
+ * usage : explains how to use the program CMD
+ */
+void usage(int argc, char** argv){
+  printf("\n");
+  printf("USAGE: %s dir -s start -e end \n", argv[0]);
+  printf("\n");
+  printf("\n");
+  printf("\tOptions:\n");
+  printf("\t\t-f scanFormat\t\t input scan file format [RIEGL_TXT|RXP|ALL SLAM6D SCAN_IO]\n");
+  printf("\t\t-W iWidth\t\t panorama image width\n");
+  printf("\t\t-H iHeight\t\t panorama image height\n");
+  printf("\t\t-p pMethod\t\t projection method [EQUIRECTANGULAR|CONIC|CYLINDRICAL|MERCATOR|RECTILINEAR|PANNINI|STEREOGRAPHIC|ZAXIS]\n");
+  printf("\t\t-N nImage\t\t number of images used for some projections\n");
+  printf("\t\t-P pParam\t\t special projection parameter (d for Pannini and r for stereographic)\n");
+  printf("\t\t-F fMethod\t\t feature detection method [SURF|SIFT|ORB|FAST|STAR]\n");
+  printf("\t\t-d dMethod\t\t feature description method [SURF|SIFT|ORB]\n");
+  printf("\t\t-m mMethod\t\t feature matching method [BRUTEFORCE|FLANN|KNN|RADIUS|RATIO]\n");
+  printf("\t\t-D minDistance \t\t threshold for min distance in registration process\n");
+  printf("\t\t-E minError \t\t threshold for min error in registration process\n");
+  printf("\t\t-I minInlier \t\t threshold for min number of inliers in registration process\n");
+  printf("\t\t-M mParam \t\t special matching paameter (knn for KNN and r for radius)\n");
+  printf("\t\t-r registration \t registration method [ALL|ransac]\n");
+  printf("\t\t-C confidence \t\t stop RANSAC when an all inlier sample has been drawn with this probability, 0 to disable (default 0.99)\n");
+  printf("\t\t-k topK \t\t number of candidate partners registered per scan, 0 registers all pairs (default 5)\n");
+  printf("\t\t-n knn \t\t\t number of nearest descriptors of all scans voting for candidates (default 3)\n");
+  printf("\t\t-G minGap \t\t min difference of the scan numbers of a pair (default 1)\n");
+  printf("\t\t-c cacheDir \t\t directory of the feature cache if not stated same as output\n");
+  printf("\t\t-V verbose \t\t level of verboseness\n");
+  printf("\t\t-O outDir \t\t output directory if not stated same as input\n");
+  printf("\t\t-S scanServer \t\t Scan Server\n");
+  printf("\n");
+  printf("\tExamples:\n");
+  printf("\tUsing Bremen City dataset:\n");
+  printf("\tFinding the 5 best partners of each of the scans 0 to 12:\n");
+  printf("\t\t %s ~/dir/to/bremen_city -s 0 -e 12\n", argv[0]);
+  printf("\tRegistering all pairs of the scans 0 to 12 with the features cached in ~/dir/to/cache:\n");
+  printf("\t\t %s -k 0 -c ~/dir/to/cache/ ~/dir/to/bremen_city -s 0 -e 12 \n", argv[0]);
+  printf("\n");
+  exit(1);
+}
+
+void parssArgs(int argc, char** argv, information& info){
+  //default values
+  info.iWidth = 3600;
+  info.iHeight = 1000;
+  info.nImages = 1;
+  info.minDistance = 50;
+  info.minError = 50;
+  info.minInlier = 5;
+  info.start = 0;
+  info.end = -1;
+  info.topK = 5;
+  info.knn = 3;
+  info.minGap = 1;
+  info.verbose = 0;
+  //depend on the projection method
+  info.pParam = 0;
+  info.mParam = 0;
+  info.confidence = 0.99;
+  //===============================
+  info.sFormat = RIEGL_TXT;
+  info.pMethod = EQUIRECTANGULAR;
+  info.fMethod = SIFT_DET;
+  info.dMethod = SIFT_DES;
+  info.mMethod = RATIO;
+  info.rMethod = RANSAC;
+  info.outDir = "";
+  info.cacheDir = "";
+  info.scanServer = false;
+
+  int c;
+  opterr = 0;
+  //reade the command line and get the options
+  while ((c = getopt (argc, argv, "F:W:H:p:N:P:f:d:m:D:E:I:M:r:C:k:n:G:c:V:O:s:e:S")) != -1)
+    switch (c)
+      {
+      case 's':
+	info.start = atoi(optarg);
+	break;
+      case 'e':
+	info.end = atoi(optarg);
+	break;
+      case 'f':
+	info.sFormat = stringToScanFormat(optarg);
+	break;
+      case 'W':
+	info.iWidth = atoi(optarg);
+	break;
+      case 'H':
+        info.iHeight = atoi(optarg);
+	break;
+      case 'p':
+	info.pMethod = stringToProjectionMethod(optarg);
+	break;
+      case 'N':
+	info.nImages = atoi(optarg);
+	break;
+      case 'P':
+	info.pParam = atoi(optarg);
+	break;
+      case 'F':
+	info.fMethod = stringToFeatureDetectorMethod(optarg);
+	break;
+      case 'd':
+	info.dMethod = stringToFeatureDescriptorMethod(optarg);
+	break;
+      case 'm':
+	info.mMethod = stringToMatcherMethod(optarg);
+	break;
+      case 'D':
+	info.minDistance = atoi(optarg);
+	break;
+      case 'E':
+	info.minError = atoi(optarg);
+	break;
+      case 'I':
+	info.minInlier = atoi(optarg);
+	break;
+      case 'M':
+	info.mParam = atoi(optarg);
+	break;
+      case 'r':
+	info.rMethod = stringToRegistrationMethod(optarg);
+	break;
+      case 'C':
+	info.confidence = atof(optarg);
+	break;
+      case 'k':
+	info.topK = atoi(optarg);
+	break;
+      case 'n':
+	info.knn = atoi(optarg);
+	break;
+      case 'G':
+	info.minGap = atoi(optarg);
+	break;
+      case 'c':
+	info.cacheDir = optarg;
+	break;
+      case 'V':
+	info.verbose = atoi(optarg);
+	break;
+      case 'O':
+	info.outDir = optarg;
+	break;
+      case 'S':
+	info.scanServer = true;
+	break;
+      case '?':
+	cout<<"Unknown option character "<<optopt<<endl;
+	usage(argc, argv);
+	break;
+      default:
+	usage(argc, argv);
+      }
+  if(info.pMethod == PANNINI && info.pParam == 0){
+    info.pParam = 1;
+    if(info.nImages < 3) info.nImages = 3;
+  }
+  if(info.pMethod == STEREOGRAPHIC && info.pParam == 0){
+    info.pParam = 2;
+    if(info.nImages < 3) info.nImages = 3;
+  }
+  if(info.pMethod == RECTILINEAR && info.nImages < 3)
+    info.nImages = 3;
+  if(info.mMethod == KNN && info.mParam == 0)
+    info.mParam = 3;
+  if(info.mMethod == RADIUS && info.mParam == 0)
+    info.mParam = 100;
+  if(info.dMethod == ORB_DES && info.fMethod == SIFT_DET){
+    cout<<"Error: SIFT feature doesn't work with ORB descriptor."<<endl;
+    usage(argc, argv);
+  }
+  if(info.mMethod == FLANN && info.dMethod == ORB_DES){
+    cout<<"Error: ORB descriptoronly works with BRUTEFORCE matcher."<<endl;
+    usage(argc, argv);
+  }
+  if(info.minGap < 1) info.minGap = 1;
+  if(info.knn < 1) info.knn = 1;
+
+  if (optind > argc - 1 || info.end < info.start)
+    {
+      cout<<"Too few input arguments. At least dir and the range of scans are required."<<endl;
+      usage(argc, argv);
+    }
+
+  info.dir = argv[optind];
+  if(info.outDir.empty()) info.outDir = info.dir;
+  else if(info.outDir.compare(info.outDir.size()-1, 1, "/") != 0) info.outDir += "/";
+  if(info.cacheDir.empty()) info.cacheDir = info.outDir;
+}
+
+void informationDescription(information info){
+  cout<<"program parameters are:"<<endl;
+  cout<<endl;
+  cout<<"input dir: "<<info.dir<<endl;
+  cout<<"output dir: "<<info.outDir<<endl;
+  cout<<"cache dir: "<<info.cacheDir<<endl;
+  cout<<"scans: "<<info.start<<" to "<<info.end<<endl;
+  cout<<"scan format: "<<scanFormatToString(info.sFormat)<<endl;
+  cout<<endl;
+  cout<<"image width: "<<info.iWidth<<endl;
+  cout<<"image height: "<<info.iHeight<<endl;
+  cout<<"number of images: "<<info.nImages<<endl;
+  cout<<"projection parameter: "<<info.pParam<<endl;
+  cout<<"projection method: "<<projectionMethodToString(info.pMethod)<<endl;
+  cout<<endl;
+  cout<<"feature detector method: "<<featureDetectorMethodToString(info.fMethod)<<endl;
+  cout<<"feature descriptor method: "<<featureDescriptorMethodToString(info.dMethod)<<endl;
+  cout<<endl;
+  cout<<"candidates per scan: "<<info.topK<<(info.topK <= 0 ? " (all pairs)" : "")<<endl;
+  cout<<"voting neighbors: "<<info.knn<<endl;
+  cout<<"min scan gap: "<<info.minGap<<endl;
+  cout<<endl;
+  cout<<"matcher parameter: "<<info.mParam<<endl;
+  cout<<"matcher method: "<<matcherMethodToString(info.mMethod)<<endl;
+  cout<<endl;
+  cout<<"min distance: "<<info.minDistance<<endl;
+  cout<<"min error: "<<info.minError<<endl;
+  cout<<"min inlier: "<<info.minInlier<<endl;
+  cout<<"registration method: "<<registrationMethodToString(info.rMethod)<<endl;
+  cout<<"RANSAC confidence: "<<info.confidence<<endl;
+  cout<<endl;
+}
+
+/**
+ * voteCandidates : counts for each pair of scans the descriptors of one
+ * that are among the knn nearest descriptors of all scans of the other
+ * @param features the features of all scans
+ * @param votes returning the symmetric number of votes, votes[i][j]
+ */
+void voteCandidates(const vector<feature>& features, vector<vector<int> >& votes){
+  int nScans = features.size();
+  votes.assign(nScans, vector<int>(nScans, 0));
+
+  //one index over the descriptors of all scans, the image index of a match is the scan
+  cv::Ptr<cv::DescriptorMatcher> index;
+  if(info.dMethod == ORB_DES){
+#if (CV_MAJOR_VERSION >= 2) && (CV_MINOR_VERSION >= 4)
+    index = new cv::BFMatcher(cv::NORM_HAMMING);
+#else  //older version of opencv than 2.4
+    index = new cv::BruteForceMatcher< cv::Hamming >();
+#endif
+  }else{
+    index = new cv::FlannBasedMatcher();
+  }
+  vector<cv::Mat> descriptors(nScans);
+  vector<int> scanOfImage;
+  for(int s = 0; s < nScans; s++){
+    feature f = features[s];
+    if(f.getDescriptors().rows == 0)
+      continue;
+    descriptors[s] = f.getDescriptors();
+    scanOfImage.push_back(s);
+  }
+  vector<cv::Mat> images;
+  for(unsigned int i = 0; i < scanOfImage.size(); i++)
+    images.push_back(descriptors[scanOfImage[i]]);
+  if(images.size() < 2)
+    return;
+  index->add(images);
+  index->train();
+
+  //the own descriptor is among the neighbors
+  int k = info.knn + 1;
+  for(int q = 0; q < nScans; q++){
+    if(descriptors[q].rows == 0)
+      continue;
+    vector<vector<cv::DMatch> > neighbors;
+    index->knnMatch(descriptors[q], neighbors, k);
+    vector<int> lastVote(nScans, -1);
+    for(unsigned int d = 0; d < neighbors.size(); d++){
+      for(unsigned int n = 0; n < neighbors[d].size(); n++){
+	int t = scanOfImage[neighbors[d][n].imgIdx];
+	//each descriptor votes once per scan
+	if(t == q || lastVote[t] == (int)d)
+	  continue;
+	lastVote[t] = d;
+	votes[q][t]++;
+	votes[t][q]++;
+      }
+    }
+  }
+}
+
+/**
+ * selectCandidates : the topK partners with the most votes of each scan,
+ * all pairs if topK is 0
+ */
+void selectCandidates(const vector<vector<int> >& votes, vector<candidate>& candidates){
+  int nScans = votes.size();
+  vector<vector<char> > selected(nScans, vector<char>(nScans, 0));
+  for(int i = 0; i < nScans; i++){
+    vector<pair<int, int> > partners;
+    for(int j = 0; j < nScans; j++){
+      if(abs(i - j) < info.minGap)
+	continue;
+      if(info.topK > 0 && votes[i][j] == 0)
+	continue;
+      partners.push_back(make_pair(-votes[i][j], j));
+    }
+    sort(partners.begin(), partners.end());
+    if(info.topK > 0 && (int)partners.size() > info.topK)
+      partners.resize(info.topK);
+    for(unsigned int p = 0; p < partners.size(); p++){
+      int j = partners[p].second;
+      selected[min(i, j)][max(i, j)] = 1;
+    }
+  }
+  for(int i = 0; i < nScans; i++)
+    for(int j = i + 1; j < nScans; j++)
+      if(selected[i][j]){
+	candidate c;
+	c.first = i;
+	c.second = j;
+	c.votes = votes[i][j];
+	c.matches = 0;
+	c.inliers = 0;
+	c.error = 0;
+	for(int a = 0; a < 16; a++)
+	  c.align[a] = 0;
+	candidates.push_back(c);
+      }
+}
+
+int main(int argc, char** argv){
+  parssArgs(argc, argv, info);
+  if(info.verbose >= 1) informationDescription(info);
+
+  int nScans = info.end - info.start + 1;
+  vector<feature> features(nScans);
+  vector<vector<cv::Point3f> > coords(nScans);
+
+  //features of each scan, computed once and cached on disk
+  feature_cache cache (info.cacheDir, info.sFormat, info.pMethod, info.iWidth, info.iHeight, info.nImages, info.pParam, FARTHEST, info.fMethod, info.dMethod, DISABLE_FILTER);
+  if(info.verbose >= 2) cache.getDescription();
+  info.cached = 0;
+  info.computed = 0;
+  info.fTime = (double)cv::getTickCount();
+  for(int s = 0; s < nScans; s++){
+    if(cache.get(info.dir, info.start + s, info.scanServer, features[s], coords[s]))
+      info.cached++;
+    else
+      info.computed++;
+    if(info.verbose >= 2) features[s].getDescription();
+  }
+  info.fTime = ((double)cv::getTickCount() - info.fTime)/cv::getTickFrequency();
+
+  //candidate pairs from the descriptors of all scans
+  info.iTime = (double)cv::getTickCount();
+  vector<vector<int> > votes;
+  if(info.topK > 0)
+    voteCandidates(features, votes);
+  else
+    votes.assign(nScans, vector<int>(nScans, 0));
+  vector<candidate> candidates;
+  selectCandidates(votes, candidates);
+  info.iTime = ((double)cv::getTickCount() - info.iTime)/cv::getTickFrequency();
+  cout<<candidates.size()<<" candidate pairs of "<<nScans * (nScans - 1) / 2<<" pairs."<<endl;
+
+  //the pairs are matched and registered in parallel
+  info.rTime = (double)cv::getTickCount();
+  int done = 0;
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int p = 0; p < (int)candidates.size(); p++){
+    candidate& c = candidates[p];
+    //the matcher requires features in both scans and two for the ratio test
+    if(features[c.first].getNumberOfFeatures() > 0 && features[c.second].getNumberOfFeatures() >= 2){
+      feature_matcher matcher (info.mMethod, info.mParam);
+      matcher.match(features[c.first], features[c.second]);
+      vector<cv::DMatch> matches = matcher.getMatches();
+      c.matches = matches.size();
+
+      registration reg (info.minDistance, info.minError, info.minInlier, info.rMethod);
+      reg.setConfidence(info.confidence);
+      reg.findRegistration(coords[c.first], coords[c.second], matches);
+      c.inliers = reg.getBestErrorIndex();
+      c.error = reg.getBestError();
+      double *bAlign = reg.getBestAlign();
+      for(int a = 0; a < 16; a++)
+        c.align[a] = bAlign[a];
+    }
+
+    //registration prints no RANSAC progress inside this loop, one line per pair instead
+#ifdef _OPENMP
+#pragma omp critical (progress)
+#endif
+    {
+      done++;
+      if(info.verbose >= 1)
+        cout<<"pair "<<done<<" of "<<candidates.size()<<": scan"<<to_string(info.start + c.first, 3)<<" scan"<<to_string(info.start + c.second, 3)<<", "<<c.matches<<" matches, "<<c.inliers<<" inliers."<<endl;
+    }
+  }
+  info.rTime = ((double)cv::getTickCount() - info.rTime)/cv::getTickFrequency();
+
+  //the registered pairs, the most inliers first
+  sort(candidates.begin(), candidates.end(), moreInliers);
+  string out = info.outDir+"scan"+to_string(info.start, 3)+"_scan"+to_string(info.end, 3)+"_"+projectionMethodToString(info.pMethod)+"_"+to_string(info.iWidth)+"x"+to_string(info.iHeight)+"_"+featureDetectorMethodToString(info.fMethod)+"_"+featureDescriptorMethodToString(info.dMethod)+"_"+matcherMethodToString(info.mMethod)+"_"+registrationMethodToString(info.rMethod)+".pairs";
+  ofstream pairs(out.c_str());
+  pairs << "#first second votes matches inliers error align" << endl;
+  int registered = 0;
+  for(unsigned int p = 0; p < candidates.size(); p++){
+    candidate& c = candidates[p];
+    if(c.inliers == 0)
+      continue;
+    registered++;
+    pairs << info.start + c.first << " " << info.start + c.second << " " << c.votes << " " << c.matches << " " << c.inliers << " " << c.error;
+    for(int a = 0; a < 16; a++)
+      pairs << " " << c.align[a];
+    pairs << endl;
+  }
+  pairs.close();
+
+  cout<<registered<<" of "<<candidates.size()<<" candidate pairs registered, written to "<<out<<"."<<endl;
+  cout<<"stage times in s:"<<endl;
+  cout<<"  features:     "<<info.fTime<<" ("<<info.cached<<" scans cached, "<<info.computed<<" computed)"<<endl;
+  cout<<"  candidates:   "<<info.iTime<<endl;
+  cout<<"  registration: "<<info.rTime<<endl;
+  cout<<endl;
+
+  return 0;
+}
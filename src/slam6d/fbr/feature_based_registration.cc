@@ -23,7 +23,7 @@ struct information{
   string local_time;
   string dir, outDir;
   int iWidth, iHeight, nImages, minDistance, minError, minInlier, fScanNumber, sScanNumber, verbose;
-  double pParam, mParam;
+  double pParam, mParam, confidence;
   IOType sFormat;
   projection_method pMethod;
   feature_detector_method fMethod;
@@ -34,6 +34,7 @@ struct information{
   
   int fSPoints, sSPoints, fFNum, sFNum, mNum, filteredMNum;
   double fSTime, sSTime, fPTime, sPTime, fFTime, sFTime, fDTime, sDTime, mTime, rTime; 
+  unsigned long rIterations;
 } info;
 
 /**
@@ -59,6 +60,7 @@ void usage(int argc, char** argv){
   printf("\t\t-I minInlier \t\t threshold for min number of inliers in registration process\n");
   printf("\t\t-M mParam \t\t special matching paameter (knn for KNN and r for radius)\n");
   printf("\t\t-r registration \t registration method [ALL|ransac]\n");
+  printf("\t\t-C confidence \t\t stop RANSAC when an all inlier sample has been drawn with this probability, 0 to disable (default 0.99)\n");
   printf("\t\t-V verbose \t\t level of verboseness\n");
   printf("\t\t-O outDir \t\t output directory if not stated same as input\n");
   printf("\t\t-S scanServer \t\t Scan Server\n");
@@ -95,6 +97,7 @@ void parssArgs(int argc, char** argv, information& info){
   //depend on the projection method
   info.pParam = 0;
   info.mParam = 0;
+  info.confidence = 0.99;
   //===============================
   info.sFormat = RIEGL_TXT;
   info.pMethod = EQUIRECTANGULAR;
@@ -108,7 +111,7 @@ void parssArgs(int argc, char** argv, information& info){
   int c;
   opterr = 0;
   //reade the command line and get the options
-  while ((c = getopt (argc, argv, "F:W:H:p:N:P:f:d:m:D:E:I:M:r:V:O:s:e:S")) != -1)
+  while ((c = getopt (argc, argv, "F:W:H:p:N:P:f:d:m:D:E:I:M:r:C:V:O:s:e:S")) != -1)
     switch (c)
       {
       case 's':
@@ -159,6 +162,9 @@ void parssArgs(int argc, char** argv, information& info){
       case 'r':
 	info.rMethod = stringToRegistrationMethod(optarg);
 	break;
+      case 'C':
+	info.confidence = atof(optarg);
+	break;
       case 'V':
 	info.verbose = atoi(optarg);
 	break;
@@ -237,6 +243,22 @@ void informationDescription(information info){
   cout<<"min error: "<<info.minError<<endl;
   cout<<"min inlier: "<<info.minInlier<<endl;
   cout<<"registration method: "<<registrationMethodToString(info.rMethod)<<endl;
+  cout<<"RANSAC confidence: "<<info.confidence<<endl;
+  cout<<endl;
+}
+
+/**
+ * timingDescription : prints the time spent in each stage
+ */
+void timingDescription(information info){
+  cout<<"stage times in s (first scan, second scan):"<<endl;
+  cout<<"  scan loading:        "<<info.fSTime<<", "<<info.sSTime<<endl;
+  cout<<"  panorama creation:   "<<info.fPTime<<", "<<info.sPTime<<endl;
+  cout<<"  feature detection:   "<<info.fFTime<<", "<<info.sFTime<<endl;
+  cout<<"  feature description: "<<info.fDTime<<", "<<info.sDTime<<endl;
+  cout<<"  matching:            "<<info.mTime<<endl;
+  cout<<"  registration:        "<<info.rTime<<" ("<<info.rIterations<<" hypotheses)"<<endl;
+  cout<<"  total:               "<<info.fSTime + info.sSTime + info.fPTime + info.sPTime + info.fFTime + info.sFTime + info.fDTime + info.sDTime + info.mTime + info.rTime<<endl;
   cout<<endl;
 }
 
@@ -268,6 +290,7 @@ void info_yml(information info, double bError, double bErrorIdx, double* bAlign)
   fs << "mMethod" << matcherMethodToString(info.mMethod);
   fs << "mParam" << info.mParam;
   fs << "rMethod" << registrationMethodToString(info.rMethod);
+  fs << "confidence" << info.confidence;
   fs << "minDistance" << info.minDistance;
   fs << "minInlier" << info.minInlier;
   fs << "minError" << info.minError;
@@ -292,7 +315,7 @@ void info_yml(information info, double bError, double bErrorIdx, double* bAlign)
   fs << "amount" << info.mNum << "filteration" << info.filteredMNum << "time" << info.mTime << "}";
   
   fs << "reg" << "{";
-  fs << "bestError" << bError << "bestErrorIdx" << bErrorIdx << "time" << info.rTime << "bAlign" << align << "}";
+  fs << "bestError" << bError << "bestErrorIdx" << bErrorIdx << "time" << info.rTime << "iterations" << (int)info.rIterations << "bAlign" << align << "}";
 
   fs << "}";
 }
@@ -305,14 +328,14 @@ int main(int argc, char** argv){
   if(info.verbose >= 1) informationDescription(info);
 
   scan_cv fScan (info.dir, info.fScanNumber, info.sFormat, info.scanServer);
-  if(info.verbose >= 4) info.fSTime = (double)cv::getTickCount();
+  info.fSTime = (double)cv::getTickCount();
   fScan.convertScanToMat();
-  if(info.verbose >= 4) info.fSTime = ((double)cv::getTickCount() - info.fSTime)/cv::getTickFrequency();
+  info.fSTime = ((double)cv::getTickCount() - info.fSTime)/cv::getTickFrequency();
   if(info.verbose >= 2) fScan.getDescription();
   panorama fPanorama (info.iWidth, info.iHeight, info.pMethod, info.nImages, info.pParam);
-  if(info.verbose >= 4) info.fPTime = (double)cv::getTickCount();
+  info.fPTime = (double)cv::getTickCount();
   fPanorama.createPanorama(fScan.getMatScan());
-  if(info.verbose >= 4) info.fPTime = ((double)cv::getTickCount() - info.fPTime)/cv::getTickFrequency();
+  info.fPTime = ((double)cv::getTickCount() - info.fPTime)/cv::getTickFrequency();
   if(info.verbose >= 2) fPanorama.getDescription();
   //write panorama to image
   if(info.verbose >= 1){
@@ -320,9 +343,9 @@ int main(int argc, char** argv){
     imwrite(out, fPanorama.getReflectanceImage());
   }
   feature fFeature;
-  if(info.verbose >= 4) info.fFTime = (double)cv::getTickCount();
+  info.fFTime = (double)cv::getTickCount();
   fFeature.featureDetection(fPanorama.getReflectanceImage(), info.fMethod);
-  if(info.verbose >= 4) info.fFTime = ((double)cv::getTickCount() - info.fFTime)/cv::getTickFrequency();
+  info.fFTime = ((double)cv::getTickCount() - info.fFTime)/cv::getTickFrequency();
   //write panorama with keypoints to image
   if(info.verbose >= 1){
     cv::drawKeypoints(fPanorama.getReflectanceImage(), fFeature.getFeatures(), outImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS );
@@ -330,20 +353,20 @@ int main(int argc, char** argv){
     imwrite(out, outImage);
     outImage.release();
   }
-  if(info.verbose >= 4) info.fDTime = (double)cv::getTickCount();
+  info.fDTime = (double)cv::getTickCount();
   fFeature.featureDescription(fPanorama.getReflectanceImage(), info.dMethod);
-  if(info.verbose >= 4) info.fDTime = ((double)cv::getTickCount() - info.fDTime)/cv::getTickFrequency();
+  info.fDTime = ((double)cv::getTickCount() - info.fDTime)/cv::getTickFrequency();
   if(info.verbose >= 2) fFeature.getDescription();
   
   scan_cv sScan (info.dir, info.sScanNumber, info.sFormat, info.scanServer);
-  if(info.verbose >= 4) info.sSTime = (double)cv::getTickCount();
+  info.sSTime = (double)cv::getTickCount();
   sScan.convertScanToMat();
-  if(info.verbose >= 4) info.sSTime = ((double)cv::getTickCount() - info.sSTime)/cv::getTickFrequency();
+  info.sSTime = ((double)cv::getTickCount() - info.sSTime)/cv::getTickFrequency();
   if(info.verbose >= 2) sScan.getDescription();
   panorama sPanorama (info.iWidth, info.iHeight, info.pMethod, info.nImages, info.pParam);
-  if(info.verbose >= 4) info.sPTime = (double)cv::getTickCount();
+  info.sPTime = (double)cv::getTickCount();
   sPanorama.createPanorama(sScan.getMatScan());
-  if(info.verbose >= 4) info.sPTime = ((double)cv::getTickCount() - info.sPTime)/cv::getTickFrequency();
+  info.sPTime = ((double)cv::getTickCount() - info.sPTime)/cv::getTickFrequency();
   if(info.verbose >= 2) sPanorama.getDescription();
   //write panorama to image
   if(info.verbose >= 1){
@@ -351,9 +374,9 @@ int main(int argc, char** argv){
     imwrite(out, sPanorama.getReflectanceImage());
   }
   feature sFeature;
-  if(info.verbose >= 4) info.sFTime = (double)cv::getTickCount();
+  info.sFTime = (double)cv::getTickCount();
   sFeature.featureDetection(sPanorama.getReflectanceImage(), info.fMethod);
-  if(info.verbose >= 4) info.sFTime = ((double)cv::getTickCount() - info.sFTime)/cv::getTickFrequency();
+  info.sFTime = ((double)cv::getTickCount() - info.sFTime)/cv::getTickFrequency();
   //write panorama with keypoints to image
   if(info.verbose >= 1){
     cv::drawKeypoints(sPanorama.getReflectanceImage(), sFeature.getFeatures(), outImage, cv::Scalar::all(-1), cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS );
@@ -361,15 +384,15 @@ int main(int argc, char** argv){
     imwrite(out, outImage);
     outImage.release();
   }
-  if(info.verbose >= 4) info.sDTime = (double)cv::getTickCount();
+  info.sDTime = (double)cv::getTickCount();
   sFeature.featureDescription(sPanorama.getReflectanceImage(), info.dMethod);
-  if(info.verbose >= 4) info.sDTime = ((double)cv::getTickCount() - info.sDTime)/cv::getTickFrequency();
+  info.sDTime = ((double)cv::getTickCount() - info.sDTime)/cv::getTickFrequency();
   if(info.verbose >= 2) sFeature.getDescription();
 
   feature_matcher matcher (info.mMethod, info.mParam);
-  if(info.verbose >= 4) info.mTime = (double)cv::getTickCount();
+  info.mTime = (double)cv::getTickCount();
   matcher.match(fFeature, sFeature);
-  if(info.verbose >= 4) info.mTime = ((double)cv::getTickCount() - info.mTime)/cv::getTickFrequency();
+  info.mTime = ((double)cv::getTickCount() - info.mTime)/cv::getTickFrequency();
   if(info.verbose >= 2) matcher.getDescription();
   //write matcheed feature to image
   if(info.verbose >= 1){
@@ -380,10 +403,13 @@ int main(int argc, char** argv){
   }
 
   registration reg (info.minDistance, info.minError, info.minInlier, info.rMethod);
-  if(info.verbose >= 4) info.rTime = (double)cv::getTickCount();
+  reg.setConfidence(info.confidence);
+  info.rTime = (double)cv::getTickCount();
   reg.findRegistration(fPanorama.getMap(), fFeature.getFeatures(), sPanorama.getMap(), sFeature.getFeatures(), matcher.getMatches());
-  if(info.verbose >= 4) info.rTime = ((double)cv::getTickCount() - info.rTime)/cv::getTickFrequency();
+  info.rTime = ((double)cv::getTickCount() - info.rTime)/cv::getTickFrequency();
+  info.rIterations = reg.getIterations();
   if(info.verbose >= 2) reg.getDescription();
+  timingDescription(info);
 
   //write .dat and .frames files
   if(info.verbose >= 0){
@@ -0,0 +1,202 @@
+/*
+ * feature_cache implementation
+ *
+ * Copyright (C) HamidReza Houshiar
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+#include "slam6d/fbr/feature_cache.h"
+#include "slam6d/fbr/scan_cv.h"
+#include "slam6d/fbr/panorama.h"
+#include "slam6d/fbr/registration.h"
+#include "slam6d/io_utils.h"
+
+#include <cstdio>
+
+using namespace std;
+
+namespace fbr{
+
+  //increase if the layout of the cache files changes
+#define FEATURE_CACHE_VERSION 2
+
+  feature_cache::feature_cache(string dir, IOType format, projection_method projection, unsigned int width, unsigned int height, unsigned int numberOfImages, double param, panorama_map_method map, feature_detector_method detector, feature_descriptor_method descriptor, feature_filtration_method filtration){
+    cDir = dir;
+    if(!cDir.empty() && cDir.compare(cDir.size()-1, 1, "/") != 0) cDir += "/";
+    sFormat = format;
+    pMethod = projection;
+    iWidth = width;
+    iHeight = height;
+    nImages = numberOfImages;
+    pParam = param;
+    mapMethod = map;
+    fMethod = detector;
+    dMethod = descriptor;
+    fFiltrationMethod = filtration;
+  }
+
+  string feature_cache::getKey(){
+    return projectionMethodToString(pMethod)+"_"+to_string(iWidth)+"x"+to_string(iHeight)+"_"+to_string(nImages)+"_"+to_string(pParam)+"_"+panoramaMapMethodToString(mapMethod)+"_"+featureDetectorMethodToString(fMethod)+"_"+featureDescriptorMethodToString(dMethod)+"_"+featureFiltrationMethodToString(fFiltrationMethod);
+  }
+
+  string feature_cache::getFileName(string sDir, unsigned int scanNumber){
+    //scans of different directories must not share a cache file
+    if(!sDir.empty() && sDir.compare(sDir.size()-1, 1, "/") != 0) sDir += "/";
+    char dirKey[17];
+    snprintf(dirKey, sizeof(dirKey), "%016llx", fingerprint(14695981039346656037ULL, sDir.data(), sDir.size()));
+    return cDir+"scan"+to_string(scanNumber, 3)+"_"+getKey()+"_"+dirKey+".fbr";
+  }
+
+  bool feature_cache::load(string sDir, unsigned int scanNumber, feature& sFeature, vector<cv::Point3f>& coords){
+    ifstream in(getFileName(sDir, scanNumber).c_str(), ios::in | ios::binary);
+    if(!in.good())
+      return false;
+
+    //the header holds the version and the parameters
+    int version = 0;
+    unsigned int length = 0;
+    in.read((char*)&version, sizeof(version));
+    in.read((char*)&length, sizeof(length));
+    if(!in.good() || version != FEATURE_CACHE_VERSION || length > 1024)
+      return false;
+    string key(length, ' ');
+    if(length > 0) in.read(&key[0], length);
+    string format;
+    in.read((char*)&length, sizeof(length));
+    if(!in.good() || key != getKey() || length > 1024)
+      return false;
+    format.resize(length);
+    if(length > 0) in.read(&format[0], length);
+    if(!in.good() || format != scanFormatToString(sFormat))
+      return false;
+    //the scan files must not have changed since
+    unsigned long long source = 0;
+    in.read((char*)&source, sizeof(source));
+    if(!in.good() || source != scanFingerprint(sDir, to_string(scanNumber, 3), sFormat))
+      return false;
+
+    unsigned int nKeypoints = 0;
+    in.read((char*)&nKeypoints, sizeof(nKeypoints));
+    if(!in.good())
+      return false;
+    vector<cv::KeyPoint> keypoints(nKeypoints);
+    coords.resize(nKeypoints);
+    for(unsigned int i = 0; i < nKeypoints; i++){
+      float k[5];
+      int o[2];
+      float c[3];
+      in.read((char*)k, sizeof(k));
+      in.read((char*)o, sizeof(o));
+      in.read((char*)c, sizeof(c));
+      keypoints[i].pt.x = k[0];
+      keypoints[i].pt.y = k[1];
+      keypoints[i].size = k[2];
+      keypoints[i].angle = k[3];
+      keypoints[i].response = k[4];
+      keypoints[i].octave = o[0];
+      keypoints[i].class_id = o[1];
+      coords[i] = cv::Point3f(c[0], c[1], c[2]);
+    }
+
+    int d[3];
+    in.read((char*)d, sizeof(d));
+    if(!in.good() || d[0] < 0 || d[1] < 0)
+      return false;
+    cv::Mat descriptors;
+    if(d[0] > 0 && d[1] > 0){
+      descriptors.create(d[0], d[1], d[2]);
+      in.read((char*)descriptors.data, descriptors.total() * descriptors.elemSize());
+    }
+    if(!in.good())
+      return false;
+
+    sFeature = feature(fMethod, dMethod, fFiltrationMethod);
+    sFeature.setFeatures(keypoints);
+    sFeature.setDescriptors(descriptors);
+    return true;
+  }
+
+  bool feature_cache::save(string sDir, unsigned int scanNumber, feature& sFeature, const vector<cv::Point3f>& coords){
+    string out = getFileName(sDir, scanNumber);
+    ofstream os(out.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!os.good()){
+      cerr<<"Could not write the feature cache "<<out<<endl;
+      return false;
+    }
+
+    int version = FEATURE_CACHE_VERSION;
+    string key = getKey();
+    string format = scanFormatToString(sFormat);
+    unsigned int length;
+    os.write((const char*)&version, sizeof(version));
+    length = key.size();
+    os.write((const char*)&length, sizeof(length));
+    os.write(key.data(), length);
+    length = format.size();
+    os.write((const char*)&length, sizeof(length));
+    os.write(format.data(), length);
+    unsigned long long source = scanFingerprint(sDir, to_string(scanNumber, 3), sFormat);
+    os.write((const char*)&source, sizeof(source));
+
+    vector<cv::KeyPoint> keypoints = sFeature.getFeatures();
+    unsigned int nKeypoints = keypoints.size();
+    os.write((const char*)&nKeypoints, sizeof(nKeypoints));
+    for(unsigned int i = 0; i < nKeypoints; i++){
+      float k[5] = {keypoints[i].pt.x, keypoints[i].pt.y, keypoints[i].size, keypoints[i].angle, keypoints[i].response};
+      int o[2] = {keypoints[i].octave, keypoints[i].class_id};
+      float c[3] = {coords[i].x, coords[i].y, coords[i].z};
+      os.write((const char*)k, sizeof(k));
+      os.write((const char*)o, sizeof(o));
+      os.write((const char*)c, sizeof(c));
+    }
+
+    cv::Mat descriptors = sFeature.getDescriptors();
+    if(!descriptors.isContinuous()) descriptors = descriptors.clone();
+    int d[3] = {descriptors.rows, descriptors.cols, descriptors.type()};
+    os.write((const char*)d, sizeof(d));
+    if(!descriptors.empty())
+      os.write((const char*)descriptors.data, descriptors.total() * descriptors.elemSize());
+    os.close();
+    return !os.fail();
+  }
+
+  void feature_cache::compute(string sDir, unsigned int scanNumber, bool scanServer, feature& sFeature, vector<cv::Point3f>& coords){
+    scan_cv sScan (sDir, scanNumber, sFormat, scanServer);
+    sScan.convertScanToMat();
+    panorama sPanorama (iWidth, iHeight, pMethod, nImages, pParam, mapMethod);
+    sPanorama.createPanorama(sScan.getMatScan());
+
+    sFeature = feature(fMethod, dMethod, fFiltrationMethod);
+    sFeature.featureDetection(sPanorama.getReflectanceImage(), fMethod, sPanorama.getRangeImage(), fFiltrationMethod);
+    sFeature.featureDescription(sPanorama.getReflectanceImage(), dMethod);
+
+    //only the 3D coordinates of the keypoints are kept from the map
+    vector<cv::KeyPoint> keypoints = sFeature.getFeatures();
+    cv::Mat pMap = sPanorama.getMap();
+    coords.assign(keypoints.size(), cv::Point3f(0, 0, 0));
+    for(unsigned int i = 0; i < keypoints.size(); i++){
+      cv::Point3f c;
+      if(registration::getKeypointCoord(keypoints[i], pMap, c))
+	coords[i] = c;
+    }
+  }
+
+  bool feature_cache::get(string sDir, unsigned int scanNumber, bool scanServer, feature& sFeature, vector<cv::Point3f>& coords){
+    if(load(sDir, scanNumber, sFeature, coords))
+      return true;
+    compute(sDir, scanNumber, scanServer, sFeature, coords);
+    save(sDir, scanNumber, sFeature, coords);
+    return false;
+  }
+
+  string feature_cache::getCacheDir(){
+    return cDir;
+  }
+
+  void feature_cache::getDescription(){
+    cout<<"feature cache dir: "<<cDir<<", scan format: "<<scanFormatToString(sFormat)<<", key: "<<getKey()<<"."<<endl;
+    cout<<endl;
+  }
+}
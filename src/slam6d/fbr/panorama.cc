@@ -7,8 +7,18 @@
  *
  */
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include "slam6d/fbr/panorama.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 namespace fbr{
@@ -69,27 +79,66 @@ namespace fbr{
     init(width, height, method, numberOfImages, param, FARTHEST);
   }
   
-  void panorama::map(int x, int y, cv::MatIterator_<cv::Vec4f> it, double range){
-    iReflectance.at<uchar>(y,x) = (*it)[3]*255;//reflectance
+  void panorama::map(int x, int y, const cv::Vec4f &point, double range){
+    iReflectance.at<uchar>(y,x) = point[3]*255;//reflectance
     iRange.at<float>(y,x) = range;//range
     if(mapMethod == FARTHEST){
       //adding the point with max distance
       if( iRange.at<float>(y,x) < range ){
-        iMap.at<cv::Vec3f>(y,x)[0] = (*it)[0];//x
-        iMap.at<cv::Vec3f>(y,x)[1] = (*it)[1];//y
-        iMap.at<cv::Vec3f>(y,x)[2] = (*it)[2];//z
+        iMap.at<cv::Vec3f>(y,x)[0] = point[0];//x
+        iMap.at<cv::Vec3f>(y,x)[1] = point[1];//y
+        iMap.at<cv::Vec3f>(y,x)[2] = point[2];//z
       }
     }else if(mapMethod == EXTENDED){
       //adding all the points
-      cv::Vec3f point;
-      point[0] = (*it)[0];//x
-      point[1] = (*it)[1];//y
-      point[2] = (*it)[2];//z
-      extendedIMap[y][x].push_back(point);
+      cv::Vec3f p(point[0], point[1], point[2]);//x, y, z
+      extendedIMap[y][x].push_back(p);
+    }
+  }
+
+  void panorama::fillImages(const cv::Vec4f *points, const vector<int> &pixel){
+    //sort the points by image row, keeping their order within each row
+    int nPoints = pixel.size();
+    vector<int> rowStart(iHeight + 1, 0);
+    for(int i = 0; i < nPoints; i++)
+      if(pixel[i] >= 0)
+	rowStart[pixel[i] / iWidth + 1]++;
+    for(unsigned int y = 0; y < iHeight; y++)
+      rowStart[y + 1] += rowStart[y];
+    vector<int> order(rowStart[iHeight]);
+    vector<int> next(rowStart.begin(), rowStart.end() - 1);
+    for(int i = 0; i < nPoints; i++)
+      if(pixel[i] >= 0)
+	order[next[pixel[i] / iWidth]++] = i;
+
+    //a row is only written by one thread, in the order of the points, so
+    //the last point of a pixel wins as before
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+    for(int y = 0; y < (int)iHeight; y++){
+      for(int k = rowStart[y]; k < rowStart[y + 1]; k++){
+	int i = order[k];
+	const cv::Vec4f &point = points[i];
+	//the range as computed by toPolar
+	double kart[3];
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
+	map(pixel[i] % iWidth, y, point, Len(kart));
+      }
     }
   }
 
   void panorama::createPanorama(cv::Mat scan){
+    //the points are projected in parallel, each one only stores its pixel
+    if(!scan.isContinuous()) scan = scan.clone();
+    int nPoints = scan.total();
+    const cv::Vec4f *points = nPoints > 0 ? scan.ptr<cv::Vec4f>(0) : 0;
+    vector<int> pixel(nPoints);
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#endif
 
     //EQUIRECTANGULAR projection
     if(pMethod == EQUIRECTANGULAR){
@@ -101,20 +150,22 @@ namespace fbr{
       double heightLow =(0 - MIN_ANGLE) / 360 * 2 * M_PI;
       int heightMax = iHeight - 1;
       
-      cv::MatIterator_<cv::Vec4f> it, end; 
-      
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -129,8 +180,8 @@ namespace fbr{
 	if (y < 0) y = 0;
 	if (y > heightMax) y = heightMax;
 	
-	//create the iReflectance iRange and map
-	map(x, y, it, range);
+	//remember the pixel, the images are filled afterwards
+	pixel[i] = y * iWidth + x;
       }
     }
 
@@ -155,20 +206,22 @@ namespace fbr{
       double yFactor = (double) iHeight / ( ymax - ymin );
       //shift all the values to positive points on image 
       int heightMax = iHeight - 1;
-      cv::MatIterator_<cv::Vec4f> it, end; 
-
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-        double kart[3], polar[3], phi, theta, range;
-        kart[0] = (*it)[2]/100;
-        kart[1] = (*it)[0]/-100;
-        kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+        const cv::Vec4f &point = points[i];
+        pixel[i] = -1;
+        double kart[3], polar[3], phi, theta;
+        kart[0] = point[2]/100;
+        kart[1] = point[0]/-100;
+        kart[2] = point[1]/100;
         toPolar(kart, polar);
         //theta == polar[0] == scan [4]
         //phi == polar[1] == scan [5]
         //range == polar[2] == scan [3]
         theta = polar[0] * 180 / M_PI;
         phi = polar[1] * 180 / M_PI;
-        range = polar[2];
         //phi == longitude == horizantal angle of view of [0:360] 
         phi = 180.0 - phi;
         phi *= M_PI / 180.0;
@@ -187,8 +240,8 @@ namespace fbr{
         y = heightMax - y;
         if (y < 0) y = 0;
         if (y > heightMax) y = heightMax;
-        //create the iReflectance iRange and map
-        map(x, y, it, range);
+        //remember the pixel, the images are filled afterwards
+        pixel[i] = y * iWidth + x;
       }
     }
     
@@ -202,20 +255,22 @@ namespace fbr{
       double heightLow = (MIN_ANGLE) / 360 * 2 * M_PI;
       int heightMax = iHeight - 1;
       
-      cv::MatIterator_<cv::Vec4f> it, end; 
-      
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -230,8 +285,8 @@ namespace fbr{
 	if (y < 0) y = 0;
 	if (y > heightMax) y = heightMax;
 	
-	//create the iReflectance iRange and map
-	map(x, y, it, range);
+	//remember the pixel, the images are filled afterwards
+	pixel[i] = y * iWidth + x;
       }
     }
     
@@ -244,20 +299,22 @@ namespace fbr{
       double heightLow = log(tan(MIN_ANGLE / 360 * 2 * M_PI) + (1/cos(MIN_ANGLE / 360 * 2 * M_PI)));
       int heightMax = iHeight - 1;
       
-      cv::MatIterator_<cv::Vec4f> it, end; 
-      
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -272,8 +329,8 @@ namespace fbr{
 	if (y < 0) y = 0;
 	if (y > heightMax) y = heightMax;
 	
-	//create the iReflectance iRange and map
-	map(x, y, it, range);
+	//remember the pixel, the images are filled afterwards
+	pixel[i] = y * iWidth + x;
       }
     }
     
@@ -290,20 +347,22 @@ namespace fbr{
       p1 = 0;
       
       //go through all points 
-      cv::MatIterator_<cv::Vec4f> it, end; 
-      
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -345,8 +404,8 @@ namespace fbr{
 	    if (y < 0) y = 0;
 	    if (y > heightMax) y = heightMax;
 	    
-	    //create the iReflectance iRange and map
-	    map(x, y, it, range);
+	    //remember the pixel, the images are filled afterwards
+	    pixel[i] = y * iWidth + x;
 	  }
 	}
       }
@@ -365,20 +424,22 @@ namespace fbr{
       //latitude of projection center
       p1 = 0;
       
-      cv::MatIterator_<cv::Vec4f> it, end; 
-         
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -421,8 +482,8 @@ namespace fbr{
 	    if (y < 0) y = 0;
 	    if (y > heightMax) y = heightMax;
 		    
-	    //create the iReflectance iRange and map
-	    map(x, y, it, range);
+	    //remember the pixel, the images are filled afterwards
+	    pixel[i] = y * iWidth + x;
 	  }
 	}
       }
@@ -443,20 +504,22 @@ namespace fbr{
       p1 = 0;
       
       //go through all points
-      cv::MatIterator_<cv::Vec4f> it, end; 
-         
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -499,8 +562,8 @@ namespace fbr{
 	    if (y < 0) y = 0;
 	    if (y > heightMax) y = heightMax;
 	    
-	    //create the iReflectance iRange and map
-	    map(x, y, it, range);
+	    //remember the pixel, the images are filled afterwards
+	    pixel[i] = y * iWidth + x;
 	  }
 	}
       }
@@ -519,20 +582,22 @@ namespace fbr{
       double heightLow = zmin;
       int heightMax = iHeight - 1;
       
-      cv::MatIterator_<cv::Vec4f> it, end; 
-         
-      for( it = scan.begin<cv::Vec4f>(), end = scan.end<cv::Vec4f>(); it != end; ++it){
-	double kart[3], polar[3], phi, theta, range;
-	kart[0] = (*it)[2]/100;
-	kart[1] = (*it)[0]/-100;
-	kart[2] = (*it)[1]/100;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for(int i = 0; i < nPoints; i++){
+	const cv::Vec4f &point = points[i];
+	pixel[i] = -1;
+	double kart[3], polar[3], phi, theta;
+	kart[0] = point[2]/100;
+	kart[1] = point[0]/-100;
+	kart[2] = point[1]/100;
 	toPolar(kart, polar);
 	//theta == polar[0] == scan [4]
 	//phi == polar[1] == scan [5]
 	//range == polar[2] == scan [3]
 	theta = polar[0] * 180 / M_PI;
 	phi = polar[1] * 180 / M_PI;
-	range = polar[2];
 	//horizantal angle of view of [0:360] and vertical of [-40:60]
 	phi = 360.0 - phi;
 	phi = phi * 2.0 * M_PI / 360.0;
@@ -543,15 +608,17 @@ namespace fbr{
 	if (x < 0) x = 0;
 	if (x > widthMax) x = widthMax;
 	///////////////////check this
-	int y = (int) ( yFactor * ((*it)[1] - heightLow) );
+	int y = (int) ( yFactor * (point[1] - heightLow) );
 	y = heightMax - y;
 	if (y < 0) y = 0;
 	if (y > heightMax) y = heightMax;
 	
-	//create the iReflectance iRange and map
-	map(x, y, it, range);
+	//remember the pixel, the images are filled afterwards
+	pixel[i] = y * iWidth + x;
       }
     }
+
+    fillImages(points, pixel);
   }
 
   void panorama::recoverPointCloud(const cv::Mat& range_image,
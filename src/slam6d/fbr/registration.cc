@@ -7,17 +7,74 @@
  *
  */
 
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include "slam6d/fbr/registration.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 namespace fbr{
 
+  /**
+   * @class ransacRandom : xorshift generator, each block of RANSAC iterations
+   * has its own one, seeded with the number of its first iteration. The
+   * hypotheses do not depend on the number of threads.
+   */
+  class ransacRandom{
+    unsigned long long state;
+  public:
+    ransacRandom(unsigned long long seed){
+      state = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+    }
+    unsigned int next(){
+      state ^= state >> 12;
+      state ^= state << 25;
+      state ^= state >> 27;
+      return (unsigned int)((state * 0x2545F4914F6CDD1DULL) >> 32);
+    }
+  };
+
+  /**
+   * @struct alignCandidate : the best align found by one thread
+   */
+  struct alignCandidate{
+    double score;
+    long long index;
+    double error;
+    unsigned int inliers;
+    double align[16];
+  };
+
+  /**
+   * takes the align if its score is lower, on equal scores the one of the
+   * earlier hypothesis wins as in a sequential search
+   */
+  static void considerAlign(alignCandidate& best, long long index, double score, double error, unsigned int inliers, const double* align){
+    if(score < best.score || (score == best.score && index < best.index)){
+      best.score = score;
+      best.index = index;
+      best.error = error;
+      best.inliers = inliers;
+      for(int a = 0; a < 16; a++)
+	best.align[a] = align[a];
+    }
+  }
+
   registration::registration(unsigned int minD, double minE, unsigned int minI, registration_method method){
     minDistance = minD;
     minError = minE;
     minInlier = minI;
     rMethod = method;
+    confidence = 0.99;
+    iterations = 0;
     bestError = minError;
     bestErrorIndex = 0;
     for(int i = 0; i < 16; i++)
@@ -29,50 +86,42 @@ namespace fbr{
     minError = 50;
     minInlier = 5;
     rMethod = RANSAC;
+    confidence = 0.99;
+    iterations = 0;
     bestError = minError;
     bestErrorIndex = 0;
     for(int i = 0; i < 16; i++)
       bestAlign[i] = 0;
   }
   
-  int registration::getCoord(vector<cv::KeyPoint> fKeypoints, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches, cv::Mat fPMap, cv::Mat sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct){
+  int registration::getKeypointCoord(const cv::KeyPoint& keypoint, const cv::Mat& pMap, cv::Point3f& c){
     int x, y;
-    y = fKeypoints[matches[idx].queryIdx].pt.x;
-    x = fKeypoints[matches[idx].queryIdx].pt.y;
+    y = keypoint.pt.x;
+    x = keypoint.pt.y;
 
-    if(fKeypoints[matches[idx].queryIdx].pt.x - x > 0.5)
-      x++;
-    if(fKeypoints[matches[idx].queryIdx].pt.y - y > 0.5)
-      y++;
-    cv::Mat_<cv::Vec3f> _fPMap = fPMap;
-    float sqr = sqrt (_fPMap(x,y)[0] * _fPMap(x,y)[0] + _fPMap(x,y)[1] * _fPMap(x,y)[1] + _fPMap(x,y)[2] * _fPMap(x,y)[2]);
-    if(sqr != 0){
-      cq.x = _fPMap(x,y)[0];
-      cq.y = _fPMap(x,y)[1];
-      cq.z = _fPMap(x,y)[2]; 
-    }
-    else
-      return 0;
-   
-    y = sKeypoints[matches[idx].trainIdx].pt.x;
-    x = sKeypoints[matches[idx].trainIdx].pt.y;
-    if(sKeypoints[matches[idx].trainIdx].pt.x - x > 0.5)
+    if(keypoint.pt.x - x > 0.5)
       x++;
-    if(sKeypoints[matches[idx].trainIdx].pt.y - y > 0.5)
+    if(keypoint.pt.y - y > 0.5)
       y++;
-    cv::Mat_<cv::Vec3f> _sPMap = sPMap;
-    sqr = sqrt (_sPMap(x,y)[0] * _sPMap(x,y)[0] + _sPMap(x,y)[1] * _sPMap(x,y)[1] + _sPMap(x,y)[2] * _sPMap(x,y)[2]);
+    cv::Mat_<cv::Vec3f> _pMap = pMap;
+    float sqr = sqrt (_pMap(x,y)[0] * _pMap(x,y)[0] + _pMap(x,y)[1] * _pMap(x,y)[1] + _pMap(x,y)[2] * _pMap(x,y)[2]);
     if(sqr != 0){
-      ct.x = _sPMap(x,y)[0];
-      ct.y = _sPMap(x,y)[1];
-      ct.z = _sPMap(x,y)[2];
+      c.x = _pMap(x,y)[0];
+      c.y = _pMap(x,y)[1];
+      c.z = _pMap(x,y)[2];
     }
     else
       return 0;
-  
+
     return 1;
   }
 
+  int registration::getCoord(const vector<cv::KeyPoint>& fKeypoints, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches, const cv::Mat& fPMap, const cv::Mat& sPMap, int idx, cv::Point3f& cq, cv::Point3f& ct){
+    if(!getKeypointCoord(fKeypoints[matches[idx].queryIdx], fPMap, cq))
+      return 0;
+    return getKeypointCoord(sKeypoints[matches[idx].trainIdx], sPMap, ct);
+  }
+
   void registration::pointToArray(cv::Point3f c, double* cd){
     cd[0] = c.x;
     cd[1] = c.y;
@@ -88,17 +137,13 @@ namespace fbr{
   }
 
 
-  int registration::findAlign(unsigned int i, unsigned int j, unsigned int k, cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches){
-    cv::Point3f c1q, c2q, c3q, c1t, c2t, c3t;
+  int registration::findAlign(unsigned int i, unsigned int j, unsigned int k, const vector<cv::Point3f>& cq, const vector<cv::Point3f>& ct, const vector<char>& valid, double* align, double& iError, unsigned int& eIdx){
     if(i == j || i == k || j == k)
       return 0;
     //get the coordinates
-    if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, i, c1q, c1t) == 0)
-      return 0;
-    if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, j, c2q, c2t) == 0)
-      return 0;
-    if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, k, c3q, c3t) == 0)
+    if(!valid[i] || !valid[j] || !valid[k])
       return 0;
+    cv::Point3f c1q = cq[i], c2q = cq[j], c3q = cq[k], c1t = ct[i], c2t = ct[j], c3t = ct[k];
     //check for min distance
     if(norm(c1q - c2q) < minDistance || norm(c1q - c3q) < minDistance || norm(c2q - c3q) < minDistance || norm(c1t - c2t) < minDistance || norm(c1t - c3t) < minDistance || norm(c2t - c3t) < minDistance)
       return 0;
@@ -114,7 +159,6 @@ namespace fbr{
     centroidt.z = centroidt.z / 3;
     //put each point into double array
     double c1qd[3], c2qd[3], c3qd[3], c1td[3], c2td[3], c3td[3];
-    cv::Point3f temp;
     pointToArray(c1q, c1qd);
     pointToArray(c2q, c2qd);
     pointToArray(c3q, c3qd);
@@ -126,60 +170,158 @@ namespace fbr{
     pairs.push_back(PtPair(c1qd, c1td));
     pairs.push_back(PtPair(c2qd, c2td));
     pairs.push_back(PtPair(c3qd, c3td));
-    double align[16];
     double centroidqd[3], centroidtd[3];
     pointToArray(centroidq, centroidqd);
     pointToArray(centroidt, centroidtd);
     icp6D_QUAT q(true);
     q.Point_Point_Align(pairs, align, centroidqd, centroidtd);
     //transform the matches with align if the error is less than minerror
-    double iError = 0;
-    unsigned int eIdx = 0;
-    for(unsigned int p = 0; p < matches.size(); p++){
+    iError = 0;
+    eIdx = 0;
+    for(unsigned int p = 0; p < cq.size(); p++){
       if(p == i || p == j || p == k)
 	continue;
-      cv::Point3f cq, ct, ct_trans;
-      if(getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, p, cq, ct) == 0)
+      if(!valid[p])
 	continue;
-      ct_trans = coordTransform(ct, align);
-      if(norm(ct_trans - cq) < minError){
-	iError += norm(ct_trans - cq);
+      cv::Point3f ct_trans = coordTransform(ct[p], align);
+      if(norm(ct_trans - cq[p]) < minError){
+	iError += norm(ct_trans - cq[p]);
 	eIdx++;
       }
     }
-    //check for mininlier and find the best align
-    if(eIdx > minInlier){ 
-      double aError = iError / eIdx;
-      if(aError - iInfluence*eIdx < bestError - iInfluence*bestErrorIndex){
-	bestError = aError;
-	bestErrorIndex = eIdx;
-	for(int a = 0; a < 16; a++) 
-	  bestAlign[a] = align[a];
-      }
-    }
     return 1;
   }
-  
-  void registration::findRegistration(cv::Mat fPMap, vector<cv::KeyPoint> fKeypoints, cv::Mat sPMap, vector<cv::KeyPoint> sKeypoints, vector<cv::DMatch> matches){
+
+  void registration::findRegistration(const cv::Mat& fPMap, const vector<cv::KeyPoint>& fKeypoints, const cv::Mat& sPMap, const vector<cv::KeyPoint>& sKeypoints, const vector<cv::DMatch>& matches){
+    unsigned int nMatches = matches.size();
+    //the 3D coordinates of all matches are looked up once
+    vector<cv::Point3f> cq(nMatches), ct(nMatches);
+    vector<char> valid(nMatches);
+    for(unsigned int m = 0; m < nMatches; m++)
+      valid[m] = getCoord(fKeypoints, sKeypoints, matches, fPMap, sPMap, m, cq[m], ct[m]);
+    findBestAlign(cq, ct, valid);
+  }
+
+  void registration::findRegistration(const vector<cv::Point3f>& fCoords, const vector<cv::Point3f>& sCoords, const vector<cv::DMatch>& matches){
+    unsigned int nMatches = matches.size();
+    vector<cv::Point3f> cq(nMatches), ct(nMatches);
+    vector<char> valid(nMatches);
+    for(unsigned int m = 0; m < nMatches; m++){
+      cq[m] = fCoords[matches[m].queryIdx];
+      ct[m] = sCoords[matches[m].trainIdx];
+      valid[m] = (cq[m].x != 0 || cq[m].y != 0 || cq[m].z != 0) && (ct[m].x != 0 || ct[m].y != 0 || ct[m].z != 0);
+    }
+    findBestAlign(cq, ct, valid);
+  }
+
+  void registration::findBestAlign(const vector<cv::Point3f>& cq, const vector<cv::Point3f>& ct, const vector<char>& valid){
+    unsigned int nMatches = cq.size();
+    iterations = 0;
+    if(nMatches == 0)
+      return;
+
+    unsigned int nValid = 0;
+    for(unsigned int m = 0; m < nMatches; m++)
+      nValid += valid[m];
+
+    alignCandidate best;
+    best.score = bestError - iInfluence*bestErrorIndex;
+    best.index = -1;
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#endif
+
     //go through all matches
     if(rMethod == ALL){
-      for(unsigned int i = 0; i < matches.size(); i++)
-	for(unsigned int j = 0; j < matches.size(); j++)
-	  for(unsigned int k = 0; k < matches.size(); k++){
-	    findAlign(i, j, k, fPMap, fKeypoints, sPMap, sKeypoints, matches);
-	  }
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+	alignCandidate local = best;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+	for(int i = 0; i < (int)nMatches; i++)
+	  for(unsigned int j = 0; j < nMatches; j++)
+	    for(unsigned int k = 0; k < nMatches; k++){
+	      double align[16], iError;
+	      unsigned int eIdx;
+	      if(findAlign(i, j, k, cq, ct, valid, align, iError, eIdx) && eIdx > minInlier){
+		double aError = iError / eIdx;
+		considerAlign(local, ((long long)i * nMatches + j) * nMatches + k, aError - iInfluence*eIdx, aError, eIdx, align);
+	      }
+	    }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+	considerAlign(best, local.index, local.score, local.error, local.inliers, local.align);
+      }
+      iterations = (unsigned long)nMatches * nMatches * nMatches;
     }
+
     //RANSAC
-    if(rMethod == RANSAC)
-      for(int r = 0; r < RANSACITR; r++){
-	if((r % (RANSACITR/10)) == 0){
-	  cout<<"RANSAC iteration: "<<(r / (RANSACITR/10) + 1) * 10 <<"%"<<endl;
+    if(rMethod == RANSAC){
+      //hypotheses drawn from one generator
+      const int block = 50;
+      const long round = RANSACITR / 10;
+      long needed = RANSACITR;
+      for(long first = 0; first < needed; first += round){
+#ifdef _OPENMP
+	//no progress if many registrations run in parallel
+	if(!omp_in_parallel())
+#endif
+	  cout<<"RANSAC iteration: "<<(first / round + 1) * 10 <<"%"<<endl;
+	int blocks = (round + block - 1) / block;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+	{
+	  alignCandidate local = best;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+	  for(int b = 0; b < blocks; b++){
+	    long r0 = first + (long)b * block;
+	    long r1 = min(r0 + block, first + round);
+	    ransacRandom rng(r0);
+	    for(long r = r0; r < r1; r++){
+	      unsigned int i = rng.next() % nMatches;
+	      unsigned int j = rng.next() % nMatches;
+	      unsigned int k = rng.next() % nMatches;
+	      double align[16], iError;
+	      unsigned int eIdx;
+	      if(findAlign(i, j, k, cq, ct, valid, align, iError, eIdx) && eIdx > minInlier){
+		double aError = iError / eIdx;
+		considerAlign(local, r, aError - iInfluence*eIdx, aError, eIdx, align);
+	      }
+	    }
+	  }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+	  considerAlign(best, local.index, local.score, local.error, local.inliers, local.align);
+	}
+	iterations = first + round;
+
+	//stop as soon as a hypothesis of three inliers has been drawn with
+	//the given confidence, for the inlier ratio of the best align
+	if(confidence > 0 && confidence < 1 && best.index >= 0 && nValid > 0){
+	  double w = (best.inliers + 3.0) / nValid;
+	  double w3 = w >= 1 ? 1 : w * w * w;
+	  if(w3 >= 1)
+	    needed = 0;
+	  else
+	    needed = min((long)RANSACITR, (long)ceil(log(1 - confidence) / log(1 - w3)));
 	}
-	unsigned int i = rand() % matches.size();
-	unsigned int j = rand() % matches.size();
-	unsigned int k = rand() % matches.size();
-	findAlign(i, j, k, fPMap, fKeypoints, sPMap, sKeypoints, matches);
       }
+    }
+
+    if(best.index >= 0){
+      bestError = best.error;
+      bestErrorIndex = best.inliers;
+      for(int a = 0; a < 16; a++)
+	bestAlign[a] = best.align[a];
+    }
   }
 
   unsigned int registration::getMinDistance(){
@@ -198,6 +340,18 @@ namespace fbr{
     return rMethod;
   }
 
+  void registration::setConfidence(double c){
+    confidence = c;
+  }
+
+  double registration::getConfidence(){
+    return confidence;
+  }
+
+  unsigned long registration::getIterations(){
+    return iterations;
+  }
+
   double * registration::getBestAlign(){
     return bestAlign;
   }
@@ -212,7 +366,7 @@ namespace fbr{
   
   void registration::getDescription(){
     cout<<"Registration minDistance: "<<minDistance<<", minError: "<<minError<<", minInlier: "<<minInlier<<", registrationMethod: "<<registrationMethodToString(rMethod)<<"."<<endl;
-    cout<<"Registration finished with besterror of: "<<bestError<<" and best error index of: "<<bestErrorIndex<<"."<<endl;
+    cout<<"Registration finished after "<<iterations<<" hypotheses with besterror of: "<<bestError<<" and best error index of: "<<bestErrorIndex<<"."<<endl;
     cout<<"align Matrix:"<<endl;
     if(bestErrorIndex > 0){
       cout<<bestAlign[0]<<"  "<<bestAlign[4]<<"  "<<bestAlign[8]<<"  "<<bestAlign[12]<<endl;
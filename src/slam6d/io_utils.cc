@@ -1,7 +1,13 @@
 #include "slam6d/io_utils.h"
+#include "scanio/scan_io.h"
 
 #include <fstream>
 using std::ifstream;
+#include <vector>
+using std::vector;
+#include <algorithm>
+
+#include <boost/filesystem/operations.hpp>
 
 /**
  * Parsing of a formats file in the scan directory for default type and scan
@@ -47,3 +53,57 @@ void parseFormatFile(string& dir, WriteOnce<IOType>& type, WriteOnce<int>& start
     }
   }
 }
+
+unsigned long long fingerprint(unsigned long long hash, const void* data, unsigned int length)
+{
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  for(unsigned int i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+unsigned long long scanFingerprint(const string& dir, const string& identifier, IOType type)
+{
+  namespace fs = boost::filesystem;
+  unsigned long long hash = 14695981039346656037ULL;
+  string prefix = "scan" + identifier + ".";
+  
+  try {
+    std::list<string> read;
+    try {
+      read = ScanIO::getScanIO(type)->readFiles(dir.c_str(), identifier.c_str());
+    } catch(fs::filesystem_error& e) {
+      throw;
+    } catch(std::runtime_error& e) {
+      // without its ScanIO the scan is taken to be in the files scanNNN.*
+    }
+    vector<fs::path> files(read.begin(), read.end());
+    if(files.empty()) {
+      for(fs::directory_iterator it(dir), end; it != end; ++it) {
+        if(!fs::is_regular_file(it->status())) continue;
+        string name = it->path().filename().string();
+        if(name.compare(0, prefix.size(), prefix) != 0) continue;
+        string ext = name.substr(prefix.size());
+        // derived files don't change the points
+        if(ext == "oct" || ext == "frames") continue;
+        files.push_back(it->path());
+      }
+    }
+    // the order of a directory listing is not defined
+    std::sort(files.begin(), files.end());
+    
+    for(size_t i = 0; i < files.size(); ++i) {
+      string name = files[i].filename().string();
+      unsigned long long size = fs::file_size(files[i]);
+      long long mtime = fs::last_write_time(files[i]);
+      hash = fingerprint(hash, name.c_str(), name.size());
+      hash = fingerprint(hash, &size, sizeof(size));
+      hash = fingerprint(hash, &mtime, sizeof(mtime));
+    }
+  } catch(fs::filesystem_error& e) {
+    cerr << "Could not fingerprint scan " << identifier << ": " << e.what() << endl;
+  }
+  return hash;
+}
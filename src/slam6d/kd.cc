@@ -87,24 +87,58 @@ double *KDtree::FindClosestAlongDir(double *_p,
   return params[threadNum].closest;
 }
 
+/**
+ * Finds the k closest points within the tree, sorted by distance.
+ * @param _p point
+ * @param k maximal number of neighbors
+ * @param maxdist2 maximal search distance
+ * @param neighbors buffer of at least k pointers for the result
+ * @param dist2 buffer of at least k squared distances for the result
+ * @param threadNum Thread number, for parallelization
+ * @return Number of neighbors found
+ */
+int KDtree::FindKClosest(double *_p,
+                         int k,
+                         double maxdist2,
+                         double **neighbors,
+                         double *dist2,
+                         int threadNum) const
+{
+  return _FindKClosest(Void(), _p, k, maxdist2, neighbors, dist2, threadNum);
+}
+
+/**
+ * Finds all points within the search distance.
+ * @param _p point
+ * @param maxdist2 maximal search distance
+ * @param neighbors vector receiving the points
+ * @param dist2 vector receiving the squared distances
+ * @param threadNum Thread number, for parallelization
+ * @return Number of points found
+ */
+int KDtree::FindInRadius(double *_p,
+                         double maxdist2,
+                         vector<double*> &neighbors,
+                         vector<double> &dist2,
+                         int threadNum) const
+{
+  return _FindInRadius(Void(), _p, maxdist2, neighbors, dist2, threadNum);
+}
+
 vector<Point> KDtree::kNearestNeighbors(double *_p,
 								int k,
 								double sqRad2,
 								int threadNum) const
 {
     vector<Point> result;
-    params[threadNum].closest = 0;
-    params[threadNum].closest_d2 = sqRad2;
-    params[threadNum].p = _p;
-    params[threadNum].heap.clear();
-    _KNNSearch(Void(), threadNum);
-
-    while (k > 0 && params[threadNum].heap.empty() == false) {
-        Point pt = params[threadNum].heap.front().first;
-        result.push_back(pt);
-        std::pop_heap(params[threadNum].heap.begin(), params[threadNum].heap.end(), PointCompare());
-        params[threadNum].heap.pop_back();
-        k--;
+    if (k <= 0) return result;
+    vector<double*> neighbors(k);
+    vector<double> dist2(k);
+    int n = FindKClosest(_p, k, sqRad2, &neighbors[0], &dist2[0], threadNum);
+
+    result.reserve(n);
+    for (int i = 0; i < n; i++) {
+        result.push_back(Point(neighbors[i]));
     }
 
     return result;
@@ -115,14 +149,13 @@ vector<Point> KDtree::fixedRangeSearch(double *_p,
 							    int threadNum) const
 {
     vector<Point> result;
-    params[threadNum].closest = 0;
-    params[threadNum].closest_d2 = sqRad2;
-    params[threadNum].p = _p;
-    params[threadNum].heap.clear();
-    _FixedRangeSearch(Void(), threadNum);
-
-    for (vector<std::pair<Point, double> >::iterator it = params[threadNum].heap.begin(); it != params[threadNum].heap.end(); ++it) {
-        result.push_back(it->first);
+    vector<double*> neighbors;
+    vector<double> dist2;
+    int n = FindInRadius(_p, sqRad2, neighbors, dist2, threadNum);
+
+    result.reserve(n);
+    for (int i = 0; i < n; i++) {
+        result.push_back(Point(neighbors[i]));
     }
 
     return result;
@@ -70,6 +70,16 @@ double* KDtreeManaged::FindClosestAlongDir(double *_p, double *_dir, double maxd
   return params[threadNum].closest;
 }
 
+int KDtreeManaged::FindKClosest(double *_p, int k, double maxdist2, double **neighbors, double *dist2, int threadNum) const
+{
+  return _FindKClosest(*m_data, _p, k, maxdist2, neighbors, dist2, threadNum);
+}
+
+int KDtreeManaged::FindInRadius(double *_p, double maxdist2, vector<double*> &neighbors, vector<double> &dist2, int threadNum) const
+{
+  return _FindInRadius(*m_data, _p, maxdist2, neighbors, dist2, threadNum);
+}
+
 void KDtreeManaged::lock()
 {
   boost::lock_guard<boost::mutex> lock(m_mutex_locking);
@@ -11,6 +11,7 @@
 
 #include "scanserver/clientInterface.h"
 #include "slam6d/Boctree.h"
+#include "slam6d/io_utils.h"
 #include "slam6d/kdManaged.h"
 
 #ifdef WITH_METRICS
@@ -312,8 +313,19 @@ void ManagedScan::createOcttree()
   string scanFileName = string(m_shared_scan->getDirPath()) + "scan" + getIdentifier() + ".oct";
   BOctTree<float>* btree = 0;
 
-  // if loadOct is given, load the octtree under blind assumption that parameters match
+  unsigned long long source = scanFingerprint(m_shared_scan->getDirPath(), getIdentifier(), m_shared_scan->getIOType());
+  
+  // if loadOct is given, load the octtree if it is an up to date octree image
+  // or a serialized octree, the latter under blind assumption that parameters match
+  bool outdated = false;
   if(octtree_loadOct && exists(scanFileName)) {
+    outdated = BOctTree<float>::isImage(scanFileName) &&
+      !BOctTree<float>::isCurrentImage(scanFileName, octtree_voxelSize, octtree_reduction_voxelSize,
+                                       octtree_pointtype, source);
+    if(outdated) cout << "Octree " << scanFileName << " is outdated, rebuilding it" << endl;
+  }
+  
+  if(octtree_loadOct && exists(scanFileName) && !outdated) {
     btree = new BOctTree<float>(scanFileName);
   } else {
     if(octtree_reduction_voxelSize > 0) { // with reduction, only xyz points
@@ -326,9 +338,9 @@ void ManagedScan::createOcttree()
       for(unsigned int i = 0; i < nrpts; ++i) delete[] pts[i]; delete[] pts;
     }
     // save created octtree
-    if(octtree_saveOct) {
+    if(octtree_saveOct || outdated) {
       cout << "Saving octree " << scanFileName << endl;
-      btree->serialize(scanFileName);
+      btree->serializeImage(scanFileName, octtree_reduction_voxelSize, source);
     }
   }
 
@@ -20,6 +20,8 @@
  * the first scan that do NOT have a corresponding point in the second scan 
  * within a distance of less than NR units.
  * Difference scans will be written to 'dir/diff'
+ * With -v a voxel map of the changes is written instead, counting for every
+ * voxel the unchanged, removed and added points.
  * ATTENTION: All scans between START and END will be loaded!
  * @author Dorit Borrmann. Automation Group, Jacobs University Bremen gGmbH, Germany. 
  */
@@ -40,11 +42,14 @@ using std::endl;
 using std::ofstream;
 using std::ifstream;
 #include <errno.h>
+#include <cstdio>
 #include <vector>
+#include <map>
 
 #include "slam6d/globals.icc"
 #include "slam6d/io_utils.h"
 #include "slam6d/scan.h"
+#include "slam6d/kd.h"
 
 #include "scanserver/clientInterface.h"
 
@@ -107,6 +112,11 @@ void usage(char* prog)
 	  << endl
 	  << bold << "  -d" << normal << " NR, " << bold << "--dist=" << normal << "NR" << endl
 	  << "         write all points that have no corresponding point closer than NR 'units'" << endl
+	  << endl
+	  << bold << "  -v" << normal << " NR, " << bold << "--voxel=" << normal << "NR" << endl
+	  << "         write a map of voxels of size NR with the number of unchanged, removed" << endl
+	  << "         and added points instead of the differing points" << endl
+	  << endl
 	  << bold << "  -S, --scanserver" << normal << endl
 	  << "         Use the scanserver as an input method and handling of scan data" << endl
     << endl << endl;
@@ -129,11 +139,13 @@ void usage(char* prog)
  * @param dist the maximal distance for a point pair
  * @param type the scan format
  * @param desc true if start is greater than end
+ * @param voxel size of the voxels of the change map, no map if <= 0
+ * @param scanserver use the scanserver
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, 
 		    int &start, int &end, int &maxDist, int &minDist, double &dist, 
-		    IOType &type, bool &desc, bool scanserver)
+		    IOType &type, bool &desc, double &voxel, bool &scanserver)
 {
   int  c;
   // from unistd.h:
@@ -152,17 +164,21 @@ int parseArgs(int argc, char **argv, string &dir,
     { "start",           required_argument,   0,  's' },
     { "end",             required_argument,   0,  'e' },
     { "dist",            required_argument,   0,  'd' },
+    { "voxel",           required_argument,   0,  'v' },
     { "scanserver",      no_argument,         0,  'S' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
   cout << endl;
-  while ((c = getopt_long(argc, argv, "f:d:s:e:m:M:", longopts, NULL)) != -1)
+  while ((c = getopt_long(argc, argv, "f:d:s:e:m:M:v:S", longopts, NULL)) != -1)
     switch (c)
 	 {
 	 case 'd':
 	   dist = atof(optarg);
 	   break;
+	 case 'v':
+	   voxel = atof(optarg);
+	   break;
 	 case 's':
 	   w_start = atoi(optarg);
 	   if (start < 0) { cerr << "Error: Cannot start at a negative scan number.\n"; exit(1); }
@@ -223,6 +239,176 @@ int parseArgs(int argc, char **argv, string &dir,
 }
 
 
+/**
+ * Marks all points of \a query that have no point of \a tree within the
+ * squared distance \a dist2. The queries are answered in parallel.
+ *
+ * @return the number of unmatched points
+ */
+unsigned int findUnmatched(KDtree &tree, DataXYZ &query, double dist2,
+                           vector<char> &unmatched)
+{
+  unmatched.assign(query.size(), 0);
+  unsigned int nr_unmatched = 0;
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 4096) reduction(+:nr_unmatched)
+#endif
+  for (int i = 0; i < (int)query.size(); i++) {
+#ifdef _OPENMP
+    int thread_num = omp_get_thread_num();
+#else
+    int thread_num = 0;
+#endif
+    double p[3] = { query[i][0], query[i][1], query[i][2] };
+    if (!tree.FindClosest(p, dist2, thread_num)) {
+      unmatched[i] = 1;
+      nr_unmatched++;
+    }
+  }
+  return nr_unmatched;
+}
+
+/**
+ * Writes the unmatched points of \a xyz, transformed by \a transMat, to
+ * \a filename. Blocks of points are formatted in parallel and written in
+ * order through a large stdio buffer.
+ */
+bool writeDiff(const string &filename, DataXYZ &xyz,
+               const vector<char> &unmatched, const double *transMat)
+{
+  FILE *out = fopen(filename.c_str(), "w");
+  if (!out) return false;
+  vector<char> outbuffer(1 << 22);
+  setvbuf(out, &outbuffer[0], _IOFBF, outbuffer.size());
+
+  const int batch = 65536;
+  const int nr_batches = OPENMP_NUM_THREADS * 4;
+  vector<string> chunks(nr_batches);
+  bool good = true;
+
+  for (unsigned int block = 0; block < xyz.size(); block += batch * nr_batches) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int b = 0; b < nr_batches; b++) {
+      string &chunk = chunks[b];
+      chunk.clear();
+      unsigned int first = block + b * batch;
+      unsigned int last = std::min(first + batch, xyz.size());
+      char line[128];
+      for (unsigned int i = first; i < last; i++) {
+        if (!unmatched[i]) continue;
+        double p[3];
+        transform3(transMat, xyz[i], p);
+        int len = snprintf(line, sizeof(line), "%f %f %f\n", p[0], p[1], p[2]);
+        chunk.append(line, len);
+      }
+    }
+    for (int b = 0; b < nr_batches; b++) {
+      if (fwrite(chunks[b].data(), 1, chunks[b].size(), out) != chunks[b].size())
+        good = false;
+    }
+  }
+
+  return fclose(out) == 0 && good;
+}
+
+/**
+ * Point counts of a voxel of the change map
+ */
+struct VoxelChange {
+  VoxelChange() : unchanged(0), removed(0), added(0) {}
+  unsigned int unchanged;
+  unsigned int removed;
+  unsigned int added;
+};
+
+typedef std::map<long long, VoxelChange> ChangeMap;
+
+//! 21 bits per axis, i.e., +-2^20 voxels around the origin
+inline long long voxelKey(const double *p, double voxel)
+{
+  long long key = 0;
+  for (int j = 0; j < 3; j++) {
+    long long v = (long long)floor(p[j] / voxel) + (1 << 20);
+    if (v < 0) v = 0;
+    if (v >= (1 << 21)) v = (1 << 21) - 1;
+    key = (key << 21) | v;
+  }
+  return key;
+}
+
+/**
+ * Counts the points of \a xyz per voxel, in the local coordinate system
+ * given by \a transMat. The voxel keys are computed in parallel, the counts
+ * are then summed up in point order, so the map does not depend on the
+ * number of threads.
+ */
+void countChanges(ChangeMap &changes, DataXYZ &xyz, const vector<char> &unmatched,
+                  const double *transMat, double voxel, bool is_source)
+{
+  // -1 for points that are not counted, valid keys are never negative
+  vector<long long> keys(xyz.size());
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+  for (int i = 0; i < (int)xyz.size(); i++) {
+    // points of the target with correspondence are counted as unchanged
+    // for the source already
+    if (!is_source && !unmatched[i]) {
+      keys[i] = -1;
+      continue;
+    }
+    double p[3];
+    transform3(transMat, xyz[i], p);
+    keys[i] = voxelKey(p, voxel);
+  }
+
+  for (unsigned int i = 0; i < keys.size(); i++) {
+    if (keys[i] < 0) continue;
+    VoxelChange &change = changes[keys[i]];
+    if (!is_source) change.added++;
+    else if (unmatched[i]) change.removed++;
+    else change.unchanged++;
+  }
+}
+
+/**
+ * Writes the change map of the two scans to \a filename, one line per
+ * voxel with its center and the number of unchanged, removed and added
+ * points.
+ */
+bool writeChangeMap(const string &filename, DataXYZ &xyz_source,
+                    const vector<char> &removed, DataXYZ &xyz_target,
+                    const vector<char> &added, const double *transMat, double voxel)
+{
+  ChangeMap changes;
+  countChanges(changes, xyz_source, removed, transMat, voxel, true);
+  countChanges(changes, xyz_target, added, transMat, voxel, false);
+
+  FILE *out = fopen(filename.c_str(), "w");
+  if (!out) return false;
+  vector<char> outbuffer(1 << 22);
+  setvbuf(out, &outbuffer[0], _IOFBF, outbuffer.size());
+
+  fprintf(out, "# voxel size %f: x y z unchanged removed added\n", voxel);
+  const long long mask = (1 << 21) - 1;
+  for (ChangeMap::iterator it = changes.begin(); it != changes.end(); ++it) {
+    double c[3];
+    c[0] = (((it->first >> 42) & mask) - (1 << 20) + 0.5) * voxel;
+    c[1] = (((it->first >> 21) & mask) - (1 << 20) + 0.5) * voxel;
+    c[2] = ((it->first & mask) - (1 << 20) + 0.5) * voxel;
+    fprintf(out, "%f %f %f %u %u %u\n", c[0], c[1], c[2],
+            it->second.unchanged, it->second.removed, it->second.added);
+  }
+  cout << changes.size() << " voxels in the change map" << endl;
+
+  return fclose(out) == 0;
+}
+
 /**
  * Main program for calculating the difference of two scans.
  * Usage: bin/scan_diff -d <NR> -s <NR> -e <NR> 'dir',
@@ -250,9 +436,10 @@ int main(int argc, char **argv)
   int    minDist    = -1;
   IOType type    = RIEGL_TXT;
   bool desc = false;  
+  double voxel = -1.0;
   bool scanserver = false;
 
-  parseArgs(argc, argv, dir, start, end, maxDist, minDist, dist, type, desc, scanserver);
+  parseArgs(argc, argv, dir, start, end, maxDist, minDist, dist, type, desc, voxel, scanserver);
 
   if (scanserver) {
     try {
@@ -330,54 +517,75 @@ int main(int argc, char **argv)
 
   Scan* scan_first = *(Scan::allScans.begin());
   Scan* scan_second = *(Scan::allScans.end()-1);
+  scan_first->setRangeFilter(maxDist, minDist);
+  scan_second->setRangeFilter(maxDist, minDist);
 
   scan_first->transform(inMatrix0, Scan::INVALID);
   scan_second->transform(inMatrix1, Scan::INVALID);
 
-  DataXYZ xyz_first(scan_first->get("xyz"));
-  DataXYZ xyz_second(scan_second->get("xyz"));
-  
-  cout << "Scan " << scan_first->getIdentifier() << " with " << xyz_first.size() << " points" << endl;
-  cout << "Scan " << scan_second->getIdentifier() << " with " << xyz_second.size() << " points" << endl;
-
-  int thread_num = 0;
-  std::vector<double*> diff;
+  // the points of the source scan are checked against the target scan
+  Scan *source = desc ? scan_second : scan_first;
+  Scan *target = desc ? scan_first : scan_second;
   double transMat[16];
-  
   if(desc) {
-    Scan::getNoPairsSimple(diff, scan_second, scan_first, thread_num, dist);
     M4inv(inMatrix1, transMat);
-    scanFileName = dir + "diff/scan" + to_string(end,3) + ".3d";
+    scanFileName = dir + "diff/scan" + to_string(end,3);
   } else {
-    Scan::getNoPairsSimple(diff, scan_first, scan_second, thread_num, dist);
     M4inv(inMatrix0, transMat);
-    scanFileName = dir + "diff/scan" + to_string(start,3) + ".3d";
+    scanFileName = dir + "diff/scan" + to_string(start,3);
   }
 
-  cout << endl; 
-  for(int i = 0; i < 16; i++) {
-    cout << transMat[i] << " ";
-  }
-  cout << endl; 
-  for(int i = 0; i < 16; i++) {
-    cout << inMatrix0[i] << " ";
+  unsigned long phasetime = GetCurrentTimeInMilliSec();
+  DataXYZ xyz_source(source->get("xyz reduced"));
+  DataXYZ xyz_target(target->get("xyz reduced"));
+  cout << "Scan " << source->getIdentifier() << " with " << xyz_source.size() << " points" << endl;
+  cout << "Scan " << target->getIdentifier() << " with " << xyz_target.size() << " points" << endl;
+  cout << "Loading: " << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s" << endl;
+
+  double dist2 = dist * dist;
+  vector<char> removed, added;
+
+  phasetime = GetCurrentTimeInMilliSec();
+  KDtree *tree_target = new KDtree(PointerArray<double>(xyz_target).get(), xyz_target.size());
+  cout << "Building search tree: " << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s" << endl;
+  phasetime = GetCurrentTimeInMilliSec();
+  unsigned int nr_removed = findUnmatched(*tree_target, xyz_source, dist2, removed);
+  cout << "Searching: " << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s, "
+       << nr_removed << " of " << xyz_source.size() << " points without correspondence" << endl;
+  delete tree_target;
+
+  if (voxel > 0.0) {
+    // the added points are those of the target without correspondence
+    phasetime = GetCurrentTimeInMilliSec();
+    KDtree *tree_source = new KDtree(PointerArray<double>(xyz_source).get(), xyz_source.size());
+    cout << "Building search tree: " << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s" << endl;
+    phasetime = GetCurrentTimeInMilliSec();
+    unsigned int nr_added = findUnmatched(*tree_source, xyz_target, dist2, added);
+    cout << "Searching: " << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s, "
+         << nr_added << " of " << xyz_target.size() << " points without correspondence" << endl;
+    delete tree_source;
   }
-  cout << endl; 
- 
-  ofstream ptsout(scanFileName.c_str());
 
-  for(unsigned int i = 0; i < diff.size(); i++) {
-    Point p(diff[i]);
-    p.transform(transMat); 
-    ptsout << p.x << " " << p.y << " " << p.z << " " << endl;    
+  phasetime = GetCurrentTimeInMilliSec();
+  bool written;
+  if (voxel > 0.0) {
+    scanFileName += ".voxels";
+    written = writeChangeMap(scanFileName, xyz_source, removed, xyz_target, added,
+                             transMat, voxel);
+  } else {
+    scanFileName += ".3d";
+    written = writeDiff(scanFileName, xyz_source, removed, transMat);
   }
- 
-  ptsout.close();
-  ptsout.clear();
+  if (!written) {
+    cerr << "Writing " << scanFileName << " failed" << endl;
+    exit(1);
+  }
+  cout << "Writing " << scanFileName << ": "
+       << (GetCurrentTimeInMilliSec() - phasetime) / 1000.0 << " s" << endl;
 
   if (scanserver) {
-    scan_first->clear("xyz");
-    scan_second->clear("xyz");
+    scan_first->clear("xyz reduced");
+    scan_second->clear("xyz reduced");
   }
 
   cout << endl << endl;
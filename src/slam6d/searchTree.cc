@@ -25,6 +25,16 @@ double *SearchTree::FindClosestAlongDir(double *_p, double *_dir, double maxdist
   throw std::runtime_error("Method FindClosestAlongDir is not implemented");
 }
 
+int SearchTree::FindKClosest(double *_p, int k, double maxdist2, double **neighbors, double *dist2, int threadNum) const
+{
+  throw std::runtime_error("Method FindKClosest is not implemented");
+}
+
+int SearchTree::FindInRadius(double *_p, double maxdist2, vector<double*> &neighbors, vector<double> &dist2, int threadNum) const
+{
+  throw std::runtime_error("Method FindInRadius is not implemented");
+}
+
 void SearchTree::getPtPairs(vector <PtPair> *pairs, 
                             double *source_alignxf,                          // source
                             double * const *q_points,
@@ -1,4 +1,12 @@
+#ifdef _MSC_VER
+#if !defined _OPENMP && defined OPENMP
+#define _OPENMP
+#endif
+#endif
+
 #include <errno.h>
+#include <float.h>
+#include <algorithm>
 #include "thermo/thermo.h"
 #include "newmat/newmatap.h"
 using namespace NEWMAT;
@@ -23,6 +31,10 @@ using namespace cvb;
 #define WIN32
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 Float2D data1;
 Float2D data2;
 
@@ -1174,7 +1186,7 @@ void writeGlobalCameras(int start, int end, bool optical, bool quiet, string dir
   }
   CvMat *Rotation;
   CvMat *Translation;
-  loadExtrinsicCalibration(Rotation, Translation, dir, method, optical);
+  loadExtrinsicCalibration(Translation, Rotation, dir, method, optical);
 
   double starttime = GetCurrentTimeInMilliSec();
 
@@ -1698,7 +1710,7 @@ void calculateGlobalCameras(int start, int end, bool optical, bool quiet, string
 
 }
 
-void loadIntrinsicCalibration(CvMat * intrinsic, CvMat * distortion, string dir, bool optical) {
+void loadIntrinsicCalibration(CvMat *&intrinsic, CvMat *&distortion, string dir, bool optical) {
   string substring = optical? "Optical" : "";
   string file = dir + "Intrinsics" + substring + ".xml";
   intrinsic = (CvMat*) cvLoad(file.c_str());
@@ -1706,7 +1718,7 @@ void loadIntrinsicCalibration(CvMat * intrinsic, CvMat * distortion, string dir,
   distortion = (CvMat*) cvLoad(file.c_str());
 }  
   
-void loadExtrinsicCalibration(CvMat * Translation, CvMat * Rotation, string dir, int method, bool optical) {
+void loadExtrinsicCalibration(CvMat *&Translation, CvMat *&Rotation, string dir, int method, bool optical) {
   string substring = optical? "Optical" : "";
   string file;
   switch(method) {
@@ -1751,7 +1763,7 @@ void openOutputDirectory(string outdir) {
   }
 }
 
-int openDirectory(CvMat* point_3Dcloud, string dir, IOType type, int count) {
+int openDirectory(CvMat *&point_3Dcloud, string dir, IOType type, int count) {
   // reading the 3D points and projecting them back to 2d
   Scan::openDirectory(false, dir, type, count, count);
   Scan::allScans[0]->setRangeFilter(-1, -1);
@@ -1771,7 +1783,7 @@ int openDirectory(CvMat* point_3Dcloud, string dir, IOType type, int count) {
   return red_size;
 }
 
-void loadImage(IplImage *image, string dir, int count0, bool optical, int scale){
+bool loadImage(IplImage *&image, string dir, int count0, bool optical, int scale){
       string t, t0;
       if(optical) {
         t = dir + "/photo" + to_string(count0, 3) + ".jpg";
@@ -1779,17 +1791,19 @@ void loadImage(IplImage *image, string dir, int count0, bool optical, int scale)
         t = dir + "/image" + to_string(count0, 3) + ".ppm";
       }
 
-      image = cvLoadImage(t.c_str(), -1);
-      if (!image) {
-        cout << "first image " << t << " cannot be loaded" << endl;
-        exit(0);
+      IplImage *source = cvLoadImage(t.c_str(), -1);
+      if (!source) {
+        cerr << "image " << t << " cannot be loaded" << endl;
+        return false;
       }
       
-      image = resizeImage(image, scale);
+      image = resizeImage(source, scale);
+      cvReleaseImage(&source);
+      return true;
 }
 
-void calculateGlobalPoses(CvMat *Translation, CvMat *Rotation, CvMat *t_comI,
-CvMat *rod_comI, double angle, CvMat *rot_tmp) {
+void calculateGlobalPoses(CvMat *Translation, CvMat *Rotation, CvMat *&t_comI,
+CvMat *&rod_comI, double angle, CvMat *&rot_tmp) {
   CvMat* RotationI = cvCreateMat(3,1,CV_32FC1);
   CvMat* TranslationI = cvCreateMat(3,1,CV_32FC1);
   CvMat* rod40 = cvCreateMat(3,1,CV_32FC1);
@@ -1840,13 +1854,166 @@ CvMat *rod_comI, double angle, CvMat *rot_tmp) {
 
 }
 
+/**
+  * A point seen in one of the images with the value it gets from the image
+  * and the squared distance of its projection to the image center.
+  */
+struct Observation {
+  int index;
+  float score;
+  float value[3];
+};
+
+/**
+  * Projects the points onto one image and collects the points that are seen
+  * in it. Only points in front of the camera are projected. With correction
+  * the points inside the image are splatted with the given radius into a
+  * depth buffer, and the points lying more than depthThresh behind the
+  * buffer are occluded.
+  * @return false if the image cannot be loaded
+  */
+bool mapImage(CvMat *point_3Dcloud, int nr_points, CvMat *Translation,
+    CvMat *Rotation, CvMat *intrinsic, CvMat *distortion, CvMat *undistort,
+    string dir, int count0, double angle, bool optical, int scale,
+    bool correction, int splat, double depthThresh,
+    vector<Observation> &observations, int &point_map1, int &point_map2) {
+
+  IplImage *image;
+  if (!loadImage(image, dir, count0, optical, scale)) {
+    return false;
+  }
+  int width = image->width;
+  int height = image->height;
+
+  CvMat* rod_comI;
+  CvMat* t_comI;
+  CvMat* rot_tmp;
+  calculateGlobalPoses(Translation, Rotation, t_comI, rod_comI, angle, rot_tmp);
+
+  float R[3][3], t[3];
+  for(int i = 0; i < 3; i++) {
+    for(int j = 0; j < 3; j++) {
+      R[i][j] = CV_MAT_ELEM(*rot_tmp,float,i,j);
+    }
+    t[i] = CV_MAT_ELEM(*t_comI,float,i,0);
+  }
+
+  // the points behind the camera are dropped before projecting
+  vector<int> front;
+  vector<float> depth;
+  for (int k = 0; k < nr_points; k++) {
+    float x = CV_MAT_ELEM(*point_3Dcloud,float,k,0);
+    float y = CV_MAT_ELEM(*point_3Dcloud,float,k,1);
+    float z = CV_MAT_ELEM(*point_3Dcloud,float,k,2);
+    if(R[2][0] * x + R[2][1] * y + R[2][2] * z < 0) {
+      continue;
+    }
+    float cx = R[0][0] * x + R[0][1] * y + R[0][2] * z + t[0];
+    float cy = R[1][0] * x + R[1][1] * y + R[1][2] * z + t[1];
+    float cz = R[2][0] * x + R[2][1] * y + R[2][2] * z + t[2];
+    front.push_back(k);
+    depth.push_back(sqrt(cx * cx + cy * cy + cz * cz));
+  }
+
+  int nr_front = front.size();
+  vector<int> pixel(nr_front, -1);
+  vector<float> score(nr_front, 0);
+  if (nr_front > 0) {
+    CvMat* front_3Dcloud = cvCreateMat(nr_front, 3, CV_32FC1);
+    CvMat* point_2Dcloud = cvCreateMat(nr_front, 2, CV_32FC1);
+    CvMat* undistort_2Dcloud = cvCreateMat(nr_front, 2, CV_32FC1);
+    for (int j = 0; j < nr_front; j++) {
+      for (int l = 0; l < 3; l++) {
+        CV_MAT_ELEM(*front_3Dcloud,float,j,l) = CV_MAT_ELEM(*point_3Dcloud,float,front[j],l);
+      }
+    }
+
+    cvProjectPoints2(front_3Dcloud, rod_comI, t_comI, intrinsic, distortion, point_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
+    cvProjectPoints2(front_3Dcloud, rod_comI, t_comI, intrinsic, undistort, undistort_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
+
+    // checking whether projection lies within the image boundaries
+    for (int j = 0; j < nr_front; j++) {
+      float px = CV_MAT_ELEM(*undistort_2Dcloud,float,j,0);
+      float py = CV_MAT_ELEM(*undistort_2Dcloud,float,j,1);
+      if (!(px < width - .5 && px >= 0 && py >= 0 && py < height - .5)) {
+        continue;
+      }
+      point_map1++;
+      px = CV_MAT_ELEM(*point_2Dcloud,float,j,0);
+      py = CV_MAT_ELEM(*point_2Dcloud,float,j,1);
+      if (!(px < width - .5 && px >= 0 && py >= 0 && py < height - .5)) {
+        continue;
+      }
+      int ppx = px - int(px) < .5 ? int(px) : int(px) + 1;
+      int ppy = py - int(py) < .5 ? int(py) : int(py) + 1;
+      pixel[j] = ppy * width + ppx;
+      score[j] = (px - width / 2.0) * (px - width / 2.0) + (py - height / 2.0) * (py - height / 2.0);
+    }
+
+    cvReleaseMat(&front_3Dcloud);
+    cvReleaseMat(&point_2Dcloud);
+    cvReleaseMat(&undistort_2Dcloud);
+  }
+
+  // the closest depth around each pixel
+  vector<float> zbuffer;
+  if (correction) {
+    zbuffer.assign(width * height, FLT_MAX);
+    for (int j = 0; j < nr_front; j++) {
+      if (pixel[j] < 0) continue;
+      int ppx = pixel[j] % width;
+      int ppy = pixel[j] / width;
+      int lower_y = max(ppy - splat, 0);
+      int upper_y = min(ppy + splat, height - 1);
+      int lower_x = max(ppx - splat, 0);
+      int upper_x = min(ppx + splat, width - 1);
+      for (int y = lower_y; y <= upper_y; y++) {
+        for (int x = lower_x; x <= upper_x; x++) {
+          float &d = zbuffer[y * width + x];
+          if (depth[j] < d) d = depth[j];
+        }
+      }
+    }
+  }
+
+  for (int j = 0; j < nr_front; j++) {
+    if (pixel[j] < 0) continue;
+    if (correction && depth[j] > zbuffer[pixel[j]] + depthThresh) continue;
+    point_map2++;
+
+    CvScalar c = cvGet2D(image, pixel[j] / width, pixel[j] % width);
+    Observation o;
+    o.index = front[j];
+    o.score = score[j];
+    if(optical) {
+      o.value[0] = c.val[2];
+      o.value[1] = c.val[1];
+      o.value[2] = c.val[0];
+    } else {
+      o.value[0] = (c.val[0] - 1000.0)/10.0;
+      o.value[1] = o.value[2] = 0;
+    }
+    observations.push_back(o);
+  }
+
+  cvReleaseMat(&t_comI);
+  cvReleaseMat(&rod_comI);
+  cvReleaseMat(&rot_tmp);
+  cvReleaseImage(&image);
+  return true;
+}
+
 /**
   * Main function for projecting the 3D points onto the corresponding image and
   * associating temperature values to the data points.
+  * The images of a scan are processed in parallel. Every point gets the value
+  * of the image it is seen closest to the center of, with correction points
+  * hidden from the camera by others are not mapped (see mapImage), depthThresh
+  * is the depth a point may lie behind the depth buffer and still be seen.
   */
 void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
     IOType type, int scale, double rot_angle, double minDist, double maxDist,
-    bool correction, int neighborhood, int method) {
+    bool correction, int neighborhood, double depthThresh, int method) {
 
   int nr_img = end - start + 1;
   if (nr_img < 1) {
@@ -1865,235 +2032,108 @@ void ProjectAndMap(int start, int end, bool optical, bool quiet, string dir,
     CV_MAT_ELEM(*undistort, float,hh,0) = 0;
   }
 
-  double starttime = GetCurrentTimeInMilliSec();
+  int splat = neighborhood / 2;
 
-  stringstream outdat;
-  int pointcnt = 0;
   string outdir = dir + "/labscan-map"; 
   openOutputDirectory(outdir);
   
   for (int count = start; count <= end; count++) {
-    // filling the rotation matrix 
-    
+    double starttime = GetCurrentTimeInMilliSec();
+
     CvMat *point_3Dcloud;
     int nr_points = openDirectory(point_3Dcloud, dir, type, count);
     
-    CvMat* point_2Dcloud = cvCreateMat(nr_points, 2, CV_32FC1);
-    CvMat* undistort_2Dcloud = cvCreateMat(nr_points, 2, CV_32FC1);
-    
     cout << "Number of points read: " << nr_points << endl;
     delete Scan::allScans[0];
     Scan::allScans.clear();
 
-    // write colored data  
-    string outname = outdir + "/scan" + to_string(count, 3) + ".3d";
-    fstream outfile;
-    outfile.open(outname.c_str(), ios::out);
-
-
     int nrP360 = 9;
+    vector<vector<Observation> > observations(nrP360);
+    vector<int> point_map1(nrP360, 0);
+    vector<int> point_map2(nrP360, 0);
+    // exiting inside the parallel region is not allowed, failures are handled after it
+    vector<int> loaded(nrP360, 0);
+
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
     for(int p = 0; p < nrP360; p++) {
-      //for(int p = 0; p < 9; p++) {
-      //double angle = rot_angle * (p%nrP360) + 2.0;
       double angle = rot_angle * (p%nrP360);
-      cout << angle << endl;
-      // loading images
-      int count0 = count * nrP360 + p;
-
-      IplImage *image;
-      loadImage(image, dir, count0, optical, scale);
-      CvSize size = cvGetSize(image); 
-
-      // rotate Rotation and Translation
-      CvMat* rod_comI; 
-      CvMat* t_comI; 
-      CvMat* rot_tmp = cvCreateMat(3,3,CV_32FC1);
-      calculateGlobalPoses(Translation, Rotation, t_comI, rod_comI, angle, rot_tmp);
-
-      // Project Points
-      cvProjectPoints2(point_3Dcloud, rod_comI, t_comI, intrinsic, distortion, point_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
-      cvProjectPoints2(point_3Dcloud, rod_comI, t_comI, intrinsic, undistort, undistort_2Dcloud, NULL, NULL, NULL, NULL, NULL, 0);
-
-      cvReleaseMat(&t_comI);
-      cvReleaseMat(&rod_comI);
-      cout << "Done projecting points" << endl;
-
-      //for counting how many points get mapped to first and second image file
-      int point_map1 = 0;  // #points mapped to first image
-      int point_map2 = 0;  //    "      "    "  second image
-      int point_map3 = 0;  //    "      "    "  second image
-
-      // checking whether projection lies within the image boundaries
-      cout << "Now project points" << endl; 
-      for (int k = 0; k < nr_points; k++) {
-        float px = CV_MAT_ELEM(*undistort_2Dcloud,float,k,0);
-        float py = CV_MAT_ELEM(*undistort_2Dcloud,float,k,1);
-        if (px < image->width - .5 && px >= 0 && py >= 0 && py < image->height - .5 ) { 
-          point_map1++;
-          px = CV_MAT_ELEM(*point_2Dcloud,float,k,0);
-          py = CV_MAT_ELEM(*point_2Dcloud,float,k,1);
-          if (px < image->width - .5 && px >= 0 && py >= 0 && py < image->height - .5) {
-            point_map2++;
-            CvMat* tmp1 = cvCreateMat(1, 1, CV_32FC3);
-            CvMat* tmp2 = cvCreateMat(1, 1, CV_32FC3);
-            CV_MAT_ELEM(*tmp1, CvPoint3D32f, 0,0).x = CV_MAT_ELEM(*point_3Dcloud,float,k,0); 
-            CV_MAT_ELEM(*tmp1, CvPoint3D32f, 0,0).y = CV_MAT_ELEM(*point_3Dcloud,float,k,1); 
-            CV_MAT_ELEM(*tmp1, CvPoint3D32f, 0,0).z = CV_MAT_ELEM(*point_3Dcloud,float,k,2); 
-
-            cvTransform(tmp1, tmp2, rot_tmp);
-            cvReleaseMat(&tmp1); 
-
-
-            if(CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).z < 0) {
-              cvReleaseMat(&tmp2); 
-              continue; 
-            }
-            cvReleaseMat(&tmp2); 
-            /*
-               outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,0) << " "
-               << CV_MAT_ELEM(*point_3Dcloud,float,k,1) << " "
-               << CV_MAT_ELEM(*point_3Dcloud,float,k,2) << " "
-               << CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).x << " "  
-               << CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).y << " "
-               << CV_MAT_ELEM(*tmp2, CvPoint3D32f, 0,0).z << endl;
-             */
-            point_map3++;
-            int ppx = 0;
-            int ppy = 0;
-            if (px - int(px) < .5) {
-              ppx = int(px);
-            } else {
-              ppx = int(px) + 1;
-            }
-            if (py - int(py) < .5) {
-              ppy = int(py);
-            } else {
-              ppy = int(py) + 1;
-            }
-
-            CvScalar c;
-            c = cvGet2D(image, ppy, ppx);
-            // check for overlap
-            /*
-               if(correction) {
-               vector<float> temp_vec;
-               float p_id = 1; // 1 for pixel, 0 for neighboring pixel
-               temp_vec.push_back(-(CV_MAT_ELEM(*point_3Dcloud,float,k,1)));
-               temp_vec.push_back((CV_MAT_ELEM(*point_3Dcloud,float,k,2)));
-               temp_vec.push_back((CV_MAT_ELEM(*point_3Dcloud,float,k,0)));
-               temp_vec.push_back(c.val[2]);
-               temp_vec.push_back(c.val[1]);
-               temp_vec.push_back(c.val[0]);
-               temp_vec.push_back(p_id);
-               if(neighborhood > 1) {
-               int limit = neighborhood / 2;
-
-               int lower_y = ppy - limit > 0 ? ppy - limit : 0;
-               int upper_y = ppy + limit < size.height ? ppy + limit : size.height - 1;
-               int lower_x = ppx - limit > 0 ? ppx - limit : 0;
-               int upper_x = ppx + limit < size.width ? ppx + limit : size.width - 1;
-
-               for (int y = lower_y; y < upper_y; y++) {
-               for (int x = lower_x; x < upper_x; x++) {
-               if(x == ppx && y == ppy) {
-               temp_vec[6] = 1;
-               } else {
-               temp_vec[6] = 0;
-               }
-               data1[y][x].push_back(temp_vec);
-               }
-               }
-
-               } else {
-               data1[ppy][ppx].push_back(temp_vec);
-               }
-               temp_vec.clear();
-               } else {
-             */
-            // write all the data
-
-            outdat << -(CV_MAT_ELEM(*point_3Dcloud,float,k,1))<<" ";
-            outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,2)<<" ";
-            outdat << CV_MAT_ELEM(*point_3Dcloud,float,k,0)<<" ";
-
-            if(optical) {
-              outdat << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
-            } else {
-              outdat << (c.val[0] - 1000.0)/10.0 << endl;
-            }
-
-            pointcnt++;
-            if(pointcnt > 100) {
-              outfile.write(outdat.str().c_str(), outdat.str().size());
-              pointcnt = 0;
-              outdat.clear();
-              outdat.str("");
-            }
-
-            /*
-               outfile << -(CV_MAT_ELEM(*point_3Dcloud,float,k,1))<<" ";
-               outfile << CV_MAT_ELEM(*point_3Dcloud,float,k,2)<<" ";
-               outfile << CV_MAT_ELEM(*point_3Dcloud,float,k,0)<<" ";
-
-               if(optical) {
-               outfile << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
-               } else {
-               outfile << (c.val[0] - 1000.0)/10.0 << endl;
-               }
-            //outfile << c.val[2] <<" "<< c.val[1]<<" "<<c.val[0]<<endl;
-             */
-
-            //}
-          } 
-          // second image
-        } 
-
+      loaded[p] = mapImage(point_3Dcloud, nr_points, Translation, Rotation, intrinsic,
+          distortion, undistort, dir, count * nrP360 + p, angle, optical,
+          scale, correction, splat, depthThresh, observations[p],
+          point_map1[p], point_map2[p]);
+    }
+    if(std::find(loaded.begin(), loaded.end(), 0) != loaded.end()) {
+      cerr << "Could not map the images of scan " << count << endl;
+      exit(1);
+    }
 
+    if(!quiet) {
+      for(int p = 0; p < nrP360; p++) {
+        cout << "image " << count * nrP360 + p << ": " << point_map1[p] << " "
+             << point_map2[p] << endl;
       }
+    }
 
-      cout << "Done sorting points" << endl;
-
-      // write data with overlap correction
-      if(correction) {
-        CorrectErrorAndWrite(data1, outfile, size, optical);
-        cout << "Done first image" << endl;
-        if(fabs(rot_angle) > 1) {
-          if(size.width > 0 && size.height > 0) {
-            CorrectErrorAndWrite(data2, outfile, size, optical);
-          }
+    // keep the observation closest to the image center, the first image on ties
+    vector<const Observation*> best(nr_points, (const Observation*)0);
+    for(int p = 0; p < nrP360; p++) {
+      for(unsigned int i = 0; i < observations[p].size(); i++) {
+        const Observation &o = observations[p][i];
+        if(best[o.index] == 0 || o.score < best[o.index]->score) {
+          best[o.index] = &o;
         }
       }
+    }
 
-      cout << "Done correction" << endl;
-      // clean up
-      outfile.flush();
-
-      double endtime = GetCurrentTimeInMilliSec();
-      double time = endtime - starttime;
-      time = time/1000.0;
-      cout<<"runtime for scan " << count0 << " in seconds is: " << time << endl;
+    // write colored data  
+    string outname = outdir + "/scan" + to_string(count, 3) + ".3d";
+    FILE *outfile = fopen(outname.c_str(), "w");
+    if(!outfile) {
+      cerr << "Could not open " << outname << endl;
+      exit(1);
+    }
 
-      cout << point_map1 << " " << point_map2 << " " << point_map3 << endl;
-      cvReleaseImage(&image);
-      if(correction) {
-        for (int i = 0; i < size.height; i++) {
-          for (int j = 0; j < size.width; j++) {
-            data1[i][j].clear();
-            if(fabs(rot_angle) > 1) {
-              data2[i][j].clear();
-            }
-          }
-        }
+    int mapped = 0;
+    string outdat;
+    char line[256];
+    for (int k = 0; k < nr_points; k++) {
+      if(best[k] == 0) continue;
+      mapped++;
+      const Observation &o = *best[k];
+      int len;
+      if(optical) {
+        len = snprintf(line, sizeof(line), "%g %g %g %g %g %g\n",
+            -(CV_MAT_ELEM(*point_3Dcloud,float,k,1)),
+            CV_MAT_ELEM(*point_3Dcloud,float,k,2),
+            CV_MAT_ELEM(*point_3Dcloud,float,k,0),
+            o.value[0], o.value[1], o.value[2]);
+      } else {
+        len = snprintf(line, sizeof(line), "%g %g %g %g\n",
+            -(CV_MAT_ELEM(*point_3Dcloud,float,k,1)),
+            CV_MAT_ELEM(*point_3Dcloud,float,k,2),
+            CV_MAT_ELEM(*point_3Dcloud,float,k,0),
+            o.value[0]);
+      }
+      outdat.append(line, len);
+      if(outdat.size() > (1 << 20)) {
+        fwrite(outdat.data(), 1, outdat.size(), outfile);
+        outdat.clear();
       }
-      cvReleaseMat(&rot_tmp);
     }
-    outfile.close();
+    fwrite(outdat.data(), 1, outdat.size(), outfile);
+    fclose(outfile);
 
-    cvReleaseMat(&point_2Dcloud);
     cvReleaseMat(&point_3Dcloud);
-    cvReleaseMat(&undistort_2Dcloud);
 
-    }
+    double endtime = GetCurrentTimeInMilliSec();
+    double time = endtime - starttime;
+    time = time/1000.0;
+    cout << "Mapped " << mapped << " of " << nr_points << " points" << endl;
+    cout<<"runtime for scan " << count << " in seconds is: " << time << endl;
+  }
   // Final cleanup  
   cvReleaseMat(&intrinsic);
   cvReleaseMat(&distortion);
@@ -2259,6 +2299,10 @@ void usage(char* prog) {
     << endl
 	  << bold << "  -P --=mapping" << normal << endl
 	  << "         perform mapping of image data to point cloud" << endl
+    << endl
+	  << bold << "  -d" << normal << " NR, " << bold << "--depth=" << normal << "NR" << endl
+	  << "         with correction a point lying more than NR behind the depth buffer" << endl
+	  << "         is hidden from the camera (default 4)" << endl
     << endl
 	  << bold << "  -q --=quiet" << normal << endl
 	  << "         " << endl
@@ -2278,7 +2322,8 @@ void usage(char* prog) {
 int parseArgs(int argc, char **argv, string &dir, int &start, int &end, double
 &maxDist, double &minDist, IOType &type, bool &optical, bool &chess, int
 &width, int &height, bool &intrinsic, bool &extrinsic, bool &mapping, bool
-&correction, int &scale, int &neighborhood, double &angle, bool &quiet ) {
+&correction, int &scale, int &neighborhood, double &angle, double &depthThresh,
+bool &quiet ) {
   // from unistd.h:
   int  c;
   extern char *optarg;
@@ -2291,6 +2336,7 @@ int parseArgs(int argc, char **argv, string &dir, int &start, int &end, double
     { "scale",           required_argument,   0,  'S' },  
     { "neighborhood",    required_argument,   0,  'n' },  
     { "angle",           required_argument,   0,  'a' },  
+    { "depth",           required_argument,   0,  'd' },  
     { "format",          required_argument,   0,  'f' },  
     { "max",             required_argument,   0,  'm' },
     { "min",             required_argument,   0,  'M' },
@@ -2308,7 +2354,7 @@ int parseArgs(int argc, char **argv, string &dir, int &start, int &end, double
   };
   
   cout << endl;
-  while ((c = getopt_long(argc, argv, "f:s:e:x:y:m:M:qoIEPcCS:n:a:", longopts, NULL)) != -1) { 
+  while ((c = getopt_long(argc, argv, "f:s:e:x:y:m:M:qoIEPcCS:n:a:d:", longopts, NULL)) != -1) { 
   switch (c)
 	{
 	 case 's':
@@ -2364,6 +2410,9 @@ int parseArgs(int argc, char **argv, string &dir, int &start, int &end, double
    case 'a':
     angle = atof(optarg);
     break;
+   case 'd':
+    depthThresh = atof(optarg);
+    break;
    case 'n':
     neighborhood = atoi(optarg);
     break;
@@ -2423,15 +2472,16 @@ int main(int argc, char** argv) {
   double rot_angle = 0;
   bool correction = false;
   int neighborhood = 1;
+  double depthThresh = 4;
 
   parseArgs(argc, argv, dir, start, end, maxDist, minDist, type, optical, chess,
   width, height, intrinsic, extrinsic, mapping, correction, scale, neighborhood,
-  rot_angle, quiet);
+  rot_angle, depthThresh, quiet);
 
   // either mapping
   if(mapping) {
     if(!quiet) cout << "Starting projecting and mapping image data to point cloud..." << endl;
-    //TODO ProjectAndMap(start, end, optical, quiet, dir, type, scale, rot_angle, minDist, maxDist, correction, neighborhood);
+    //TODO ProjectAndMap(start, end, optical, quiet, dir, type, scale, rot_angle, minDist, maxDist, correction, neighborhood, depthThresh);
     
     //calculateGlobalCameras(start, end, optical, quiet, dir, type, scale,
     writeGlobalCameras(start, end, optical, quiet, dir, type, scale,
@@ -0,0 +1,158 @@
+/*
+ * gridcell implementation
+ *
+ * Copyright (C) Andreas Nuechter, Li Wei, Li Ming
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Implementation of the polar cell grid of a velodyne scan
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ */
+
+#ifdef _MSC_VER
+#define  _USE_MATH_DEFINES
+#endif
+
+#include <cmath>
+#include <algorithm>
+
+#include "veloslam/gridcell.h"
+
+/** entries of the lookup table per column of an octant */
+#define LUT_RESOLUTION 4
+
+cellArray::cellArray()
+  : columnSize(0), cellNumber(0), sectionSize(0)
+{
+}
+
+/**
+ * The column is found by the octant of the direction and the tangent
+ * t = minor / major of its angle to the nearest axis, 0 <= t <= 1. A
+ * lookup table over t gives the column up to one, since the table is finer
+ * than the columns, a single comparison with the tangent of the next
+ * column border decides.
+ */
+int cellArray::columnIndex(double x, double z) const
+{
+	double ax = fabs(x);
+	double az = fabs(z);
+	bool steep = az > ax;
+	double t = steep ? ax / az : (ax > 0 ? az / ax : 0);
+
+	int s = lut[(int)(t * (lut.size() - 1))];
+	if (s + 1 < sectionSize && t >= tanv[s + 1])
+		s++;
+
+	// octants are numbered counterclockwise, starting at the x axis
+	int octant;
+	if (x >= 0)
+		octant = z >= 0 ? (steep ? 1 : 0) : (steep ? 6 : 7);
+	else
+		octant = z >= 0 ? (steep ? 2 : 3) : (steep ? 5 : 4);
+
+	// in odd octants the angle to the nearest axis decreases
+	if (octant & 1)
+		return (octant + 1) * sectionSize - 1 - s;
+	return octant * sectionSize + s;
+}
+
+int cellArray::build(vector<Point>& points, int _columnSize, int _cellNumber,
+					 float minRad, float maxRad, float cellSize)
+{
+	if (_columnSize <= 0 || _columnSize % 8 != 0 || _cellNumber <= 0)
+		return -1;
+
+	int i;
+	if (_columnSize != columnSize) {
+		columnSize = _columnSize;
+		sectionSize = columnSize / 8;
+		float inc = (M_PI * 2) / columnSize;
+
+		tanv.resize(sectionSize);
+		for (i = 0; i < sectionSize; ++i)
+			tanv[i] = tan(inc * i);
+
+		int lutSize = sectionSize * LUT_RESOLUTION;
+		lut.resize(lutSize + 1);
+		for (i = 0; i <= lutSize; ++i) {
+			float t = i / (float)lutSize;
+			lut[i] = (upper_bound(tanv.begin(), tanv.end(), t) - tanv.begin()) - 1;
+		}
+	}
+	cellNumber = _cellNumber;
+
+	int cellCount = columnSize * cellNumber;
+	int size = points.size();
+	cellOf.resize(size);
+	start.assign(cellCount + 1, 0);
+
+	// counting sort, count the points per cell first
+	for (i = 0; i < size; ++i) {
+		Point &pt = points[i];
+		cellOf[i] = -1;
+		if (pt.rad <= minRad || pt.rad >= maxRad)
+			continue;
+
+		int ring = (int)((pt.rad - minRad) / cellSize);
+		if (ring >= cellNumber)
+			continue;
+
+		int c = columnIndex(pt.x, pt.z) * cellNumber + ring;
+		cellOf[i] = c;
+		start[c + 1]++;
+	}
+
+	for (i = 0; i < cellCount; ++i)
+		start[i + 1] += start[i];
+
+	// then place the point indices, keeping their order within each cell
+	index.resize(start[cellCount]);
+	cells.resize(cellCount);
+	for (i = 0; i < cellCount; ++i)
+		cells[i].count = 0;
+
+	for (i = 0; i < size; ++i) {
+		int c = cellOf[i];
+		if (c < 0)
+			continue;
+		index[start[c] + cells[c].count++] = i;
+	}
+
+	Point *base = points.empty() ? 0 : &points[0];
+	const int *first = index.empty() ? 0 : &index[0];
+	for (i = 0; i < cellCount; ++i) {
+		cells[i].points = base;
+		cells[i].index = first + start[i];
+	}
+
+	return 0;
+}
+
+void cellArray::clear()
+{
+	cellOf.clear();
+	start.clear();
+	index.clear();
+	cells.clear();
+	cellNumber = 0;
+}
+
+void cellArray::swap(cellArray& other)
+{
+	std::swap(columnSize, other.columnSize);
+	std::swap(cellNumber, other.cellNumber);
+	std::swap(sectionSize, other.sectionSize);
+	tanv.swap(other.tanv);
+	lut.swap(other.lut);
+	cellOf.swap(other.cellOf);
+	start.swap(other.start);
+	index.swap(other.index);
+	cells.swap(other.cells);
+}
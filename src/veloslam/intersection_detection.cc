@@ -9,12 +9,12 @@
 
 #include "veloslam/intersection_detection.h"
 #include "veloslam/veloscan.h"
+#include "veloslam/svm_batch.h"
 #include <iostream>
 #include <fstream>
 #define  DefaultColumnSize 360
 
 svm_model *m = svm_load_model("SegIter.model");
-svm_node *nod=new svm_node[361];
 
 IntersectionDetection::IntersectionDetection()
 {
@@ -74,149 +74,10 @@ int IntersectionDetection::CalcRadAndTheta()
 
 int IntersectionDetection::CalPointCellPos(double x,double y,double z ,int * column,int * row)
 {
-	int i,j,count=0;
-	float flag;
-	int offset;
-	int sectionSize=columnNum/8;
-	float inc=(M_PI*2)/columnNum;
-
-	vector<float> tanv;
-	vector<float>::iterator result;
-
-	for(i=0; i<sectionSize; ++i)
-	{
-		tanv.push_back(tan(inc*i));
-	}
 	double rad=sqrt(x*x+z*z);
-	double tan_theta=z/x;
-
-	int diff;
-	if(x >0 && z>0 )
-	{
-		if(x >z)
-		{
-			flag=tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize-1;
-			}
-			else
-			{
-				offset=result-tanv.begin();
-			}
-		}
-		else
-		{
-			flag=1/tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize;
-			}
-			else
-			{
-				diff=result-tanv.begin();
-				offset=sectionSize*2-1-(diff);
-			}
-
-		}
-	}
-
-	else if(x<0 && z>0)
-	{
-		if(-x>z)
-		{
-			flag=-tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize*3;
-			}
-			else
-			{
-				offset=sectionSize*4-1-(result-tanv.begin());
-			}
-
-		}
-		else
-		{
-			flag=1/-tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize*3-1;
-			}
-			else
-			{
-				offset=sectionSize*2+(result-tanv.begin());
-			}
-		}
-	}
-
-	else if(x<0&&z<0)
-	{
-		if(-x>-z)
-		{
-			flag=tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize*5-1;
-			}
-			else
-			{
-				offset=sectionSize*4+(result-tanv.begin());
-			}
-		}
-		else
-		{
-			flag=1/tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize*5;
-			}
-			else
-			{
-				offset=sectionSize*6-1-(result-tanv.begin());
-			}
-
-		}
-	}
-
-	else if(x>0&&z<0)
-	{
-		if(x>-z)
-		{
-			flag=-tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize*7;
-			}
-			else
-			{
-				offset=sectionSize*8-1-(result-tanv.begin());
-			}
-		}
-		else
-		{
-			flag=1/-tan_theta;
-			result=upper_bound(tanv.begin(),tanv.end(),flag);
-			if(result==tanv.end())
-			{
-				offset=sectionSize*7-1;
-			}
-			else
-			{
-				offset=sectionSize*6+(result-tanv.begin());
-			}
-		}
-	}
 
 	int k= (int)((rad-MinRad)/(cellSize*1.0));
-	* column=offset;
+	* column=cellArray_AfterRegstn.columnIndex(x,z);
 	* row=k;
 	return 0;
 }
@@ -241,169 +102,8 @@ int IntersectionDetection::CalCellMinDis()
 
 int IntersectionDetection::TransferToCellArray()
 {
-
-	int i,j,count=0;
-	float flag;
-	int offset;
-	int sectionSize=columnNum/8;
-
-
-	cellArray_AfterRegstn.resize(columnNum);
-	for(i=0; i<columnNum; ++i)
-		cellArray_AfterRegstn[i].resize(cellNum);
-
-	float inc=(M_PI*2)/columnNum;
-
-	vector<float> tanv;
-	vector<float>::iterator result;
-
-	for(i=0; i<sectionSize; ++i)
-	{
-		tanv.push_back(tan(inc*i));
-	}
-
-	int diff;
-	for(i=0; i< allPoints_AfterRegstn.size(); ++i)
-	{
-		count++;
-		Point  &pt= allPoints_AfterRegstn[i];
-
-		if(pt.rad <=MinRad || pt.rad>=MaxRad)
-			continue;
-
-		if(pt.x >0 && pt.z>0 )
-		{
-			if(pt.x > pt.z)
-			{
-				flag=pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize-1;
-				}
-				else
-				{
-					offset=result-tanv.begin();
-				}
-			}
-			else
-			{
-				flag=1/pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize;
-				}
-				else
-				{
-					diff=result-tanv.begin();
-					offset=sectionSize*2-1-(diff);
-				}
-
-			}
-		}
-
-		else if(pt.x<0 && pt.z>0)
-		{
-			if(-pt.x>pt.z)
-			{
-				flag=-pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize*3;
-				}
-				else
-				{
-					offset=sectionSize*4-1-(result-tanv.begin());
-				}
-
-			}
-			else
-			{
-				flag=1/-pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize*3-1;
-				}
-				else
-				{
-					offset=sectionSize*2+(result-tanv.begin());
-				}
-			}
-		}
-
-		else if(pt.x<0&&pt.z<0)
-		{
-			if(-pt.x>-pt.z)
-			{
-				flag=pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize*5-1;
-				}
-				else
-				{
-					offset=sectionSize*4+(result-tanv.begin());
-				}
-			}
-			else
-			{
-				flag=1/pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize*5;
-				}
-				else
-				{
-					offset=sectionSize*6-1-(result-tanv.begin());
-				}
-
-			}
-		}
-
-		else if(pt.x>0&&pt.z<0)
-		{
-			if(pt.x>-pt.z)
-			{
-				flag=-pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize*7;
-				}
-				else
-				{
-					offset=sectionSize*8-1-(result-tanv.begin());
-				}
-			}
-			else
-			{
-				flag=1/-pt.tan_theta;
-				result=upper_bound(tanv.begin(),tanv.end(),flag);
-				if(result==tanv.end())
-				{
-					offset=sectionSize*7-1;
-				}
-				else
-				{
-					offset=sectionSize*6+(result-tanv.begin());
-				}
-			}
-		}
-
-		else
-		{
-			continue;
-		}
-
-		int k= (int)((pt.rad-MinRad)/(cellSize*1.0));
-		cellArray_AfterRegstn[offset][k].push_back(&pt);
-	}
-	return 0;
+	return cellArray_AfterRegstn.build(allPoints_AfterRegstn, columnNum, cellNum,
+									   MinRad, MaxRad, cellSize);
 }
 
 
@@ -507,7 +207,7 @@ int IntersectionDetection::CalcAllCellFeature()
 {
 	int i,j;
 
-	if( cellArray_AfterRegstn.size()==0)
+	if( cellArray_AfterRegstn.empty())
 		return -1;
 
 	if( cellFeatureArray_AfterRegstn.size()==0)
@@ -519,11 +219,9 @@ int IntersectionDetection::CalcAllCellFeature()
 
 	for(j=0; j <columnNum; j++)
 	{
-		cellColumn &column=cellArray_AfterRegstn[j];
-		cellNum=column.size();
 		for( i=0; i<cellNum; i++)
 		{
-			cell &cellObj=cellArray_AfterRegstn[j][i];
+			cell &cellObj=cellArray_AfterRegstn(j,i);
 			cellFeature &feature=cellFeatureArray_AfterRegstn[j][i];
 
 			feature.columnID=j;
@@ -628,19 +326,20 @@ int IntersectionDetection::DetectIntersection()
 	}
 
 	double labelSVM;
+	double feature[DefaultColumnSize];
 	for(int i=0;i<360;i++)
 	{
-		nod[i].index=i+1;
-		nod[i].value=intersectionFeature[i].slashLength/slashMaxLength;
+		feature[i]=intersectionFeature[i].slashLength/slashMaxLength;
 	}
-	nod[360].index=-1;
-	labelSVM= svm_predict(m,nod);
+	// built on first use, destroyed at exit
+	static SVMBatchPredictor predictor(m);
+	labelSVM= predictor.predict(feature,360);
 
 	ofstream output;
 	output.open("intersection.txt");
 	output<<"labelSVM:"<<labelSVM<<endl;
 	for(int j=0;j<360;j++)
-		output<<j<<":"<<"  "<<nod[j].value;
+		output<<j<<":"<<"  "<<feature[j];
 	output.close();
 
 	if(labelSVM>0.5)
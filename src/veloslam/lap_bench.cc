@@ -0,0 +1,237 @@
+/*
+ * lap_bench implementation
+ *
+ * Copyright (C) Andreas Nuechter, Li Wei, Li Ming
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Benchmark of the dense and the sparse assignment of trackers
+ *
+ * Creates synthetic scenes of moving objects. The trackers predict the
+ * positions of the objects, the clusters are the objects as found in the
+ * next scan, a few objects are lost and a few new ones appear. Pairs within
+ * the gate get the distance as their cost. The dense lap() solves the
+ * padded square matrix, sparse_lap() only the gated pairs. Both costs are
+ * compared, they have to be equal.
+ *
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <vector>
+using std::vector;
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#include <sys/time.h>
+#else
+#include <windows.h>
+#include "XGetopt.h"
+#endif
+
+#include "veloslam/lap.h"
+#include "veloslam/sparselap.h"
+
+void usage(char* prog)
+{
+  cout << endl
+       << "USAGE " << endl
+       << "   " << prog << " [options] [objects ...]" << endl << endl
+       << "OPTIONS" << endl
+       << "  -g NR, --gate=NR" << endl
+       << "         gate radius in meters (default: 3)" << endl << endl
+       << "  -S NR, --spacing=NR" << endl
+       << "         mean distance of the objects in meters (default: 8)" << endl << endl
+       << "  -d NR, --dense=NR" << endl
+       << "         solve the dense problem up to NR objects (default: 2000)" << endl << endl
+       << "  -r NR, --seed=NR" << endl
+       << "         seed of the random numbers (default: 1)" << endl << endl
+       << "Runs 50 100 200 500 1000 2000 objects if none are given." << endl
+       << endl;
+  exit(1);
+}
+
+static double getTimeInMilliSec()
+{
+#ifndef _MSC_VER
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#else
+  return GetTickCount();
+#endif
+}
+
+static double uniform()
+{
+  return rand() / (RAND_MAX + 1.0);
+}
+
+struct Object {
+  double x, z;
+};
+
+/**
+ * Predicted tracker positions and measured clusters of a scene with n
+ * objects, at a density given by their mean distance.
+ */
+static void createScene(int n, double spacing,
+                        vector<Object> &trackers, vector<Object> &clusters)
+{
+  double side = sqrt((double)n) * spacing;
+  trackers.clear();
+  clusters.clear();
+  for (int i = 0; i < n; i++) {
+    Object o;
+    o.x = uniform() * side;
+    o.z = uniform() * side;
+    // one in twenty objects is lost, one in twenty is new
+    double r = uniform();
+    if (r >= 0.05) {
+      Object t = o;
+      t.x += (uniform() - 0.5) * 1.0;
+      t.z += (uniform() - 0.5) * 1.0;
+      trackers.push_back(t);
+    }
+    if (r < 0.05 || r >= 0.1) {
+      Object c = o;
+      c.x += (uniform() - 0.5) * 1.0;
+      c.z += (uniform() - 0.5) * 1.0;
+      clusters.push_back(c);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  double gate = 3.0;
+  double spacing = 8.0;
+  int maxDense = 2000;
+  int seed = 1;
+
+  static struct option longopts[] = {
+    { "gate",            required_argument,   0,  'g' },
+    { "spacing",         required_argument,   0,  'S' },
+    { "dense",           required_argument,   0,  'd' },
+    { "seed",            required_argument,   0,  'r' },
+    { 0,           0,   0,   0}                    // needed, cf. getopt.h
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "g:S:d:r:", longopts, NULL)) != -1) {
+    switch (c) {
+      case 'g': gate = atof(optarg); break;
+      case 'S': spacing = atof(optarg); break;
+      case 'd': maxDense = atoi(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  vector<int> sizes;
+  for (int i = optind; i < argc; i++) sizes.push_back(atoi(argv[i]));
+  if (sizes.empty()) {
+    int defaults[] = { 50, 100, 200, 500, 1000, 2000 };
+    sizes.assign(defaults, defaults + 6);
+  }
+
+  srand(seed);
+  cout << std::setw(8) << "objects" << std::setw(8) << "pairs"
+       << std::setw(8) << "comps" << std::setw(12) << "dense ms"
+       << std::setw(12) << "sparse ms" << std::setw(10) << "speedup" << endl;
+
+  for (unsigned int s = 0; s < sizes.size(); s++) {
+    int n = sizes[s];
+    vector<Object> trackers, clusters;
+    createScene(n, spacing, trackers, clusters);
+    int rows = (int)trackers.size();
+    int cols = (int)clusters.size();
+    int dim = rows > cols ? rows : cols;
+
+    // small scenes are solved several times for a measurable time
+    int reps = n < 1000 ? 1000 / n : 1;
+
+    SparseCostMatrix sparse(rows, cols);
+    for (int i = 0; i < rows; i++) {
+      for (int j = 0; j < cols; j++) {
+        double dx = trackers[i].x - clusters[j].x;
+        double dz = trackers[i].z - clusters[j].z;
+        if (fabs(dx) < gate && fabs(dz) < gate)
+          sparse.add(i, j, sqrt(dx*dx + dz*dz));
+      }
+    }
+
+    vector<col> rowsol(dim);
+    vector<row> colsol(dim);
+    int components = 0;
+    cost sparseCost = 0.0;
+    double sparseTime = getTimeInMilliSec();
+    for (int r = 0; r < reps; r++)
+      sparseCost = sparse_lap(sparse, BIG, &rowsol[0], &colsol[0], &components);
+    sparseTime = (getTimeInMilliSec() - sparseTime) / reps;
+
+    double denseTime = -1.0;
+    if (n <= maxDense) {
+      // the square matrix of TrackerManager before, padded with BIG
+      cost **assigncost = new cost*[dim];
+      for (int i = 0; i < dim; i++) {
+        assigncost[i] = new cost[dim];
+        for (int j = 0; j < dim; j++) assigncost[i][j] = BIG;
+      }
+      for (int i = 0; i < rows; i++) {
+        for (int e = sparse.first(i); e < sparse.first(i + 1); e++)
+          assigncost[i][sparse.getCol(e)] = sparse.getCost(e);
+      }
+
+      vector<cost> u(dim), v(dim);
+      vector<col> denseRowsol(dim);
+      vector<row> denseColsol(dim);
+      denseTime = getTimeInMilliSec();
+      for (int r = 0; r < reps; r++)
+        lap(dim, assigncost, &denseRowsol[0], &denseColsol[0], &u[0], &v[0]);
+      denseTime = (getTimeInMilliSec() - denseTime) / reps;
+
+      cost denseCost = 0.0;
+      for (int i = 0; i < rows; i++)
+        denseCost += assigncost[i][denseRowsol[i]];
+      if (fabs(denseCost - sparseCost) > 1e-6 * denseCost) {
+        cerr << "cost of the sparse assignment " << sparseCost
+             << " differs from the dense one " << denseCost << endl;
+      }
+
+      for (int i = 0; i < dim; i++) delete[] assigncost[i];
+      delete[] assigncost;
+    }
+
+    cout << std::setw(8) << n << std::setw(8) << sparse.getEntries()
+         << std::setw(8) << components << std::fixed << std::setprecision(3);
+    if (denseTime >= 0.0) {
+      cout << std::setw(12) << denseTime << std::setw(12) << sparseTime;
+      if (sparseTime > 0.0) cout << std::setw(10) << std::setprecision(1) << denseTime / sparseTime;
+    } else {
+      cout << std::setw(12) << "-" << std::setw(12) << sparseTime;
+    }
+    cout << endl;
+  }
+
+  return 0;
+}
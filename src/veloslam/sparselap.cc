@@ -0,0 +1,278 @@
+/*
+ * sparselap implementation
+ *
+ * Copyright (C) Andreas Nuechter, Li Wei, Li Ming
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Linear assignment on sparse cost matrices
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+using std::vector;
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "veloslam/sparselap.h"
+
+SparseCostMatrix::SparseCostMatrix(int rows, int cols)
+{
+  reset(rows, cols);
+}
+
+void SparseCostMatrix::reset(int _rows, int _cols)
+{
+  rows = _rows;
+  cols = _cols;
+  filled = 0;
+  start.clear();
+  column.clear();
+  value.clear();
+}
+
+void SparseCostMatrix::add(row i, col j, cost c)
+{
+  while (filled <= i) {
+    start.push_back((int)column.size());
+    filled++;
+  }
+  column.push_back(j);
+  value.push_back(c);
+}
+
+static int findRoot(vector<int> &parent, int x)
+{
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+typedef std::pair<cost, col> HeapEntry;
+
+/**
+ * Solves one connected component. Every row has a column of its own with
+ * the cost missCost, so there is always an augmenting path. The columns
+ * are reached in the order of their distance from the free row, by
+ * Dijkstra's algorithm on the reduced costs.
+ */
+static cost solveComponent(const SparseCostMatrix &m, cost missCost,
+                           const vector<row> &rows, const vector<col> &cols,
+                           const vector<int> &localCol,
+                           col *rowsol, row *colsol)
+{
+  int nr = (int)rows.size();
+  int nc = (int)cols.size();
+  int n = nc + nr;
+
+  if (nr == 1) {
+    // most components in a sparse scene, the cheapest entry is taken
+    row gi = rows[0];
+    int best = -1;
+    for (int e = m.first(gi); e < m.first(gi + 1); e++) {
+      if (m.getCost(e) < missCost && (best < 0 || m.getCost(e) < m.getCost(best)))
+        best = e;
+    }
+    if (best < 0) return missCost;
+    rowsol[gi] = m.getCol(best);
+    colsol[m.getCol(best)] = gi;
+    return m.getCost(best);
+  }
+
+  vector<cost> v(n, 0.0);          // column reduction numbers
+  vector<cost> d(n);               // distances in the current search
+  vector<cost> predCost(n);        // cost of the entry leading to a column
+  vector<row> pred(n);             // row-predecessor of a column
+  vector<char> state(n, 0);        // 0 unseen, 1 reached, 2 scanned
+  vector<row> csol(n, -1);
+  vector<col> rsol(nr, -1);
+  vector<cost> assigned(nr, 0.0);  // cost of the entry assigned to a row
+  vector<col> touched, scanned;
+  std::priority_queue<HeapEntry, vector<HeapEntry>, std::greater<HeapEntry> > heap;
+
+  for (row f = 0; f < nr; f++) {
+    row i = f;
+    cost h = 0.0;
+    col sink = -1;
+
+    while (true) {
+      // relax the entries of row i, h is its distance less its reduction
+      row gi = rows[i];
+      int end = m.first(gi + 1);
+      for (int e = m.first(gi); e <= end; e++) {
+        col k;
+        cost c;
+        if (e < end) {
+          k = localCol[m.getCol(e)];
+          c = m.getCost(e);
+        } else {
+          k = nc + i;
+          c = missCost;
+        }
+        if (state[k] == 2) continue;
+        cost dk = h + c - v[k];
+        if (state[k] == 0 || dk < d[k]) {
+          if (state[k] == 0) touched.push_back(k);
+          state[k] = 1;
+          d[k] = dk;
+          pred[k] = i;
+          predCost[k] = c;
+          heap.push(HeapEntry(dk, k));
+        }
+      }
+
+      // scan the nearest column
+      col j;
+      do {
+        j = heap.top().second;
+        cost dj = heap.top().first;
+        heap.pop();
+        if (state[j] == 1 && dj == d[j]) break;
+      } while (true);
+      state[j] = 2;
+      scanned.push_back(j);
+
+      if (csol[j] < 0) {
+        sink = j;
+        break;
+      }
+      i = csol[j];
+      h = d[j] - (assigned[i] - v[j]);
+    }
+
+    // update the column reductions of the scanned columns
+    cost dmin = d[sink];
+    for (size_t s = 0; s < scanned.size(); s++) {
+      col j = scanned[s];
+      v[j] += d[j] - dmin;
+    }
+
+    // augment along the path
+    col j = sink;
+    while (true) {
+      row p = pred[j];
+      col previous = rsol[p];
+      rsol[p] = j;
+      csol[j] = p;
+      assigned[p] = predCost[j];
+      if (p == f) break;
+      j = previous;
+    }
+
+    for (size_t t = 0; t < touched.size(); t++) state[touched[t]] = 0;
+    touched.clear();
+    scanned.clear();
+    while (!heap.empty()) heap.pop();
+  }
+
+  cost total = 0.0;
+  for (row r = 0; r < nr; r++) {
+    col j = rsol[r];
+    if (j < nc) {
+      rowsol[rows[r]] = cols[j];
+      colsol[cols[j]] = rows[r];
+      total += assigned[r];
+    } else {
+      total += missCost;
+    }
+  }
+  return total;
+}
+
+static bool largerComponent(const std::pair<int, int> &a, const std::pair<int, int> &b)
+{
+  return a.first > b.first;
+}
+
+cost sparse_lap(const SparseCostMatrix &assigncost, cost missCost,
+                col *rowsol, row *colsol, int *components)
+{
+  int rows = assigncost.getRows();
+  int cols = assigncost.getCols();
+  int i, j, e;
+
+  for (i = 0; i < rows; i++) rowsol[i] = -1;
+  for (j = 0; j < cols; j++) colsol[j] = -1;
+
+  // find the connected components, rows are the nodes 0 to rows - 1,
+  // columns follow them
+  vector<int> parent(rows + cols);
+  for (i = 0; i < rows + cols; i++) parent[i] = i;
+  for (i = 0; i < rows; i++) {
+    for (e = assigncost.first(i); e < assigncost.first(i + 1); e++) {
+      int a = findRoot(parent, i);
+      int b = findRoot(parent, rows + assigncost.getCol(e));
+      if (a != b) parent[b] = a;
+    }
+  }
+
+  cost total = 0.0;
+  vector<int> label(rows + cols, -1);
+  vector< vector<row> > compRows;
+  vector< vector<col> > compCols;
+  for (i = 0; i < rows; i++) {
+    if (assigncost.first(i) == assigncost.first(i + 1)) {
+      // a row without entries stays unassigned
+      total += missCost;
+      continue;
+    }
+    int r = findRoot(parent, i);
+    if (label[r] < 0) {
+      label[r] = (int)compRows.size();
+      compRows.push_back(vector<row>());
+      compCols.push_back(vector<col>());
+    }
+    compRows[label[r]].push_back(i);
+  }
+
+  vector<int> localCol(cols, -1);
+  for (j = 0; j < cols; j++) {
+    int l = label[findRoot(parent, rows + j)];
+    if (l < 0) continue;
+    localCol[j] = (int)compCols[l].size();
+    compCols[l].push_back(j);
+  }
+
+  // the largest components first, for balancing the load
+  int n = (int)compRows.size();
+  vector< std::pair<int, int> > order(n);
+  for (i = 0; i < n; i++) {
+    order[i].first = (int)(compRows[i].size() + compCols[i].size());
+    order[i].second = i;
+  }
+  std::stable_sort(order.begin(), order.end(), largerComponent);
+
+  vector<cost> compCost(n);
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic) if(assigncost.getEntries() > 1000)
+#endif
+  for (i = 0; i < n; i++) {
+    int c = order[i].second;
+    compCost[c] = solveComponent(assigncost, missCost, compRows[c], compCols[c],
+                                 localCol, rowsol, colsol);
+  }
+
+  for (i = 0; i < n; i++) total += compCost[i];
+  if (components) *components = n;
+  return total;
+}
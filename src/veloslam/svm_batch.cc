@@ -0,0 +1,235 @@
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <math.h>
+#include <vector>
+#include "veloslam/svm_batch.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** samples whose kernel values are computed in one pass over the support vectors */
+#define SVM_BATCH_BLOCK 8
+
+static inline double powi(double base, int times)
+{
+	double tmp = base, ret = 1.0;
+
+	for(int t=times; t>0; t/=2)
+	{
+		if(t%2==1) ret*=tmp;
+		tmp = tmp * tmp;
+	}
+	return ret;
+}
+
+SVMBatchPredictor::SVMBatchPredictor(const svm_model *model)
+	: model(model), l(model->l), dim(0)
+{
+	int i;
+	for(i=0;i<l;i++)
+		for(const svm_node *p=model->SV[i];p->index!=-1;p++)
+			if(p->index > dim)
+				dim = p->index;
+
+	sv.assign((size_t)dim*l, 0.0);
+	if(model->param.kernel_type != PRECOMPUTED)
+		for(i=0;i<l;i++)
+			for(const svm_node *p=model->SV[i];p->index!=-1;p++)
+				if(p->index > 0)
+					sv[(size_t)(p->index-1)*l+i] = p->value;
+
+	start.resize(model->nr_class);
+	if(model->nSV)
+	{
+		start[0] = 0;
+		for(i=1;i<model->nr_class;i++)
+			start[i] = start[i-1]+model->nSV[i-1];
+	}
+}
+
+/**
+ * Kernel values of n <= SVM_BATCH_BLOCK samples against all support
+ * vectors, kvalue[b*l+i] for sample b and support vector i. Absent
+ * features only add zero terms to the sums of libsvm, so summing over
+ * all features in their order gives the same values.
+ */
+void SVMBatchPredictor::kernelBlock(const double *x, int n, int features, double *kvalue) const
+{
+	const svm_parameter &param = model->param;
+	bool rbf = param.kernel_type == RBF;
+	int b, d, i;
+
+	for(i=0;i<n*l;i++)
+		kvalue[i] = 0;
+
+	for(d=0;d<dim;d++)
+	{
+		const double *svd = l > 0 ? &sv[(size_t)d*l] : 0;
+		for(b=0;b<n;b++)
+		{
+			double xd = d < features ? x[(size_t)b*features+d] : 0;
+			double *sum = kvalue+b*l;
+			if(rbf)
+				for(i=0;i<l;i++)
+				{
+					double t = xd - svd[i];
+					sum[i] += t*t;
+				}
+			else
+				for(i=0;i<l;i++)
+					sum[i] += xd * svd[i];
+		}
+	}
+
+	// features beyond the support vectors only count for the distance
+	if(rbf)
+		for(b=0;b<n;b++)
+		{
+			double *sum = kvalue+b*l;
+			for(d=dim;d<features;d++)
+			{
+				double xd = x[(size_t)b*features+d];
+				for(i=0;i<l;i++)
+					sum[i] += xd*xd;
+			}
+		}
+
+	for(i=0;i<n*l;i++)
+	{
+		switch(param.kernel_type)
+		{
+			case POLY:
+				kvalue[i] = powi(param.gamma*kvalue[i]+param.coef0,param.degree);
+				break;
+			case RBF:
+				kvalue[i] = exp(-param.gamma*kvalue[i]);
+				break;
+			case SIGMOID:
+				kvalue[i] = tanh(param.gamma*kvalue[i]+param.coef0);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/** The decision of svm_predict_values() from the kernel values of a sample */
+double SVMBatchPredictor::decide(const double *kvalue, double *dec_values) const
+{
+	int i;
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+	{
+		double *sv_coef = model->sv_coef[0];
+		double sum = 0;
+		for(i=0;i<l;i++)
+			sum += sv_coef[i] * kvalue[i];
+		sum -= model->rho[0];
+		if(dec_values)
+			*dec_values = sum;
+
+		if(model->param.svm_type == ONE_CLASS)
+			return (sum>0)?1:-1;
+		else
+			return sum;
+	}
+
+	int nr_class = model->nr_class;
+	std::vector<int> vote(nr_class,0);
+	int p=0;
+	for(i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			double sum = 0;
+			int si = start[i];
+			int sj = start[j];
+			int ci = model->nSV[i];
+			int cj = model->nSV[j];
+
+			int k;
+			double *coef1 = model->sv_coef[j-1];
+			double *coef2 = model->sv_coef[i];
+			for(k=0;k<ci;k++)
+				sum += coef1[si+k] * kvalue[si+k];
+			for(k=0;k<cj;k++)
+				sum += coef2[sj+k] * kvalue[sj+k];
+			sum -= model->rho[p];
+			if(dec_values)
+				dec_values[p] = sum;
+
+			if(sum > 0)
+				++vote[i];
+			else
+				++vote[j];
+			p++;
+		}
+
+	int vote_max_idx = 0;
+	for(i=1;i<nr_class;i++)
+		if(vote[i] > vote[vote_max_idx])
+			vote_max_idx = i;
+
+	return model->label[vote_max_idx];
+}
+
+void SVMBatchPredictor::predict(const double *x, int n, int features, double *labels,
+								double *dec_values) const
+{
+	int nr_dec;
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		nr_dec = 1;
+	else
+		nr_dec = model->nr_class*(model->nr_class-1)/2;
+
+	if(model->param.kernel_type == PRECOMPUTED)
+	{
+		// the features are kernel values, nothing to batch
+		std::vector<svm_node> nodes(features+1);
+		for(int s=0;s<n;s++)
+		{
+			for(int d=0;d<features;d++)
+			{
+				nodes[d].index = d+1;
+				nodes[d].value = x[(size_t)s*features+d];
+			}
+			nodes[features].index = -1;
+			std::vector<double> dec(nr_dec);
+			labels[s] = svm_predict_values(model,&nodes[0],&dec[0]);
+			if(dec_values)
+				for(int k=0;k<nr_dec;k++)
+					dec_values[(size_t)s*nr_dec+k] = dec[k];
+		}
+		return;
+	}
+
+	int blocks = (n+SVM_BATCH_BLOCK-1)/SVM_BATCH_BLOCK;
+#ifdef _OPENMP
+	omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic) if(blocks > 1)
+#endif
+	for(int blk=0;blk<blocks;blk++)
+	{
+		int first = blk*SVM_BATCH_BLOCK;
+		int count = n-first < SVM_BATCH_BLOCK ? n-first : SVM_BATCH_BLOCK;
+		std::vector<double> kvalue((size_t)count*l+1);
+		kernelBlock(x+(size_t)first*features,count,features,&kvalue[0]);
+		for(int b=0;b<count;b++)
+			labels[first+b] = decide(&kvalue[(size_t)b*l],
+									 dec_values ? dec_values+(size_t)(first+b)*nr_dec : 0);
+	}
+}
+
+double SVMBatchPredictor::predict(const double *x, int features) const
+{
+	double label;
+	predict(x,1,features,&label);
+	return label;
+}
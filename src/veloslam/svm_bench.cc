@@ -0,0 +1,197 @@
+/*
+ * svm_bench implementation
+ *
+ * Copyright (C) Andreas Nuechter, Li Wei, Li Ming
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Check and benchmark of the batch SVM prediction
+ *
+ * Predicts samples with svm_predict_values() one at a time and with the
+ * SVMBatchPredictor in one batch. Half of the samples are support vectors
+ * of the model with some noise, so both sides of the decision boundary
+ * are covered, the other half are uniformly distributed features. Labels
+ * and decision values of both have to be equal, otherwise the program
+ * exits with 1.
+ *
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <vector>
+using std::vector;
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+
+#ifndef _MSC_VER
+#include <getopt.h>
+#include <sys/time.h>
+#else
+#include <windows.h>
+#include "XGetopt.h"
+#endif
+
+#include "veloslam/svm.h"
+#include "veloslam/svm_batch.h"
+
+void usage(char* prog)
+{
+  cout << endl
+       << "USAGE " << endl
+       << "   " << prog << " [options] [model]" << endl << endl
+       << "OPTIONS" << endl
+       << "  -n NR, --samples=NR" << endl
+       << "         number of samples (default: 20000)" << endl << endl
+       << "  -r NR, --seed=NR" << endl
+       << "         seed of the random numbers (default: 1)" << endl << endl
+       << "Uses SegIter.model if no model is given." << endl
+       << endl;
+  exit(1);
+}
+
+static double getTimeInMilliSec()
+{
+#ifndef _MSC_VER
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#else
+  return GetTickCount();
+#endif
+}
+
+static double uniform()
+{
+  return rand() / (RAND_MAX + 1.0);
+}
+
+int main(int argc, char **argv)
+{
+  int n = 20000;
+  int seed = 1;
+
+  static struct option longopts[] = {
+    { "samples",         required_argument,   0,  'n' },
+    { "seed",            required_argument,   0,  'r' },
+    { 0,           0,   0,   0}                    // needed, cf. getopt.h
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "n:r:", longopts, NULL)) != -1) {
+    switch (c) {
+      case 'n': n = atoi(optarg); break;
+      case 'r': seed = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  const char *modelFile = optind < argc ? argv[optind] : "SegIter.model";
+  if (n < 1) usage(argv[0]);
+
+  svm_model *model = svm_load_model(modelFile);
+  if (model == 0) {
+    cerr << "could not load the model " << modelFile << endl;
+    return 1;
+  }
+
+  SVMBatchPredictor predictor(model);
+  int dim = predictor.getDimension();
+  int nr_class = svm_get_nr_class(model);
+  int nr_dec = nr_class * (nr_class - 1) / 2;
+  int type = svm_get_svm_type(model);
+  if (type == ONE_CLASS || type == EPSILON_SVR || type == NU_SVR) nr_dec = 1;
+
+  srand(seed);
+  vector<double> x((size_t)n * dim, 0.0);
+  for (int i = 0; i < n; i++) {
+    double *sample = &x[(size_t)i * dim];
+    if (i % 2 == 0 && model->l > 0) {
+      const svm_node *sv = model->SV[rand() % model->l];
+      for (; sv->index != -1; sv++) {
+        if (sv->index <= dim) sample[sv->index - 1] = sv->value + 0.1 * (uniform() - 0.5);
+      }
+    } else {
+      for (int d = 0; d < dim; d++) sample[d] = uniform();
+    }
+  }
+
+  // the sparse samples of svm_predict_values, absent features are zero
+  vector<svm_node> nodes((size_t)n * (dim + 1));
+  for (int i = 0; i < n; i++) {
+    svm_node *node = &nodes[(size_t)i * (dim + 1)];
+    const double *sample = &x[(size_t)i * dim];
+    int k = 0;
+    for (int d = 0; d < dim; d++) {
+      if (sample[d] == 0.0) continue;
+      node[k].index = d + 1;
+      node[k].value = sample[d];
+      k++;
+    }
+    node[k].index = -1;
+  }
+
+  vector<double> labels(n), decs((size_t)n * nr_dec);
+  double singleTime = getTimeInMilliSec();
+  for (int i = 0; i < n; i++) {
+    labels[i] = svm_predict_values(model, &nodes[(size_t)i * (dim + 1)], &decs[(size_t)i * nr_dec]);
+  }
+  singleTime = getTimeInMilliSec() - singleTime;
+
+  vector<double> batchLabels(n), batchDecs((size_t)n * nr_dec);
+  double batchTime = getTimeInMilliSec();
+  predictor.predict(&x[0], n, dim, &batchLabels[0], &batchDecs[0]);
+  batchTime = getTimeInMilliSec() - batchTime;
+
+  int labelMismatches = 0, decMismatches = 0;
+  vector<int> histogram(nr_class > 0 ? nr_class : 1, 0);
+  for (int i = 0; i < n; i++) {
+    if (labels[i] != batchLabels[i]) labelMismatches++;
+    for (int k = 0; k < nr_dec; k++) {
+      if (decs[(size_t)i * nr_dec + k] != batchDecs[(size_t)i * nr_dec + k]) {
+        decMismatches++;
+        break;
+      }
+    }
+    for (int k = 0; k < nr_class; k++) {
+      if (model->label && labels[i] == model->label[k]) histogram[k]++;
+    }
+  }
+
+  cout << n << " samples of " << dim << " features, " << model->l << " support vectors" << endl;
+  if (model->label) {
+    for (int k = 0; k < nr_class; k++) {
+      cout << "  label " << model->label[k] << ": " << histogram[k] << " samples" << endl;
+    }
+  }
+  cout << std::fixed << std::setprecision(3)
+       << "svm_predict " << std::setw(10) << singleTime << " ms" << endl
+       << "batch       " << std::setw(10) << batchTime << " ms";
+  if (batchTime > 0.0) cout << "  speedup " << std::setprecision(1) << singleTime / batchTime;
+  cout << endl;
+
+  svm_free_and_destroy_model(&model);
+
+  if (labelMismatches || decMismatches) {
+    cerr << labelMismatches << " labels and " << decMismatches
+         << " decision values differ from svm_predict" << endl;
+    return 1;
+  }
+  cout << "labels and decision values equal svm_predict" << endl;
+  return 0;
+}
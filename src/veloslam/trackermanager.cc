@@ -36,7 +36,7 @@
 #include "veloslam/trackermanager.h"
 #include "veloslam/debugview.h"
 #include "veloslam/kalmanfilter.h"
-#include "veloslam/lap.h"
+#include "veloslam/sparselap.h"
 
 
 
@@ -687,24 +687,68 @@ void TrackerManager::GetTwoScanRoll(Scan *CurrentScan,Scan *preScan)//???
 	//cout<<"delta_pos: "<<delta_Pos[0]<<" "<<delta_Pos[1]<<" "<<delta_Pos[2]<<endl;
 }
 
-CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
+/**
+ * Only the gated pairs of trackers and clusters enter the cost matrix. The
+ * clusters to be tracked are sorted into a uniform grid over their
+ * positions with about one cluster per cell, each tracker only visits the
+ * cells overlapping its gate around the predicted position.
+ */
+void TrackerManager::ConstructCostMatrix(VeloScan &scanRef, SparseCostMatrix &costMatrix, vector<int> &clusterIndex)
 {
-	int clusterSize=scanRef.clusterNum;
+	int i,j,k,c;
+	int size=scanRef.scanClusterArray.size();
+
+	clusterIndex.clear();
+	for(j=0;j<size;j++)
+	{
+		if(clusterStatus.size()!=0&&clusterStatus[j].FilterRet==false)
+			continue;
+		clusterIndex.push_back(j);
+	}
+
+	int clusterSize=clusterIndex.size();
 	int trackSize=getNumberofTracker();
+	costMatrix.reset(trackSize,clusterSize);
 
-	int maxSize;
-	if (clusterSize!=trackSize)
+	// bucket the clusters, the cells are large enough for a grid of at
+	// most about three times as many cells as clusters
+	double minX=0,maxX=0,minZ=0,maxZ=0;
+	for(k=0;k<clusterSize;k++)
 	{
-		maxSize=clusterSize>trackSize?clusterSize:trackSize;
+		clusterFeature &glu=scanRef.scanClusterFeatureArray[clusterIndex[k]];
+		if (k==0 || glu.avg_x<minX) minX=glu.avg_x;
+		if (k==0 || glu.avg_x>maxX) maxX=glu.avg_x;
+		if (k==0 || glu.avg_z<minZ) minZ=glu.avg_z;
+		if (k==0 || glu.avg_z>maxZ) maxZ=glu.avg_z;
 	}
-	else
+	double cellSize=0;
+	if (clusterSize>0)
 	{
-		maxSize=clusterSize;
+		double width=maxX-minX, depth=maxZ-minZ;
+		cellSize=max(sqrt(width*depth/clusterSize), max(width,depth)/clusterSize);
 	}
+	if (cellSize<=0)
+		cellSize=1.0;
+	int gridX=(int)((maxX-minX)/cellSize)+1;
+	int gridZ=(int)((maxZ-minZ)/cellSize)+1;
+
+	vector<int> cellStart(gridX*gridZ+1,0);
+	vector<int> cellOf(clusterSize);
+	vector<int> cellItems(clusterSize);
+	for(k=0;k<clusterSize;k++)
+	{
+		clusterFeature &glu=scanRef.scanClusterFeatureArray[clusterIndex[k]];
+		int cx=min((int)((glu.avg_x-minX)/cellSize),gridX-1);
+		int cz=min((int)((glu.avg_z-minZ)/cellSize),gridZ-1);
+		cellOf[k]=cx*gridZ+cz;
+		cellStart[cellOf[k]+1]++;
+	}
+	for(c=0;c<gridX*gridZ;c++)
+		cellStart[c+1]+=cellStart[c];
+	vector<int> fill(cellStart.begin(),cellStart.end()-1);
+	for(k=0;k<clusterSize;k++)
+		cellItems[fill[cellOf[k]]++]=k;
 
-	CMatrix costMatrix(maxSize,maxSize);
-
-	int i=0,j,k;
 	double costValue;
 	float radiusDiff;
 	float thetaDiff;
@@ -715,8 +759,9 @@ CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
 	bool IsSmaller1,IsSmaller2;
 	float kg;
 
+	i=0;
 	list<Tracker>::iterator it;
-	for(it=tracks.begin(); it!=tracks.end(); it++)
+	for(it=tracks.begin(); it!=tracks.end(); it++,i++)
 	{
 		Tracker &tracker=*it;
 
@@ -732,70 +777,50 @@ CMatrix TrackerManager::ConstructCostMatrix(VeloScan &scanRef,int *clusterIndex)
 			kg=KG;
 		}
 
-		k=0;
-		for(j=0;j<scanRef.scanClusterArray.size();j++)
-		{
-
-			clusterFeature &glu=scanRef.scanClusterFeatureArray[j];
-			cluster &gluData=scanRef.scanClusterArray[j];
-
-			if(clusterStatus.size()!=0&&clusterStatus[j].FilterRet==false)
-				continue;
-
-			measurementErro.m_pTMatrix[0][0]=glu.avg_x-predictMeasurement.x_measurement;
-			measurementErro.m_pTMatrix[1][0]=glu.avg_z-predictMeasurement.z_measurement;
-
-			IsSmaller1=(fabs(measurementErro.m_pTMatrix[0][0])<kg*standardDeviation.m_pTMatrix[0][0]);
-			IsSmaller2=(fabs(measurementErro.m_pTMatrix[1][0])<kg*standardDeviation.m_pTMatrix[1][1]);
-
-			if (IsSmaller1&&IsSmaller2)
-			{
-				radiusDiff=fabs(tracker.statusList.back().radius-glu.radius);
-				thetaDiff=fabs(tracker.statusList.back().theta-glu.theta);
-				sizeDiff =abs(tracker.statusList.back().size-glu.size);
-				positionDiff = sqrt(sqr(tracker.statusList.back().avg_x -glu.avg_x) + sqr(tracker.statusList.back().avg_z -glu.avg_z) ) ;
-				costValue= radiusDiff*1.0 + thetaDiff*1.0  +  sizeDiff*0.8 + positionDiff * 0.03 ;
-				costMatrix.m_pTMatrix[i][k]=costValue;
-			}
-			else
-			{
-				costMatrix.m_pTMatrix[i][k]=BIGNUM;
-			}
+		double gateX=kg*standardDeviation.m_pTMatrix[0][0];
+		double gateZ=kg*standardDeviation.m_pTMatrix[1][1];
+		if (clusterSize==0 || !(gateX>0) || !(gateZ>0))
+			continue;
 
-			if (i==0)
-			{
-				clusterIndex[k]=j;
-			}
-			k++;
-		}
-		i++;
-	}
+		// the range of cells covered by the gate, clamped to the grid
+		double loX=floor((predictMeasurement.x_measurement-gateX-minX)/cellSize);
+		double hiX=floor((predictMeasurement.x_measurement+gateX-minX)/cellSize);
+		double loZ=floor((predictMeasurement.z_measurement-gateZ-minZ)/cellSize);
+		double hiZ=floor((predictMeasurement.z_measurement+gateZ-minZ)/cellSize);
+		if (hiX<0 || hiZ<0 || loX>=gridX || loZ>=gridZ)
+			continue;
+		int x0=(int)max(loX,0.0), x1=(int)min(hiX,gridX-1.0);
+		int z0=(int)max(loZ,0.0), z1=(int)min(hiZ,gridZ-1.0);
 
-	if (clusterSize!=trackSize)
-	{
-		if (maxSize==clusterSize)
+		for (int cx=x0;cx<=x1;cx++)
 		{
-			for (i=trackSize;i<maxSize;i++)
+			for (int cz=z0;cz<=z1;cz++)
 			{
-				for (j=0;j<maxSize;j++)
+				c=cx*gridZ+cz;
+				for (int n=cellStart[c];n<cellStart[c+1];n++)
 				{
-					costMatrix.m_pTMatrix[i][j]=BIGNUM;
-				}
-			}
-		}
-		else
-		{
-			for (i=0;i<maxSize;i++)
-			{
-				for (j=clusterSize;j<maxSize;j++)
-				{
-					costMatrix.m_pTMatrix[i][j]=BIGNUM;
+					k=cellItems[n];
+					clusterFeature &glu=scanRef.scanClusterFeatureArray[clusterIndex[k]];
+
+					measurementErro.m_pTMatrix[0][0]=glu.avg_x-predictMeasurement.x_measurement;
+					measurementErro.m_pTMatrix[1][0]=glu.avg_z-predictMeasurement.z_measurement;
+
+					IsSmaller1=(fabs(measurementErro.m_pTMatrix[0][0])<gateX);
+					IsSmaller2=(fabs(measurementErro.m_pTMatrix[1][0])<gateZ);
+
+					if (IsSmaller1&&IsSmaller2)
+					{
+						radiusDiff=fabs(tracker.statusList.back().radius-glu.radius);
+						thetaDiff=fabs(tracker.statusList.back().theta-glu.theta);
+						sizeDiff =abs(tracker.statusList.back().size-glu.size);
+						positionDiff = sqrt(sqr(tracker.statusList.back().avg_x -glu.avg_x) + sqr(tracker.statusList.back().avg_z -glu.avg_z) ) ;
+						costValue= radiusDiff*1.0 + thetaDiff*1.0  +  sizeDiff*0.8 + positionDiff * 0.03 ;
+						costMatrix.add(i,k,costValue);
+					}
 				}
 			}
 		}
 	}
-
-	return costMatrix;
 }
 
 int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
@@ -806,66 +831,13 @@ int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
 		return 0;
 	}
 
-	CMatrix costMatrix;
-	int clusterSize=scanRef.clusterNum;
-	int trackSize=getNumberofTracker();
-	int *clusterIndex;
-	clusterIndex=new int[clusterSize];
-	costMatrix=ConstructCostMatrix(scanRef,clusterIndex);
-	int dim=costMatrix.m_nCol;
-
-	//FILE *fp=fopen("F:\\VeloSlamTemp\\bin\\Release\\CostMatix.txt","a");
-	//fprintf(fp,"scanID:%d\n",scanRef.scanid);
-	//for (int m=0;m<dim;m++)
-	//{
-	//	for (int l=0;l<dim;l++)
-	//	{
-	//		fprintf(fp,"%.1f\t",costMatrix.m_pTMatrix[m][l]);
-
-	//	}
-	//	fprintf(fp,"\n");
-	//}
-	//fclose(fp);
-
-	int *colsol,*rowsol;
-	colsol=new int[dim];
-	rowsol=new int[dim];
-
-	double *u,*v;
-	u=new double[dim];
-	v=new double[dim];
+	SparseCostMatrix costMatrix;
+	vector<int> clusterIndex;
+	ConstructCostMatrix(scanRef,costMatrix,clusterIndex);
 
-	int i,j;
-	bool *missFlag;
-	missFlag=new bool[trackSize];
-	for (i=0;i<trackSize;i++)
-	{
-		missFlag[i]=false;
-	}
-
-	double **assignCost;
-	assignCost = new double*[dim];
-	for (i = 0; i < dim; i++)
-		assignCost[i] = new double[dim];
-
-	for (i=0;i<dim;i++)
-	{
-		for (j=0;j<dim;j++)
-		{
-			assignCost[i][j]=costMatrix.m_pTMatrix[i][j];
-		}
-	}
-
-	lap(dim,assignCost,rowsol,colsol,u,v);
-
-	for (i=0;i<trackSize;i++)
-	{
-		int col=rowsol[i];
-		if (assignCost[i][col]==BIGNUM)
-		{
-			missFlag[i]=true;
-		}
-	}
+	// a tracker without a cluster costs as much as a pair outside the gate
+	vector<int> rowsol(costMatrix.getRows()+1),colsol(costMatrix.getCols()+1);
+	sparse_lap(costMatrix,BIGNUM,&rowsol[0],&colsol[0]);
 
 	int trackerIndex=-1;
 	int trackNO =0;
@@ -875,7 +847,7 @@ int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
 		Tracker &tracker=*it;
 		trackNO ++;
 		trackerIndex++;
-		if (missFlag[trackerIndex])
+		if (rowsol[trackerIndex]<0)
 		{
 			tracker.missMatch=true;
 			tracker.missedTime++;
@@ -917,13 +889,5 @@ int TrackerManager::MatchTracksWithClusters(VeloScan &scanRef)
 
 	}
 
-	delete[] assignCost;
-	delete[] rowsol;
-	delete[] colsol;
-	delete[] u;
-	delete[] v;
-	delete[] clusterIndex;
-	delete[] missFlag;
-
 	return 0;
 }
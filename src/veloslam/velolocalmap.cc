@@ -0,0 +1,362 @@
+/*
+ * velolocalmap implementation
+ *
+ * Copyright (C) Andreas Nuechter, Li Wei, Li Ming
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Local map of the sliding window for registering velodyne scans
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#include <cmath>
+#include <cfloat>
+
+#include "veloslam/velolocalmap.h"
+#include "slam6d/icp6D.h"
+#include "slam6d/globals.icc"
+
+VoxelMapTree::VoxelMapTree(double voxelSize, double resolution)
+  : voxelSize(voxelSize > 0.0 ? voxelSize : 1.0),
+    resolution2(resolution > 0.0 ? sqr(resolution) : 0.0),
+    nrPoints(0), nrVoxels(0)
+{
+  rehash(1024);
+}
+
+long long VoxelMapTree::key(long long x, long long y, long long z) const
+{
+  // 21 bits per axis
+  const long long mask = (1LL << 21) - 1;
+  return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+}
+
+void VoxelMapTree::cell(const double *p, long long c[3]) const
+{
+  for (int k = 0; k < 3; k++) {
+    c[k] = (long long)floor(p[k] / voxelSize);
+  }
+}
+
+unsigned int VoxelMapTree::slot(long long key) const
+{
+  // Fibonacci hashing, the table size is a power of two
+  unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+  return (unsigned int)(h >> 32) & (slots.size() - 1);
+}
+
+int VoxelMapTree::findVoxel(long long key) const
+{
+  const unsigned int mask = slots.size() - 1;
+  for (unsigned int i = slot(key); slots[i].voxel >= 0; i = (i + 1) & mask) {
+    if (slots[i].key == key) return slots[i].voxel;
+  }
+  return -1;
+}
+
+int VoxelMapTree::addVoxel(long long key, bool &created)
+{
+  // at most half of the slots are used
+  if (2 * (nrVoxels + 1) > slots.size()) rehash(2 * slots.size());
+
+  const unsigned int mask = slots.size() - 1;
+  unsigned int i = slot(key);
+  for (; slots[i].voxel >= 0; i = (i + 1) & mask) {
+    if (slots[i].key == key) {
+      created = false;
+      return slots[i].voxel;
+    }
+  }
+
+  int v;
+  if (freeVoxels.empty()) {
+    v = pool.size();
+    pool.push_back(Voxel());
+  } else {
+    v = freeVoxels.back();
+    freeVoxels.pop_back();
+  }
+  slots[i].key = key;
+  slots[i].voxel = v;
+  nrVoxels++;
+  created = true;
+  return v;
+}
+
+void VoxelMapTree::eraseVoxel(long long key)
+{
+  const unsigned int mask = slots.size() - 1;
+  unsigned int i = slot(key);
+  while (slots[i].voxel >= 0 && slots[i].key != key) i = (i + 1) & mask;
+  if (slots[i].voxel < 0) return;
+
+  Voxel &v = pool[slots[i].voxel];
+  std::vector<double>().swap(v.points);
+  std::vector<int>().swap(v.owners);
+  freeVoxels.push_back(slots[i].voxel);
+  nrVoxels--;
+
+  // shift the following keys back, so no probe sequence is interrupted
+  unsigned int j = i;
+  for (;;) {
+    slots[i].voxel = -1;
+    for (;;) {
+      j = (j + 1) & mask;
+      if (slots[j].voxel < 0) return;
+      unsigned int home = slot(slots[j].key);
+      // can the key in j be moved to i without passing its home slot?
+      if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) break;
+    }
+    slots[i] = slots[j];
+    i = j;
+  }
+}
+
+void VoxelMapTree::rehash(unsigned int size)
+{
+  std::vector<Slot> old(size);
+  old.swap(slots);
+  for (unsigned int i = 0; i < size; i++) slots[i].voxel = -1;
+
+  const unsigned int mask = size - 1;
+  for (unsigned int j = 0; j < old.size(); j++) {
+    if (old[j].voxel < 0) continue;
+    unsigned int i = slot(old[j].key);
+    while (slots[i].voxel >= 0) i = (i + 1) & mask;
+    slots[i] = old[j];
+  }
+}
+
+void VoxelMapTree::insert(const DataXYZ& xyz, int owner, std::vector<long long>& keys)
+{
+  keys.clear();
+  long long c[3];
+  for (unsigned int i = 0; i < xyz.size(); i++) {
+    cell(xyz[i], c);
+    long long k = key(c[0], c[1], c[2]);
+    bool created;
+    Voxel &v = pool[addVoxel(k, created)];
+    if (created || v.lastOwner != owner) {
+      v.lastOwner = owner;
+      keys.push_back(k);
+    }
+
+    // a point seen again stays in the map as long as the new owner
+    unsigned int j = 0;
+    if (resolution2 > 0.0) {
+      while (j < v.owners.size() && Dist2(xyz[i], &v.points[3 * j]) >= resolution2) j++;
+    } else {
+      j = v.owners.size();
+    }
+    if (j < v.owners.size()) {
+      v.owners[j] = owner;
+      continue;
+    }
+
+    v.points.push_back(xyz[i][0]);
+    v.points.push_back(xyz[i][1]);
+    v.points.push_back(xyz[i][2]);
+    v.owners.push_back(owner);
+    nrPoints++;
+  }
+}
+
+void VoxelMapTree::remove(int owner, const std::vector<long long>& keys)
+{
+  for (unsigned int i = 0; i < keys.size(); i++) {
+    int index = findVoxel(keys[i]);
+    if (index < 0) continue;
+    Voxel &v = pool[index];
+    unsigned int n = 0;
+    for (unsigned int j = 0; j < v.owners.size(); j++) {
+      if (v.owners[j] == owner) continue;
+      v.owners[n] = v.owners[j];
+      v.points[3 * n] = v.points[3 * j];
+      v.points[3 * n + 1] = v.points[3 * j + 1];
+      v.points[3 * n + 2] = v.points[3 * j + 2];
+      n++;
+    }
+    nrPoints -= v.owners.size() - n;
+    if (n == 0) {
+      eraseVoxel(keys[i]);
+    } else {
+      v.owners.resize(n);
+      v.points.resize(3 * n);
+    }
+  }
+}
+
+void VoxelMapTree::resetHints(unsigned int n)
+{
+  hints.assign(n, (const double*)0);
+}
+
+const double *VoxelMapTree::closest(const double *p, double maxdist2, const double *hint) const
+{
+  const double *best = 0;
+  double best2 = maxdist2;
+  if (hint) {
+    double d2 = Dist2(p, hint);
+    if (d2 < best2) {
+      best = hint;
+      best2 = d2;
+    }
+  }
+
+  long long c[3];
+  cell(p, c);
+
+  // the voxel of the query point first, to narrow the search
+  int home = findVoxel(key(c[0], c[1], c[2]));
+  if (home >= 0) {
+    const std::vector<double> &pts = pool[home].points;
+    for (unsigned int j = 0; j < pts.size(); j += 3) {
+      double d2 = Dist2(p, &pts[j]);
+      if (d2 < best2) {
+        best = &pts[j];
+        best2 = d2;
+      }
+    }
+  }
+
+  double r = sqrt(best2);
+  long long lo[3], hi[3];
+  for (int k = 0; k < 3; k++) {
+    lo[k] = (long long)floor((p[k] - r) / voxelSize);
+    hi[k] = (long long)floor((p[k] + r) / voxelSize);
+  }
+
+  for (long long x = lo[0]; x <= hi[0]; x++) {
+    for (long long y = lo[1]; y <= hi[1]; y++) {
+      for (long long z = lo[2]; z <= hi[2]; z++) {
+        if (x == c[0] && y == c[1] && z == c[2]) continue;
+
+        // distance of the query point to the box of the voxel
+        long long v[3] = {x, y, z};
+        double box2 = 0.0;
+        for (int k = 0; k < 3; k++) {
+          double l = v[k] * voxelSize;
+          double d = p[k] < l ? l - p[k] : (p[k] > l + voxelSize ? p[k] - l - voxelSize : 0.0);
+          box2 += d * d;
+        }
+        if (box2 >= best2) continue;
+
+        int index = findVoxel(key(x, y, z));
+        if (index < 0) continue;
+        const std::vector<double> &pts = pool[index].points;
+        for (unsigned int j = 0; j < pts.size(); j += 3) {
+          double d2 = Dist2(p, &pts[j]);
+          if (d2 < best2) {
+            best = &pts[j];
+            best2 = d2;
+          }
+        }
+      }
+    }
+  }
+  return best;
+}
+
+double *VoxelMapTree::FindClosest(double *_p, double maxdist2, int threadNum) const
+{
+  return const_cast<double*>(closest(_p, maxdist2, 0));
+}
+
+void VoxelMapTree::getPtPairs(vector <PtPair> *pairs,
+                              double *source_alignxf,
+                              const DataXYZ& xyz_r, const DataNormal& normal_r,
+                              unsigned int startindex, unsigned int endindex,
+                              int thread_num,
+                              int rnd, double max_dist_match2, double &sum,
+                              double *centroid_m, double *centroid_d,
+                              PairingMode pairing_mode)
+{
+  if (pairing_mode != CLOSEST_POINT) {
+    SearchTree::getPtPairs(pairs, source_alignxf, xyz_r, normal_r, startindex, endindex,
+                           thread_num, rnd, max_dist_match2, sum,
+                           centroid_m, centroid_d, pairing_mode);
+    return;
+  }
+
+  double local_alignxf_inv[16];
+  M4inv(source_alignxf, local_alignxf_inv);
+
+  // t is the original point from target, s is the (inverted) query point from target and then
+  // the closest point in source
+  double t[3], s[3];
+  for (unsigned int i = startindex; i < endindex; i++) {
+    if (rnd > 1 && rand(rnd) != 0) continue;  // take about 1/rnd-th of the numbers only
+
+    t[0] = xyz_r[i][0];
+    t[1] = xyz_r[i][1];
+    t[2] = xyz_r[i][2];
+
+    transform3(local_alignxf_inv, t, s);
+
+    // the threads work on disjoint ranges of the hints
+    const double *hint = i < hints.size() ? hints[i] : 0;
+    const double *found = closest(s, max_dist_match2, hint);
+    if (i < hints.size()) hints[i] = found;
+    if (!found) continue;
+
+    transform3(source_alignxf, found, s);
+
+    centroid_m[0] += s[0];
+    centroid_m[1] += s[1];
+    centroid_m[2] += s[2];
+    centroid_d[0] += t[0];
+    centroid_d[1] += t[1];
+    centroid_d[2] += t[2];
+
+    PtPair myPair(s, t);
+    double p12[3] = {
+      myPair.p1.x - myPair.p2.x,
+      myPair.p1.y - myPair.p2.y,
+      myPair.p1.z - myPair.p2.z };
+    sum += Len2(p12);
+
+    pairs->push_back(myPair);
+  }
+}
+
+VeloLocalMap::VeloLocalMap(double voxelSize, double resolution, unsigned int windowSize)
+  : windowSize(windowSize < 1 ? 1 : windowSize), nextOwner(0)
+{
+  tree = new VoxelMapTree(voxelSize, resolution);
+  // deleted with the scan
+  kd = tree;
+}
+
+VeloLocalMap::~VeloLocalMap()
+{
+}
+
+int VeloLocalMap::match(icp6D *my_icp, Scan *scan)
+{
+  if (window.empty()) return 0;
+
+  tree->resetHints(scan->size<DataXYZ>("xyz reduced"));
+  int iterations = my_icp->match(this, scan);
+  tree->resetHints(0);
+  return iterations;
+}
+
+void VeloLocalMap::insert(Scan *scan)
+{
+  DataXYZ xyz(scan->get("xyz reduced"));
+
+  window.push_back(Entry());
+  window.back().owner = nextOwner++;
+  tree->insert(xyz, window.back().owner, window.back().keys);
+
+  while (window.size() > windowSize) {
+    tree->remove(window.front().owner, window.front().keys);
+    window.pop_front();
+  }
+}
@@ -0,0 +1,347 @@
+/*
+ * velopipeline implementation
+ *
+ * Copyright (C) Andreas Nuechter, Li Wei, Li Ming
+ *
+ * Released under the GPL version 3.
+ *
+ */
+
+/**
+ * @file
+ * @brief Pipelined processing of velodyne revolutions in veloslam
+ * @author Andreas Nuechter. Jacobs University Bremen, Germany
+ * @author Li Wei, Wuhan University, China
+ * @author Li Ming, Wuhan University, China
+ */
+
+#ifdef _MSC_VER
+#ifdef OPENMP
+#define _OPENMP
+#endif
+#endif
+
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+#include <iomanip>
+#include <cmath>
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include "veloslam/velopipeline.h"
+#include "veloslam/veloscan.h"
+#include "veloslam/velolocalmap.h"
+#include "slam6d/icp6D.h"
+#include "slam6d/pointfilter.h"
+#include "scanio/scan_io.h"
+#include "slam6d/globals.icc"
+
+extern int scanCount;
+extern int sliding_window_size;
+extern int current_sliding_window_pos;
+extern Trajectory VelodyneTrajectory;
+
+LatencyHistogram::LatencyHistogram(const std::string& name)
+  : name(name), bins(max_ms + 1, 0), count(0), max(0), sum(0.0)
+{
+}
+
+void LatencyHistogram::add(long ms)
+{
+  if (ms < 0) ms = 0;
+  bins[ms < max_ms ? ms : max_ms]++;
+  count++;
+  sum += ms;
+  if (ms > max) max = ms;
+}
+
+long LatencyHistogram::percentile(double p) const
+{
+  if (count == 0) return 0;
+  // nearest rank
+  unsigned long rank = (unsigned long)ceil(p * count);
+  if (rank < 1) rank = 1;
+  unsigned long n = 0;
+  for (long i = 0; i <= max_ms; i++) {
+    n += bins[i];
+    if (n >= rank) return i < max_ms ? i : max;
+  }
+  return max;
+}
+
+unsigned long LatencyHistogram::countAbove(long ms) const
+{
+  unsigned long n = 0;
+  for (long i = (ms < 0 ? 0 : ms + 1); i <= max_ms; i++) n += bins[i];
+  return n;
+}
+
+void LatencyHistogram::print(std::ostream& os) const
+{
+  os << std::setw(12) << std::left << name << std::right
+     << " mean " << std::setw(6) << (count ? (long)(sum / count + 0.5) : 0)
+     << "  p50 " << std::setw(6) << percentile(0.5)
+     << "  p90 " << std::setw(6) << percentile(0.9)
+     << "  p99 " << std::setw(6) << percentile(0.99)
+     << "  max " << std::setw(6) << max << " ms" << endl;
+}
+
+VeloPipeline::VeloPipeline(icp6D *my_icp, bool eP, int tracking, int trackingAlgo,
+                           int maxDist, int minDist, double red, int octree,
+                           int nns_method, bool cuda_enabled,
+                           int ringSize, double rate,
+                           int localmap, double mapVoxelSize)
+  : my_icp(my_icp), eP(eP), tracking(tracking), trackingAlgo(trackingAlgo),
+    maxDist(maxDist), minDist(minDist), red(red), octree(octree),
+    nns_method(nns_method), cuda_enabled(cuda_enabled),
+    ringSize(ringSize < 2 ? 2 : ringSize), rate(rate),
+    localMap(localmap > 0 ? new VeloLocalMap(mapVoxelSize, red, localmap) : 0),
+    type(VELODYNE), start(0), end(-1),
+    freeRevolutions(this->ringSize), revolutions(this->ringSize),
+    segmented(1), reduced(1),
+    matched(0), dropped(0), started(0), finished(0),
+    decodeTime("decode"), segmentTime("segment"), reduceTime("reduce"),
+    matchTime("icp"), endToEnd("end-to-end")
+{
+}
+
+VeloPipeline::~VeloPipeline()
+{
+  if (localMap) delete localMap;
+}
+
+void VeloPipeline::run(const std::string& _dir, IOType _type, int _start, int _end)
+{
+  dir = _dir;
+  type = _type;
+  start = _start;
+  end = _end;
+
+  for (int i = 0; i < ringSize; i++) {
+    freeRevolutions.push(new VeloRevolution);
+  }
+
+  started = GetCurrentTimeInMilliSec();
+  boost::thread reader(boost::bind(&VeloPipeline::readRevolutions, this));
+  boost::thread segmenter(boost::bind(&VeloPipeline::segment, this));
+  boost::thread reducer(boost::bind(&VeloPipeline::reduce, this));
+
+  // the matching runs in the calling thread
+  match();
+
+  reader.join();
+  segmenter.join();
+  reducer.join();
+  finished = GetCurrentTimeInMilliSec();
+
+  VeloRevolution *rev;
+  while (freeRevolutions.tryPop(rev)) delete rev;
+  while (revolutions.tryPop(rev)) delete rev;
+}
+
+void VeloPipeline::readRevolutions()
+{
+  ScanIO* sio = ScanIO::getScanIO(type);
+  // reading the directory loads the calibration of the sensor
+  sio->readDirectory(dir.c_str(), start, start);
+
+  PointFilter filter;
+  filter.setRange(maxDist, minDist);
+
+  unsigned long begin = GetCurrentTimeInMilliSec();
+  for (int index = start; end < 0 || index <= end; index++) {
+    unsigned long arrival;
+    if (rate > 0.0) {
+      // the sensor completes its revolutions at a fixed rate
+      arrival = begin + (unsigned long)((index - start + 1) * 1000.0 / rate);
+      unsigned long now = GetCurrentTimeInMilliSec();
+      if (arrival > now) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(arrival - now));
+      }
+    } else {
+      arrival = GetCurrentTimeInMilliSec();
+    }
+
+    VeloRevolution *rev;
+    if (!freeRevolutions.tryPop(rev)) {
+      if (rate > 0.0 && revolutions.tryPop(rev)) {
+        // a sensor does not wait, the oldest revolution is lost
+        dropped++;
+      } else if (!freeRevolutions.pop(rev)) {
+        break;
+      }
+    }
+
+    unsigned long decoding = GetCurrentTimeInMilliSec();
+    rev->index = index;
+    rev->arrival = arrival;
+    rev->xyz.clear();
+    sio->readScan(dir.c_str(), to_string(index, 3).c_str(), filter, &rev->xyz);
+    rev->decoded = GetCurrentTimeInMilliSec();
+
+    // the log has ended
+    if (rev->xyz.empty()) {
+      freeRevolutions.push(rev);
+      break;
+    }
+
+    decodeTime.add(rev->decoded - decoding);
+    revolutions.push(rev);
+  }
+  revolutions.close();
+}
+
+void VeloPipeline::segment()
+{
+  int n = 0;
+  VeloRevolution *rev;
+  while (revolutions.pop(rev)) {
+    unsigned long begin = GetCurrentTimeInMilliSec();
+
+    vector<double*> points(rev->xyz.size() / 3);
+    for (unsigned int i = 0; i < points.size(); i++) {
+      points[i] = &rev->xyz[3 * i];
+    }
+    double rPos[3] = {0.0, 0.0, 0.0};
+    double rPosTheta[3] = {0.0, 0.0, 0.0};
+    VeloScan *scan = new VeloScan(rPos, rPosTheta, points);
+
+    VeloFrame frame;
+    frame.scan = scan;
+    frame.index = n;
+    frame.arrival = rev->arrival;
+    frame.decoded = rev->decoded;
+
+    // the scan has its own copy of the points
+    freeRevolutions.push(rev);
+
+    scan->setRangeFilter(maxDist, minDist);
+    scan->setReductionParameter(red, octree);
+    scan->setSearchTreeParameter(nns_method, cuda_enabled);
+    scan->isTrackerHandled = false;
+    scan->scanid = n;
+    scanCount = n;
+    current_sliding_window_pos = n;
+
+    // the trackers refer to the scans of the sliding window. This is the
+    // only thread changing Scan::allScans, the ICP of the match stage walks
+    // it under scansMutex.
+    bool full = (int)Scan::allScans.size() >= sliding_window_size + 1;
+    // the oldest scan is needed until its successor has been matched, this
+    // has to be waited for without the lock held by the matching
+    if (full) waitMatched(n - sliding_window_size);
+    {
+      boost::mutex::scoped_lock lock(scansMutex);
+      Scan::allScans.push_back(scan);
+      if (full) {
+        delete Scan::allScans.front();
+        Scan::allScans.erase(Scan::allScans.begin());
+      }
+    }
+
+    if (tracking == 1) {
+      scan->FindingAllofObject(maxDist, minDist);
+      scan->ClassifiAllofObject();
+    }
+    if (tracking == 2) {
+      int windowsize = 3;
+      scan->FindingAllofObject(maxDist, minDist);
+      // tracking needs the final poses of the previous scans
+      waitMatched(n - 1);
+      scan->TrackingAllofObject(trackingAlgo);
+      scan->ClassifibyTrackingAllObject(n, windowsize);
+    }
+    scan->ExchangePointCloud();
+
+    frame.segmented = GetCurrentTimeInMilliSec();
+    segmentTime.add(frame.segmented - begin);
+    segmented.push(frame);
+    n++;
+  }
+  segmented.close();
+}
+
+void VeloPipeline::reduce()
+{
+  VeloFrame frame;
+  while (segmented.pop(frame)) {
+    unsigned long begin = GetCurrentTimeInMilliSec();
+    frame.scan->calcReducedPoints_byClassifi(red, octree, PointType());
+    // the scan is only the model of a match without the map
+    if (!localMap) frame.scan->createSearchTree();
+    frame.reduced = GetCurrentTimeInMilliSec();
+    reduceTime.add(frame.reduced - begin);
+    reduced.push(frame);
+  }
+  reduced.close();
+}
+
+void VeloPipeline::match()
+{
+  VeloScan *previous = 0;
+  VeloFrame frame;
+  while (reduced.pop(frame)) {
+    unsigned long begin = GetCurrentTimeInMilliSec();
+    if (previous) {
+      // extrapolate odometry
+      if (eP) frame.scan->mergeCoordinatesWithRoboterPosition(previous);
+      // the ICP adds a frame to every scan in Scan::allScans
+      boost::mutex::scoped_lock lock(scansMutex);
+      if (localMap) {
+        localMap->match(my_icp, frame.scan);
+      } else {
+        my_icp->match(previous, frame.scan);
+      }
+    }
+    if (localMap) localMap->insert(frame.scan);
+
+    const double* p = frame.scan->get_rPos();
+    Point x(p[0], p[1], p[2]);
+    VelodyneTrajectory.path.push_back(x);
+
+    unsigned long done = GetCurrentTimeInMilliSec();
+    matchTime.add(done - begin);
+    endToEnd.add(done - frame.arrival);
+    previous = frame.scan;
+
+    boost::mutex::scoped_lock lock(matchedMutex);
+    matched = frame.index + 1;
+    matchedCond.notify_all();
+  }
+}
+
+void VeloPipeline::waitMatched(int index)
+{
+  boost::mutex::scoped_lock lock(matchedMutex);
+  while (matched <= index) matchedCond.wait(lock);
+}
+
+void VeloPipeline::printStatistics(std::ostream& os) const
+{
+  unsigned long frames = endToEnd.getCount();
+  double seconds = (finished - started) / 1000.0;
+
+  os << "Pipeline processed " << frames << " revolutions";
+  if (seconds > 0.0) os << " in " << seconds << " s (" << frames / seconds << " Hz)";
+  os << ", " << dropped << " dropped" << endl;
+
+  decodeTime.print(os);
+  segmentTime.print(os);
+  reduceTime.print(os);
+  matchTime.print(os);
+  endToEnd.print(os);
+
+  if (localMap) {
+    os << "Local map of " << localMap->getNrScans() << " scans with "
+       << localMap->getNrPoints() << " points" << endl;
+  }
+
+  if (rate > 0.0) {
+    long period = (long)(1000.0 / rate);
+    os << endToEnd.countAbove(period) << " of " << frames
+       << " revolutions took longer than the period of " << period << " ms" << endl;
+  }
+}
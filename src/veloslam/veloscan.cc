@@ -91,9 +91,13 @@ using std::flush;
 #endif
 #include "veloslam/velodefs.h"
 #include "veloslam/color_util.h"
+#include "slam6d/globals.icc"
 
 int scanCount =0;
 TrackerManager trackMgr;
+
+cellArray VeloScan::spareCellArray;
+vector<Point> VeloScan::spareScanPoints;
 float absf(float a)
 {
 	return a>0?a:-a;
@@ -114,6 +118,21 @@ VeloScan::VeloScan()
     isTrackerHandled =false;
 }
 
+/**
+ * Constructor for a revolution that has been read already, e.g., by the
+ * pipeline of veloslam
+ */
+VeloScan::VeloScan(double *rPos, double *rPosTheta, vector<double*> points)
+    : BasicScan(rPos, rPosTheta, points)
+{
+    isTrackerHandled =false;
+
+    // there is no file to load the point types from
+    DataType Pt(create("type", sizeof(int)*points.size()));
+    for(unsigned int i = 0; i < points.size(); ++i)
+        Pt[i] = 0;
+}
+
 /**
  * Desctuctor
  */
@@ -140,7 +159,6 @@ VeloScan::VeloScan(const VeloScan& s)
 int VeloScan::TransferToCellArray(int maxDist, int minDist)
 {
 #define  DefaultColumnSize 360
-    Point P;
     DataXYZ xyz(get("xyz"));
     int size= xyz.size();
 
@@ -153,10 +171,8 @@ int VeloScan::TransferToCellArray(int maxDist, int minDist)
     if((MaxRad-MinRad)%CellSize!=0)
         CellSize=10;
 
-    int i,j,count=0;
+    int i;
     int CellNumber=(MaxRad-MinRad)/CellSize;
-    float flag;
-    int offset;
 
     if(columnSize==0)
         return -1;
@@ -164,174 +180,38 @@ int VeloScan::TransferToCellArray(int maxDist, int minDist)
     if(columnSize%360!=0)
         columnSize=DefaultColumnSize;
 
-    int sectionSize=columnSize/8;
-
-    scanCellArray.resize(columnSize);
-    for(i=0; i<columnSize; ++i)
-        scanCellArray[i].resize(CellNumber);
-
-    float inc=(M_PI*2)/columnSize;
-
-    vector<float> tanv;
-    vector<float>::iterator result;
-
-    for(i=0; i<sectionSize; ++i)
+    // continue with the memory of the last deleted scan
+    if(scanCellArray.empty())
     {
-        tanv.push_back(tan(inc*i));
+        scanCellArray.swap(spareCellArray);
+        scanPoints.swap(spareScanPoints);
     }
 
-    int diff;
-
+    scanPoints.clear();
+    scanPoints.reserve(size);
     for(i=0; i<size; ++i)
     {
-            count++;
-            Point pt;
-            pt.x = xyz[i][0];
-            pt.y = xyz[i][1];
-            pt.z = xyz[i][2];
-
-			pt.point_id = i;  //important   for find point in  scans  ---raw points
-
-            pt.rad = sqrt(pt.x*pt.x + pt.z*pt.z);
-            pt.tan_theta = pt.z/pt.x ;
-
-            if(pt.rad <=MinRad || pt.rad>=MaxRad)
-                continue;
-
-            // some point losted which on the vline or hline
-            if(pt.x >=0 && pt.z>=0 )
-            {
-                if(pt.x > pt.z)
-                {
-                    flag= pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize-1;
-                    }
-                    else
-                    {
-                        offset=result-tanv.begin();
-                    }
-                }
-                else
-                {
-                    flag=1/pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize;
-                    }
-                    else
-                    {
-                        diff=result-tanv.begin();
-                        offset=sectionSize*2-1-(diff);
-                    }
-
-                }
-            }
-
-            else if(pt.x <= 0 && pt.z >=0)
-            {
-                if(-pt.x>pt.z)
-                {
-                    flag=-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*3;
-                    }
-                    else
-                    {
-                        offset=sectionSize*4-1-(result-tanv.begin());
-                    }
-
-                }
-                else
-                {
-                    flag=1/-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*3-1;
-                    }
-                    else
-                    {
-                        offset=sectionSize*2+(result-tanv.begin());
-                    }
-                }
-            }
-
-            else if(pt.x<=0 && pt.z<=0)
-            {
-                if(-pt.x>-pt.z)
-                {
-                    flag=pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*5-1;
-                    }
-                    else
-                    {
-                        offset=sectionSize*4+(result-tanv.begin());
-                    }
-                }
-                else
-                {
-                    flag=1/pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*5;
-                    }
-                    else
-                    {
-                        offset=sectionSize*6-1-(result-tanv.begin());
-                    }
-
-                }
-            }
-
-            else if(pt.x>=0&&pt.z<=0)
-            {
-                if(pt.x>-pt.z)
-                {
-                    flag=-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*7;
-                    }
-                    else
-                    {
-                        offset=sectionSize*8-1-(result-tanv.begin());
-                    }
-                }
-                else
-                {
-                    flag=1/-pt.tan_theta;
-                    result=upper_bound(tanv.begin(),tanv.end(),flag);
-                    if(result==tanv.end())
-                    {
-                        offset=sectionSize*7-1;
-                    }
-                    else
-                    {
-                        offset=sectionSize*6+(result-tanv.begin());
-                    }
-                }
-            }
-
-            else
-            {
-                continue;
-            }
-
-            int k= (int)((pt.rad-MinRad)/(CellSize*1.0));
-            scanCellArray[offset][k].push_back(&pt);
+        double x = xyz[i][0];
+        double z = xyz[i][2];
+        double rad = sqrt(x*x + z*z);
+
+        if(rad <=MinRad || rad>=MaxRad)
+            continue;
+
+        scanPoints.push_back(Point());
+        Point &pt = scanPoints.back();
+        pt.x = x;
+        pt.y = xyz[i][1];
+        pt.z = z;
+
+        pt.point_id = i;  //important   for find point in  scans  ---raw points
+
+        pt.rad = rad;
+        pt.tan_theta = z/x;
     }
-	return 0;
+
+    return scanCellArray.build(scanPoints, columnSize, CellNumber,
+                               MinRad, MaxRad, CellSize);
 }
 
 
@@ -439,13 +319,14 @@ int VeloScan::CalcCellFeature(cell& cellobj, cellFeature& f)
 
 int VeloScan::CalcScanCellFeature()
 {
-    int i,j;
+    int i;
 
-    if( scanCellArray.size()==0)
+    if( scanCellArray.empty())
         return -1;
 
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
+    int columnSize=scanCellArray.getColumnSize();
+    int cellNumber=scanCellArray.getCellNumber();
+    int cellCount=scanCellArray.getCellCount();
 
     if( scanCellFeatureArray.size()==0)
     {
@@ -454,30 +335,23 @@ int VeloScan::CalcScanCellFeature()
             scanCellFeatureArray[i].resize(cellNumber);
     }
 
-    for(j=0; j <columnSize; j++)
+    // all cells in one pass, each cell is independent of the others
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for(i=0; i<cellCount; i++)
     {
-        cellColumn &column=scanCellArray[j];
-        cellNumber=column.size();
-        for( i=0; i<cellNumber; i++)
-        {
-            cell &cellObj=scanCellArray[j][i];
-            cellFeature &feature=scanCellFeatureArray[j][i];
-
-			feature.columnID=j;
-			feature.cellID=i;
-
-            feature.pCell=&cellObj;
-            CalcCellFeature(cellObj,feature);
+        int column=i/cellNumber;
+        int ring=i%cellNumber;
+        cell &cellObj=scanCellArray[i];
+        cellFeature &feature=scanCellFeatureArray[column][ring];
 
-//	         if( feature.delta_y > 120)
-//             {
-//				 scanCellFeatureArray[j][i].cellType |= CELL_TYPE_STATIC;
-//				 for(int k=0;k <scanCellArray[j][i].size(); k++)
-//					 scanCellArray[j][i][k]->type |= POINT_TYPE_ABOVE_DELTA_Y;
-//
-//			 }
+        feature.columnID=column;
+        feature.cellID=ring;
 
-        }
+        feature.pCell=&cellObj;
+        CalcCellFeature(cellObj,feature);
     }
 
     return 0;
@@ -485,8 +359,8 @@ int VeloScan::CalcScanCellFeature()
 
 int VeloScan::SearchNeigh(cluster& clu,charvv& flagvv,int i,int j)
 {
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
+    int columnSize=scanCellArray.getColumnSize();
+    int cellNumber=scanCellArray.getCellNumber();
 
 	if(i==-1)
 		i= columnSize-1;
@@ -606,11 +480,11 @@ int VeloScan::FindAndCalcScanClusterFeature()
 {
     int i,j;
 
-    if( scanCellArray.size()==0)
+    if( scanCellArray.empty())
         return -1;
 
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
+    int columnSize=scanCellArray.getColumnSize();
+    int cellNumber=scanCellArray.getCellNumber();
 
     charvv searchedFlag;
     searchedFlag.resize(columnSize);
@@ -644,28 +518,16 @@ int VeloScan::FindAndCalcScanClusterFeature()
 
 void VeloScan::FreeAllCellAndCluterMemory()
 {
-    int i,j;
-    int columnSize=scanCellArray.size();
-    int cellNumber=scanCellArray[0].size();
+    int j;
 
-    for(j=0; j <columnSize; j++)
+    // hand the memory of the grid on to the next scan
+    scanCellArray.clear();
+    scanPoints.clear();
+    if(scanPoints.capacity() > spareScanPoints.capacity())
     {
-        cellColumn &column=scanCellArray[j];
-        cellFeatureColumn &columnFeature=scanCellFeatureArray[j];
-
-        cellNumber=column.size();
-        for( i=0; i<cellNumber; i++)
-        {
-            cell &cellObj=scanCellArray[j][i];
-            cellFeature &feature=scanCellFeatureArray[j][i];
-            cellObj.clear();
-
-        }
-        column.clear();
-        columnFeature.clear();
+        scanCellArray.swap(spareCellArray);
+        scanPoints.swap(spareScanPoints);
     }
-
-	scanCellArray.clear();
 	scanCellFeatureArray.clear();
     int ClusterSize=scanClusterArray.size();
     for(j=0; j <ClusterSize; j++)
@@ -942,13 +804,13 @@ void VeloScan::MarkStaticorMovingPointCloud()
 		   for( k=0; k< gcellFreature.pCell->size();++k)
 		   {
 			        // find Point in scan raw points by point_id;
-					Point p = *(gCell[k]);
+					const Point *p = gCell[k];
 				   if(gcellFreature.cellType & CELL_TYPE_STATIC)
-					   Pt[p.point_id] = POINT_TYPE_STATIC_OBJECT;
+					   Pt[p->point_id] = POINT_TYPE_STATIC_OBJECT;
     			   if(gcellFreature.cellType & CELL_TYPE_MOVING)
-					   Pt[p.point_id] = POINT_TYPE_MOVING_OBJECT;
+					   Pt[p->point_id] = POINT_TYPE_MOVING_OBJECT;
     			   if(gcellFreature.cellType & CELL_TYPE_GROUND)
-					   Pt[p.point_id] = POINT_TYPE_GROUND;
+					   Pt[p->point_id] = POINT_TYPE_GROUND;
 		   }
 
 		}
@@ -957,9 +819,17 @@ void VeloScan::MarkStaticorMovingPointCloud()
 
 void VeloScan::FindingAllofObject(int maxDist, int minDist)
 {
+	long t0 = GetCurrentTimeInMilliSec();
 	TransferToCellArray(maxDist, minDist);
+	long t1 = GetCurrentTimeInMilliSec();
 	CalcScanCellFeature();
+	long t2 = GetCurrentTimeInMilliSec();
 	FindAndCalcScanClusterFeature();
+	long t3 = GetCurrentTimeInMilliSec();
+
+	cout << "scan " << scanid << ": " << scanPoints.size() << " points in grid, "
+		 << "transfer " << t1 - t0 << " ms, cell features " << t2 - t1
+		 << " ms, clusters " << t3 - t2 << " ms" << endl;
 
     return;
  }
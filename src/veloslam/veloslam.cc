@@ -69,6 +69,8 @@
 #include "veloslam/tracker.h"
 #include "veloslam/trackermanager.h"
 #include "veloslam/intersection_detection.h"
+#include "veloslam/velopipeline.h"
+#include "veloslam/velolocalmap.h"
 
 #ifdef _MSC_VER
 #define strcasecmp _stricmp
@@ -273,6 +275,18 @@ void usage(char* prog)
     << "         use randomized octree based point reduction (pts per voxel=<NR>)" << endl
     << "         requires " << bold << "-r" << normal <<" or " << bold << "--reduce" << endl
     << endl
+    << bold << "  --pipeline" << normal << "[=NR]   [default: 4]" << endl
+    << "         process the revolutions of a velodyne log in overlapping stages," << endl
+    << "         keeping at most NR decoded revolutions in memory" << endl
+    << endl
+    << bold << "  --rate=" << normal << "NR" << endl
+    << "         with --pipeline, replay the log at NR revolutions per second and drop" << endl
+    << "         revolutions the pipeline cannot keep up with" << endl
+    << endl
+    << bold << "  --localmap" << normal << "[=NR]   [default: 6]" << endl
+    << "         register each scan against a map of the static points of the last" << endl
+    << "         NR scans instead of the previous scan, the map is updated incrementally" << endl
+    << endl
     << bold << "  -p, --trustpose" << normal << endl
     << "         Trust the pose file, do not extrapolate the last transformation." << endl
     << "         (just for testing purposes, or gps input.)" << endl
@@ -403,6 +417,9 @@ void parseFormatFile(string& dir, WriteOnce<IOType>& type, WriteOnce<int>& start
  * @param lum6DAlgo specifies the used algorithm for global SLAM correction
  * @param loopsize defines the minimal loop size
  * @param tracking select sematic algorithm of none/classification/tracking on/off the point classification mode
+ * @param pipeline number of revolutions in the ring buffer of the pipeline, 0 to process the scans one after the other
+ * @param rate replay rate of the pipeline in revolutions per second, 0 to read as fast as possible
+ * @param localmap number of scans in the local map to register against, 0 to register against the previous scan
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
@@ -412,7 +429,7 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     int &mni_lum, string &net, double &cldist, int &clpairs, int &loopsize,int &trackingAlgo,
     double &epsilonICP, double &epsilonSLAM,  int &nns_method, bool &exportPts, double &distLoop,
     int &iterLoop, double &graphDist, int &octree, bool &cuda_enabled, IOType &type,
-    bool& scanserver)
+    bool& scanserver, int &pipeline, double &rate, int &localmap)
 {
   int  c;
   // from unistd.h:
@@ -462,6 +479,9 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     { "cuda",            no_argument,         0,  'u' }, // cuda will be enabled
 	{ "trackingAlgo",    required_argument,   0,    'y'},//tracking algorithm
     { "scanserver",      no_argument,         0,  'S' },
+    { "pipeline",        optional_argument,   0,  '7' }, // use the long format only
+    { "rate",            required_argument,   0,  '0' }, // use the long format only
+    { "localmap",        optional_argument,   0,  'w' }, // use the long format only
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
@@ -613,6 +633,23 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
       case 'u':
         cuda_enabled = true;
         break;
+      case '7':  // = --pipeline
+        if (optarg) {
+          pipeline = atoi(optarg);
+        } else {
+          pipeline = 4;
+        }
+        break;
+      case '0':  // = --rate
+        rate = atof(optarg);
+        break;
+      case 'w':  // = --localmap
+        if (optarg) {
+          localmap = atoi(optarg);
+        } else {
+          localmap = sliding_window_size;
+        }
+        break;
       case 'S':
         scanserver = true;  // maybe some errors.
         break;
@@ -988,7 +1025,7 @@ int   FinalSLAM( double &red, int &rand,
 	return 0;
   }
 
-void MatchTwoScan(icp6D *my_icp, VeloScan* currentScan, int scanCount, bool eP )
+void MatchTwoScan(icp6D *my_icp, VeloScan* currentScan, int scanCount, bool eP, VeloLocalMap *localMap)
 {
          Scan *PreviousScan = 0;
   		//////////////////////ICP//////////////////////
@@ -999,8 +1036,14 @@ void MatchTwoScan(icp6D *my_icp, VeloScan* currentScan, int scanCount, bool eP )
 				if (eP)
 					currentScan->mergeCoordinatesWithRoboterPosition(PreviousScan);
 
-   				my_icp->match(PreviousScan, currentScan);
+				if (localMap)
+					localMap->match(my_icp, currentScan);
+				else
+					my_icp->match(PreviousScan, currentScan);
 		}
+		// the map takes the registered static points
+		if (localMap)
+			localMap->insert(currentScan);
 }
 /**
  * Main program for 6D SLAM.
@@ -1063,13 +1106,16 @@ int main(int argc, char **argv)
   IOType type  = UOS;
   int trackingAlgo=0;
   bool scanserver = false;
+  int pipeline = 0;
+  double rate = 0.0;
+  int localmap = 0;
 
   parseArgs(argc, argv, dir, red, rand, mdm, mdml, mdmll, mni, start, end,
       maxDist, minDist, quiet, veryQuiet, eP, meta, algo, tracking,
       loopSlam6DAlgo, lum6DAlgo, anim,
       mni_lum, net, cldist, clpairs, loopsize, trackingAlgo,epsilonICP, epsilonSLAM,
       nns_method, exportPts, distLoop, iterLoop, graphDist, octree, cuda_enabled, type,
-      scanserver);
+      scanserver, pipeline, rate, localmap);
 	  
 
   cout << "VeloSLAM will proceed with the following parameters:" << endl;
@@ -1087,6 +1133,20 @@ int main(int argc, char **argv)
 	   exit(0);
 	}
 
+  if(pipeline > 0) {
+    VeloPipeline velopipeline(my_icp, eP, tracking, trackingAlgo, maxDist, minDist,
+                              red, octree, nns_method, cuda_enabled, pipeline, rate,
+                              localmap, 2 * mdm);
+    velopipeline.run(dir, type, start, end);
+    velopipeline.printStatistics(cout);
+
+    BasicScan::closeDirectory();
+    delete my_icp6Dminimizer;
+    delete my_icp;
+    cout << endl << "Normal program end." << endl;
+    return 0;
+  }
+
   Scan::openDirectory(scanserver, dir, type, start, end);
   
   if(VeloScan::allScans.size() == 0) {
@@ -1094,6 +1154,12 @@ int main(int argc, char **argv)
     exit(-1);
   }
   
+    // voxels of twice the matching distance, points at the resolution
+    // of the reduced points
+    VeloLocalMap *localMap = 0;
+    if (localmap > 0)
+        localMap = new VeloLocalMap(2 * mdm, red, localmap);
+
     double eu[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
     vector <Point> ptss;
 	veryQuiet =true;
@@ -1138,14 +1204,16 @@ int main(int argc, char **argv)
              currentScan->calcReducedPoints_byClassifi(red, octree, PointType());
          }
 
-		 currentScan->createSearchTree();
+		 // the scan is only the model of a match without the map
+		 if (!localMap)
+		     currentScan->createSearchTree();
 #ifdef  NO_SLIDING_WINDOW
-		MatchTwoScan(my_icp,  currentScan,  scanCount,  eP);
+		MatchTwoScan(my_icp,  currentScan,  scanCount,  eP, localMap);
 #else
          if(current_sliding_window_pos > sliding_window_size )
-    		    MatchTwoScan(my_icp,  currentScan,  sliding_window_size,  eP);
+    		    MatchTwoScan(my_icp,  currentScan,  sliding_window_size,  eP, localMap);
          else
-                MatchTwoScan(my_icp,  currentScan,  scanCount,  eP);
+                MatchTwoScan(my_icp,  currentScan,  scanCount,  eP, localMap);
 #endif
 
       // update the cluster position in trakers.
@@ -1217,6 +1285,7 @@ int main(int argc, char **argv)
   
     Scan::closeDirectory();
 
+    if (localMap) delete localMap;
 	delete my_icp6Dminimizer;
     delete my_icp;
 